@@ -10,11 +10,22 @@ SCLOrkConfab {
 	classvar listFoundFunc;
 	classvar listErrorFunc;
 	classvar listItemsFunc;
+	classvar listSizeResultFunc;
+	classvar listPrefetchedFunc;
+	classvar listPinnedFunc;
+	classvar cacheStatsFunc;
+	classvar assetSearchResultsFunc;
+	classvar listSearchResultsFunc;
 
 	classvar addCallbackMap;
 	classvar findCallbackMap;
 	classvar loadCallbackMap;
 	classvar listCallbackMap;
+	classvar listSizeCallbackMap;
+	classvar prefetchCallbackMap;
+	classvar pinCallbackMap;
+	classvar cacheStatsCallbacks;
+	classvar searchCallbackMap;
 
 	*start { |
 		confabBindPort = 4248,
@@ -27,6 +38,10 @@ SCLOrkConfab {
 		findCallbackMap = IdentityDictionary.new;
 		loadCallbackMap = IdentityDictionary.new;
 		listCallbackMap = IdentityDictionary.new;
+		listSizeCallbackMap = IdentityDictionary.new;
+		prefetchCallbackMap = IdentityDictionary.new;
+		pinCallbackMap = IdentityDictionary.new;
+		searchCallbackMap = Dictionary.new;
 
 		SCLOrkConfab.prBindResponseMessages(scBindPort);
 		SCLOrkConfab.prStartConfab;
@@ -54,6 +69,13 @@ SCLOrkConfab {
 		confab.sendMsg('/assetFindName', name);
 	}
 
+	// Searches Asset names for query. If fuzzy is true, matches similar names ignoring case, otherwise matches names
+	// beginning with query. Callback is called with the query and an Array of [key, name] pairs.
+	*searchAssets { |query, callback, fuzzy = true, maxResults = 20|
+		searchCallbackMap.put(['asset', query.asString], callback);
+		confab.sendMsg('/assetSearch', query, if (fuzzy, { "fuzzy" }, { "prefix" }), maxResults);
+	}
+
 	*loadAssetById { |id, callback|
 		loadCallbackMap.put(id, callback);
 		confab.sendMsg('/assetLoad', id);
@@ -74,6 +96,79 @@ SCLOrkConfab {
 		confab.sendMsg('/listNext', listId, fromToken);
 	}
 
+	// Fetches items before fromToken, most recent first. Pass "ffffffffffffffff" as fromToken to start from the most
+	// recently added item.
+	*getListPrev { |listId, fromToken, callback|
+		listCallbackMap.put(listId, callback);
+		confab.sendMsg('/listPrev', listId, fromToken);
+	}
+
+	// Fetches items starting at a position in the list, where 0 is the first item.
+	*getListAt { |listId, offset, callback|
+		listCallbackMap.put(listId, callback);
+		confab.sendMsg('/listAt', listId, offset);
+	}
+
+	// Callback is called with the list id and the number of items in the list.
+	*getListSize { |listId, callback|
+		listSizeCallbackMap.put(listId.asSymbol, callback);
+		confab.sendMsg('/listSize', listId);
+	}
+
+	// Downloads the file Assets in a list into the cache in the background, so that loading them later is fast. Stops
+	// after budgetMB megabytes, or uses confab's configured budget if budgetMB is nil. Callback is called with the list
+	// id, a status of "complete", "cancelled", "overBudget" or "listError", and the number of Assets downloaded, already
+	// cached, and failed.
+	*prefetchList { |listId, callback, budgetMB = nil|
+		prefetchCallbackMap.put(listId.asSymbol, callback);
+		if (budgetMB.notNil, {
+			confab.sendMsg('/listPrefetch', listId, budgetMB.asInteger);
+		}, {
+			confab.sendMsg('/listPrefetch', listId);
+		});
+	}
+
+	// Stops prefetching a list, or every list if listId is nil.
+	*cancelPrefetch { |listId = nil|
+		confab.sendMsg('/listPrefetchCancel', if (listId.notNil, { listId }, { "" }));
+	}
+
+	// Pins the file Assets in a list in the cache, so they are never evicted, and downloads any not yet cached. Callback
+	// is called as with prefetchList once the downloads end. Pins are kept across restarts of confab until unpinned.
+	*pinList { |listId, callback|
+		pinCallbackMap.put(listId.asSymbol, callback);
+		confab.sendMsg('/listPin', listId);
+	}
+
+	// Allows the Assets pinned by pinList to be evicted again, unless pinned some other way.
+	*unpinList { |listId|
+		confab.sendMsg('/listUnpin', listId);
+	}
+
+	// Pins a file Asset in the cache, and downloads it in the background if it is not yet cached.
+	*pinAsset { |assetId|
+		confab.sendMsg('/assetPin', assetId);
+	}
+
+	// Allows an Asset pinned by pinAsset to be evicted again, unless pinned some other way.
+	*unpinAsset { |assetId|
+		confab.sendMsg('/assetUnpin', assetId);
+	}
+
+	// Callback is called with an IdentityDictionary of file cache statistics by name, such as \hits, \misses,
+	// \hit_rate, \size_bytes and \free_disk_bytes, counted since confab started. Latencies, \latency_chunk_download
+	// and \latency_asset_download, are themselves IdentityDictionaries of \count, \mean_us, \p50_us, \p90_us,
+	// \p99_us and \p999_us.
+	*getCacheStats { |callback|
+		cacheStatsCallbacks = cacheStatsCallbacks.add(callback);
+		confab.sendMsg('/cacheStats');
+	}
+
+	*searchLists { |query, callback, fuzzy = true, maxResults = 20|
+		searchCallbackMap.put(['list', query.asString], callback);
+		confab.sendMsg('/listSearch', query, if (fuzzy, { "fuzzy" }, { "prefix" }), maxResults);
+	}
+
 	*isConfabRunning {
 		if (confabPid.notNil, {
 			^confabPid.pidRunning;
@@ -194,6 +289,96 @@ SCLOrkConfab {
 		},
 		'/listItems',
 		recvPort: recvPort);
+
+		listSizeResultFunc = OSCFunc.new({ |msg, time, addr|
+			var listId = msg[1];
+			var size = msg[2];
+			var callback = listSizeCallbackMap.at(listId);
+			if (callback.notNil, {
+				listSizeCallbackMap.removeAt(listId);
+				callback.value(listId, size);
+			}, {
+				"confab /listSizeResult got callback on missing item %".format(listId).postln;
+			});
+		},
+		'/listSizeResult',
+		recvPort: recvPort);
+
+		listPrefetchedFunc = OSCFunc.new({ |msg, time, addr|
+			var listId = msg[1];
+			var status = msg[2];
+			var downloaded = msg[3];
+			var cached = msg[4];
+			var failed = msg[5];
+			var callback = prefetchCallbackMap.at(listId);
+			if (callback.notNil, {
+				prefetchCallbackMap.removeAt(listId);
+				callback.value(listId, status, downloaded, cached, failed);
+			});
+		},
+		'/listPrefetched',
+		recvPort: recvPort);
+
+		listPinnedFunc = OSCFunc.new({ |msg, time, addr|
+			var listId = msg[1];
+			var callback = pinCallbackMap.at(listId);
+			if (callback.notNil, {
+				pinCallbackMap.removeAt(listId);
+				callback.value(listId, msg[2], msg[3], msg[4], msg[5]);
+			});
+		},
+		'/listPinned',
+		recvPort: recvPort);
+
+		cacheStatsFunc = OSCFunc.new({ |msg, time, addr|
+			var stats = IdentityDictionary.new;
+			var callbacks = cacheStatsCallbacks;
+			msg[1].asString.split($\n).do({ |line|
+				var fields = line.split($ );
+				if (fields.size == 2, {
+					stats.put(fields[0].asSymbol, if (fields[0] == "policy", { fields[1] }, { fields[1].asFloat }));
+				}, {
+					if (fields.size > 2, {
+						var latency = IdentityDictionary.new;
+						(1, 3 .. fields.size - 2).do({ |i|
+							latency.put(fields[i].asSymbol, fields[i + 1].asFloat);
+						});
+						stats.put(fields[0].asSymbol, latency);
+					});
+				});
+			});
+			cacheStatsCallbacks = nil;
+			callbacks.do({ |callback| callback.value(stats) });
+		},
+		'/cacheStats',
+		recvPort: recvPort);
+
+		assetSearchResultsFunc = OSCFunc.new({ |msg, time, addr|
+			SCLOrkConfab.prOnSearchResults('asset', msg[1], msg[2]);
+		},
+		'/assetSearchResults',
+		recvPort: recvPort);
+
+		listSearchResultsFunc = OSCFunc.new({ |msg, time, addr|
+			SCLOrkConfab.prOnSearchResults('list', msg[1], msg[2]);
+		},
+		'/listSearchResults',
+		recvPort: recvPort);
+	}
+
+	*prOnSearchResults { |table, query, results|
+		var callbackKey = [table, query.asString];
+		var callback = searchCallbackMap.at(callbackKey);
+		var matches = results.asString.split($\n).reject({ |line| line.isEmpty }).collect({ |line|
+			var space = line.indexOf($ );
+			[line.copyRange(0, space - 1).asSymbol, line.copyToEnd(space + 1)];
+		});
+		if (callback.notNil, {
+			searchCallbackMap.removeAt(callbackKey);
+			callback.value(query, matches);
+		}, {
+			"confab got % search results on missing query %".format(table, query).postln;
+		});
 	}
 
 	*prStartConfab { |
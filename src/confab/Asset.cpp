@@ -60,6 +60,7 @@ Asset::Asset(Asset::Type type) :
     m_deprecates(0),
     m_size(0),
     m_chunks(0),
+    m_manifestPages(0),
     m_salt(0),
     m_inlineData(nullptr) {
 }
@@ -72,6 +73,7 @@ Asset::Asset(const Data::FlatAsset* flatAsset)  :
     m_deprecates(flatAsset->deprecates()),
     m_size(flatAsset->size()),
     m_chunks(flatAsset->chunks()),
+    m_manifestPages(flatAsset->manifestPages()),
     m_salt(flatAsset->salt()) {
 
     if (flatAsset->name()) {
@@ -133,6 +135,9 @@ void Asset::flatten(flatbuffers::FlatBufferBuilder& builder, const uint8_t* inli
     if (m_salt) {
         assetBuilder.add_salt(m_salt);
     }
+    if (m_manifestPages) {
+        assetBuilder.add_manifestPages(m_manifestPages);
+    }
     if (!builderInline.IsNull()) {
         assetBuilder.add_inlineData(builderInline);
     }
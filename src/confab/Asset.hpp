@@ -186,6 +186,18 @@ public:
      */
     uint64_t chunks() const { return m_chunks; }
 
+    /*! Sets the number of manifest pages of a content-chunked Asset, see ContentChunker.
+     *
+     * \param manifestPages The number of manifest pages, or zero if the Asset data is stored in fixed-size chunks.
+     */
+    void setManifestPages(uint64_t manifestPages) { m_manifestPages = manifestPages; }
+
+    /*! The number of manifest pages stored in place of AssetData chunks, for content-chunked Assets.
+     *
+     * \return The number of manifest pages, or zero if the Asset data is stored in fixed-size chunks.
+     */
+    uint64_t manifestPages() const { return m_manifestPages; }
+
     /*! Adds a salt value to the Asset.
      *
      * \param salt The salt value to add. It will be used as the starting state in hash computations.
@@ -255,6 +267,7 @@ private:
     uint64_t m_deprecates;
     uint64_t m_size;
     uint64_t m_chunks;
+    uint64_t m_manifestPages;
     std::vector<uint64_t> m_lists;
 
     uint64_t m_salt;
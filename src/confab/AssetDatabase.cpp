@@ -1,19 +1,28 @@
 #include "AssetDatabase.hpp"
 
 #include "Asset.hpp"
+#include "Backup.hpp"
+#include "Catalog.hpp"
 #include "Constants.hpp"
+#include "ContentChunker.hpp"
+#include "StorageEngine.hpp"
+#include "ThreadPool.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 #include "schemas/FlatList_generated.h"
 
 #include "glog/logging.h"
-#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
+#include "xxhash.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstring>
+#include <limits>
+#include <unordered_map>
 
 namespace {
 
@@ -61,7 +70,21 @@ enum KeyPrefix : char {
     /*! Prefix for List name entries. Key is the kListEntry prefix, followed by 8 bytes of the List key, followed by
      * an 8-byte timestamp, then the final 8 bytes of Asset key. There are no data associated with these keys.
      */
-    kListEntry = 'e'
+    kListEntry = 'e',
+
+    /*! Prefix for internal server state records. Key is the kInternal prefix, followed by the record name.
+     */
+    kInternal = 'i',
+
+    /*! Prefix for change feed records. Key is the kChangeFeed prefix, followed by 8 bytes of the sequence number in
+     * big-endian order, so that the database orders records by sequence number.
+     */
+    kChangeFeed = 'f',
+
+    /*! Prefix for content chunk entries, holding the data of content-chunked Assets. Key is the kContentChunk prefix,
+     * followed by 8 bytes of the XXH64 hash of the chunk data.
+     */
+    kContentChunk = 'k'
 };
 
 static const char* kAssetNamePrefix = "na";
@@ -71,6 +94,32 @@ static const char* kListNamePrefix = "nl";
  */
 static const size_t kAssetMaxListEntries = 8;
 
+/*! How long a list cursor may go unread before it expires, unless changed with setListCursorTimeout().
+ */
+static const std::chrono::seconds kDefaultListCursorTimeout(60);
+
+/*! Maximum number of open list cursors. Each holds a database snapshot, which keeps LevelDB from discarding
+ * overwritten and deleted entries during compaction, so the number open at once is bounded.
+ */
+static const size_t kMaxListCursors = 256;
+
+/*! Size of a change feed record key, one byte of kChangeFeed prefix followed by the 8-byte sequence number.
+ */
+static const size_t kChangeFeedKeySize = 9;
+
+/*! Size of a content chunk key, one byte of kContentChunk prefix followed by the 8-byte content hash.
+ */
+static const size_t kContentChunkKeySize = 9;
+
+/*! Key prefixes reported on by AssetDatabase::getPrefixStats().
+ */
+static const char* kStatsPrefixes[] = { "a", "d", "k", "l", "e", "na", "nl", "i", "f" };
+
+/*! Names of the AssetDatabase::Operation values, as used in AssetDatabase::statsReport().
+ */
+static const char* kOperationNames[] = { "find_asset", "store_asset", "load_data_chunk", "store_data_chunk",
+    "find_name", "load_list", "store_list", "read_list" };
+
 /*! Writes a byte sequence in keyOut suitable for storing or retrieving an Asset record from the database.
  *
  * \param key The key to format.
@@ -93,17 +142,175 @@ inline void makeAssetDataKey(uint64_t key, uint64_t chunkNumber, char* keyOut) n
     std::memcpy(keyOut + 9, reinterpret_cast<const char*>(&chunkNumber), sizeof(uint64_t));
 }
 
+inline void makeContentChunkKey(uint64_t hash, char* keyOut) noexcept {
+    keyOut[0] = kContentChunk;
+    std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&hash), sizeof(uint64_t));
+}
+
 inline void makeListKey(uint64_t key, char* keyOut) noexcept {
     keyOut[0] = kList;
     std::memcpy(keyOut + 1, reinterpret_cast<const char*>(&key), sizeof(uint64_t));
 }
 
+inline void makeChangeFeedKey(uint64_t sequence, char* keyOut) noexcept {
+    keyOut[0] = kChangeFeed;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        keyOut[8 - i] = static_cast<char>((sequence >> (8 * i)) & 0xff);
+    }
+}
+
+inline uint64_t parseChangeFeedKey(const leveldb::Slice& key) noexcept {
+    uint64_t sequence = 0;
+    for (size_t i = 1; i < kChangeFeedKeySize; ++i) {
+        sequence = (sequence << 8) | static_cast<uint8_t>(key[i]);
+    }
+    return sequence;
+}
+
+/*! Serializes the operations in a WriteBatch into a change feed record.
+ *
+ * A record is the XXH64 hash of the rest of the record, followed by each operation in order. An operation is a 'p' for
+ * Put or 'd' for Delete, followed by a 4-byte key size and the key, then for Put a 4-byte value size and the value.
+ */
+class ChangeFeedEncoder : public leveldb::WriteBatch::Handler {
+public:
+    ChangeFeedEncoder() : m_record(sizeof(uint64_t), '\0') { }
+    ~ChangeFeedEncoder() override { }
+
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+        m_record.push_back('p');
+        appendSlice(key);
+        appendSlice(value);
+    }
+
+    void Delete(const leveldb::Slice& key) override {
+        m_record.push_back('d');
+        appendSlice(key);
+    }
+
+    bool empty() const { return m_record.size() == sizeof(uint64_t); }
+
+    std::string finish() {
+        uint64_t hash = XXH64(m_record.data() + sizeof(uint64_t), m_record.size() - sizeof(uint64_t), 0);
+        std::memcpy(&m_record[0], &hash, sizeof(uint64_t));
+        return std::move(m_record);
+    }
+
+private:
+    void appendSlice(const leveldb::Slice& slice) {
+        uint32_t size = static_cast<uint32_t>(slice.size());
+        m_record.append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+        m_record.append(slice.data(), slice.size());
+    }
+
+    std::string m_record;
+};
+
+/*! A single operation decoded from a change feed record, pointing into the record.
+ */
+struct ChangeFeedOperation {
+    bool put;
+    leveldb::Slice key;
+    leveldb::Slice value;
+};
+
+/*! Parses a change feed record made by ChangeFeedEncoder. Returns false if the record is truncated or fails its hash.
+ */
+bool decodeChangeFeedRecord(const Confab::SizedPointer& record, std::vector<ChangeFeedOperation>* operations) {
+    const char* data = record.dataChar();
+    size_t size = record.size();
+    if (size < sizeof(uint64_t)) {
+        return false;
+    }
+    uint64_t hash = 0;
+    std::memcpy(&hash, data, sizeof(uint64_t));
+    if (XXH64(data + sizeof(uint64_t), size - sizeof(uint64_t), 0) != hash) {
+        return false;
+    }
+
+    auto readSlice = [data, size](size_t* offset, leveldb::Slice* slice) {
+        uint32_t sliceSize = 0;
+        if (*offset + sizeof(uint32_t) > size) {
+            return false;
+        }
+        std::memcpy(&sliceSize, data + *offset, sizeof(uint32_t));
+        *offset += sizeof(uint32_t);
+        if (*offset + sliceSize > size) {
+            return false;
+        }
+        *slice = leveldb::Slice(data + *offset, sliceSize);
+        *offset += sliceSize;
+        return true;
+    };
+
+    size_t offset = sizeof(uint64_t);
+    while (offset < size) {
+        ChangeFeedOperation operation;
+        char type = data[offset++];
+        if (type != 'p' && type != 'd') {
+            return false;
+        }
+        operation.put = type == 'p';
+        if (!readSlice(&offset, &operation.key) || (operation.put && !readSlice(&offset, &operation.value))) {
+            return false;
+        }
+        operations->push_back(operation);
+    }
+    return true;
+}
+
 inline bool iteratorMatch(std::shared_ptr<leveldb::Iterator> iterator, char* key, size_t keySize) noexcept {
     return iterator->Valid() &&
            iterator->key().size() == keySize &&
            std::memcmp(key, iterator->key().data(), keySize) == 0;
 }
 
+/*! Points iterator at the list entry for fromToken, or at the begin sentinel if fromToken is 0, so that the entry
+ * after it is the next to read. Returns false if the list is not found.
+ */
+bool seekListToken(leveldb::Iterator* iterator, uint64_t listKey, uint64_t fromToken) {
+    std::array<char, kListEntryKeySize> listEntryKey;
+    listEntryKey[0] = kListEntry;
+    std::memcpy(listEntryKey.data() + 1, &listKey, sizeof(uint64_t));
+    std::memcpy(listEntryKey.data() + 9, &fromToken, sizeof(uint64_t));
+    std::memcpy(listEntryKey.data() + 17, &Confab::kBeginList, sizeof(uint64_t));
+    iterator->Seek(leveldb::Slice(listEntryKey.data(), kListEntryKeySize));
+    if (!iterator->Valid()) {
+        LOG(ERROR) << "error finding first element token: " << Confab::Asset::keyToString(fromToken) << " in list: "
+            << Confab::Asset::keyToString(listKey);
+        return false;
+    }
+    return true;
+}
+
+/*! Advances iterator through the entries of a list, copying up to maxPairs <token, key> pairs into listOut. Stops
+ * after the end sentinel. Returns the number of pairs copied, or 0 on error.
+ */
+size_t readListEntries(leveldb::Iterator* iterator, uint64_t listKey, size_t maxPairs, uint64_t* listOut) {
+    size_t pairs = 0;
+    while (pairs < maxPairs) {
+        iterator->Next();
+        if (!iterator->Valid()) {
+            LOG(ERROR) << "error finding list " << Confab::Asset::keyToString(listKey) << " for iteration.";
+            return 0;
+        }
+        // We only compare the first 9 bytes of the list key, to make sure the prefix and key match.
+        if (iterator->key().size() != kListEntryKeySize || iterator->key()[0] != kListEntry ||
+            std::memcmp(iterator->key().data() + 1, &listKey, sizeof(uint64_t)) != 0) {
+            LOG(INFO) << "walked off end of list " << Confab::Asset::keyToString(listKey) << " after " << pairs
+                << " pairs.";
+            break;
+        }
+
+        std::memcpy(listOut + (pairs * 2), iterator->key().data() + 9, sizeof(uint64_t) * 2);
+        ++pairs;
+        if (listOut[(pairs * 2) - 2] == Confab::kEndList) {
+            break;
+        }
+    }
+    return pairs;
+}
+
 }  // namespace
 
 namespace Confab {
@@ -160,44 +367,51 @@ private:
 
 
 AssetDatabase::AssetDatabase() :
-    m_database(nullptr) {
+    m_database(nullptr),
+    m_gcQuit(false),
+    m_listCursorTimeout(kDefaultListCursorTimeout),
+    m_listCursorIds(std::random_device()()),
+    m_feedSequence(0),
+    m_feedRetention(0) {
 }
 
 AssetDatabase::~AssetDatabase() {
+    stopGarbageCollector();
 }
 
-bool AssetDatabase::open(const char* path, bool createNew, int cacheSize) {
-    leveldb::Options options;
-    options.create_if_missing = createNew;
-    options.error_if_exists = createNew;
-    if (cacheSize > 0) {
-        options.block_cache = leveldb::NewLRUCache(cacheSize);
+bool AssetDatabase::open(const char* path, bool createNew, int cacheSize, const std::string& storageEngine) {
+    m_database = makeStorageEngine(storageEngine);
+    if (!m_database) {
+        LOG(ERROR) << "Unknown storage engine '" << storageEngine << "'.";
+        return false;
     }
-
-    leveldb::DB* database = nullptr;
-
-    leveldb::Status status = leveldb::DB::Open(options, path, &database);
-    if (!status.ok()) {
-        LOG(ERROR) << "Failure opening or creating database at '" << path << "'. LevelDB status: " << status.ToString();
+    if (!m_database->open(path, createNew, cacheSize)) {
+        m_database.reset();
         return false;
-    } else {
-        LOG(INFO) << "Opened database file at '" << path << "'.";
     }
 
-    m_database.reset(database);
-
+    loadIndices();
     return true;
 }
 
 void AssetDatabase::close() {
+    stopGarbageCollector();
+    {
+        std::lock_guard<std::mutex> lock(m_listCursorMutex);
+        m_listCursors.clear();
+    }
     m_database.reset();
+    m_assetNames.clear();
+    m_listNames.clear();
+    m_listEntries.clear();
 }
 
 RecordPtr AssetDatabase::findAsset(uint64_t key) {
+    LatencyHistogram::Timer timer(&m_latency[kFindAsset]);
     std::array<char, kAssetKeySize> assetKey;
     makeAssetKey(key, assetKey.data());
 
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
     iterator->Seek(leveldb::Slice(assetKey.data(), kAssetKeySize));
     if (!iteratorMatch(iterator, assetKey.data(), kAssetKeySize)) {
         LOG(ERROR) << "Asset " << Asset::keyToString(key) << " not found in database.";
@@ -225,9 +439,10 @@ RecordPtr AssetDatabase::findAsset(uint64_t key) {
 }
 
 RecordPtr AssetDatabase::findNamedAsset(const std::string& name) {
+    LatencyHistogram::Timer timer(&m_latency[kFindName]);
     // Look up name entry, if any.
     std::string nameKey = kAssetNamePrefix + name;
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
     iterator->Seek(nameKey);
     if (!iteratorMatch(iterator, nameKey.data(), nameKey.size())) {
         LOG(WARNING) << "no named asset found under name " << name;
@@ -240,43 +455,29 @@ RecordPtr AssetDatabase::findNamedAsset(const std::string& name) {
     return findAsset(assetKey);
 }
 
-bool AssetDatabase::storeAsset(uint64_t key, const SizedPointer& assetData) {
-    leveldb::WriteBatch batch;
-
-    // First we parse the Asset data to extract the name, if any.
-    const Data::FlatAsset* flatAsset = Data::GetFlatAsset(assetData.data());
-    // This string, name has to live as long as the call to the database write(), so lives out here.
-    std::string name;
-    if (flatAsset->name() && flatAsset->name()->size() > 0) {
-        name = kAssetNamePrefix + flatAsset->name()->str();
-        LOG(INFO) << "adding name '" << flatAsset->name()->data() << "' lookup to asset " << Asset::keyToString(key);
-        batch.Put(name, leveldb::Slice(reinterpret_cast<const char*>(&key), sizeof(uint64_t)));
-    }
-
-    // Add any list entries to the batch.
-    char listKeys[kListEntryKeySize * kAssetMaxListEntries];
-    uint64_t timeStamp = flatAsset->lists()->size() ?
-        std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch()).count() : 0;
-    for (auto i = 0; i < flatAsset->lists()->size(); ++i) {
-        char* listKey = listKeys + (i * kListEntryKeySize);
-        listKey[0]  = kListEntry;
-        std::memcpy(listKey + 1, flatAsset->lists()->data() + i, sizeof(uint64_t));
-        std::memcpy(listKey + 9, &timeStamp, sizeof(uint64_t));
-        std::memcpy(listKey + 17, &key, sizeof(uint64_t));
-        LOG(INFO) << "adding asset " << Asset::keyToString(key) << " to list " << Asset::keyToString(
-            flatAsset->lists()->data()[i]);
-        batch.Put(leveldb::Slice(listKey, kListEntryKeySize), leveldb::Slice());
+size_t AssetDatabase::searchAssetNames(const std::string& query, bool fuzzy, size_t maxResults,
+    std::vector<NameIndex::Match>* matches) {
+    if (fuzzy) {
+        return m_assetNames.search(query, maxResults, matches);
     }
+    return scanNamePrefix(kAssetNamePrefix, query, maxResults, matches);
+}
 
-    // Store actual Asset key/value pair.
-    std::array<char, kAssetKeySize> assetKey;
-    makeAssetKey(key, assetKey.data());
-    batch.Put(leveldb::Slice(assetKey.data(), kAssetKeySize), leveldb::Slice(assetData.dataChar(), assetData.size()));
+bool AssetDatabase::storeAsset(uint64_t key, const SizedPointer& assetData) {
+    LatencyHistogram::Timer timer(&m_latency[kStoreAsset]);
+    leveldb::WriteBatch batch;
+    std::vector<ListIndex::Entry> listEntries;
+    std::string name = addAssetToBatch(key, assetData, &batch, &listEntries);
 
-    auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+    auto status = writeBatch(leveldb::WriteOptions(), &batch);
     if (status.ok()) {
         LOG(INFO) << "Asset store " << Asset::keyToString(key) << " success.";
+        if (name.size()) {
+            m_assetNames.insert(name, key);
+        }
+        for (const auto& entry : listEntries) {
+            m_listEntries.insert(entry);
+        }
     } else {
         LOG(ERROR) << "Failed to store Asset " << Asset::keyToString(key) << " in database, status: "
             << status.ToString();
@@ -286,9 +487,10 @@ bool AssetDatabase::storeAsset(uint64_t key, const SizedPointer& assetData) {
 }
 
 RecordPtr AssetDatabase::loadAssetDataChunk(uint64_t key, uint64_t chunk) {
+    LatencyHistogram::Timer timer(&m_latency[kLoadDataChunk]);
     std::array<char, kAssetDataKeySize> assetDataKey;
     makeAssetDataKey(key, chunk, assetDataKey.data());
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
     iterator->Seek(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize));
     if (!iteratorMatch(iterator, assetDataKey.data(), kAssetDataKeySize)) {
         LOG(ERROR) << "asset Data " << Asset::keyToString(key) << " chunk: " << chunk << " not found.";
@@ -300,10 +502,13 @@ RecordPtr AssetDatabase::loadAssetDataChunk(uint64_t key, uint64_t chunk) {
 }
 
 bool AssetDatabase::storeAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData) {
+    LatencyHistogram::Timer timer(&m_latency[kStoreDataChunk]);
     std::array<char, kAssetDataKeySize> assetDataKey;
     makeAssetDataKey(key, chunk, assetDataKey.data());
-    auto status = m_database->Put(leveldb::WriteOptions(), leveldb::Slice(assetDataKey.data(), kAssetDataKeySize),
+    leveldb::WriteBatch batch;
+    batch.Put(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize),
         leveldb::Slice(flatAssetData.dataChar(), flatAssetData.size()));
+    auto status = writeBatch(leveldb::WriteOptions(), &batch);
 
     if (status.ok()) {
         LOG(INFO) << "Asset Data store " << Asset::keyToString(key) << " chunk " << chunk << " success.";
@@ -315,7 +520,146 @@ bool AssetDatabase::storeAssetDataChunk(uint64_t key, uint64_t chunk, const Size
     return status.ok();
 }
 
+RecordPtr AssetDatabase::loadContentChunk(uint64_t hash) {
+    LatencyHistogram::Timer timer(&m_latency[kLoadDataChunk]);
+    std::array<char, kContentChunkKeySize> contentChunkKey;
+    makeContentChunkKey(hash, contentChunkKey.data());
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(contentChunkKey.data(), kContentChunkKeySize));
+    if (!iteratorMatch(iterator, contentChunkKey.data(), kContentChunkKeySize)) {
+        LOG(ERROR) << "content chunk " << Asset::keyToString(hash) << " not found.";
+        return makeEmptyRecord();
+    }
+    return RecordPtr(new DatabaseRecord(iterator));
+}
+
+bool AssetDatabase::storeContentChunk(uint64_t hash, const SizedPointer& flatAssetData) {
+    LatencyHistogram::Timer timer(&m_latency[kStoreDataChunk]);
+    // A chunk stored under the wrong hash would corrupt every Asset sharing it, so check it here as well as on receipt.
+    const Data::FlatAssetData* flatData = Data::GetFlatAssetData(flatAssetData.data());
+    if (!flatData->data() || flatData->hash() != hash ||
+        XXH64(flatData->data()->data(), flatData->data()->size(), 0) != hash) {
+        LOG(ERROR) << "refusing to store content chunk " << Asset::keyToString(hash) << " with mismatched hash.";
+        return false;
+    }
+
+    std::array<char, kContentChunkKeySize> contentChunkKey;
+    makeContentChunkKey(hash, contentChunkKey.data());
+    leveldb::Slice keySlice(contentChunkKey.data(), kContentChunkKeySize);
+    std::string existing;
+    if (m_database->get(leveldb::ReadOptions(), keySlice, &existing).ok()) {
+        return true;
+    }
+
+    leveldb::WriteBatch batch;
+    batch.Put(keySlice, leveldb::Slice(flatAssetData.dataChar(), flatAssetData.size()));
+    auto status = writeBatch(leveldb::WriteOptions(), &batch);
+    if (status.ok()) {
+        LOG(INFO) << "content chunk store " << Asset::keyToString(hash) << " success.";
+    } else {
+        LOG(ERROR) << "Failed to store content chunk " << Asset::keyToString(hash) << ", status: " << status.ToString();
+    }
+    return status.ok();
+}
+
+size_t AssetDatabase::findMissingContentChunks(const std::vector<uint64_t>& hashes, std::vector<uint64_t>* missing) {
+    leveldb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(readOptions));
+    std::array<char, kContentChunkKeySize> contentChunkKey;
+    std::vector<uint64_t> found;
+    size_t missingCount = 0;
+    for (auto hash : hashes) {
+        makeContentChunkKey(hash, contentChunkKey.data());
+        leveldb::Slice keySlice(contentChunkKey.data(), kContentChunkKeySize);
+        iterator->Seek(keySlice);
+        if (iterator->Valid() && iterator->key().compare(keySlice) == 0) {
+            found.push_back(hash);
+        } else {
+            missing->push_back(hash);
+            ++missingCount;
+        }
+    }
+
+    // The client will not upload the chunks found, so keep the next garbage collection pass from deleting them before
+    // the Asset referring to them is stored.
+    if (found.size()) {
+        std::lock_guard<std::mutex> lock(m_gcMutex);
+        for (auto hash : found) {
+            m_gcContentOrphans.erase(hash);
+        }
+    }
+    return missingCount;
+}
+
+std::unique_ptr<AssetDatabase::BulkWriter> AssetDatabase::makeBulkWriter(size_t maxBatchBytes, bool sync) {
+    return std::unique_ptr<BulkWriter>(new BulkWriter(this, maxBatchBytes, sync));
+}
+
+AssetDatabase::BulkWriter::BulkWriter(AssetDatabase* assetDatabase, size_t maxBatchBytes, bool sync) :
+    m_assetDatabase(assetDatabase),
+    m_maxBatchBytes(maxBatchBytes),
+    m_sync(sync),
+    m_batch(new leveldb::WriteBatch),
+    m_bytesWritten(0) {
+}
+
+AssetDatabase::BulkWriter::~BulkWriter() {
+    if (m_batch->ApproximateSize() > leveldb::WriteBatch().ApproximateSize()) {
+        LOG(ERROR) << "BulkWriter destroyed with unwritten records, discarding them.";
+    }
+}
+
+bool AssetDatabase::BulkWriter::addAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData) {
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    makeAssetDataKey(key, chunk, assetDataKey.data());
+    m_batch->Put(leveldb::Slice(assetDataKey.data(), kAssetDataKeySize),
+        leveldb::Slice(flatAssetData.dataChar(), flatAssetData.size()));
+    return flushIfFull();
+}
+
+bool AssetDatabase::BulkWriter::addAsset(uint64_t key, const SizedPointer& assetData) {
+    std::string name = m_assetDatabase->addAssetToBatch(key, assetData, m_batch.get(), &m_pendingListEntries);
+    if (name.size()) {
+        m_pendingNames.emplace_back(name, key);
+    }
+    return flushIfFull();
+}
+
+bool AssetDatabase::BulkWriter::flush() {
+    size_t batchBytes = m_batch->ApproximateSize();
+    leveldb::WriteOptions options;
+    options.sync = m_sync;
+    auto status = m_assetDatabase->writeBatch(options, m_batch.get());
+    m_batch->Clear();
+    if (!status.ok()) {
+        LOG(ERROR) << "Failed to write bulk batch of " << batchBytes << " bytes, status: " << status.ToString();
+        m_pendingNames.clear();
+        m_pendingListEntries.clear();
+        return false;
+    }
+
+    m_bytesWritten += batchBytes;
+    for (const auto& pending : m_pendingNames) {
+        m_assetDatabase->m_assetNames.insert(pending.first, pending.second);
+    }
+    m_pendingNames.clear();
+    for (const auto& entry : m_pendingListEntries) {
+        m_assetDatabase->m_listEntries.insert(entry);
+    }
+    m_pendingListEntries.clear();
+    return true;
+}
+
+bool AssetDatabase::BulkWriter::flushIfFull() {
+    if (m_batch->ApproximateSize() < m_maxBatchBytes) {
+        return true;
+    }
+    return flush();
+}
+
 bool AssetDatabase::storeList(uint64_t key, const SizedPointer& listEntry) {
+    LatencyHistogram::Timer timer(&m_latency[kStoreList]);
     leveldb::WriteBatch batch;
 
     // Extract the name, if any, for storage in a lookup table.
@@ -346,9 +690,12 @@ bool AssetDatabase::storeList(uint64_t key, const SizedPointer& listEntry) {
     makeListKey(key, listKey.data());
     batch.Put(leveldb::Slice(listKey.data(), kListKeySize), leveldb::Slice(listEntry.dataChar(), listEntry.size()));
 
-    auto status = m_database->Write(leveldb::WriteOptions(), &batch);
+    auto status = writeBatch(leveldb::WriteOptions(), &batch);
     if (status.ok()) {
         LOG(INFO) << "List store " << Asset::keyToString(key) << " success.";
+        if (name.size()) {
+            m_listNames.insert(flatList->name()->str(), key);
+        }
     } else {
         LOG(ERROR) << "Failed to store KeyList Data " << Asset::keyToString(key) << ", status: " << status.ToString();
     }
@@ -357,9 +704,10 @@ bool AssetDatabase::storeList(uint64_t key, const SizedPointer& listEntry) {
 }
 
 RecordPtr AssetDatabase::loadList(uint64_t key) {
+    LatencyHistogram::Timer timer(&m_latency[kLoadList]);
     std::array<char, kListKeySize> listKey;
     makeListKey(key, listKey.data());
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
     iterator->Seek(leveldb::Slice(listKey.data(), kListKeySize));
     if (!iteratorMatch(iterator, listKey.data(), kListKeySize)) {
         LOG(ERROR) << "error retrieving list " << Asset::keyToString(key) << ".";
@@ -371,8 +719,9 @@ RecordPtr AssetDatabase::loadList(uint64_t key) {
 }
 
 RecordPtr AssetDatabase::findNamedList(const std::string& name) {
+    LatencyHistogram::Timer timer(&m_latency[kFindName]);
     std::string nameKey = kListNamePrefix + name;
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
     iterator->Seek(nameKey);
     if (!iteratorMatch(iterator, nameKey.data(), nameKey.size())) {
         LOG(WARNING) << "no named list found under name " << name;
@@ -385,7 +734,16 @@ RecordPtr AssetDatabase::findNamedList(const std::string& name) {
     return loadList(listKey);
 }
 
+size_t AssetDatabase::searchListNames(const std::string& query, bool fuzzy, size_t maxResults,
+    std::vector<NameIndex::Match>* matches) {
+    if (fuzzy) {
+        return m_listNames.search(query, maxResults, matches);
+    }
+    return scanNamePrefix(kListNamePrefix, query, maxResults, matches);
+}
+
 size_t AssetDatabase::getListNext(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut) {
+    LatencyHistogram::Timer timer(&m_latency[kReadList]);
     // Early-out for asking for the end of the list.
     if (fromToken == kEndList) {
         if (maxPairs >= 1) {
@@ -395,40 +753,1154 @@ size_t AssetDatabase::getListNext(uint64_t listKey, uint64_t fromToken, size_t m
         return 1;
     }
 
-    // Point the iterator at the fromToken position in the list.
-    std::array<char, kListEntryKeySize> listEntryKey;
-    listEntryKey[0] = kListEntry;
-    std::memcpy(listEntryKey.data() + 1, &listKey, sizeof(uint64_t));
-    std::memcpy(listEntryKey.data() + 9, &fromToken, sizeof(uint64_t));
-    std::memcpy(listEntryKey.data() + 17, &kBeginList, sizeof(uint64_t));
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    if (!seekListToken(iterator.get(), listKey, fromToken)) {
+        return 0;
+    }
+    return readListEntries(iterator.get(), listKey, maxPairs, listOut);
+}
 
-    std::shared_ptr<leveldb::Iterator> iterator(m_database->NewIterator(leveldb::ReadOptions()));
-    iterator->Seek(leveldb::Slice(listEntryKey.data(), kListEntryKeySize));
-    if (!iterator->Valid()) {
-        LOG(ERROR) << "error finding first element token: " << Asset::keyToString(fromToken) << " in list: "
-            << Asset::keyToString(listKey);
+size_t AssetDatabase::getListPrev(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut) {
+    LatencyHistogram::Timer timer(&m_latency[kReadList]);
+    // Early-out for asking for the beginning of the list.
+    if (fromToken == kBeginList) {
+        if (maxPairs >= 1) {
+            listOut[0] = kBeginList;
+            listOut[1] = kBeginList;
+        }
+        return 1;
+    }
+
+    // List entry keys hold their tokens little-endian, so walking the database backwards would not visit entries in the
+    // order they were added. The index keeps them in token order as well.
+    size_t pairs = m_listEntries.getBefore(listKey, fromToken, maxPairs, listOut);
+    if (pairs < maxPairs) {
+        listOut[pairs * 2] = kBeginList;
+        listOut[(pairs * 2) + 1] = kBeginList;
+        ++pairs;
+    }
+    return pairs;
+}
+
+size_t AssetDatabase::getListSize(uint64_t listKey) {
+    return m_listEntries.size(listKey);
+}
+
+size_t AssetDatabase::getListAt(uint64_t listKey, size_t offset, size_t maxPairs, uint64_t* listOut) {
+    LatencyHistogram::Timer timer(&m_latency[kReadList]);
+    size_t pairs = m_listEntries.getAt(listKey, offset, maxPairs, listOut);
+    if (pairs < maxPairs && offset + pairs >= m_listEntries.size(listKey)) {
+        listOut[pairs * 2] = kEndList;
+        listOut[(pairs * 2) + 1] = kEndList;
+        ++pairs;
+    }
+    return pairs;
+}
+
+/*! An open list cursor, holding a database snapshot and an iterator over it. The iterator is always left pointing at
+ * the last entry returned.
+ */
+struct AssetDatabase::ListCursor {
+    ListCursor(StorageEngine* engine, uint64_t key) :
+        database(engine),
+        snapshot(engine->getSnapshot()),
+        listKey(key),
+        finished(false) {
+        leveldb::ReadOptions readOptions;
+        readOptions.snapshot = snapshot;
+        iterator.reset(database->newIterator(readOptions));
+    }
+
+    ~ListCursor() {
+        // The iterator reads from the snapshot, so must be destroyed before the snapshot is released.
+        iterator.reset();
+        database->releaseSnapshot(snapshot);
+    }
+
+    StorageEngine* database;
+    const leveldb::Snapshot* snapshot;
+    std::unique_ptr<leveldb::Iterator> iterator;
+    uint64_t listKey;
+    bool finished;
+    std::chrono::steady_clock::time_point lastRead;
+    // Serializes reads of the same cursor from different threads.
+    std::mutex mutex;
+};
+
+uint64_t AssetDatabase::openListCursor(uint64_t listKey, uint64_t fromToken) {
+    if (fromToken == kEndList) {
+        LOG(ERROR) << "refusing to open cursor at end of list " << Asset::keyToString(listKey);
         return 0;
     }
 
+    std::shared_ptr<ListCursor> cursor(new ListCursor(m_database.get(), listKey));
+    if (!seekListToken(cursor->iterator.get(), listKey, fromToken)) {
+        return 0;
+    }
+    cursor->lastRead = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_listCursorMutex);
+    expireListCursors();
+    uint64_t cursorId = 0;
+    while (cursorId == 0 || m_listCursors.count(cursorId)) {
+        cursorId = m_listCursorIds();
+    }
+    m_listCursors.emplace(cursorId, cursor);
+    LOG(INFO) << "opened cursor " << Asset::keyToString(cursorId) << " on list " << Asset::keyToString(listKey)
+        << ", " << m_listCursors.size() << " cursors open.";
+    return cursorId;
+}
+
+size_t AssetDatabase::readListCursor(uint64_t cursorId, size_t maxPairs, uint64_t* listOut) {
+    LatencyHistogram::Timer timer(&m_latency[kReadList]);
+    std::shared_ptr<ListCursor> cursor;
+    {
+        std::lock_guard<std::mutex> lock(m_listCursorMutex);
+        auto found = m_listCursors.find(cursorId);
+        if (found == m_listCursors.end()) {
+            LOG(ERROR) << "unknown or expired list cursor " << Asset::keyToString(cursorId);
+            return 0;
+        }
+        cursor = found->second;
+        cursor->lastRead = std::chrono::steady_clock::now();
+    }
+
     size_t pairs = 0;
-    while (pairs < maxPairs) {
-        iterator->Next();
-        if (!iterator->Valid()) {
-            LOG(ERROR) << "error finding list " << Asset::keyToString(listKey) << " for iteration.";
+    {
+        std::lock_guard<std::mutex> lock(cursor->mutex);
+        if (cursor->finished) {
             return 0;
         }
-        // We only compare the first 9 bytes of the list key, to make sure the prefix and key match.
-        if (iterator->key().size() != kListEntryKeySize ||
-            std::memcmp(iterator->key().data(), listEntryKey.data(), 9) != 0) {
-            LOG(INFO) << "walked off end of list " << Asset::keyToString(listKey) << " after " << pairs << " pairs.";
+        pairs = readListEntries(cursor->iterator.get(), cursor->listKey, maxPairs, listOut);
+        cursor->finished = pairs == 0 || (listOut[(pairs - 1) * 2] == kEndList);
+    }
+
+    if (cursor->finished) {
+        closeListCursor(cursorId);
+    }
+    return pairs;
+}
+
+void AssetDatabase::closeListCursor(uint64_t cursorId) {
+    std::shared_ptr<ListCursor> cursor;
+    {
+        std::lock_guard<std::mutex> lock(m_listCursorMutex);
+        auto found = m_listCursors.find(cursorId);
+        if (found == m_listCursors.end()) {
+            return;
+        }
+        cursor = found->second;
+        m_listCursors.erase(found);
+    }
+    LOG(INFO) << "closed list cursor " << Asset::keyToString(cursorId);
+}
+
+void AssetDatabase::setListCursorTimeout(std::chrono::seconds timeout) {
+    std::lock_guard<std::mutex> lock(m_listCursorMutex);
+    m_listCursorTimeout = timeout;
+}
+
+void AssetDatabase::expireListCursors() {
+    auto now = std::chrono::steady_clock::now();
+    auto oldest = m_listCursors.end();
+    for (auto it = m_listCursors.begin(); it != m_listCursors.end();) {
+        if (now - it->second->lastRead > m_listCursorTimeout) {
+            LOG(INFO) << "expiring idle list cursor " << Asset::keyToString(it->first);
+            it = m_listCursors.erase(it);
+            continue;
+        }
+        if (oldest == m_listCursors.end() || it->second->lastRead < oldest->second->lastRead) {
+            oldest = it;
+        }
+        ++it;
+    }
+
+    if (m_listCursors.size() >= kMaxListCursors && oldest != m_listCursors.end()) {
+        LOG(INFO) << "too many list cursors open, closing least recently read " << Asset::keyToString(oldest->first);
+        m_listCursors.erase(oldest);
+    }
+}
+
+size_t AssetDatabase::getAssetKeys(uint64_t afterKey, size_t maxKeys, std::vector<uint64_t>* keys) {
+    std::array<char, kAssetKeySize> assetKey;
+    makeAssetKey(afterKey, assetKey.data());
+    leveldb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(readOptions));
+    iterator->Seek(leveldb::Slice(assetKey.data(), kAssetKeySize));
+    if (iteratorMatch(iterator, assetKey.data(), kAssetKeySize)) {
+        iterator->Next();
+    }
+
+    size_t found = 0;
+    for (; found < maxKeys && iterator->Valid() && iterator->key()[0] == kAsset; iterator->Next()) {
+        if (iterator->key().size() != kAssetKeySize) {
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+        keys->push_back(key);
+        ++found;
+    }
+    return found;
+}
+
+bool AssetDatabase::verifyAssetData(uint64_t key, std::function<bool(size_t)> progress, std::string* problem) {
+    leveldb::ReadOptions readOptions;
+    // Verification walks every chunk once, caching them would only evict records in active use.
+    readOptions.fill_cache = false;
+
+    std::array<char, kAssetKeySize> assetKey;
+    makeAssetKey(key, assetKey.data());
+    std::string assetValue;
+    auto status = m_database->get(readOptions, leveldb::Slice(assetKey.data(), kAssetKeySize), &assetValue);
+    if (!status.ok()) {
+        *problem = "metadata missing";
+        return false;
+    }
+    auto assetVerifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(assetValue.data()),
+        assetValue.size());
+    if (!Data::VerifyFlatAssetBuffer(assetVerifier)) {
+        *problem = "metadata malformed";
+        return false;
+    }
+    const Data::FlatAsset* flatAsset = Data::GetFlatAsset(assetValue.data());
+    if (flatAsset->chunks() == 0) {
+        return true;
+    }
+    if (flatAsset->manifestPages()) {
+        return verifyContentChunks(key, flatAsset->manifestPages(), flatAsset->size(), progress, problem);
+    }
+
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    uint64_t digest = 0;
+    uint64_t verifiedSize = 0;
+    bool ok = true;
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    std::string chunkValue;
+    for (uint64_t chunk = 0; verifiedSize < flatAsset->size(); ++chunk) {
+        makeAssetDataKey(key, chunk, assetDataKey.data());
+        status = m_database->get(readOptions, leveldb::Slice(assetDataKey.data(), kAssetDataKeySize), &chunkValue);
+        if (!status.ok()) {
+            *problem = "chunk " + std::to_string(chunk) + " missing";
+            ok = false;
+            break;
+        }
+        auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(chunkValue.data()), chunkValue.size());
+        if (!Data::VerifyFlatAssetDataBuffer(verifier)) {
+            *problem = "chunk " + std::to_string(chunk) + " malformed";
+            ok = false;
+            break;
+        }
+        const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(chunkValue.data());
+        if (!flatAssetData->data() || flatAssetData->data()->size() == 0) {
+            *problem = "chunk " + std::to_string(chunk) + " empty";
+            ok = false;
+            break;
+        }
+        XXH64_update(hashState, flatAssetData->data()->data(), flatAssetData->data()->size());
+        digest = XXH64_digest(hashState);
+        if (digest != flatAssetData->hash()) {
+            *problem = "chunk " + std::to_string(chunk) + " hash mismatch";
+            ok = false;
             break;
         }
+        verifiedSize += flatAssetData->data()->size();
+        if (!progress(flatAssetData->data()->size())) {
+            XXH64_freeState(hashState);
+            return true;
+        }
+    }
+    XXH64_freeState(hashState);
 
-        std::memcpy(listOut + (pairs * 2), iterator->key().data() + 9, sizeof(uint64_t) * 2);
-        ++pairs;
+    if (ok && verifiedSize != flatAsset->size()) {
+        *problem = "size mismatch";
+        ok = false;
+    }
+    if (ok && digest != key) {
+        *problem = "key mismatch";
+        ok = false;
+    }
+    if (!ok) {
+        LOG(ERROR) << "verification of Asset " << Asset::keyToString(key) << " failed, " << *problem;
+    }
+    return ok;
+}
+
+bool AssetDatabase::verifyContentChunks(uint64_t key, uint64_t manifestPages, uint64_t size,
+    std::function<bool(size_t)> progress, std::string* problem) {
+    leveldb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    uint64_t verifiedSize = 0;
+    bool ok = true;
+    std::array<char, kAssetDataKeySize> assetDataKey;
+    std::array<char, kContentChunkKeySize> contentChunkKey;
+    std::string pageValue;
+    std::string chunkValue;
+    std::vector<ContentChunker::ManifestEntry> entries;
+    for (uint64_t page = 0; ok && page < manifestPages; ++page) {
+        makeAssetDataKey(key, page, assetDataKey.data());
+        auto status = m_database->get(readOptions, leveldb::Slice(assetDataKey.data(), kAssetDataKeySize), &pageValue);
+        if (!status.ok()) {
+            *problem = "manifest page " + std::to_string(page) + " missing";
+            ok = false;
+            break;
+        }
+        auto verifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(pageValue.data()), pageValue.size());
+        if (!Data::VerifyFlatAssetDataBuffer(verifier)) {
+            *problem = "manifest page " + std::to_string(page) + " malformed";
+            ok = false;
+            break;
+        }
+        const Data::FlatAssetData* pageData = Data::GetFlatAssetData(pageValue.data());
+        entries.clear();
+        if (!pageData->data() || XXH64(pageData->data()->data(), pageData->data()->size(), 0) != pageData->hash() ||
+            !ContentChunker::parseManifestPage(pageData->data()->data(), pageData->data()->size(), &entries)) {
+            *problem = "manifest page " + std::to_string(page) + " corrupt";
+            ok = false;
+            break;
+        }
+
+        for (const auto& entry : entries) {
+            makeContentChunkKey(entry.hash, contentChunkKey.data());
+            status = m_database->get(readOptions, leveldb::Slice(contentChunkKey.data(), kContentChunkKeySize),
+                &chunkValue);
+            if (!status.ok()) {
+                *problem = "content chunk " + Asset::keyToString(entry.hash) + " missing";
+                ok = false;
+                break;
+            }
+            auto chunkVerifier = flatbuffers::Verifier(reinterpret_cast<const uint8_t*>(chunkValue.data()),
+                chunkValue.size());
+            if (!Data::VerifyFlatAssetDataBuffer(chunkVerifier)) {
+                *problem = "content chunk " + Asset::keyToString(entry.hash) + " malformed";
+                ok = false;
+                break;
+            }
+            const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(chunkValue.data());
+            if (!flatAssetData->data() || flatAssetData->data()->size() != entry.size ||
+                XXH64(flatAssetData->data()->data(), entry.size, 0) != entry.hash) {
+                *problem = "content chunk " + Asset::keyToString(entry.hash) + " hash mismatch";
+                ok = false;
+                break;
+            }
+            XXH64_update(hashState, flatAssetData->data()->data(), entry.size);
+            verifiedSize += entry.size;
+            if (!progress(entry.size)) {
+                XXH64_freeState(hashState);
+                return true;
+            }
+        }
     }
+    uint64_t digest = XXH64_digest(hashState);
+    XXH64_freeState(hashState);
 
-    return pairs;
+    if (ok && verifiedSize != size) {
+        *problem = "size mismatch";
+        ok = false;
+    }
+    if (ok && digest != key) {
+        *problem = "key mismatch";
+        ok = false;
+    }
+    if (!ok) {
+        LOG(ERROR) << "verification of content-chunked Asset " << Asset::keyToString(key) << " failed, " << *problem;
+    }
+    return ok;
+}
+
+std::vector<AssetDatabase::PrefixStats> AssetDatabase::getPrefixStats(bool countKeys) {
+    std::vector<PrefixStats> stats;
+    for (const char* prefix : kStatsPrefixes) {
+        PrefixStats prefixStats;
+        prefixStats.prefix = prefix;
+        stats.push_back(prefixStats);
+    }
+
+    // Each prefix covers the keys from the prefix itself up to, but not including, the prefix with its last character
+    // incremented.
+    std::vector<std::string> limits;
+    for (const auto& prefixStats : stats) {
+        std::string limit = prefixStats.prefix;
+        limit.back() = static_cast<char>(limit.back() + 1);
+        limits.push_back(limit);
+    }
+    std::vector<leveldb::Range> ranges;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        ranges.emplace_back(stats[i].prefix, limits[i]);
+    }
+    std::vector<uint64_t> sizes(ranges.size());
+    m_database->getApproximateSizes(ranges.data(), static_cast<int>(ranges.size()), sizes.data());
+    for (size_t i = 0; i < stats.size(); ++i) {
+        stats[i].approximateBytes = sizes[i];
+    }
+
+    if (countKeys) {
+        const leveldb::Snapshot* snapshot = m_database->getSnapshot();
+        leveldb::ReadOptions readOptions;
+        readOptions.snapshot = snapshot;
+        readOptions.fill_cache = false;
+        std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(readOptions));
+        for (size_t i = 0; i < stats.size(); ++i) {
+            for (iterator->Seek(stats[i].prefix); iterator->Valid() &&
+                iterator->key().compare(leveldb::Slice(limits[i])) < 0; iterator->Next()) {
+                ++stats[i].keys;
+                stats[i].bytes += iterator->key().size() + iterator->value().size();
+            }
+        }
+        iterator.reset();
+        m_database->releaseSnapshot(snapshot);
+    }
+    return stats;
+}
+
+std::string AssetDatabase::statsReport(bool countKeys) {
+    std::string report = "engine " + std::string(m_database->name()) + "\n";
+    for (const auto& prefixStats : getPrefixStats(countKeys)) {
+        report += "prefix_" + prefixStats.prefix + "_approximate_bytes " + std::to_string(prefixStats.approximateBytes)
+            + "\n";
+        if (countKeys) {
+            report += "prefix_" + prefixStats.prefix + "_keys " + std::to_string(prefixStats.keys) + "\n";
+            report += "prefix_" + prefixStats.prefix + "_bytes " + std::to_string(prefixStats.bytes) + "\n";
+        }
+    }
+
+    uint64_t reads = 0;
+    for (size_t operation = 0; operation < kOperationCount; ++operation) {
+        report += "latency_" + std::string(kOperationNames[operation]) + " " + m_latency[operation].summary() + "\n";
+    }
+    for (auto operation : { kFindAsset, kLoadDataChunk, kFindName, kLoadList, kReadList }) {
+        reads += m_latency[operation].count();
+    }
+
+    // Every block cache miss is a block read from disk, so misses per read measure read amplification.
+    StorageEngine::CacheStats cacheStats = m_database->cacheStats();
+    uint64_t lookups = cacheStats.hits + cacheStats.misses;
+    report += "cache_hits " + std::to_string(cacheStats.hits) + "\n";
+    report += "cache_misses " + std::to_string(cacheStats.misses) + "\n";
+    report += "cache_usage_bytes " + std::to_string(cacheStats.usage) + "\n";
+    if (lookups) {
+        report += "cache_hit_rate " + std::to_string(static_cast<double>(cacheStats.hits) / lookups) + "\n";
+    }
+    if (reads) {
+        report += "block_reads_per_read " + std::to_string(static_cast<double>(cacheStats.misses) / reads) + "\n";
+    }
+
+    std::string property;
+    if (m_database->getProperty("leveldb.approximate-memory-usage", &property)) {
+        report += "memory_usage_bytes " + property + "\n";
+    }
+    if (m_database->getProperty("leveldb.stats", &property)) {
+        report += property;
+    }
+    return report;
+}
+
+RecordPtr AssetDatabase::loadInternal(const std::string& name) {
+    std::string internalKey = std::string(1, kInternal) + name;
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    iterator->Seek(internalKey);
+    if (!iteratorMatch(iterator, &internalKey[0], internalKey.size())) {
+        return makeEmptyRecord();
+    }
+    return RecordPtr(new DatabaseRecord(iterator));
+}
+
+bool AssetDatabase::storeInternal(const std::string& name, const SizedPointer& value) {
+    std::string internalKey = std::string(1, kInternal) + name;
+    leveldb::WriteBatch batch;
+    batch.Put(internalKey, leveldb::Slice(value.dataChar(), value.size()));
+    auto status = m_database->write(leveldb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LOG(ERROR) << "failed to store internal record " << name << ", status: " << status.ToString();
+        return false;
+    }
+    return true;
+}
+
+bool AssetDatabase::exportCatalog(const std::string& path, size_t* assetCount) {
+    const leveldb::Snapshot* snapshot = m_database->getSnapshot();
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = snapshot;
+    readOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(readOptions));
+
+    CatalogBuilder builder;
+    char prefix = kAsset;
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kAsset;
+        iterator->Next()) {
+        if (iterator->key().size() != kAssetKeySize) {
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+        builder.add(key, SizedPointer(iterator->value().data(), iterator->value().size()));
+    }
+    iterator.reset();
+    m_database->releaseSnapshot(snapshot);
+
+    if (assetCount) {
+        *assetCount = builder.size();
+    }
+    return builder.write(path);
+}
+
+bool AssetDatabase::writeBackup(const std::string& path, size_t blockBytes, uint64_t* recordCount) {
+    const leveldb::Snapshot* snapshot = m_database->getSnapshot();
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = snapshot;
+    readOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(readOptions));
+
+    BackupWriter writer;
+    bool ok = writer.open(path, blockBytes);
+    for (iterator->SeekToFirst(); ok && iterator->Valid(); iterator->Next()) {
+        ok = writer.add(SizedPointer(iterator->key().data(), iterator->key().size()),
+            SizedPointer(iterator->value().data(), iterator->value().size()));
+    }
+    if (ok && !iterator->status().ok()) {
+        LOG(ERROR) << "error reading database for backup, status: " << iterator->status().ToString();
+        ok = false;
+    }
+    iterator.reset();
+    m_database->releaseSnapshot(snapshot);
+
+    if (!ok || !writer.finish()) {
+        LOG(ERROR) << "failed to write backup " << path;
+        return false;
+    }
+    if (recordCount) {
+        *recordCount = writer.recordCount();
+    }
+    return true;
+}
+
+bool AssetDatabase::restoreBackup(const std::string& path, size_t numThreads, bool sync, uint64_t* recordCount) {
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    iterator->SeekToFirst();
+    if (iterator->Valid()) {
+        LOG(ERROR) << "refusing to restore backup " << path << " into a database that is not empty.";
+        return false;
+    }
+    iterator.reset();
+
+    BackupReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    // Blocks hold disjoint key ranges, so they can be written in any order. Each becomes a single batch, which costs
+    // one log write instead of one per record, and bypasses the change feed so that the restored feed records keep
+    // their original sequence numbers.
+    leveldb::WriteOptions writeOptions;
+    writeOptions.sync = sync;
+    std::atomic<bool> ok(true);
+    std::atomic<uint64_t> restored(0);
+    {
+        ThreadPool pool(std::max(numThreads, static_cast<size_t>(1)));
+        for (size_t block = 0; block < reader.blockCount(); ++block) {
+            pool.post(ThreadPool::kHighPriority, [this, &reader, &writeOptions, &ok, &restored, block] {
+                if (!ok) {
+                    return;
+                }
+                leveldb::WriteBatch batch;
+                uint64_t records = 0;
+                if (!reader.readBlock(block, [&batch, &records](const SizedPointer& key, const SizedPointer& value) {
+                    batch.Put(leveldb::Slice(key.dataChar(), key.size()), leveldb::Slice(value.dataChar(),
+                        value.size()));
+                    ++records;
+                })) {
+                    ok = false;
+                    return;
+                }
+                auto status = m_database->write(writeOptions, &batch);
+                if (!status.ok()) {
+                    LOG(ERROR) << "failed to write restored backup block " << block << ", status: "
+                        << status.ToString();
+                    ok = false;
+                    return;
+                }
+                restored += records;
+            });
+        }
+        pool.shutdown();
+    }
+
+    if (!ok) {
+        LOG(ERROR) << "failed to restore backup " << path << ", " << restored << " records written.";
+        return false;
+    }
+    loadIndices();
+    if (recordCount) {
+        *recordCount = restored;
+    }
+    return true;
+}
+
+bool AssetDatabase::collectGarbage(const GarbageCollectionOptions& options, GarbageCollectionReport* report) {
+    auto startTime = std::chrono::steady_clock::now();
+    GarbageCollectionReport totals;
+
+    // Scan a consistent view of the database, so that Assets stored during collection are never mistaken for missing.
+    const leveldb::Snapshot* snapshot = m_database->getSnapshot();
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = snapshot;
+    // A full scan would otherwise evict the records in active use from the block cache.
+    readOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(readOptions));
+
+    leveldb::WriteBatch batch;
+    size_t batchBytes = 0;
+    // Index removals wait with the batch that deletes their records, and are applied only once it is written.
+    std::vector<std::string> batchNames;
+    std::vector<ListIndex::Entry> batchEntries;
+    bool ok = true;
+    bool quit = false;
+    auto deleteKey = [&batch, &batchBytes, &totals](const leveldb::Slice& key, size_t valueSize) {
+        batch.Delete(key);
+        batchBytes += key.size();
+        ++totals.keysDeleted;
+        totals.bytesReclaimed += key.size() + valueSize;
+    };
+    // Writes the pending batch if it has grown past the limit, or if force is true, then pauses. Returns false if the
+    // collection should stop.
+    auto flush = [this, &options, &batch, &batchBytes, &batchNames, &batchEntries, &ok, &quit](bool force) {
+        if (batchBytes == 0 || (!force && batchBytes < options.maxBatchBytes)) {
+            return ok && !quit;
+        }
+        auto status = writeBatch(leveldb::WriteOptions(), &batch);
+        if (status.ok()) {
+            for (const auto& name : batchNames) {
+                m_assetNames.remove(name);
+            }
+            for (const auto& entry : batchEntries) {
+                m_listEntries.remove(entry);
+            }
+        } else {
+            LOG(ERROR) << "garbage collection failed to write deletion batch, status: " << status.ToString();
+            ok = false;
+        }
+        batch.Clear();
+        batchBytes = 0;
+        batchNames.clear();
+        batchEntries.clear();
+        std::unique_lock<std::mutex> lock(m_gcMutex);
+        quit = m_gcCondition.wait_for(lock, options.batchPause, [this] { return m_gcQuit; });
+        return ok && !quit;
+    };
+
+    // Record which Asset keys exist, the size of their metadata, and which newer version deprecates each one.
+    std::unordered_map<uint64_t, size_t> assetSizes;
+    std::unordered_map<uint64_t, uint64_t> newerVersion;
+    std::unordered_map<uint64_t, uint64_t> manifestPages;
+    char prefix = kAsset;
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kAsset;
+        iterator->Next()) {
+        if (iterator->key().size() != kAssetKeySize) {
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+        assetSizes.emplace(key, iterator->value().size());
+        const Data::FlatAsset* flatAsset = Data::GetFlatAsset(iterator->value().data());
+        // An explicit deprecatedBy field takes precedence over an inferred one from a newer version.
+        if (flatAsset->deprecatedBy()) {
+            newerVersion[key] = flatAsset->deprecatedBy();
+        }
+        if (flatAsset->deprecates()) {
+            newerVersion.emplace(flatAsset->deprecates(), key);
+        }
+        if (flatAsset->manifestPages()) {
+            manifestPages.emplace(key, flatAsset->manifestPages());
+        }
+    }
+
+    // Find the Assets with more than retentionDepth stored versions newer than themselves.
+    std::unordered_set<uint64_t> trimmed;
+    if (options.retentionDepth > 0) {
+        for (const auto& asset : assetSizes) {
+            size_t depth = 0;
+            uint64_t current = asset.first;
+            while (depth <= options.retentionDepth) {
+                auto newer = newerVersion.find(current);
+                if (newer == newerVersion.end() || newer->second == asset.first ||
+                    assetSizes.find(newer->second) == assetSizes.end()) {
+                    break;
+                }
+                current = newer->second;
+                ++depth;
+            }
+            if (depth > options.retentionDepth) {
+                trimmed.insert(asset.first);
+            }
+        }
+    }
+
+    std::unordered_set<uint64_t> previousOrphans;
+    {
+        std::lock_guard<std::mutex> lock(m_gcMutex);
+        previousOrphans.swap(m_gcOrphans);
+    }
+    std::unordered_set<uint64_t> newOrphans;
+    // Content chunks referred to by the manifest of an Asset that is kept.
+    std::unordered_set<uint64_t> referencedContent;
+    std::vector<ContentChunker::ManifestEntry> entries;
+
+    // Delete the data chunks of trimmed Assets, and those that have been orphaned for two consecutive passes.
+    prefix = kAssetData;
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); flush(false) && iterator->Valid() &&
+        iterator->key()[0] == kAssetData; iterator->Next()) {
+        if (iterator->key().size() != kAssetDataKeySize) {
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->key().data() + 1, sizeof(uint64_t));
+        if (trimmed.count(key)) {
+            deleteKey(iterator->key(), iterator->value().size());
+        } else if (assetSizes.find(key) == assetSizes.end()) {
+            if (previousOrphans.count(key)) {
+                deleteKey(iterator->key(), iterator->value().size());
+                ++totals.orphanChunks;
+            } else {
+                newOrphans.insert(key);
+            }
+        } else {
+            uint64_t chunk = 0;
+            std::memcpy(&chunk, iterator->key().data() + 9, sizeof(uint64_t));
+            auto pages = manifestPages.find(key);
+            if (pages != manifestPages.end() && chunk < pages->second) {
+                const Data::FlatAssetData* pageData = Data::GetFlatAssetData(iterator->value().data());
+                entries.clear();
+                if (pageData->data()) {
+                    ContentChunker::parseManifestPage(pageData->data()->data(), pageData->data()->size(), &entries);
+                }
+                for (const auto& entry : entries) {
+                    referencedContent.insert(entry.hash);
+                }
+            }
+        }
+    }
+
+    // Delete content chunks no kept manifest refers to, once they have been unreferenced for two consecutive passes.
+    // This is only safe after a complete scan of the manifests.
+    std::unordered_set<uint64_t> newContentOrphans;
+    bool contentScanned = ok && !quit;
+    prefix = kContentChunk;
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); contentScanned && flush(false) && iterator->Valid() &&
+        iterator->key()[0] == kContentChunk; iterator->Next()) {
+        if (iterator->key().size() != kContentChunkKeySize) {
+            continue;
+        }
+        uint64_t hash = 0;
+        std::memcpy(&hash, iterator->key().data() + 1, sizeof(uint64_t));
+        if (referencedContent.count(hash)) {
+            continue;
+        }
+        bool orphaned = false;
+        {
+            // Checked under the lock, as findMissingContentChunks() removes chunks a client is about to reuse.
+            std::lock_guard<std::mutex> lock(m_gcMutex);
+            orphaned = m_gcContentOrphans.count(hash) > 0;
+        }
+        if (orphaned) {
+            deleteKey(iterator->key(), iterator->value().size());
+            ++totals.orphanChunks;
+        } else {
+            newContentOrphans.insert(hash);
+        }
+    }
+
+    if (trimmed.size() && ok && !quit) {
+        for (auto key : trimmed) {
+            std::array<char, kAssetKeySize> assetKey;
+            makeAssetKey(key, assetKey.data());
+            deleteKey(leveldb::Slice(assetKey.data(), kAssetKeySize), assetSizes[key]);
+            ++totals.trimmedAssets;
+            LOG(INFO) << "garbage collection trimming deprecated Asset " << Asset::keyToString(key);
+            if (!flush(false)) {
+                break;
+            }
+        }
+
+        // Remove name lookups still pointing at trimmed Assets.
+        for (iterator->Seek(kAssetNamePrefix); flush(false) && iterator->Valid() &&
+            iterator->key().starts_with(kAssetNamePrefix); iterator->Next()) {
+            uint64_t key = 0;
+            if (iterator->value().size() == sizeof(uint64_t)) {
+                std::memcpy(&key, iterator->value().data(), sizeof(uint64_t));
+            }
+            if (trimmed.count(key)) {
+                deleteKey(iterator->key(), iterator->value().size());
+                batchNames.push_back(iterator->key().ToString().substr(std::strlen(kAssetNamePrefix)));
+            }
+        }
+
+        // Remove trimmed Assets from any lists they were added to. List entry keys end with the Asset key.
+        prefix = kListEntry;
+        for (iterator->Seek(leveldb::Slice(&prefix, 1)); flush(false) && iterator->Valid() &&
+            iterator->key()[0] == kListEntry; iterator->Next()) {
+            if (iterator->key().size() != kListEntryKeySize) {
+                continue;
+            }
+            ListIndex::Entry entry;
+            std::memcpy(&entry.listKey, iterator->key().data() + 1, sizeof(uint64_t));
+            std::memcpy(&entry.token, iterator->key().data() + 9, sizeof(uint64_t));
+            std::memcpy(&entry.assetKey, iterator->key().data() + 17, sizeof(uint64_t));
+            if (trimmed.count(entry.assetKey)) {
+                deleteKey(iterator->key(), iterator->value().size());
+                batchEntries.push_back(entry);
+            }
+        }
+    }
+
+    flush(true);
+    iterator.reset();
+    m_database->releaseSnapshot(snapshot);
+
+    {
+        std::lock_guard<std::mutex> lock(m_gcMutex);
+        m_gcOrphans.swap(newOrphans);
+        if (contentScanned) {
+            m_gcContentOrphans.swap(newContentOrphans);
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    LOG(INFO) << "garbage collection " << (quit ? "interrupted" : "complete") << " after " << elapsed.count()
+        << " ms, deleted " << totals.orphanChunks << " orphaned chunks and " << totals.trimmedAssets
+        << " deprecated Assets, " << totals.keysDeleted << " keys, reclaimed " << totals.bytesReclaimed << " bytes.";
+    if (report) {
+        *report = totals;
+    }
+    return ok;
+}
+
+void AssetDatabase::setChangeFeedRetention(uint64_t retention) {
+    std::lock_guard<std::mutex> lock(m_feedMutex);
+    m_feedRetention = retention;
+    if (retention == 0 || m_feedSequence <= retention) {
+        return;
+    }
+
+    // Trim any records left from a longer retention on a previous run. After this each write trims one record.
+    std::array<char, kChangeFeedKeySize> firstKept;
+    makeChangeFeedKey(m_feedSequence - retention + 1, firstKept.data());
+    leveldb::WriteBatch batch;
+    size_t trimmed = 0;
+    char prefix = kChangeFeed;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kChangeFeed &&
+        iterator->key().compare(leveldb::Slice(firstKept.data(), kChangeFeedKeySize)) < 0; iterator->Next()) {
+        batch.Delete(iterator->key());
+        ++trimmed;
+    }
+    auto status = m_database->write(leveldb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LOG(ERROR) << "failed to trim change feed, status: " << status.ToString();
+    } else if (trimmed) {
+        LOG(INFO) << "trimmed " << trimmed << " change feed records beyond retention of " << retention;
+    }
+}
+
+uint64_t AssetDatabase::changeFeedSequence() {
+    std::lock_guard<std::mutex> lock(m_feedMutex);
+    return m_feedSequence;
+}
+
+size_t AssetDatabase::getChangeFeed(uint64_t fromSequence, size_t maxEntries, std::vector<ChangeFeedEntry>* entries,
+    uint64_t* oldestSequence) {
+    *oldestSequence = 0;
+    char prefix = kChangeFeed;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(&prefix, 1));
+    if (!iterator->Valid() || iterator->key()[0] != kChangeFeed) {
+        return 0;
+    }
+    *oldestSequence = parseChangeFeedKey(iterator->key());
+
+    std::array<char, kChangeFeedKeySize> feedKey;
+    makeChangeFeedKey(fromSequence, feedKey.data());
+    size_t found = 0;
+    for (iterator->Seek(leveldb::Slice(feedKey.data(), kChangeFeedKeySize)); found < maxEntries &&
+        iterator->Valid() && iterator->key()[0] == kChangeFeed; iterator->Next()) {
+        if (iterator->key().size() != kChangeFeedKeySize) {
+            continue;
+        }
+        entries->push_back(ChangeFeedEntry{ parseChangeFeedKey(iterator->key()), iterator->value().size() });
+        ++found;
+    }
+    return found;
+}
+
+RecordPtr AssetDatabase::loadChangeFeedRecord(uint64_t sequence) {
+    std::array<char, kChangeFeedKeySize> feedKey;
+    makeChangeFeedKey(sequence, feedKey.data());
+    std::shared_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(feedKey.data(), kChangeFeedKeySize));
+    if (!iteratorMatch(iterator, feedKey.data(), kChangeFeedKeySize)) {
+        LOG(ERROR) << "change feed record " << sequence << " not found.";
+        return makeEmptyRecord();
+    }
+    return RecordPtr(new DatabaseRecord(iterator));
+}
+
+bool AssetDatabase::applyChangeFeedRecord(uint64_t sequence, const SizedPointer& record) {
+    std::vector<ChangeFeedOperation> operations;
+    if (!decodeChangeFeedRecord(record, &operations)) {
+        LOG(ERROR) << "change feed record " << sequence << " is corrupt, refusing to apply.";
+        return false;
+    }
+
+    leveldb::WriteBatch batch;
+    for (const auto& operation : operations) {
+        if (operation.put) {
+            batch.Put(operation.key, operation.value);
+        } else {
+            batch.Delete(operation.key);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_feedMutex);
+        if (m_feedRetention == 0) {
+            LOG(ERROR) << "change feed disabled, unable to track replication position.";
+            return false;
+        }
+        if (sequence != m_feedSequence + 1) {
+            LOG(ERROR) << "change feed record " << sequence << " out of order, expected " << m_feedSequence + 1;
+            return false;
+        }
+        // Keep the same record under the same sequence number, so this database can serve the feed in turn.
+        appendChangeFeed(sequence, std::string(record.dataChar(), record.size()), &batch);
+        auto status = m_database->write(leveldb::WriteOptions(), &batch);
+        if (!status.ok()) {
+            LOG(ERROR) << "failed to apply change feed record " << sequence << ", status: " << status.ToString();
+            return false;
+        }
+        m_feedSequence = sequence;
+    }
+
+    // Bring the in-memory indices up to date with the name lookups and list entries written.
+    size_t assetNamePrefixSize = std::strlen(kAssetNamePrefix);
+    size_t listNamePrefixSize = std::strlen(kListNamePrefix);
+    for (const auto& operation : operations) {
+        const leveldb::Slice& key = operation.key;
+        if (key.starts_with(kAssetNamePrefix) || key.starts_with(kListNamePrefix)) {
+            bool asset = key.starts_with(kAssetNamePrefix);
+            NameIndex* index = asset ? &m_assetNames : &m_listNames;
+            size_t prefixSize = asset ? assetNamePrefixSize : listNamePrefixSize;
+            std::string name(key.data() + prefixSize, key.size() - prefixSize);
+            if (!operation.put) {
+                index->remove(name);
+            } else if (operation.value.size() == sizeof(uint64_t)) {
+                uint64_t nameKey = 0;
+                std::memcpy(&nameKey, operation.value.data(), sizeof(uint64_t));
+                index->insert(name, nameKey);
+            }
+        } else if (key.size() == kListEntryKeySize && key[0] == kListEntry) {
+            ListIndex::Entry entry;
+            std::memcpy(&entry.listKey, key.data() + 1, sizeof(uint64_t));
+            std::memcpy(&entry.token, key.data() + 9, sizeof(uint64_t));
+            std::memcpy(&entry.assetKey, key.data() + 17, sizeof(uint64_t));
+            if (entry.token == kBeginList || entry.token == kEndList) {
+                continue;
+            }
+            if (operation.put) {
+                m_listEntries.insert(entry);
+            } else {
+                m_listEntries.remove(entry);
+            }
+        }
+    }
+    return true;
+}
+
+void AssetDatabase::startGarbageCollector(std::chrono::seconds interval, const GarbageCollectionOptions& options) {
+    stopGarbageCollector();
+    m_gcQuit = false;
+    m_gcThread = std::thread([this, interval, options] {
+        LOG(INFO) << "garbage collector started, running every " << interval.count() << " seconds.";
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_gcMutex);
+                if (m_gcCondition.wait_for(lock, interval, [this] { return m_gcQuit; })) {
+                    break;
+                }
+            }
+            collectGarbage(options, nullptr);
+        }
+        LOG(INFO) << "garbage collector stopped.";
+    });
+}
+
+void AssetDatabase::stopGarbageCollector() {
+    {
+        std::lock_guard<std::mutex> lock(m_gcMutex);
+        m_gcQuit = true;
+    }
+    m_gcCondition.notify_all();
+    if (m_gcThread.joinable()) {
+        m_gcThread.join();
+    }
+}
+
+std::string AssetDatabase::addAssetToBatch(uint64_t key, const SizedPointer& assetData, leveldb::WriteBatch* batch,
+    std::vector<ListIndex::Entry>* listEntries) {
+    // First we parse the Asset data to extract the name, if any.
+    const Data::FlatAsset* flatAsset = Data::GetFlatAsset(assetData.data());
+    std::string name;
+    if (flatAsset->name() && flatAsset->name()->size() > 0) {
+        name = flatAsset->name()->str();
+        LOG(INFO) << "adding name '" << name << "' lookup to asset " << Asset::keyToString(key);
+        batch->Put(kAssetNamePrefix + name, leveldb::Slice(reinterpret_cast<const char*>(&key), sizeof(uint64_t)));
+    }
+
+    // Add any list entries to the batch.
+    char listKeys[kListEntryKeySize * kAssetMaxListEntries];
+    uint64_t timeStamp = flatAsset->lists()->size() ?
+        std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count() : 0;
+    for (auto i = 0; i < flatAsset->lists()->size(); ++i) {
+        char* listKey = listKeys + (i * kListEntryKeySize);
+        listKey[0]  = kListEntry;
+        std::memcpy(listKey + 1, flatAsset->lists()->data() + i, sizeof(uint64_t));
+        std::memcpy(listKey + 9, &timeStamp, sizeof(uint64_t));
+        std::memcpy(listKey + 17, &key, sizeof(uint64_t));
+        LOG(INFO) << "adding asset " << Asset::keyToString(key) << " to list " << Asset::keyToString(
+            flatAsset->lists()->data()[i]);
+        batch->Put(leveldb::Slice(listKey, kListEntryKeySize), leveldb::Slice());
+        listEntries->push_back(ListIndex::Entry{ flatAsset->lists()->data()[i], timeStamp, key });
+    }
+
+    // Store actual Asset key/value pair.
+    std::array<char, kAssetKeySize> assetKey;
+    makeAssetKey(key, assetKey.data());
+    batch->Put(leveldb::Slice(assetKey.data(), kAssetKeySize), leveldb::Slice(assetData.dataChar(), assetData.size()));
+
+    return name;
+}
+
+leveldb::Status AssetDatabase::writeBatch(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) {
+    if (m_feedRetention.load() == 0) {
+        return m_database->write(options, batch);
+    }
+
+    std::lock_guard<std::mutex> lock(m_feedMutex);
+    // Sequence numbers are assigned and written under the lock, so the feed order is the order writes were applied.
+    ChangeFeedEncoder encoder;
+    batch->Iterate(&encoder);
+    if (encoder.empty()) {
+        return m_database->write(options, batch);
+    }
+    appendChangeFeed(m_feedSequence + 1, encoder.finish(), batch);
+    auto status = m_database->write(options, batch);
+    if (status.ok()) {
+        ++m_feedSequence;
+    }
+    return status;
+}
+
+void AssetDatabase::appendChangeFeed(uint64_t sequence, const std::string& record, leveldb::WriteBatch* batch) {
+    std::array<char, kChangeFeedKeySize> feedKey;
+    makeChangeFeedKey(sequence, feedKey.data());
+    batch->Put(leveldb::Slice(feedKey.data(), kChangeFeedKeySize), record);
+    uint64_t retention = m_feedRetention.load();
+    if (retention > 0 && sequence > retention) {
+        makeChangeFeedKey(sequence - retention, feedKey.data());
+        batch->Delete(leveldb::Slice(feedKey.data(), kChangeFeedKeySize));
+    }
+}
+
+void AssetDatabase::loadIndices() {
+    loadNameIndex(kAssetNamePrefix, &m_assetNames);
+    loadNameIndex(kListNamePrefix, &m_listNames);
+    LOG(INFO) << "Indexed " << m_assetNames.size() << " Asset names and " << m_listNames.size() << " List names.";
+    size_t entries = loadListIndex();
+    LOG(INFO) << "Indexed " << entries << " List entries.";
+
+    // Resume numbering the change feed after the last record written.
+    std::array<char, kChangeFeedKeySize> feedKey;
+    makeChangeFeedKey(std::numeric_limits<uint64_t>::max(), feedKey.data());
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    iterator->Seek(leveldb::Slice(feedKey.data(), kChangeFeedKeySize));
+    if (iterator->Valid()) {
+        iterator->Prev();
+    } else {
+        iterator->SeekToLast();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_feedMutex);
+        m_feedSequence = 0;
+        if (iterator->Valid() && iterator->key().size() == kChangeFeedKeySize && iterator->key()[0] == kChangeFeed) {
+            m_feedSequence = parseChangeFeedKey(iterator->key());
+        }
+        LOG(INFO) << "Change feed at sequence " << m_feedSequence;
+    }
+}
+
+void AssetDatabase::loadNameIndex(const char* namePrefix, NameIndex* index) {
+    index->clear();
+    size_t prefixSize = std::strlen(namePrefix);
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(namePrefix); iterator->Valid() && iterator->key().starts_with(namePrefix);
+        iterator->Next()) {
+        if (iterator->value().size() != sizeof(uint64_t)) {
+            LOG(WARNING) << "skipping malformed name entry " << iterator->key().ToString();
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->value().data(), sizeof(uint64_t));
+        index->insert(std::string(iterator->key().data() + prefixSize, iterator->key().size() - prefixSize), key);
+    }
+}
+
+size_t AssetDatabase::loadListIndex() {
+    m_listEntries.clear();
+    size_t entries = 0;
+    char prefix = kListEntry;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    for (iterator->Seek(leveldb::Slice(&prefix, 1)); iterator->Valid() && iterator->key()[0] == kListEntry;
+        iterator->Next()) {
+        if (iterator->key().size() != kListEntryKeySize) {
+            continue;
+        }
+        ListIndex::Entry entry;
+        std::memcpy(&entry.listKey, iterator->key().data() + 1, sizeof(uint64_t));
+        std::memcpy(&entry.token, iterator->key().data() + 9, sizeof(uint64_t));
+        std::memcpy(&entry.assetKey, iterator->key().data() + 17, sizeof(uint64_t));
+        if (entry.token == kBeginList || entry.token == kEndList) {
+            continue;
+        }
+        m_listEntries.insert(entry);
+        ++entries;
+    }
+    return entries;
+}
+
+size_t AssetDatabase::scanNamePrefix(const char* namePrefix, const std::string& query, size_t maxResults,
+    std::vector<NameIndex::Match>* matches) {
+    std::string seekKey = namePrefix + query;
+    size_t prefixSize = std::strlen(namePrefix);
+    size_t found = 0;
+    std::unique_ptr<leveldb::Iterator> iterator(m_database->newIterator(leveldb::ReadOptions()));
+    // Name keys are sorted lexically, so every name starting with the query is in one contiguous range following it.
+    for (iterator->Seek(seekKey); found < maxResults && iterator->Valid() && iterator->key().starts_with(seekKey);
+        iterator->Next()) {
+        if (iterator->value().size() != sizeof(uint64_t)) {
+            continue;
+        }
+        uint64_t key = 0;
+        std::memcpy(&key, iterator->value().data(), sizeof(uint64_t));
+        matches->push_back(NameIndex::Match{
+            std::string(iterator->key().data() + prefixSize, iterator->key().size() - prefixSize), key, 1.0f});
+        ++found;
+    }
+    LOG(INFO) << "found " << found << " names with prefix '" << query << "' in table " << namePrefix;
+    return found;
 }
 
 }  // namespace Confab
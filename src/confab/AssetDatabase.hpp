@@ -1,26 +1,81 @@
 #ifndef SRC_CONFAB_ASSET_DATABASE_HPP_
 #define SRC_CONFAB_ASSET_DATABASE_HPP_
 
+#include "LatencyHistogram.hpp"
+#include "ListIndex.hpp"
+#include "NameIndex.hpp"
 #include "Record.hpp"
 #include "SizedPointer.hpp"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace leveldb {
-    class DB;
     class Iterator;
+    class Status;
     class WriteBatch;
+    struct WriteOptions;
 }
 
 namespace Confab {
 
 class Database;
+class StorageEngine;
 
 /*! Class responsible for storage, retrieval, and verification of FlatAsset and FlatAssetData objects in the provided
  * file database.
  */
 class AssetDatabase {
 public:
+    /*! Parameters controlling a garbage collection pass.
+     */
+    struct GarbageCollectionOptions {
+        /*! How many older versions of an Asset to keep along a deprecation chain. Versions deprecated by more than
+         * this many newer versions have their metadata, data chunks, name and list entries deleted. Zero keeps every
+         * version.
+         */
+        size_t retentionDepth = 0;
+
+        /*! Deletions are written in batches of approximately this many bytes of keys.
+         */
+        size_t maxBatchBytes = 64 * 1024;
+
+        /*! Pause between batches, to leave database bandwidth for serving requests.
+         */
+        std::chrono::milliseconds batchPause = std::chrono::milliseconds(50);
+    };
+
+    /*! Results of a garbage collection pass.
+     */
+    struct GarbageCollectionReport {
+        /*! Number of data chunks deleted because no Asset metadata refers to them.
+         */
+        uint64_t orphanChunks = 0;
+
+        /*! Number of deprecated Asset versions deleted because they were beyond the retention depth.
+         */
+        uint64_t trimmedAssets = 0;
+
+        /*! Total number of database keys deleted.
+         */
+        uint64_t keysDeleted = 0;
+
+        /*! Total size in bytes of the keys and values deleted, before any compression by the database.
+         */
+        uint64_t bytesReclaimed = 0;
+    };
+
     /*! Constructs an AssetDatabase.
      */
     AssetDatabase();
@@ -29,17 +84,18 @@ public:
      */
     ~AssetDatabase();
 
-    /*! Open or create Database LevelDB database file tree.
+    /*! Open or create Database database file tree.
      *
-     * \param path A path to a directory where the Confab LevelDB database is stored.
+     * \param path A path to a directory where the Confab database is stored.
      * \param createNew If true, open() will attempt to create a new database, and will treat an existing or already
      *                  initialized database as an error condition. If false, open() will expect a valid database to
      *                  exist at \a path.
      * \param cacheSize Size in bytes of the LRU memory cache to request from LevelDB. A size <= 0 will disable the
      *                  cache.
+     * \param storageEngine The name of the StorageEngine to store data with, see makeStorageEngine().
      * \return true on success, or false on error.
      */
-    bool open(const char* path, bool createNew, int cacheSize);
+    bool open(const char* path, bool createNew, int cacheSize, const std::string& storageEngine);
 
     /*! Close the database, and delete any internal references to it.
      *
@@ -66,6 +122,20 @@ public:
      */
     RecordPtr findNamedAsset(const std::string& name);
 
+    /*! Searches the names of stored Assets for the provided query.
+     *
+     * \param query The full or partial name to look for.
+     * \param fuzzy If false, returns names that begin with query, in lexical order, using a range scan over the name
+     *              lookup keys in the database. Prefix matching is case-sensitive, and an empty query matches every
+     *              name. If true, returns the names most similar to query from an in-memory trigram index, best match
+     *              first, ignoring case and tolerating misspellings.
+     * \param maxResults The maximum number of matches to return.
+     * \param matches A vector to append the matching names and their Asset keys to.
+     * \return The number of matches appended.
+     */
+    size_t searchAssetNames(const std::string& query, bool fuzzy, size_t maxResults,
+        std::vector<NameIndex::Match>* matches);
+
     /*! Stores a FlatAsset record with an already computed hash into the database.
      *
      * \param key The key to store the serialized asset under.
@@ -91,6 +161,101 @@ public:
      */
     bool storeAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData);
 
+    /*! Loads a content chunk FlatAssetData record from the database. Content chunks hold the data of Assets stored in
+     * content-chunked form, and are keyed by the XXH64 hash of their contents so that Assets can share them.
+     *
+     * \param hash The hash of the content chunk data.
+     * \return A non-owning pointer to the FlatAssetData record, or an empty Record on error.
+     */
+    RecordPtr loadContentChunk(uint64_t hash);
+
+    /*! Stores a content chunk FlatAssetData record into the database, unless a chunk with the same hash is already
+     * stored.
+     *
+     * \param hash The hash of the content chunk data, which must match both the data and the hash field of the record.
+     * \param flatAssetData The FlatAssetData record to save.
+     * \return true on success or if the chunk was already stored, false on error or hash mismatch.
+     */
+    bool storeContentChunk(uint64_t hash, const SizedPointer& flatAssetData);
+
+    /*! Finds which of a set of content chunks are not stored in the database. Chunks found are protected from garbage
+     * collection for one more pass, giving a client time to store the Asset that refers to them.
+     *
+     * \param hashes The hashes of the content chunks to look for.
+     * \param missing A vector to append the hashes of chunks not found to.
+     * \return The number of hashes appended to missing.
+     */
+    size_t findMissingContentChunks(const std::vector<uint64_t>& hashes, std::vector<uint64_t>* missing);
+
+    /*! Accumulates many Asset and Asset data chunk records into large write batches, for bulk ingest.
+     *
+     * Records are written when the pending batch grows past the configured size, or when flush() is called. Names of
+     * stored Assets become searchable once the batch containing them is written. A BulkWriter is not thread-safe, but
+     * any number of BulkWriters may write to the same AssetDatabase concurrently. Any unwritten records are discarded
+     * when the BulkWriter is destroyed, so call flush() after adding the last record.
+     */
+    class BulkWriter {
+    public:
+        ~BulkWriter();
+
+        /*! Adds a FlatAssetData record to the pending batch, writing the batch if it has grown too large.
+         *
+         * \param key The key to associate with this Asset data chunk.
+         * \param chunk The chunk number to store this under.
+         * \param flatAssetData The FlatAssetData record to save.
+         * \return true on success, false if a batch write failed.
+         */
+        bool addAssetDataChunk(uint64_t key, uint64_t chunk, const SizedPointer& flatAssetData);
+
+        /*! Adds a FlatAsset record, along with its name and list entries, to the pending batch, writing the batch if
+         * it has grown too large.
+         *
+         * \param key The key to store the serialized asset under.
+         * \param assetData The serialized asset data.
+         * \return true on success, false if a batch write failed.
+         */
+        bool addAsset(uint64_t key, const SizedPointer& assetData);
+
+        /*! Writes any pending records to the database.
+         *
+         * \return true on success, false on error.
+         */
+        bool flush();
+
+        /*! Returns the total number of record bytes written by this BulkWriter so far.
+         */
+        uint64_t bytesWritten() const { return m_bytesWritten; }
+
+        /// @cond UNDOCUMENTED
+        BulkWriter(const BulkWriter&) = delete;
+        BulkWriter& operator=(const BulkWriter&) = delete;
+        /// @endcond UNDOCUMENTED
+
+    private:
+        friend class AssetDatabase;
+        BulkWriter(AssetDatabase* assetDatabase, size_t maxBatchBytes, bool sync);
+        bool flushIfFull();
+
+        AssetDatabase* m_assetDatabase;
+        size_t m_maxBatchBytes;
+        bool m_sync;
+        std::unique_ptr<leveldb::WriteBatch> m_batch;
+        // Names and list entries of Assets in the pending batch, added to the indices once the batch is written.
+        std::vector<std::pair<std::string, uint64_t>> m_pendingNames;
+        std::vector<ListIndex::Entry> m_pendingListEntries;
+        uint64_t m_bytesWritten;
+    };
+
+    /*! Makes a BulkWriter for ingesting large numbers of records with fewer, larger writes than storeAsset() and
+     * storeAssetDataChunk(). The BulkWriter must not outlive this AssetDatabase.
+     *
+     * \param maxBatchBytes Pending records are written once they exceed approximately this many bytes.
+     * \param sync If true, each batch write waits for the data to reach stable storage before returning. Ingesting
+     *        without sync is much faster, but recently written batches may be lost if the machine crashes.
+     * \return A new BulkWriter.
+     */
+    std::unique_ptr<BulkWriter> makeBulkWriter(size_t maxBatchBytes, bool sync);
+
     /*! Stores a new List entity into the database.
      *
      * \param key The list key to associate with this List.
@@ -113,6 +278,17 @@ public:
      */
     RecordPtr findNamedList(const std::string& name);
 
+    /*! Searches the names of stored Lists for the provided query. Behaves identically to searchAssetNames().
+     *
+     * \param query The full or partial name to look for.
+     * \param fuzzy If false, matches names starting with query. If true, matches names similar to query.
+     * \param maxResults The maximum number of matches to return.
+     * \param matches A vector to append the matching names and their List keys to.
+     * \return The number of matches appended.
+     */
+    size_t searchListNames(const std::string& query, bool fuzzy, size_t maxResults,
+        std::vector<NameIndex::Match>* matches);
+
     /*! Populates the provided buffer with <token, key> pairs from a list. If it reaches the end of the list it will
      * put a <kEndList, kEndList> pair at the end.
      *
@@ -126,13 +302,375 @@ public:
      */
     size_t getListNext(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut);
 
+    /*! Populates the provided buffer with <token, key> pairs from a list, in decreasing token order so that the most
+     * recently added entries come first. Answered from memory. If it reaches the oldest entry of the list it will put
+     * a <kBeginList, kBeginList> pair at the end.
+     *
+     * \param listKey The key of the list to draw from.
+     * \param fromToken The token to start before, or kEndList to start from the most recently added entry. Returned
+     *                  list will only include entries with smaller tokens.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the list, in reverse order.
+     * \return The number of pairs written into listOut.
+     */
+    size_t getListPrev(uint64_t listKey, uint64_t fromToken, size_t maxPairs, uint64_t* listOut);
+
+    /*! Returns the number of entries in a list, not counting the sentinel entries. Answered from memory.
+     *
+     * \param listKey The key of the list to count.
+     * \return The number of entries in the list, which is 0 for an unknown list.
+     */
+    size_t getListSize(uint64_t listKey);
+
+    /*! Populates the provided buffer with <token, key> pairs from a list, starting at a position in the list. Answered
+     * from memory. If it reaches the end of the list it will put a <kEndList, kEndList> pair at the end.
+     *
+     * \param listKey The key of the list to draw from.
+     * \param offset The position in the list of the first pair to return, where 0 is the first entry.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the ordered list.
+     * \return The number of pairs written into listOut.
+     */
+    size_t getListAt(uint64_t listKey, size_t offset, size_t maxPairs, uint64_t* listOut);
+
+    /*! Opens a cursor over a list, for paging through it with readListCursor().
+     *
+     * A cursor reads from a snapshot of the database taken when it is opened, so entries added to or removed from the
+     * list afterwards do not appear or disappear part way through, and each page continues from the iterator position
+     * left by the previous one instead of seeking again. A cursor not read for longer than the list cursor timeout is
+     * closed automatically, as is the least recently read cursor if too many are open.
+     *
+     * \param listKey The key of the list to page through.
+     * \param fromToken The token to start after, or 0 if starting from the beginning.
+     * \return An opaque nonzero cursor id, or 0 on error.
+     */
+    uint64_t openListCursor(uint64_t listKey, uint64_t fromToken);
+
+    /*! Populates the provided buffer with the next <token, key> pairs from a list cursor, in the same format as
+     * getListNext(). The cursor is closed once the end of list pair <kEndList, kEndList> has been read.
+     *
+     * \param cursorId The cursor id as returned by openListCursor().
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the ordered list.
+     * \return The number of pairs written into listOut, or 0 if the cursor is unknown or has expired.
+     */
+    size_t readListCursor(uint64_t cursorId, size_t maxPairs, uint64_t* listOut);
+
+    /*! Closes a list cursor, releasing its database snapshot. Does nothing if the cursor is already closed.
+     *
+     * \param cursorId The cursor id as returned by openListCursor().
+     */
+    void closeListCursor(uint64_t cursorId);
+
+    /*! Sets how long a list cursor may go unread before it is closed automatically.
+     *
+     * \param timeout The idle time after which list cursors expire.
+     */
+    void setListCursorTimeout(std::chrono::seconds timeout);
+
+    /*! Fetches Asset keys in database order, for walking every stored Asset in batches.
+     *
+     * \param afterKey The key to start after, as returned at the end of the previous batch, or 0 to start from the
+     *                 beginning. The order is that of the database, not numerical order.
+     * \param maxKeys The maximum number of keys to return.
+     * \param keys A vector to append the keys to.
+     * \return The number of keys appended, which is less than maxKeys only at the end of the Assets.
+     */
+    size_t getAssetKeys(uint64_t afterKey, size_t maxKeys, std::vector<uint64_t>* keys);
+
+    /*! Re-reads the stored FlatAssetData chunks of an Asset and checks them against their recorded hashes.
+     *
+     * Chunks are hashed in order, and the incremental hash after each chunk must match the hash stored in that chunk.
+     * The final hash must equal the Asset key and the total size must match the size in the FlatAsset. Assets with
+     * only inline data have no chunks and always verify. Content-chunked Assets are verified by walking their manifest
+     * pages, checking each content chunk against its own hash and size and the combined data against the Asset key.
+     * Reads bypass the block cache.
+     *
+     * \param key The key of the Asset to verify.
+     * \param progress Called after each chunk with its size in bytes, can sleep to limit the rate of verification.
+     *                 If it returns false verification stops early, and the Asset is reported as not corrupt.
+     * \param problem Set to a description of the first problem found, if any.
+     * \return false if the Asset is corrupt, true otherwise.
+     */
+    bool verifyAssetData(uint64_t key, std::function<bool(size_t)> progress, std::string* problem);
+
+    /*! Loads a record of internal server state, such as progress of background tasks, from the database.
+     *
+     * \param name The name of the internal record.
+     * \return The stored value, or an empty Record if not present.
+     */
+    RecordPtr loadInternal(const std::string& name);
+
+    /*! Stores a record of internal server state, replacing any existing record of the same name. Internal records are
+     * kept separate from Assets and Lists and are never served to clients.
+     *
+     * \param name The name of the internal record.
+     * \param value The value to store.
+     * \return true on success, false on error.
+     */
+    bool storeInternal(const std::string& name, const SizedPointer& value);
+
+    /*! Writes every stored FlatAsset record into a Catalog file, for downstream clients to map at startup.
+     *
+     * Scans a consistent snapshot of the database without filling the block cache. The catalog is written to a
+     * temporary file and renamed into place, so an existing catalog at path stays valid until the export completes.
+     *
+     * \param path The path of the catalog file to write.
+     * \param assetCount If non-null, is set to the number of Assets exported.
+     * \return true on success, false on error.
+     */
+    bool exportCatalog(const std::string& path, size_t* assetCount);
+
+    /*! Writes every record in the database into a backup archive, while the database stays available for reads and
+     * writes.
+     *
+     * Scans a consistent snapshot of the database without filling the block cache, so the archive holds exactly the
+     * records present when the backup started, and streams them into the archive a block at a time. The archive is
+     * written to a temporary file and renamed into place once complete.
+     *
+     * \param path The path of the archive to write.
+     * \param blockBytes Approximate size of each archive block. Larger blocks compress keys better, smaller ones
+     *        spread a restore over more threads.
+     * \param recordCount If non-null, is set to the number of records backed up.
+     * \return true on success, false on error.
+     */
+    bool writeBackup(const std::string& path, size_t blockBytes, uint64_t* recordCount);
+
+    /*! Loads every record in a backup archive written by writeBackup() into this database, which must be empty.
+     *
+     * Each archive block is verified and written as a single batch, on a pool of threads, and the in-memory name and
+     * List indices are rebuilt afterwards. Must not be called while other threads are using the database. A failed
+     * restore may leave some blocks written, so restore again into a fresh database.
+     *
+     * \param path The path of the archive to restore.
+     * \param numThreads Number of threads verifying and writing blocks.
+     * \param sync If true, each block write waits for the data to reach stable storage.
+     * \param recordCount If non-null, is set to the number of records restored.
+     * \return true on success, false if the database is not empty, or the archive is corrupt or could not be written.
+     */
+    bool restoreBackup(const std::string& path, size_t numThreads, bool sync, uint64_t* recordCount);
+
+    /*! Deletes unreachable data from the database.
+     *
+     * Data chunks are unreachable when there is no Asset metadata with their key, which is usually the result of a
+     * failed upload. Chunks found unreachable are only deleted if they were also found unreachable on the previous
+     * pass, which gives any upload in progress the time between passes to complete. If options.retentionDepth is
+     * nonzero, Assets deprecated by more than that many newer versions are also deleted entirely.
+     *
+     * Scans a consistent snapshot of the database without filling the block cache, and deletes in bounded batches
+     * with a pause in between. Storage is returned to the filesystem as LevelDB compacts the deleted ranges.
+     *
+     * \param options Parameters for the collection pass.
+     * \param report If non-null, is filled with statistics about the data deleted.
+     * \return true on success, false on error.
+     */
+    bool collectGarbage(const GarbageCollectionOptions& options, GarbageCollectionReport* report);
+
+    /*! Starts a thread that calls collectGarbage() periodically, until stopGarbageCollector() or close() is called.
+     *
+     * \param interval Time between the end of one collection pass and the start of the next.
+     * \param options Parameters for each collection pass.
+     */
+    void startGarbageCollector(std::chrono::seconds interval, const GarbageCollectionOptions& options);
+
+    /*! Stops the garbage collection thread, if running. Blocks until any pass in progress finishes its current batch.
+     */
+    void stopGarbageCollector();
+
+    /*! Sets how many change feed records to keep. Every write of Asset, data chunk, or List records is appended to the
+     * change feed with a sequence number one larger than the previous write, so that a standby server can replay the
+     * writes in the same order. Records older than the most recent retention records are deleted.
+     *
+     * \param retention The number of records to keep, or 0 to stop recording the change feed.
+     */
+    void setChangeFeedRetention(uint64_t retention);
+
+    /*! The sequence number of the most recent change feed record, or 0 if none has been written.
+     */
+    uint64_t changeFeedSequence();
+
+    /*! Describes a single change feed record.
+     */
+    struct ChangeFeedEntry {
+        /*! The sequence number of the record.
+         */
+        uint64_t sequence;
+
+        /*! The size of the record in bytes.
+         */
+        size_t size;
+    };
+
+    /*! Lists change feed records in sequence order.
+     *
+     * \param fromSequence The sequence number of the first record to list.
+     * \param maxEntries The maximum number of records to list.
+     * \param entries A vector to append the records to.
+     * \param oldestSequence Set to the sequence number of the oldest record still kept, or 0 if the feed is empty. A
+     *                       standby needing records older than this must be seeded from a copy of the database.
+     * \return The number of entries appended.
+     */
+    size_t getChangeFeed(uint64_t fromSequence, size_t maxEntries, std::vector<ChangeFeedEntry>* entries,
+        uint64_t* oldestSequence);
+
+    /*! Loads a change feed record, for sending to a standby server.
+     *
+     * \param sequence The sequence number of the record to load.
+     * \return The record, or an empty Record if it was never written or has been trimmed.
+     */
+    RecordPtr loadChangeFeedRecord(uint64_t sequence);
+
+    /*! Applies a change feed record loaded from another database to this one, updating the name and list indices.
+     *
+     * Records must be applied in order, so sequence must be one larger than changeFeedSequence(). The record is also
+     * kept in this database's change feed under the same sequence number. Requires a nonzero change feed retention.
+     *
+     * \param sequence The sequence number of the record.
+     * \param record The record contents, as returned by loadChangeFeedRecord().
+     * \return true on success, false if the record is out of order, corrupt, or failed to write.
+     */
+    bool applyChangeFeedRecord(uint64_t sequence, const SizedPointer& record);
+
+    /*! Database operations whose latencies are recorded, see latency().
+     */
+    enum Operation : size_t {
+        kFindAsset,
+        kStoreAsset,
+        kLoadDataChunk,
+        kStoreDataChunk,
+        kFindName,
+        kLoadList,
+        kStoreList,
+        kReadList,
+        kOperationCount
+    };
+
+    /*! The latencies of every call of one kind of operation since the database was opened. Loads and stores of content
+     * chunks count as data chunk operations, and all ways of reading List entries as kReadList.
+     *
+     * \param operation The operation.
+     * \return The latency histogram for the operation.
+     */
+    const LatencyHistogram& latency(Operation operation) const { return m_latency[operation]; }
+
+    /*! Storage used by the keys with one prefix.
+     */
+    struct PrefixStats {
+        /*! The key prefix, such as "a" for Asset metadata.
+         */
+        std::string prefix;
+
+        /*! Number of keys, only counted if requested.
+         */
+        uint64_t keys = 0;
+
+        /*! Total size of the keys and their values before compression, only counted if requested.
+         */
+        uint64_t bytes = 0;
+
+        /*! The storage engine's estimate of the space the keys take up on disk, after compression.
+         */
+        uint64_t approximateBytes = 0;
+    };
+
+    /*! Measures how much of the database is taken up by each kind of record.
+     *
+     * \param countKeys If true, also count the keys and bytes under each prefix exactly. This scans the whole database,
+     *                  bypassing the block cache, so takes time proportional to its size.
+     * \return The statistics for each key prefix.
+     */
+    std::vector<PrefixStats> getPrefixStats(bool countKeys);
+
+    /*! Formats a plain text report of the database, with one "name value" pair per line. Includes the per-prefix
+     * statistics, operation latencies, block cache hit rate, and the storage engine's own statistics.
+     *
+     * \param countKeys If true, count keys exactly as in getPrefixStats().
+     * \return The report.
+     */
+    std::string statsReport(bool countKeys);
+
     /// @cond UNDOCUMENTED
     AssetDatabase(const AssetDatabase&) = delete;
     AssetDatabase& operator=(const AssetDatabase&) = delete;
     /// @endcond UNDOCUMENTED
 
 private:
-    std::unique_ptr<leveldb::DB> m_database;
+    /*! Rebuilds the name and List indices and finds the change feed sequence number from the database contents.
+     */
+    void loadIndices();
+
+    /*! Populates a NameIndex with every name stored in the database under the provided name prefix.
+     *
+     * \param namePrefix The name lookup table prefix to scan.
+     * \param index The index to clear and then populate.
+     */
+    void loadNameIndex(const char* namePrefix, NameIndex* index);
+
+    /*! Adds the FlatAsset record with its name lookup and list entries to batch, and appends the list entries added
+     * to listEntries.
+     *
+     * \return The name of the Asset, or an empty string if unnamed.
+     */
+    std::string addAssetToBatch(uint64_t key, const SizedPointer& assetData, leveldb::WriteBatch* batch,
+        std::vector<ListIndex::Entry>* listEntries);
+
+    /*! Writes batch to the database, appending it to the change feed if enabled.
+     */
+    leveldb::Status writeBatch(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch);
+
+    /*! Adds a change feed record with the provided sequence number to batch, and deletes the record falling out of
+     * retention. Call with m_feedMutex held.
+     */
+    void appendChangeFeed(uint64_t sequence, const std::string& record, leveldb::WriteBatch* batch);
+
+    /*! Populates m_listEntries with every list entry stored in the database.
+     *
+     * \return The number of entries indexed.
+     */
+    size_t loadListIndex();
+
+    /*! Appends up to maxResults names starting with query, from the name lookup table with the provided prefix.
+     */
+    size_t scanNamePrefix(const char* namePrefix, const std::string& query, size_t maxResults,
+        std::vector<NameIndex::Match>* matches);
+
+    struct ListCursor;
+
+    /*! Closes expired cursors, and if still at the limit the least recently read one. Call with m_listCursorMutex held.
+     */
+    void expireListCursors();
+
+    /*! Implements verifyAssetData() for a content-chunked Asset, with its manifest in chunks 0 to manifestPages - 1.
+     */
+    bool verifyContentChunks(uint64_t key, uint64_t manifestPages, uint64_t size, std::function<bool(size_t)> progress,
+        std::string* problem);
+
+    std::unique_ptr<StorageEngine> m_database;
+    NameIndex m_assetNames;
+    NameIndex m_listNames;
+    ListIndex m_listEntries;
+
+    std::thread m_gcThread;
+    std::mutex m_gcMutex;
+    std::condition_variable m_gcCondition;
+    bool m_gcQuit;
+    // Asset keys whose chunks were unreachable on the last garbage collection pass.
+    std::unordered_set<uint64_t> m_gcOrphans;
+    // Hashes of content chunks no manifest referred to on the last garbage collection pass.
+    std::unordered_set<uint64_t> m_gcContentOrphans;
+
+    std::mutex m_listCursorMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<ListCursor>> m_listCursors;
+    std::chrono::seconds m_listCursorTimeout;
+    std::mt19937_64 m_listCursorIds;
+
+    std::array<LatencyHistogram, kOperationCount> m_latency;
+
+    // Serializes writes while the change feed is enabled, so that sequence numbers follow the order of the writes.
+    // Retention is read without the lock, so that writes skip it entirely while the feed is disabled.
+    std::mutex m_feedMutex;
+    uint64_t m_feedSequence;
+    std::atomic<uint64_t> m_feedRetention;
 };
 
 }  // namespace Confab
@@ -0,0 +1,188 @@
+#include "AssetScrubber.hpp"
+
+#include "Asset.hpp"
+#include "AssetDatabase.hpp"
+
+#include "glog/logging.h"
+
+#include <sstream>
+#include <vector>
+
+namespace {
+
+/*! Name of the internal database record holding scrub progress.
+ */
+static const char* kScrubProgressName = "scrub";
+
+/*! Number of Asset keys fetched from the database at a time.
+ */
+static const size_t kKeysPerBatch = 64;
+
+/*! How often to save progress to the database during a pass.
+ */
+static const std::chrono::seconds kSaveInterval(30);
+
+}  // namespace
+
+namespace Confab {
+
+AssetScrubber::AssetScrubber(std::shared_ptr<AssetDatabase> assetDatabase, size_t bytesPerSecond) :
+    m_assetDatabase(assetDatabase),
+    m_bytesPerSecond(bytesPerSecond > 0 ? bytesPerSecond : 1),
+    m_quit(false) {
+    loadProgress();
+}
+
+AssetScrubber::~AssetScrubber() {
+    stop();
+}
+
+void AssetScrubber::start(std::chrono::seconds passInterval) {
+    stop();
+    m_quit = false;
+    {
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        m_status.running = true;
+    }
+    m_thread = std::thread(&AssetScrubber::scrubLoop, this, passInterval);
+}
+
+void AssetScrubber::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        m_quit = true;
+    }
+    m_quitCondition.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+        saveProgress();
+    }
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    m_status.running = false;
+}
+
+AssetScrubber::Status AssetScrubber::status() {
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    return m_status;
+}
+
+void AssetScrubber::scrubLoop(std::chrono::seconds passInterval) {
+    uint64_t cursor = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        cursor = m_status.cursor;
+    }
+    LOG(INFO) << "scrubber starting at " << Asset::keyToString(cursor) << ", limited to " << m_bytesPerSecond
+        << " bytes per second.";
+    auto lastSave = std::chrono::steady_clock::now();
+
+    while (true) {
+        std::vector<uint64_t> keys;
+        m_assetDatabase->getAssetKeys(cursor, kKeysPerBatch, &keys);
+        for (auto key : keys) {
+            std::string problem;
+            uint64_t bytesChecked = 0;
+            bool valid = m_assetDatabase->verifyAssetData(key, [this, &bytesChecked](size_t bytes) {
+                bytesChecked += bytes;
+                return throttle(bytes);
+            }, &problem);
+
+            {
+                std::lock_guard<std::mutex> lock(m_quitMutex);
+                if (m_quit) {
+                    // Verification of this Asset may have been abandoned part way, so leave the cursor before it.
+                    return;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_statusMutex);
+                ++m_status.assetsChecked;
+                m_status.bytesChecked += bytesChecked;
+                m_status.cursor = key;
+                if (valid) {
+                    m_status.corruptAssets.erase(key);
+                } else {
+                    m_status.corruptAssets[key] = problem;
+                }
+            }
+            cursor = key;
+
+            if (std::chrono::steady_clock::now() - lastSave > kSaveInterval) {
+                saveProgress();
+                lastSave = std::chrono::steady_clock::now();
+            }
+        }
+
+        if (keys.size() < kKeysPerBatch) {
+            size_t corruptCount = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_statusMutex);
+                ++m_status.passesCompleted;
+                m_status.cursor = 0;
+                corruptCount = m_status.corruptAssets.size();
+            }
+            cursor = 0;
+            saveProgress();
+            LOG(INFO) << "scrubber completed pass, " << corruptCount << " corrupt Assets known.";
+            if (!waitFor(passInterval)) {
+                return;
+            }
+        }
+    }
+}
+
+bool AssetScrubber::throttle(size_t bytes) {
+    return waitFor(std::chrono::microseconds((bytes * 1000000) / m_bytesPerSecond));
+}
+
+bool AssetScrubber::waitFor(std::chrono::microseconds duration) {
+    std::unique_lock<std::mutex> lock(m_quitMutex);
+    return !m_quitCondition.wait_for(lock, duration, [this] { return m_quit; });
+}
+
+void AssetScrubber::loadProgress() {
+    RecordPtr record = m_assetDatabase->loadInternal(kScrubProgressName);
+    if (record->empty()) {
+        LOG(INFO) << "no saved scrub progress, starting from the beginning.";
+        return;
+    }
+
+    // Progress is stored as text lines of "cursor <key>", "passes <count>", and "corrupt <key> <problem>".
+    std::istringstream progress(std::string(record->data().dataChar(), record->data().size()));
+    std::string line;
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    while (std::getline(progress, line)) {
+        std::istringstream fields(line);
+        std::string field;
+        fields >> field;
+        if (field == "cursor") {
+            fields >> field;
+            m_status.cursor = Asset::stringToKey(field);
+        } else if (field == "passes") {
+            fields >> m_status.passesCompleted;
+        } else if (field == "corrupt") {
+            fields >> field;
+            std::string problem;
+            std::getline(fields >> std::ws, problem);
+            m_status.corruptAssets[Asset::stringToKey(field)] = problem;
+        }
+    }
+    LOG(INFO) << "loaded scrub progress at " << Asset::keyToString(m_status.cursor) << ", "
+        << m_status.corruptAssets.size() << " corrupt Assets known.";
+}
+
+void AssetScrubber::saveProgress() {
+    std::string progress;
+    {
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        progress = "cursor " + Asset::keyToString(m_status.cursor) + "\n";
+        progress += "passes " + std::to_string(m_status.passesCompleted) + "\n";
+        for (const auto& corrupt : m_status.corruptAssets) {
+            progress += "corrupt " + Asset::keyToString(corrupt.first) + " " + corrupt.second + "\n";
+        }
+    }
+    m_assetDatabase->storeInternal(kScrubProgressName, SizedPointer(progress.data(), progress.size()));
+}
+
+}  // namespace Confab
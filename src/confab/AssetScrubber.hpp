@@ -0,0 +1,115 @@
+#ifndef SRC_CONFAB_ASSET_SCRUBBER_HPP_
+#define SRC_CONFAB_ASSET_SCRUBBER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Confab {
+
+class AssetDatabase;
+
+/*! Background thread that walks every stored Asset, re-verifying its data chunks to find corruption before a client
+ * does.
+ *
+ * Verification reads are limited to a configured number of bytes per second, so scrubbing does not compete with
+ * clients for disk bandwidth. The position of the scrub and the set of corrupt Assets found are saved periodically in
+ * the database, so a restarted server resumes where it left off instead of starting over.
+ */
+class AssetScrubber {
+public:
+    /*! Summary of scrubbing progress and findings.
+     */
+    struct Status {
+        /*! True if the scrubbing thread is running.
+         */
+        bool running = false;
+
+        /*! Number of complete passes over every Asset.
+         */
+        uint64_t passesCompleted = 0;
+
+        /*! Number of Assets verified since the server started.
+         */
+        uint64_t assetsChecked = 0;
+
+        /*! Number of bytes of Asset data verified since the server started.
+         */
+        uint64_t bytesChecked = 0;
+
+        /*! The key of the last Asset verified in the current pass, or 0 at the start of a pass.
+         */
+        uint64_t cursor = 0;
+
+        /*! Assets that failed verification, mapped to a description of the problem. An Asset is removed if it later
+         * passes verification, for example after being uploaded again.
+         */
+        std::map<uint64_t, std::string> corruptAssets;
+    };
+
+    /*! Constructs an AssetScrubber, loading any saved progress from the database.
+     *
+     * \param assetDatabase The opened AssetDatabase to scrub.
+     * \param bytesPerSecond The maximum rate to read Asset data at.
+     */
+    AssetScrubber(std::shared_ptr<AssetDatabase> assetDatabase, size_t bytesPerSecond);
+
+    /*! Destructs an AssetScrubber, stopping the thread if running.
+     */
+    ~AssetScrubber();
+
+    /*! Starts the scrubbing thread.
+     *
+     * \param passInterval Time to wait after completing a pass before starting the next one.
+     */
+    void start(std::chrono::seconds passInterval);
+
+    /*! Stops the scrubbing thread and saves progress. Blocks until the Asset being verified is abandoned.
+     */
+    void stop();
+
+    /*! Returns a copy of the current scrubbing status.
+     *
+     * \return The scrubbing status.
+     */
+    Status status();
+
+    /// @cond UNDOCUMENTED
+    AssetScrubber(const AssetScrubber&) = delete;
+    AssetScrubber& operator=(const AssetScrubber&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    void scrubLoop(std::chrono::seconds passInterval);
+
+    /*! Sleeps long enough to keep verification at the configured rate. Returns false if stop() was called.
+     */
+    bool throttle(size_t bytes);
+
+    /*! Waits for the provided duration, returning false early if stop() was called.
+     */
+    bool waitFor(std::chrono::microseconds duration);
+
+    void loadProgress();
+    void saveProgress();
+
+    std::shared_ptr<AssetDatabase> m_assetDatabase;
+    size_t m_bytesPerSecond;
+
+    std::thread m_thread;
+    std::mutex m_quitMutex;
+    std::condition_variable m_quitCondition;
+    bool m_quit;
+
+    std::mutex m_statusMutex;
+    Status m_status;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_ASSET_SCRUBBER_HPP_
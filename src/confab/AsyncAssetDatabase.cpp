@@ -0,0 +1,291 @@
+#include "AsyncAssetDatabase.hpp"
+
+#include "AssetDatabase.hpp"
+
+#include "glog/logging.h"
+
+#include <cstring>
+
+namespace {
+
+/*! Builds a coalescing key from a request type and its numeric arguments.
+ */
+std::string makeRequestKey(char type, uint64_t key, uint64_t chunk = 0) {
+    std::string requestKey(1 + (2 * sizeof(uint64_t)), type);
+    std::memcpy(&requestKey[1], &key, sizeof(uint64_t));
+    std::memcpy(&requestKey[1 + sizeof(uint64_t)], &chunk, sizeof(uint64_t));
+    return requestKey;
+}
+
+}  // namespace
+
+namespace Confab {
+
+AsyncAssetDatabase::AsyncAssetDatabase(std::shared_ptr<AssetDatabase> assetDatabase, size_t numThreads) :
+    m_assetDatabase(assetDatabase),
+    m_threadPool(numThreads) {
+}
+
+AsyncAssetDatabase::~AsyncAssetDatabase() {
+    shutdown();
+}
+
+void AsyncAssetDatabase::findAsset(uint64_t key, RecordCallback callback) {
+    coalesceLoad(makeRequestKey('a', key), ThreadPool::kHighPriority, [this, key] {
+        return m_assetDatabase->findAsset(key);
+    }, callback);
+}
+
+void AsyncAssetDatabase::findNamedAsset(const std::string& name, RecordCallback callback) {
+    coalesceLoad("na" + name, ThreadPool::kHighPriority, [this, name] {
+        return m_assetDatabase->findNamedAsset(name);
+    }, callback);
+}
+
+void AsyncAssetDatabase::searchAssetNames(const std::string& query, bool fuzzy, size_t maxResults,
+    MatchesCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, query, fuzzy, maxResults, callback] {
+        std::vector<NameIndex::Match> matches;
+        m_assetDatabase->searchAssetNames(query, fuzzy, maxResults, &matches);
+        callback(std::move(matches));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback({});
+    }
+}
+
+void AsyncAssetDatabase::storeAsset(uint64_t key, std::vector<uint8_t> assetData, StatusCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, key, assetData = std::move(assetData),
+        callback] {
+        callback(m_assetDatabase->storeAsset(key, SizedPointer(assetData.data(), assetData.size())));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback(false);
+    }
+}
+
+void AsyncAssetDatabase::loadAssetDataChunk(uint64_t key, uint64_t chunk, RecordCallback callback) {
+    coalesceLoad(makeRequestKey('d', key, chunk), ThreadPool::kLowPriority, [this, key, chunk] {
+        return m_assetDatabase->loadAssetDataChunk(key, chunk);
+    }, callback);
+}
+
+void AsyncAssetDatabase::storeAssetDataChunk(uint64_t key, uint64_t chunk, std::vector<uint8_t> flatAssetData,
+    StatusCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kLowPriority, [this, key, chunk,
+        flatAssetData = std::move(flatAssetData), callback] {
+        callback(m_assetDatabase->storeAssetDataChunk(key, chunk,
+            SizedPointer(flatAssetData.data(), flatAssetData.size())));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback(false);
+    }
+}
+
+void AsyncAssetDatabase::loadContentChunk(uint64_t hash, RecordCallback callback) {
+    coalesceLoad(makeRequestKey('k', hash), ThreadPool::kLowPriority, [this, hash] {
+        return m_assetDatabase->loadContentChunk(hash);
+    }, callback);
+}
+
+void AsyncAssetDatabase::storeContentChunk(uint64_t hash, std::vector<uint8_t> flatAssetData,
+    StatusCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kLowPriority, [this, hash, flatAssetData = std::move(flatAssetData),
+        callback] {
+        callback(m_assetDatabase->storeContentChunk(hash, SizedPointer(flatAssetData.data(), flatAssetData.size())));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback(false);
+    }
+}
+
+void AsyncAssetDatabase::findMissingContentChunks(std::vector<uint64_t> hashes, KeysCallback callback) {
+    auto shared = std::make_shared<std::vector<uint64_t>>(std::move(hashes));
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, shared, callback] {
+        std::vector<uint64_t> missing;
+        m_assetDatabase->findMissingContentChunks(*shared, &missing);
+        callback(missing);
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback(*shared);
+    }
+}
+
+void AsyncAssetDatabase::storeList(uint64_t key, std::vector<uint8_t> listData, StatusCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, key, listData = std::move(listData),
+        callback] {
+        callback(m_assetDatabase->storeList(key, SizedPointer(listData.data(), listData.size())));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback(false);
+    }
+}
+
+void AsyncAssetDatabase::loadList(uint64_t key, RecordCallback callback) {
+    coalesceLoad(makeRequestKey('l', key), ThreadPool::kHighPriority, [this, key] {
+        return m_assetDatabase->loadList(key);
+    }, callback);
+}
+
+void AsyncAssetDatabase::findNamedList(const std::string& name, RecordCallback callback) {
+    coalesceLoad("nl" + name, ThreadPool::kHighPriority, [this, name] {
+        return m_assetDatabase->findNamedList(name);
+    }, callback);
+}
+
+void AsyncAssetDatabase::searchListNames(const std::string& query, bool fuzzy, size_t maxResults,
+    MatchesCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, query, fuzzy, maxResults, callback] {
+        std::vector<NameIndex::Match> matches;
+        m_assetDatabase->searchListNames(query, fuzzy, maxResults, &matches);
+        callback(std::move(matches));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback({});
+    }
+}
+
+void AsyncAssetDatabase::getListNext(uint64_t listKey, uint64_t fromToken, size_t maxPairs, ListCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, listKey, fromToken, maxPairs, callback] {
+        std::vector<uint64_t> pairs(maxPairs * 2);
+        size_t numPairs = m_assetDatabase->getListNext(listKey, fromToken, maxPairs, pairs.data());
+        pairs.resize(numPairs * 2);
+        callback(std::move(pairs));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback({});
+    }
+}
+
+void AsyncAssetDatabase::getListPrev(uint64_t listKey, uint64_t fromToken, size_t maxPairs, ListCallback callback) {
+    // Reverse iteration is answered from memory, so there is no need to queue behind database reads.
+    std::vector<uint64_t> pairs(maxPairs * 2);
+    size_t numPairs = m_assetDatabase->getListPrev(listKey, fromToken, maxPairs, pairs.data());
+    pairs.resize(numPairs * 2);
+    callback(std::move(pairs));
+}
+
+void AsyncAssetDatabase::getListSize(uint64_t listKey, SizeCallback callback) {
+    // Counts are answered from memory, so there is no need to queue behind database reads.
+    callback(m_assetDatabase->getListSize(listKey));
+}
+
+void AsyncAssetDatabase::getListAt(uint64_t listKey, size_t offset, size_t maxPairs, ListCallback callback) {
+    // Positional access is answered from memory, so there is no need to queue behind database reads.
+    std::vector<uint64_t> pairs(maxPairs * 2);
+    size_t numPairs = m_assetDatabase->getListAt(listKey, offset, maxPairs, pairs.data());
+    pairs.resize(numPairs * 2);
+    callback(std::move(pairs));
+}
+
+void AsyncAssetDatabase::openListCursor(uint64_t listKey, uint64_t fromToken, CursorCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, listKey, fromToken, callback] {
+        callback(m_assetDatabase->openListCursor(listKey, fromToken));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback(0);
+    }
+}
+
+void AsyncAssetDatabase::readListCursor(uint64_t cursorId, size_t maxPairs, ListCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, cursorId, maxPairs, callback] {
+        std::vector<uint64_t> pairs(maxPairs * 2);
+        size_t numPairs = m_assetDatabase->readListCursor(cursorId, maxPairs, pairs.data());
+        pairs.resize(numPairs * 2);
+        callback(std::move(pairs));
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback({});
+    }
+}
+
+void AsyncAssetDatabase::closeListCursor(uint64_t cursorId) {
+    bool queued = m_threadPool.post(ThreadPool::kHighPriority, [this, cursorId] {
+        m_assetDatabase->closeListCursor(cursorId);
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+    }
+}
+
+void AsyncAssetDatabase::getChangeFeed(uint64_t fromSequence, size_t maxEntries, FeedCallback callback) {
+    bool queued = m_threadPool.post(ThreadPool::kLowPriority, [this, fromSequence, maxEntries, callback] {
+        std::vector<AssetDatabase::ChangeFeedEntry> entries;
+        uint64_t oldestSequence = 0;
+        uint64_t latestSequence = m_assetDatabase->changeFeedSequence();
+        m_assetDatabase->getChangeFeed(fromSequence, maxEntries, &entries, &oldestSequence);
+        callback(std::move(entries), oldestSequence, latestSequence);
+    });
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, dropping.";
+        callback({}, 0, 0);
+    }
+}
+
+void AsyncAssetDatabase::loadChangeFeedRecord(uint64_t sequence, RecordCallback callback) {
+    coalesceLoad(makeRequestKey('f', sequence), ThreadPool::kLowPriority, [this, sequence] {
+        return m_assetDatabase->loadChangeFeedRecord(sequence);
+    }, callback);
+}
+
+void AsyncAssetDatabase::shutdown() {
+    m_threadPool.shutdown();
+}
+
+void AsyncAssetDatabase::coalesceLoad(const std::string& requestKey, ThreadPool::Priority priority,
+    std::function<RecordPtr()> load, RecordCallback callback) {
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        auto pending = m_pendingLoads.find(requestKey);
+        if (pending != m_pendingLoads.end()) {
+            pending->second.push_back(callback);
+            return;
+        }
+        m_pendingLoads.emplace(requestKey, std::vector<RecordCallback>({ callback }));
+    }
+
+    bool queued = m_threadPool.post(priority, [this, requestKey, load] {
+        RecordPtr record = load();
+        std::vector<RecordCallback> callbacks;
+        {
+            // Remove the pending entry before calling back, so that any request arriving after this point issues a
+            // fresh load and observes writes that completed after this one.
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            auto pending = m_pendingLoads.find(requestKey);
+            callbacks.swap(pending->second);
+            m_pendingLoads.erase(pending);
+        }
+        // Records are read-only, so a single result is safely shared between all waiting callbacks.
+        for (auto& waiting : callbacks) {
+            waiting(record);
+        }
+    });
+
+    if (!queued) {
+        LOG(ERROR) << "database request after shutdown, returning empty record.";
+        std::vector<RecordCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            auto pending = m_pendingLoads.find(requestKey);
+            if (pending != m_pendingLoads.end()) {
+                callbacks.swap(pending->second);
+                m_pendingLoads.erase(pending);
+            }
+        }
+        for (auto& waiting : callbacks) {
+            waiting(makeEmptyRecord());
+        }
+    }
+}
+
+}  // namespace Confab
@@ -0,0 +1,282 @@
+#ifndef SRC_CONFAB_ASYNC_ASSET_DATABASE_HPP_
+#define SRC_CONFAB_ASYNC_ASSET_DATABASE_HPP_
+
+#include "AssetDatabase.hpp"
+#include "NameIndex.hpp"
+#include "Record.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Confab {
+
+/*! Callback-based wrapper around AssetDatabase that runs all database access on a dedicated pool of I/O threads.
+ *
+ * Lets network handlers hand off requests without blocking their own threads on LevelDB reads or writes. Metadata
+ * requests for Assets and Lists run on the high priority lane of the pool, and Asset data chunk transfers on the low
+ * priority lane, so that a large download does not delay lookups queued behind it. Concurrent loads of the same record
+ * are coalesced into a single database read, with the result delivered to every waiting callback.
+ *
+ * Callbacks are called on a pool thread, and must not block for long.
+ */
+class AsyncAssetDatabase {
+public:
+    /*! Called with the loaded Record, which is empty if the load failed.
+     */
+    using RecordCallback = std::function<void(RecordPtr)>;
+
+    /*! Called with true if the store succeeded, false on error.
+     */
+    using StatusCallback = std::function<void(bool)>;
+
+    /*! Called with the results of a name search.
+     */
+    using MatchesCallback = std::function<void(std::vector<NameIndex::Match>)>;
+
+    /*! Called with the <token, key> pairs from a List, which is empty on error.
+     */
+    using ListCallback = std::function<void(std::vector<uint64_t>)>;
+
+    /*! Called with a new list cursor id, which is 0 on error.
+     */
+    using CursorCallback = std::function<void(uint64_t)>;
+
+    /*! Called with the number of entries in a List.
+     */
+    using SizeCallback = std::function<void(size_t)>;
+
+    /*! Called with a list of keys or hashes.
+     */
+    using KeysCallback = std::function<void(std::vector<uint64_t>)>;
+
+    /*! Called with change feed entries, the oldest sequence number still kept, and the latest sequence number.
+     */
+    using FeedCallback = std::function<void(std::vector<AssetDatabase::ChangeFeedEntry>, uint64_t, uint64_t)>;
+
+    /*! Constructs an AsyncAssetDatabase and starts its thread pool.
+     *
+     * \param assetDatabase The already opened AssetDatabase to run requests against.
+     * \param numThreads The number of I/O threads to start.
+     */
+    AsyncAssetDatabase(std::shared_ptr<AssetDatabase> assetDatabase, size_t numThreads);
+
+    /*! Destructs an AsyncAssetDatabase, waiting for queued requests to complete.
+     */
+    ~AsyncAssetDatabase();
+
+    /*! Asynchronous version of AssetDatabase::findAsset().
+     *
+     * \param key The Asset key to look up.
+     * \param callback Called with the most recent version of the FlatAsset record.
+     */
+    void findAsset(uint64_t key, RecordCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::findNamedAsset().
+     *
+     * \param name The name of the Asset to look up.
+     * \param callback Called with the most recent version of the FlatAsset record.
+     */
+    void findNamedAsset(const std::string& name, RecordCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::searchAssetNames().
+     *
+     * \param query The full or partial name to look for.
+     * \param fuzzy If true use the trigram index, if false match names starting with query.
+     * \param maxResults The maximum number of matches to return.
+     * \param callback Called with the matching names and their Asset keys.
+     */
+    void searchAssetNames(const std::string& query, bool fuzzy, size_t maxResults, MatchesCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::storeAsset().
+     *
+     * \param key The key to store the serialized Asset under.
+     * \param assetData The serialized FlatAsset, moved into the request.
+     * \param callback Called with the result of the store.
+     */
+    void storeAsset(uint64_t key, std::vector<uint8_t> assetData, StatusCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::loadAssetDataChunk(). Runs on the low priority lane.
+     *
+     * \param key The key of the Asset.
+     * \param chunk Which chunk number to load.
+     * \param callback Called with the FlatAssetData record.
+     */
+    void loadAssetDataChunk(uint64_t key, uint64_t chunk, RecordCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::storeAssetDataChunk(). Runs on the low priority lane.
+     *
+     * \param key The key of the Asset.
+     * \param chunk The chunk number to store.
+     * \param flatAssetData The serialized FlatAssetData, moved into the request.
+     * \param callback Called with the result of the store.
+     */
+    void storeAssetDataChunk(uint64_t key, uint64_t chunk, std::vector<uint8_t> flatAssetData,
+        StatusCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::loadContentChunk(). Runs on the low priority lane.
+     *
+     * \param hash The hash of the content chunk.
+     * \param callback Called with the FlatAssetData record.
+     */
+    void loadContentChunk(uint64_t hash, RecordCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::storeContentChunk(). Runs on the low priority lane.
+     *
+     * \param hash The hash of the content chunk.
+     * \param flatAssetData The serialized FlatAssetData, moved into the request.
+     * \param callback Called with the result of the store.
+     */
+    void storeContentChunk(uint64_t hash, std::vector<uint8_t> flatAssetData, StatusCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::findMissingContentChunks().
+     *
+     * \param hashes The hashes of the content chunks to look for, moved into the request.
+     * \param callback Called with the hashes of the chunks not found, which is all of them on error.
+     */
+    void findMissingContentChunks(std::vector<uint64_t> hashes, KeysCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::storeList().
+     *
+     * \param key The List key.
+     * \param listData The serialized FlatList, moved into the request.
+     * \param callback Called with the result of the store.
+     */
+    void storeList(uint64_t key, std::vector<uint8_t> listData, StatusCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::loadList().
+     *
+     * \param key The List key to load.
+     * \param callback Called with the FlatList record.
+     */
+    void loadList(uint64_t key, RecordCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::findNamedList().
+     *
+     * \param name The name of the List to look up.
+     * \param callback Called with the FlatList record.
+     */
+    void findNamedList(const std::string& name, RecordCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::searchListNames().
+     *
+     * \param query The full or partial name to look for.
+     * \param fuzzy If true use the trigram index, if false match names starting with query.
+     * \param maxResults The maximum number of matches to return.
+     * \param callback Called with the matching names and their List keys.
+     */
+    void searchListNames(const std::string& query, bool fuzzy, size_t maxResults, MatchesCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::getListNext().
+     *
+     * \param listKey The key of the List to draw from.
+     * \param fromToken The token to start after, or 0 to start from the beginning.
+     * \param maxPairs The maximum number of <token, key> pairs to return.
+     * \param callback Called with the flattened <token, key> pairs.
+     */
+    void getListNext(uint64_t listKey, uint64_t fromToken, size_t maxPairs, ListCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::getListPrev().
+     *
+     * \param listKey The key of the List to draw from.
+     * \param fromToken The token to start before, or kEndList to start from the most recently added entry.
+     * \param maxPairs The maximum number of <token, key> pairs to return.
+     * \param callback Called with the flattened <token, key> pairs, in reverse order.
+     */
+    void getListPrev(uint64_t listKey, uint64_t fromToken, size_t maxPairs, ListCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::getListSize().
+     *
+     * \param listKey The key of the List to count.
+     * \param callback Called with the number of entries in the List.
+     */
+    void getListSize(uint64_t listKey, SizeCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::getListAt().
+     *
+     * \param listKey The key of the List to draw from.
+     * \param offset The position in the List of the first pair to return.
+     * \param maxPairs The maximum number of <token, key> pairs to return.
+     * \param callback Called with the flattened <token, key> pairs.
+     */
+    void getListAt(uint64_t listKey, size_t offset, size_t maxPairs, ListCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::openListCursor().
+     *
+     * \param listKey The key of the List to page through.
+     * \param fromToken The token to start after, or 0 to start from the beginning.
+     * \param callback Called with the new cursor id.
+     */
+    void openListCursor(uint64_t listKey, uint64_t fromToken, CursorCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::readListCursor().
+     *
+     * \param cursorId The cursor id to read from.
+     * \param maxPairs The maximum number of <token, key> pairs to return.
+     * \param callback Called with the flattened <token, key> pairs.
+     */
+    void readListCursor(uint64_t cursorId, size_t maxPairs, ListCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::closeListCursor().
+     *
+     * \param cursorId The cursor id to close.
+     */
+    void closeListCursor(uint64_t cursorId);
+
+    /*! Asynchronous version of AssetDatabase::getChangeFeed().
+     *
+     * \param fromSequence The sequence number of the first record to list.
+     * \param maxEntries The maximum number of records to list.
+     * \param callback Called with the records listed, and the range of sequence numbers kept.
+     */
+    void getChangeFeed(uint64_t fromSequence, size_t maxEntries, FeedCallback callback);
+
+    /*! Asynchronous version of AssetDatabase::loadChangeFeedRecord().
+     *
+     * \param sequence The sequence number of the record to load.
+     * \param callback Called with the change feed record.
+     */
+    void loadChangeFeedRecord(uint64_t sequence, RecordCallback callback);
+
+    /*! Stops accepting requests and waits for those already queued to complete.
+     */
+    void shutdown();
+
+    /*! The underlying synchronous database.
+     *
+     * \return The shared AssetDatabase object.
+     */
+    std::shared_ptr<AssetDatabase> assetDatabase() { return m_assetDatabase; }
+
+    /// @cond UNDOCUMENTED
+    AsyncAssetDatabase(const AsyncAssetDatabase&) = delete;
+    AsyncAssetDatabase& operator=(const AsyncAssetDatabase&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    /*! Queues a Record load, unless an identical load is already in flight, in which case the callback is added to
+     * those waiting on the existing load.
+     *
+     * \param requestKey Uniquely identifies the load, requests with equal keys are coalesced.
+     * \param priority Which lane of the thread pool to run the load on.
+     * \param load Performs the load, called on a pool thread.
+     * \param callback Called with the loaded Record.
+     */
+    void coalesceLoad(const std::string& requestKey, ThreadPool::Priority priority, std::function<RecordPtr()> load,
+        RecordCallback callback);
+
+    std::shared_ptr<AssetDatabase> m_assetDatabase;
+    ThreadPool m_threadPool;
+
+    std::mutex m_pendingMutex;
+    std::unordered_map<std::string, std::vector<RecordCallback>> m_pendingLoads;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_ASYNC_ASSET_DATABASE_HPP_
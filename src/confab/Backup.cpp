@@ -0,0 +1,360 @@
+#include "Backup.hpp"
+
+#include "glog/logging.h"
+#include "xxhash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+static const char kBackupMagic[8] = { 'c', 'o', 'n', 'f', 'a', 'b', 'b', 'k' };
+static const uint32_t kBackupVersion = 1;
+
+/*! Fixed header at the start of every archive.
+ */
+struct BackupHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(BackupHeader) == 16, "backup header layout must be stable across builds");
+
+/*! Precedes the records of each block.
+ */
+struct BlockHeader {
+    uint32_t records;
+    uint32_t size;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(BlockHeader) == 16, "backup block header layout must be stable across builds");
+
+/*! Fixed footer at the end of every archive. The index of (offset, record count) pairs for each block sits just before
+ * it, and the checksum covers the header and the index.
+ */
+struct BackupFooter {
+    uint64_t indexOffset;
+    uint64_t blockCount;
+    uint64_t recordCount;
+    uint64_t checksum;
+    char magic[8];
+};
+
+static_assert(sizeof(BackupFooter) == 40, "backup footer layout must be stable across builds");
+
+void appendVarint(uint32_t value, std::string* out) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+/*! Decodes a varint from [*data, end), advancing *data past it. Returns false if the varint is truncated or too long.
+ */
+bool parseVarint(const uint8_t** data, const uint8_t* end, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35 && *data < end; shift += 7) {
+        uint8_t byte = *((*data)++);
+        *value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t checksumHeaderAndIndex(const void* header, const void* index, size_t indexBytes) {
+    XXH64_state_t* state = XXH64_createState();
+    XXH64_reset(state, 0);
+    XXH64_update(state, header, sizeof(BackupHeader));
+    XXH64_update(state, index, indexBytes);
+    uint64_t checksum = XXH64_digest(state);
+    XXH64_freeState(state);
+    return checksum;
+}
+
+BackupHeader makeHeader() {
+    BackupHeader header;
+    std::memcpy(header.magic, kBackupMagic, sizeof(kBackupMagic));
+    header.version = kBackupVersion;
+    header.reserved = 0;
+    return header;
+}
+
+}  // namespace
+
+namespace Confab {
+
+// static
+constexpr size_t BackupWriter::kDefaultBlockBytes;
+
+BackupWriter::BackupWriter() :
+    m_blockBytes(kDefaultBlockBytes),
+    m_blockRecords(0),
+    m_recordCount(0),
+    m_bytesWritten(0),
+    m_finished(false) {
+}
+
+BackupWriter::~BackupWriter() {
+    if (!m_writePath.empty() && !m_finished) {
+        m_file.close();
+        std::error_code error;
+        fs::remove(m_writePath, error);
+    }
+}
+
+bool BackupWriter::open(const fs::path& path, size_t blockBytes) {
+    m_path = path;
+    m_writePath = path;
+    m_writePath += ".tmp";
+    m_blockBytes = std::max(blockBytes, static_cast<size_t>(1));
+    m_file.open(m_writePath, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        LOG(ERROR) << "failed to open backup file " << m_writePath << " for writing.";
+        return false;
+    }
+
+    BackupHeader header = makeHeader();
+    return write(&header, sizeof(BackupHeader));
+}
+
+bool BackupWriter::add(const SizedPointer& key, const SizedPointer& value) {
+    size_t shared = 0;
+    size_t limit = std::min(m_lastKey.size(), key.size());
+    while (shared < limit && m_lastKey[shared] == key.dataChar()[shared]) {
+        ++shared;
+    }
+    appendVarint(static_cast<uint32_t>(shared), &m_block);
+    appendVarint(static_cast<uint32_t>(key.size() - shared), &m_block);
+    appendVarint(static_cast<uint32_t>(value.size()), &m_block);
+    m_block.append(key.dataChar() + shared, key.size() - shared);
+    m_block.append(value.dataChar(), value.size());
+    m_lastKey.assign(key.dataChar(), key.size());
+    ++m_blockRecords;
+    ++m_recordCount;
+
+    if (m_block.size() >= m_blockBytes) {
+        return writeBlock();
+    }
+    return true;
+}
+
+bool BackupWriter::finish() {
+    if (m_blockRecords && !writeBlock()) {
+        return false;
+    }
+
+    BackupFooter footer;
+    footer.indexOffset = m_bytesWritten;
+    footer.blockCount = m_index.size();
+    footer.recordCount = m_recordCount;
+    std::memcpy(footer.magic, kBackupMagic, sizeof(kBackupMagic));
+    BackupHeader header = makeHeader();
+    footer.checksum = checksumHeaderAndIndex(&header, m_index.data(), m_index.size() * sizeof(m_index[0]));
+
+    if (!write(m_index.data(), m_index.size() * sizeof(m_index[0])) || !write(&footer, sizeof(BackupFooter))) {
+        return false;
+    }
+    m_file.close();
+    if (!m_file) {
+        LOG(ERROR) << "error closing backup file " << m_writePath;
+        return false;
+    }
+
+    // The rename must not reach the disk before the data it names, or a crash could leave a truncated archive under
+    // the final name.
+    int fd = ::open(m_writePath.c_str(), O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+        LOG(ERROR) << "failed to flush backup file " << m_writePath << " to stable storage.";
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    ::close(fd);
+
+    std::error_code error;
+    fs::rename(m_writePath, m_path, error);
+    if (error) {
+        LOG(ERROR) << "failed to rename backup file " << m_writePath << " to " << m_path << ": " << error.message();
+        return false;
+    }
+    m_finished = true;
+    LOG(INFO) << "wrote backup " << m_path << " with " << m_recordCount << " records in " << m_index.size()
+        << " blocks, " << m_bytesWritten << " bytes.";
+    return true;
+}
+
+bool BackupWriter::writeBlock() {
+    BlockHeader header;
+    header.records = m_blockRecords;
+    header.size = static_cast<uint32_t>(m_block.size());
+    header.checksum = XXH64(m_block.data(), m_block.size(), 0);
+    m_index.emplace_back(m_bytesWritten, m_blockRecords);
+    bool ok = write(&header, sizeof(BlockHeader)) && write(m_block.data(), m_block.size());
+    m_block.clear();
+    m_blockRecords = 0;
+    m_lastKey.clear();
+    return ok;
+}
+
+bool BackupWriter::write(const void* data, size_t size) {
+    m_file.write(static_cast<const char*>(data), size);
+    if (!m_file) {
+        LOG(ERROR) << "error writing backup file " << m_writePath;
+        return false;
+    }
+    m_bytesWritten += size;
+    return true;
+}
+
+BackupReader::BackupReader() :
+    m_data(nullptr),
+    m_size(0),
+    m_index(nullptr),
+    m_blockCount(0),
+    m_recordCount(0) {
+}
+
+BackupReader::~BackupReader() {
+    close();
+}
+
+bool BackupReader::open(const fs::path& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "failed to open backup file " << path;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 ||
+        static_cast<size_t>(fileStat.st_size) < sizeof(BackupHeader) + sizeof(BackupFooter)) {
+        LOG(ERROR) << "backup file " << path << " too small for header and footer.";
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "failed to map backup file " << path;
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(mapped);
+    m_size = fileSize;
+
+    const BackupHeader* header = reinterpret_cast<const BackupHeader*>(m_data);
+    BackupFooter footer;
+    std::memcpy(&footer, m_data + fileSize - sizeof(BackupFooter), sizeof(BackupFooter));
+    if (std::memcmp(header->magic, kBackupMagic, sizeof(kBackupMagic)) != 0 || header->version != kBackupVersion ||
+        std::memcmp(footer.magic, kBackupMagic, sizeof(kBackupMagic)) != 0) {
+        LOG(ERROR) << "backup file " << path << " has unrecognized magic or version, or is truncated.";
+        close();
+        return false;
+    }
+    size_t indexEnd = fileSize - sizeof(BackupFooter);
+    if (footer.indexOffset < sizeof(BackupHeader) || footer.indexOffset > indexEnd ||
+        footer.blockCount != (indexEnd - footer.indexOffset) / (2 * sizeof(uint64_t)) ||
+        footer.indexOffset + (footer.blockCount * 2 * sizeof(uint64_t)) != indexEnd ||
+        checksumHeaderAndIndex(m_data, m_data + footer.indexOffset, footer.blockCount * 2 * sizeof(uint64_t)) !=
+        footer.checksum) {
+        LOG(ERROR) << "backup file " << path << " index does not match file layout.";
+        close();
+        return false;
+    }
+
+    // Bounds-check every block up front, so that readBlock() can trust the index.
+    const uint64_t* index = reinterpret_cast<const uint64_t*>(m_data + footer.indexOffset);
+    uint64_t records = 0;
+    for (size_t i = 0; i < footer.blockCount; ++i) {
+        uint64_t end = (i + 1 < footer.blockCount) ? index[2 * (i + 1)] : footer.indexOffset;
+        if (index[2 * i] < sizeof(BackupHeader) || index[2 * i] + sizeof(BlockHeader) > end) {
+            LOG(ERROR) << "backup file " << path << " block " << i << " out of bounds.";
+            close();
+            return false;
+        }
+        BlockHeader blockHeader;
+        std::memcpy(&blockHeader, m_data + index[2 * i], sizeof(BlockHeader));
+        if (index[2 * i] + sizeof(BlockHeader) + blockHeader.size != end || blockHeader.records != index[(2 * i) + 1]) {
+            LOG(ERROR) << "backup file " << path << " block " << i << " header does not match index.";
+            close();
+            return false;
+        }
+        records += blockHeader.records;
+    }
+    if (records != footer.recordCount) {
+        LOG(ERROR) << "backup file " << path << " block record counts do not match footer.";
+        close();
+        return false;
+    }
+
+    // Restores read each block once, front to back.
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+
+    m_index = index;
+    m_blockCount = footer.blockCount;
+    m_recordCount = footer.recordCount;
+    LOG(INFO) << "opened backup " << path << " with " << m_recordCount << " records in " << m_blockCount << " blocks.";
+    return true;
+}
+
+void BackupReader::close() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_index = nullptr;
+    m_blockCount = 0;
+    m_recordCount = 0;
+}
+
+bool BackupReader::readBlock(size_t block,
+    std::function<void(const SizedPointer& key, const SizedPointer& value)> callback) const {
+    if (block >= m_blockCount) {
+        return false;
+    }
+    BlockHeader header;
+    std::memcpy(&header, m_data + m_index[2 * block], sizeof(BlockHeader));
+    const uint8_t* data = m_data + m_index[2 * block] + sizeof(BlockHeader);
+    const uint8_t* end = data + header.size;
+    if (XXH64(data, header.size, 0) != header.checksum) {
+        LOG(ERROR) << "backup block " << block << " failed checksum verification.";
+        return false;
+    }
+
+    std::string key;
+    for (uint32_t i = 0; i < header.records; ++i) {
+        uint32_t shared = 0;
+        uint32_t unshared = 0;
+        uint32_t valueSize = 0;
+        if (!parseVarint(&data, end, &shared) || !parseVarint(&data, end, &unshared) ||
+            !parseVarint(&data, end, &valueSize) || shared > key.size() ||
+            static_cast<size_t>(end - data) < static_cast<size_t>(unshared) + valueSize) {
+            LOG(ERROR) << "backup block " << block << " record " << i << " is malformed.";
+            return false;
+        }
+        key.resize(shared);
+        key.append(reinterpret_cast<const char*>(data), unshared);
+        data += unshared;
+        callback(SizedPointer(key.data(), key.size()), SizedPointer(data, valueSize));
+        data += valueSize;
+    }
+    if (data != end) {
+        LOG(ERROR) << "backup block " << block << " has trailing bytes after its records.";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace Confab
@@ -0,0 +1,153 @@
+#ifndef SRC_CONFAB_BACKUP_HPP_
+#define SRC_CONFAB_BACKUP_HPP_
+
+#include "SizedPointer.hpp"
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+/*! Streams database records, in key order, into a backup archive file.
+ *
+ * An archive is a fixed header, then a sequence of blocks, then an index of the blocks and a fixed footer. Each block
+ * holds the records added while it was open, up to about the block size, with each key stored as the length of the
+ * prefix it shares with the previous key in the block and the bytes that differ, so the long runs of keys with common
+ * prefixes in the database take little space. Every block carries an XXH64 hash of its contents and starts its key
+ * compression afresh, so blocks can be verified and restored independently and in parallel.
+ *
+ * Only one block is held in memory at once. The archive is written beside its destination and renamed into place by
+ * finish(), so an interrupted backup never leaves a truncated archive behind.
+ */
+class BackupWriter {
+public:
+    /*! Default size of each block before it is written, in bytes.
+     */
+    static constexpr size_t kDefaultBlockBytes = 4 * 1024 * 1024;
+
+    /*! Constructs a BackupWriter. Call open() before adding records.
+     */
+    BackupWriter();
+
+    /*! Destructs a BackupWriter, removing the partially written archive if finish() did not succeed.
+     */
+    ~BackupWriter();
+
+    /*! Starts writing a new archive.
+     *
+     * \param path The destination path of the archive.
+     * \param blockBytes Records are written out as a block once they exceed approximately this many bytes.
+     * \return true on success, false if the temporary file could not be created.
+     */
+    bool open(const fs::path& path, size_t blockBytes);
+
+    /*! Adds a record to the archive. Keys must be added in increasing bytewise order.
+     *
+     * \param key The database key.
+     * \param value The value stored under key.
+     * \return true on success, false if a block write failed.
+     */
+    bool add(const SizedPointer& key, const SizedPointer& value);
+
+    /*! Writes the last block, the index and footer, flushes the archive to stable storage and renames it into place.
+     *
+     * \return true on success, false on error.
+     */
+    bool finish();
+
+    /*! The number of records added so far.
+     */
+    uint64_t recordCount() const { return m_recordCount; }
+
+    /*! The number of archive bytes written so far.
+     */
+    uint64_t bytesWritten() const { return m_bytesWritten; }
+
+    /// @cond UNDOCUMENTED
+    BackupWriter(const BackupWriter&) = delete;
+    BackupWriter& operator=(const BackupWriter&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    bool writeBlock();
+    bool write(const void* data, size_t size);
+
+    fs::path m_path;
+    fs::path m_writePath;
+    std::ofstream m_file;
+    size_t m_blockBytes;
+    std::string m_block;
+    uint32_t m_blockRecords;
+    std::string m_lastKey;
+    // Offset and record count of each block written so far.
+    std::vector<std::pair<uint64_t, uint64_t>> m_index;
+    uint64_t m_recordCount;
+    uint64_t m_bytesWritten;
+    bool m_finished;
+};
+
+/*! Memory-mapped, read-only view of a backup archive written by BackupWriter.
+ */
+class BackupReader {
+public:
+    /*! Constructs an empty BackupReader. Call open() to map an archive.
+     */
+    BackupReader();
+
+    /*! Destructs a BackupReader, unmapping any open archive.
+     */
+    ~BackupReader();
+
+    /*! Maps an archive, validating its header, footer and index. Block contents are only verified as they are read.
+     *
+     * \param path The path of the archive to open.
+     * \return true on success, false if the file is missing, truncated or malformed.
+     */
+    bool open(const fs::path& path);
+
+    /*! Unmaps the archive, if open.
+     */
+    void close();
+
+    /*! The number of blocks in the archive.
+     */
+    size_t blockCount() const { return m_blockCount; }
+
+    /*! The total number of records in the archive.
+     */
+    uint64_t recordCount() const { return m_recordCount; }
+
+    /*! Verifies the hash of one block, then calls back with each of its records in key order. Safe to call from any
+     * number of threads at once.
+     *
+     * \param block The index of the block to read, less than blockCount().
+     * \param callback Called with each key and value. The pointers are only valid during the call.
+     * \return true on success, false if the block is corrupt, in which case some records may already have been passed
+     *         to callback.
+     */
+    bool readBlock(size_t block, std::function<void(const SizedPointer& key, const SizedPointer& value)> callback)
+        const;
+
+    /// @cond UNDOCUMENTED
+    BackupReader(const BackupReader&) = delete;
+    BackupReader& operator=(const BackupReader&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    const uint64_t* m_index;
+    size_t m_blockCount;
+    uint64_t m_recordCount;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_BACKUP_HPP_
@@ -0,0 +1,116 @@
+#include "Backup.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+fs::path makeBackupPath() {
+    return fs::temp_directory_path() / ("confab-backup-test-" + std::to_string(getpid()));
+}
+
+std::vector<std::pair<std::string, std::string>> readAll(const Confab::BackupReader& reader) {
+    std::vector<std::pair<std::string, std::string>> records;
+    for (size_t i = 0; i < reader.blockCount(); ++i) {
+        EXPECT_TRUE(reader.readBlock(i, [&records](const Confab::SizedPointer& key, const Confab::SizedPointer& value) {
+            records.emplace_back(std::string(key.dataChar(), key.size()), std::string(value.dataChar(), value.size()));
+        }));
+    }
+    return records;
+}
+
+}  // namespace
+
+TEST(BackupTest, EmptyArchive) {
+    fs::path path = makeBackupPath();
+    {
+        Confab::BackupWriter writer;
+        ASSERT_TRUE(writer.open(path, 1024));
+        ASSERT_TRUE(writer.finish());
+    }
+    Confab::BackupReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(0, reader.blockCount());
+    EXPECT_EQ(0, reader.recordCount());
+    fs::remove(path);
+}
+
+TEST(BackupTest, RoundTripsRecordsAcrossBlocks) {
+    fs::path path = makeBackupPath();
+    std::vector<std::pair<std::string, std::string>> records;
+    for (int i = 0; i < 1000; ++i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "d%08d", i);
+        records.emplace_back(key, std::string(i % 300, static_cast<char>('a' + (i % 26))));
+    }
+    {
+        Confab::BackupWriter writer;
+        ASSERT_TRUE(writer.open(path, 4096));
+        for (const auto& record : records) {
+            ASSERT_TRUE(writer.add(Confab::SizedPointer(record.first.data(), record.first.size()),
+                Confab::SizedPointer(record.second.data(), record.second.size())));
+        }
+        ASSERT_TRUE(writer.finish());
+        EXPECT_EQ(1000, writer.recordCount());
+    }
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+
+    Confab::BackupReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_LT(1, reader.blockCount());
+    EXPECT_EQ(1000, reader.recordCount());
+    EXPECT_EQ(records, readAll(reader));
+    fs::remove(path);
+}
+
+TEST(BackupTest, UnfinishedArchiveIsDiscarded) {
+    fs::path path = makeBackupPath();
+    {
+        Confab::BackupWriter writer;
+        ASSERT_TRUE(writer.open(path, 1024));
+        ASSERT_TRUE(writer.add(Confab::SizedPointer("a", 1), Confab::SizedPointer("value", 5)));
+    }
+    EXPECT_FALSE(fs::exists(path));
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+}
+
+TEST(BackupTest, DetectsCorruption) {
+    fs::path path = makeBackupPath();
+    {
+        Confab::BackupWriter writer;
+        ASSERT_TRUE(writer.open(path, 1024));
+        for (int i = 0; i < 100; ++i) {
+            std::string key = "a" + std::to_string(1000 + i);
+            ASSERT_TRUE(writer.add(Confab::SizedPointer(key.data(), key.size()), Confab::SizedPointer("0123456789",
+                10)));
+        }
+        ASSERT_TRUE(writer.finish());
+    }
+
+    // Flip a byte in the middle of the first block.
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekg(64);
+        char byte = 0;
+        file.read(&byte, 1);
+        byte ^= 0x55;
+        file.seekp(64);
+        file.write(&byte, 1);
+    }
+    Confab::BackupReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_FALSE(reader.readBlock(0, [](const Confab::SizedPointer&, const Confab::SizedPointer&) { }));
+    EXPECT_TRUE(reader.readBlock(1, [](const Confab::SizedPointer&, const Confab::SizedPointer&) { }));
+    reader.close();
+
+    // A truncated archive has no valid footer and is refused outright.
+    fs::resize_file(path, fs::file_size(path) - 1);
+    EXPECT_FALSE(reader.open(path));
+    fs::remove(path);
+}
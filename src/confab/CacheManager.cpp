@@ -1,219 +1,1498 @@
 #include "CacheManager.hpp"
 
 #include "Asset.hpp"
+#include "CachePolicy.hpp"
 #include "Constants.hpp"
+#include "ContentChunker.hpp"
 #include "HttpClient.hpp"
+#include "ThreadPool.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 
 #include "glog/logging.h"
+// Exposes the layout of XXH64_state_t, so that the hash state of a partial download can be saved.
+#define XXH_STATIC_LINKING_ONLY
 #include "xxhash.h"
 
-#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <map>
+#include <iterator>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// The manifest is a header, then one record per cached file, each followed by the extension of the file.
+struct ManifestHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    // XXH64 hash of everything after the header.
+    uint64_t checksum;
+};
+
+struct ManifestRecord {
+    uint64_t key;
+    uint64_t inode;
+    uint64_t size;
+    int64_t modified;
+    int64_t lastAccess;
+    uint32_t verified;
+    uint32_t extensionSize;
+};
+
+const char kManifestMagic[8] = { 'c', 'o', 'n', 'f', 'a', 'b', 'c', 'm' };
+const uint32_t kManifestVersion = 1;
+
+// The saved state of a partial download is a header, the hash state after its verified chunks, the number and expected
+// hash of each chunk written beyond them, then a bitmap of every chunk written.
+struct DownloadStateHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hashStateSize;
+    uint64_t key;
+    uint64_t fileSize;
+    uint64_t chunks;
+    uint64_t verifiedChunks;
+    uint64_t pendingCount;
+    // XXH64 hash of everything after the header.
+    uint64_t checksum;
+};
+
+struct PendingChunkRecord {
+    uint64_t chunk;
+    uint64_t hash;
+};
+
+const char kDownloadStateMagic[8] = { 'c', 'o', 'n', 'f', 'a', 'b', 'p', 'd' };
+const uint32_t kDownloadStateVersion = 1;
+
+}  // namespace
 
 namespace Confab {
 
+struct CacheManager::DownloadState {
+    explicit DownloadState(uint64_t totalChunks) :
+        chunks(totalChunks),
+        verifiedChunks(0),
+        written((totalChunks + 7) / 8, 0) {
+        XXH64_reset(&hashState, 0);
+    }
+
+    bool isWritten(uint64_t chunk) const { return written[chunk / 8] & (1 << (chunk % 8)); }
+    void setWritten(uint64_t chunk) { written[chunk / 8] |= 1 << (chunk % 8); }
+
+    uint64_t chunks;
+    // Chunks verified in order from the start of the Asset, and the hash state after them.
+    uint64_t verifiedChunks;
+    XXH64_state_t hashState;
+    // One bit per chunk written to the partial file.
+    std::vector<uint8_t> written;
+    // Chunks written beyond the verified ones, with the hash each should bring the Asset data to. Their data is held
+    // here until the chunks before them are verified.
+    std::map<uint64_t, std::pair<std::vector<uint8_t>, uint64_t>> pending;
+};
+
 CacheManager::CacheManager(const fs::path& cachePath, size_t maxSize, std::shared_ptr<HttpClient> httpClient) :
     m_cachePath(cachePath),
     m_maxSize(maxSize),
     m_httpClient(httpClient),
-    m_currentSize(0) {
+    m_downloadConcurrency(kDefaultDownloadConcurrency),
+    m_currentSize(0),
+    m_highWatermark(maxSize),
+    m_lowWatermark(maxSize),
+    m_minFreeBytes(0),
+    m_evictionRequested(false),
+    m_evictionQuit(false),
+    m_policy(makeCachePolicy("lru", maxSize)),
+    m_pinnedSize(0),
+    m_ramMaxSize(0),
+    m_ramMaxAssetSize(0),
+    m_ramPromoteAccesses(0),
+    m_ramSize(0),
+    m_accessesSinceAging(0),
+    m_hits(0),
+    m_ramHits(0),
+    m_misses(0),
+    m_completedDownloads(0),
+    m_downloadFailures(0),
+    m_downloadedBytes(0),
+    m_reusedBytes(0),
+    m_evictions(0),
+    m_evictedBytes(0),
+    m_validationFailures(0) {
 }
 
-void CacheManager::checkExistingEntries(bool validate) {
+CacheManager::~CacheManager() {
+    stopEvictionThread();
+}
+
+void CacheManager::startEvictionThread(double highWatermark, double lowWatermark, size_t minFreeBytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_highWatermark = static_cast<size_t>(static_cast<double>(m_maxSize) * std::min(highWatermark, 1.0));
+        m_lowWatermark = std::min(m_highWatermark,
+            static_cast<size_t>(static_cast<double>(m_maxSize) * std::max(lowWatermark, 0.0)));
+        m_minFreeBytes = minFreeBytes;
+    }
+    LOG(INFO) << "starting cache eviction thread, evicting from " << m_highWatermark << " down to " << m_lowWatermark
+        << " bytes, keeping " << minFreeBytes << " bytes of disk free.";
+    m_evictionThread = std::thread(&CacheManager::evictionLoop, this);
+}
+
+void CacheManager::setPolicy(std::unique_ptr<CachePolicy> policy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = std::move(policy);
+    trackEntries();
+}
+
+bool CacheManager::setRamTier(const fs::path& ramPath, size_t maxSize, size_t maxAssetSize,
+    uint32_t promoteAccesses) {
+    std::error_code error;
+    fs::create_directories(ramPath, error);
+    if (error || !fs::is_directory(ramPath)) {
+        LOG(ERROR) << "unable to create RAM cache directory " << ramPath;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ramPath = ramPath;
+    m_ramMaxSize = maxSize;
+    m_ramMaxAssetSize = maxAssetSize;
+    m_ramPromoteAccesses = std::max(promoteAccesses, static_cast<uint32_t>(1));
+    clearRamTier();
+    LOG(INFO) << "RAM cache tier in " << ramPath << " holding up to " << maxSize << " bytes of Assets up to "
+        << maxAssetSize << " bytes each.";
+    return true;
+}
+
+void CacheManager::checkExistingEntries(bool validate, size_t numThreads) {
     LOG(INFO) << "CacheManager starting file enumeration within path: " << m_cachePath;
 
     // Reset current state to empty.
-    m_currentSize = 0;
-    while (!m_timeQueue.empty()) {
-        m_timeQueue.pop();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_currentSize = 0;
+        m_pinnedSize = 0;
+        m_entries.clear();
+        m_policy->clear();
+        m_pendingAccesses.clear();
+        m_contentChunks.clear();
+        m_assetContentChunks.clear();
+        m_validating.clear();
+        clearRamTier();
+        // Pins made before the cache was enumerated are kept, along with those saved by an earlier run.
+        readPins();
     }
-    m_extensionMap.clear();
 
+    // Files whose identity has not changed since the manifest was written keep their access time and verification.
+    std::unordered_map<uint64_t, CacheFile> manifest;
+    if (readManifest(&manifest)) {
+        LOG(INFO) << "read " << manifest.size() << " records from cache manifest.";
+    }
+
+    std::vector<CacheFile> trusted;
+    std::vector<CacheFile> unverified;
     for (auto& entry : fs::directory_iterator(m_cachePath)) {
         fs::path path = entry.path();
-        if (fs::is_regular_file(path)) {
-            size_t fileSize = fs::file_size(path);
-            std::chrono::time_point writeTime = fs::last_write_time(path);
-            uint64_t key = Asset::stringToKey(path.stem());
-            bool valid = true;
-            if (validate) {
-                XXH64_state_t* hashState = XXH64_createState();
-                XXH64_reset(hashState, 0);
-                std::array<char, kDataChunkSize> fileChunk;
-                std::ifstream inFile(path);
-                if (!inFile) {
-                    LOG(ERROR) << "error opening cache file: " << path << " for hash validation.";
-                    valid = false;
-                } else {
-                    size_t bytesRemaining = fileSize;
-                    while (inFile && bytesRemaining > 0) {
-                        inFile.read(fileChunk.data(), kDataChunkSize);
-                        size_t bytesRead = inFile.gcount();
-                        bytesRemaining -= bytesRead;
-                        XXH64_update(hashState, fileChunk.data(), bytesRead);
-                    }
-                    uint64_t hash = XXH64_digest(hashState);
-                    if (hash != key || bytesRemaining > 0) {
-                        LOG(ERROR) << "error validating cache file: " << path << " computed hash of "
-                            << Asset::keyToString(hash) << " with " << bytesRemaining << " bytes unread.";
-                        valid = false;
-                    } else {
-                        LOG(INFO) << "validated cache file " << path << ".";
+        if (path.filename().string().front() == '.') {
+            // Interrupted downloads are kept with their saved state for a while, so that a retry can resume them. A
+            // partial file without state was interrupted by a crash before any progress was saved. Requests are
+            // served during the scan, so the files of a download in progress are skipped, checked under the lock so
+            // that a download cannot start between the check and the removal.
+            if (path.extension() == kDownloadExtension || path.extension() == kPartialExtension) {
+                fs::path partialPath = path;
+                partialPath.replace_extension(kDownloadExtension);
+                fs::path statePath = path;
+                statePath.replace_extension(kPartialExtension);
+                std::error_code error;
+                auto saved = fs::last_write_time(statePath, error);
+                if (error || !fs::exists(partialPath) ||
+                    fs::file_time_type::clock::now() - saved > kPartialDownloadLifetime) {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (!m_writing.count(Asset::stringToKey(path.filename().string().substr(1)))) {
+                        LOG(INFO) << "removing interrupted download " << path;
+                        fs::remove(path, error);
                     }
                 }
-                XXH64_freeState(hashState);
             }
-            if (valid) {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                LOG(INFO) << "adding " << path << " to cache record, " << fileSize << " bytes.";
-                m_currentSize += fileSize;
-                m_timeQueue.push(std::make_pair(writeTime, path));
-                fs::path extension = path.extension();
-                m_extensionMap.insert(std::make_pair(key, extension));
-            } else {
-                LOG(WARNING) << "removing invalid cache file " << path;
-                fs::remove(path);
-            }
-        } else {
+            continue;
+        }
+        if (!fs::is_regular_file(path)) {
             LOG(INFO) << "found non-file entry: " << path << " in cache.";
+            continue;
+        }
+        CacheFile file;
+        file.key = Asset::stringToKey(path.stem());
+        file.extension = path.extension().string();
+        if (!readIdentity(path, &file.identity)) {
+            LOG(ERROR) << "unable to stat cache file " << path;
+            continue;
+        }
+        // Until the journal says otherwise, a file was last accessed when it was downloaded.
+        file.lastAccess = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::nanoseconds(file.identity.modified)).count();
+        auto recorded = manifest.find(file.key);
+        if (recorded != manifest.end() && recorded->second.extension == file.extension &&
+            recorded->second.identity == file.identity) {
+            file.lastAccess = recorded->second.lastAccess;
+            file.verified = recorded->second.verified;
+        }
+        if (file.verified || !validate) {
+            trusted.push_back(file);
+        } else {
+            unverified.push_back(file);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& file : trusted) {
+            addEntry(file);
+        }
+        for (const auto& file : unverified) {
+            m_validating.insert(file.key);
+        }
+    }
+    LOG(INFO) << "CacheManager trusting " << trusted.size() << " files, validating " << unverified.size() << ".";
+
+    if (!unverified.empty()) {
+        // Each file joins the cache as soon as it is verified, so it can be served while the rest are still hashing.
+        ThreadPool pool(std::max(numThreads, static_cast<size_t>(1)));
+        for (const auto& file : unverified) {
+            pool.post(ThreadPool::kHighPriority, [this, file] {
+                validateFile(file);
+            });
         }
+        pool.shutdown();
     }
 
-    LOG(INFO) << "CacheManager found " << m_extensionMap.size() << " entries, total " << m_currentSize << " bytes,"
+    applyJournal();
+    // Record the outcome of validation right away, so that a crash later in this run does not repeat it.
+    writeManifest();
+
+    LOG(INFO) << "CacheManager found " << m_entries.size() << " entries, total " << m_currentSize << " bytes,"
         " starting eviction process.";
 
-    makeRoomFor(0);
+    evict(m_maxSize, 0);
+    wakeEvictionThread();
+}
+
+void CacheManager::validateFile(const CacheFile& file) {
+    fs::path path = entryPath(file.key, file.extension);
+    std::vector<ContentChunker::ManifestEntry> entries;
+    bool valid = hashFile(path, file, &entries);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // A download of the same Asset started during validation replaces the file, and takes over its cache entry.
+    if (m_validating.erase(file.key) == 0) {
+        LOG(INFO) << "cache file " << path << " replaced during validation.";
+        return;
+    }
+    if (valid) {
+        LOG(INFO) << "adding " << path << " to cache record, " << file.identity.size << " bytes.";
+        CacheFile verified = file;
+        verified.verified = true;
+        addEntry(verified);
+        addContentChunks(file.key, entries);
+    } else {
+        // Removed with the lock held, so that a download of the same Asset cannot rename its file into place first.
+        LOG(WARNING) << "removing invalid cache file " << path;
+        ++m_validationFailures;
+        fs::remove(path);
+    }
 }
 
-fs::path CacheManager::checkCache(uint64_t key) {
+// static
+bool CacheManager::hashFile(const fs::path& path, const CacheFile& file,
+    std::vector<ContentChunker::ManifestEntry>* entries) {
+    size_t fileSize = file.identity.size;
+    void* mapped = MAP_FAILED;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        if (fileSize > 0) {
+            mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "error opening cache file: " << path << " for hash validation.";
+        return false;
+    }
+
+    // Hash the file and split it into content chunks in the same pass, so that downloads of content-chunked Assets
+    // can reuse its data. The kernel is asked to read ahead a stride at a time, keeping the disk busy while hashing.
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+    const uint8_t* fileData = static_cast<const uint8_t*>(mapped);
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    size_t prefetched = std::min(kValidationStride, fileSize);
+    madvise(mapped, prefetched, MADV_WILLNEED);
+    for (size_t offset = 0; offset < fileSize;) {
+        if (offset + kValidationStride > prefetched && prefetched < fileSize) {
+            size_t prefetchSize = std::min(kValidationStride, fileSize - prefetched);
+            // madvise() needs a page aligned address, and strides are a multiple of the page size.
+            madvise(const_cast<uint8_t*>(fileData) + prefetched, prefetchSize, MADV_WILLNEED);
+            prefetched += prefetchSize;
+        }
+        size_t chunkSize = ContentChunker::nextChunkSize(fileData + offset, fileSize - offset);
+        XXH64_update(hashState, fileData + offset, chunkSize);
+        entries->push_back({ XXH64(fileData + offset, chunkSize, 0), static_cast<uint32_t>(chunkSize) });
+        offset += chunkSize;
+    }
+    uint64_t hash = XXH64_digest(hashState);
+    XXH64_freeState(hashState);
+    munmap(mapped, fileSize);
+
+    if (hash != file.key) {
+        LOG(ERROR) << "error validating cache file: " << path << " computed hash of " << Asset::keyToString(hash);
+        return false;
+    }
+    LOG(INFO) << "validated cache file " << path << ".";
+    return true;
+}
+
+fs::path CacheManager::checkCache(uint64_t key, bool countLookup) {
     fs::path cachePath;
+    bool flush = false;
+    bool promoting = false;
+    CacheFile promoted;
+    std::vector<fs::path> demoted;
 
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        auto extensionPair = m_extensionMap.find(key);
-        if (extensionPair == m_extensionMap.end()) {
+        auto found = m_entries.find(key);
+        if (found == m_entries.end()) {
             LOG(INFO) << "cache miss for Asset " << Asset::keyToString(key);
+            if (countLookup) {
+                ++m_misses;
+            }
             return fs::path();
         }
-        cachePath = m_cachePath;
-        cachePath += fs::path(Asset::keyToString(key) + extensionPair->second);
+        if (countLookup) {
+            ++m_hits;
+        }
+        CacheFile& file = found->second;
+        cachePath = entryPath(key, file.extension);
+        file.lastAccess = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!m_pins.count(key)) {
+            m_policy->access(key);
+        }
+        m_pendingAccesses.push_back(JournalRecord{ key, file.lastAccess });
+        flush = m_pendingAccesses.size() >= kJournalFlushAccesses;
+        if (!m_ramPath.empty() && file.identity.size <= m_ramMaxAssetSize) {
+            // Only loads asked for count towards promotion, so prefetching or browsing a list cannot fill the RAM tier.
+            promoting = countLookup && countRamAccess(key, file, &demoted);
+            if (m_ramEntries.count(key)) {
+                cachePath = ramEntryPath(key, file.extension);
+                if (countLookup) {
+                    ++m_ramHits;
+                }
+            } else if (promoting) {
+                promoted = file;
+            }
+        }
+    }
+
+    std::error_code error;
+    for (const auto& path : demoted) {
+        fs::remove(path, error);
+    }
+    if (promoting) {
+        fs::path ramPath = promote(key, cachePath, promoted);
+        if (!ramPath.empty()) {
+            cachePath = ramPath;
+        }
     }
 
     LOG(INFO) << "cache hit for Asset " << Asset::keyToString(key) << " at " << cachePath;
 
-    // Update file write time to reflect the access of this cached asset. NOTE that this means the data in m_timeQueue
-    // is now invalid, leading to a need for re-verification of write times in the queue when identifying eviction
-    // candidates.
-    fs::last_write_time(cachePath, std::chrono::system_clock::now());
+    if (flush) {
+        flushJournal();
+    }
     return cachePath;
 }
 
-fs::path CacheManager::download(uint64_t key, size_t fileSize, uint64_t chunks, const std::string& fileExtension) {
-    fs::path filePath = m_cachePath;
-    filePath += fs::path("/" + Asset::keyToString(key) + fileExtension);
+fs::path CacheManager::download(uint64_t key, size_t fileSize, uint64_t chunks, uint64_t manifestPages,
+    const std::string& fileExtension) {
+    // Requests for the same Asset tend to arrive together, and separate downloads would write over the same file.
+    return m_downloads.run(key, [this, key, fileSize, chunks, manifestPages, &fileExtension] {
+        // The caller has already counted its own lookup.
+        fs::path cached = checkCache(key, false);
+        if (!cached.empty()) {
+            return cached;
+        }
+        auto start = std::chrono::steady_clock::now();
+        // The cache may still be enumerated while downloads start, so mark the temporary files as in use first.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writing.insert(key);
+        }
+        fs::path path = downloadFile(key, fileSize, chunks, manifestPages, fileExtension);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writing.erase(key);
+        }
+        if (path.empty()) {
+            ++m_downloadFailures;
+        } else {
+            ++m_completedDownloads;
+            m_downloadLatency.record(std::chrono::steady_clock::now() - start);
+        }
+        return path;
+    });
+}
+
+fs::path CacheManager::downloadFile(uint64_t key, size_t fileSize, uint64_t chunks, uint64_t manifestPages,
+    const std::string& fileExtension) {
+    fs::path filePath = entryPath(key, fileExtension);
     LOG(INFO) << "downloading Asset data for " << Asset::keyToString(key) << ", " << chunks << " chunks "
         << fileSize << " bytes, into file " << filePath;
 
-    std::ofstream outFile(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!outFile) {
-        LOG(ERROR) << "error opening file " << filePath << " for writing.";
+    // Forget any existing copy, which is about to be replaced, then make sure there is room for the new one.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_validating.erase(key);
+        if (m_entries.count(key)) {
+            removeContentChunks(key);
+            removeEntry(key);
+        }
+    }
+    if (!makeRoomFor(fileSize)) {
+        LOG(ERROR) << "not enough disk space to download " << filePath << ", " << fileSize << " bytes.";
         return fs::path();
     }
 
+    // Download beside the destination and rename into place when complete, so that the file at filePath is only ever
+    // whole, even to a reader that mapped it earlier.
+    std::string fileName = "." + Asset::keyToString(key) + fileExtension;
+    fs::path writePath = m_cachePath / (fileName + kDownloadExtension);
+    fs::path statePath = m_cachePath / (fileName + kPartialExtension);
+    std::error_code error;
+
+    // Pick up where an earlier attempt at a regular Asset left off, if it saved its progress.
+    DownloadState state(chunks);
+    int fd = -1;
+    if (manifestPages == 0 && readDownloadState(statePath, key, fileSize, &state)) {
+        fd = ::open(writePath.c_str(), O_RDWR);
+    }
+    if (fd >= 0) {
+        LOG(INFO) << "resuming download of " << filePath << " with " << state.verifiedChunks << " of " << chunks
+            << " chunks verified.";
+    } else {
+        state = DownloadState(chunks);
+        fs::remove(statePath, error);
+        fd = ::open(writePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            LOG(ERROR) << "error opening file " << writePath << " for writing.";
+            return fs::path();
+        }
+        // Reserve the whole file up front, so that chunks written out of order neither fragment it nor run out of
+        // space part way through. Not every filesystem supports this, in which case the file grows as chunks arrive.
+        if (fileSize > 0 && fallocate(fd, 0, 0, fileSize) != 0) {
+            LOG(INFO) << "unable to preallocate " << fileSize << " bytes for " << writePath;
+        }
+    }
+
     size_t downloadedSize = 0;
     uint64_t digest = 0;
-    XXH64_state_t* hashState = XXH64_createState();
-    XXH64_reset(hashState, 0);
     bool ok = true;
+    bool resumable = false;
+    std::vector<ContentChunker::ManifestEntry> entries;
 
-    // Download AssetData chunk-by-chunk sequentially, validate each chunk, then write to file.
-    for (auto i = 0; i < chunks; ++i) {
-        m_httpClient->getAssetData(key, i, [&filePath, &outFile, &downloadedSize, &digest, &hashState, &ok](
-            uint64_t chunkKey, uint64_t chunkNumber, RecordPtr assetDataRecord) {
-            if (assetDataRecord->empty()) {
-                LOG(ERROR) << "error downloading chunk " << chunkNumber << " for file " << filePath;
-                ok = false;
-            } else {
-                // Validate incremental hash of incoming data.
-                const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(assetDataRecord->data().data());
-                const uint8_t* chunkData = flatAssetData->data()->data();
-                size_t chunkDataSize = flatAssetData->data()->size();
-                XXH64_update(hashState, chunkData, chunkDataSize);
-                digest = XXH64_digest(hashState);
-                if (digest != flatAssetData->hash()) {
-                    LOG(ERROR) << "incremental hash validation for asset download " << filePath << " chunk number "
-                        << chunkNumber << " failed, computed " << Asset::keyToString(digest) << ", expected "
-                        << Asset::keyToString(flatAssetData->hash());
-                    ok = false;
-                } else {
-                    downloadedSize += chunkDataSize;
-                    outFile.write(reinterpret_cast<const char*>(chunkData), chunkDataSize);
-                }
-            }
-        });
-        if (!ok) break;
+    if (manifestPages) {
+        digest = downloadContentChunks(key, manifestPages, fd, &entries, &ok);
+        for (const auto& entry : entries) {
+            downloadedSize += entry.size;
+        }
+    } else {
+        ok = downloadChunks(key, fileSize, fd, statePath, &state, &downloadedSize, &digest, &resumable);
     }
 
-    XXH64_freeState(hashState);
-    outFile.close();
+    if (::close(fd) != 0) {
+        LOG(ERROR) << "error closing file " << writePath;
+        ok = false;
+    }
 
     if (ok && (key != digest || fileSize != downloadedSize)) {
+        ++m_validationFailures;
         LOG(ERROR) << "asset Data mismatch, key: " << Asset::keyToString(key) << " computed hash: "
             << Asset::keyToString(digest) << " recorded size: " << fileSize << " downloaded bytes: " << downloadedSize;
         ok = false;
+        resumable = false;
     }
 
     if (!ok) {
-        LOG(WARNING) << "failed to download " << filePath << " removing file.";
-        fs::remove(filePath);
+        if (resumable) {
+            LOG(WARNING) << "failed to download " << filePath << ", keeping partial download to resume later.";
+        } else {
+            LOG(WARNING) << "failed to download " << filePath << " removing file.";
+            fs::remove(writePath, error);
+            fs::remove(statePath, error);
+        }
         return fs::path();
     }
+    fs::remove(statePath, error);
 
-    std::chrono::time_point writeTime = fs::last_write_time(filePath);
+    CacheFile file;
+    file.key = key;
+    file.extension = fileExtension;
+    bool wake = false;
+    file.lastAccess = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    // Every byte was checked against the Asset key as it was downloaded.
+    file.verified = true;
 
     // Add filePath to cache tracking data structures.
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_currentSize += fileSize;
+        fs::rename(writePath, filePath, error);
+        if (error) {
+            LOG(ERROR) << "failed to rename " << writePath << " to " << filePath << ": " << error.message();
+            fs::remove(writePath);
+            return fs::path();
+        }
+        // A file that cannot be stated never matches its manifest record, so is validated again on the next start.
+        if (!readIdentity(filePath, &file.identity)) {
+            LOG(ERROR) << "unable to stat downloaded file " << filePath;
+            file.identity.size = fileSize;
+        }
+        addEntry(file);
         LOG(INFO) << "adding " << filePath << " to cache record, " << fileSize << " bytes, cache now " << m_currentSize
             << " bytes.";
-        m_timeQueue.push(std::make_pair(writeTime, filePath));
-        m_extensionMap.insert(std::make_pair(key, fileExtension));
+        wake = m_currentSize > m_highWatermark;
+        m_pendingAccesses.push_back(JournalRecord{ key, file.lastAccess });
+        addContentChunks(key, entries);
     }
 
+    if (wake) {
+        wakeEvictionThread();
+    }
+    // A download already costs far more than a journal append, so record accesses now rather than on a later hit.
+    flushJournal();
     return filePath;
 }
 
-void CacheManager::makeRoomFor(size_t addedBytes) {
-    while (m_currentSize + addedBytes > m_maxSize) {
-        fs::path fileToRemove;
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            auto oldest = m_timeQueue.top();
-            m_timeQueue.pop();
-            // Validate access time against reality, as this entry may have been accessed since queue insertion.
-            auto realWriteTime = fs::last_write_time(oldest.second);
-            if (realWriteTime == oldest.first) {
-                size_t oldestSize = fs::file_size(oldest.second);
-                LOG(INFO) << "evicting " << oldest.second << " from cache, " << oldestSize << " bytes.";
-                m_currentSize = m_currentSize - oldestSize;
-                fileToRemove = oldest.second; 
-                // Also remove this cached asset from the map.
-                m_extensionMap.erase(Asset::stringToKey(oldest.second.stem()));
+fs::path CacheManager::ramEntryPath(uint64_t key, const std::string& extension) const {
+    return m_ramPath / fs::path(Asset::keyToString(key) + extension);
+}
+
+bool CacheManager::countRamAccess(uint64_t key, const CacheFile& file, std::vector<fs::path>* demoted) {
+    if (++m_accessesSinceAging >= kRamAgingAccesses) {
+        m_accessesSinceAging = 0;
+        for (auto it = m_accessCounts.begin(); it != m_accessCounts.end();) {
+            it->second /= 2;
+            if (it->second == 0) {
+                it = m_accessCounts.erase(it);
             } else {
-                LOG(INFO) << "updating access time in queue on asset " << oldest.second;
-                m_timeQueue.push(std::make_pair(realWriteTime, oldest.second));
+                ++it;
+            }
+        }
+    }
+    uint32_t count = ++m_accessCounts[key];
+    size_t size = file.identity.size;
+    if (count < m_ramPromoteAccesses || m_ramEntries.count(key) || m_promoting.count(key) || size > m_ramMaxSize) {
+        return false;
+    }
+
+    // Displace the least used RAM entries, but only those used less often than this Asset, so that a burst of
+    // accesses to new Assets cannot flush the RAM tier of the ones in steady use.
+    if (m_ramSize + size > m_ramMaxSize) {
+        std::vector<std::pair<uint32_t, uint64_t>> candidates;
+        candidates.reserve(m_ramEntries.size());
+        for (const auto& entry : m_ramEntries) {
+            auto counted = m_accessCounts.find(entry.first);
+            candidates.emplace_back(counted == m_accessCounts.end() ? 0 : counted->second, entry.first);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        size_t freed = 0;
+        size_t victims = 0;
+        while (m_ramSize - freed + size > m_ramMaxSize) {
+            if (victims == candidates.size() || candidates[victims].first >= count) {
+                return false;
+            }
+            freed += m_ramEntries[candidates[victims].second];
+            ++victims;
+        }
+        for (size_t i = 0; i < victims; ++i) {
+            LOG(INFO) << "demoting " << Asset::keyToString(candidates[i].second) << " from RAM cache tier.";
+            demoted->push_back(demote(candidates[i].second));
+        }
+    }
+
+    // Reserve the space now, so that concurrent promotions cannot overfill the RAM tier.
+    m_ramSize += size;
+    m_promoting.insert(key);
+    return true;
+}
+
+fs::path CacheManager::promote(uint64_t key, const fs::path& diskPath, const CacheFile& file) {
+    fs::path ramPath = ramEntryPath(key, file.extension);
+    fs::path writePath = m_ramPath / ("." + Asset::keyToString(key) + file.extension + kDownloadExtension);
+    std::error_code error;
+    bool copied = fs::copy_file(diskPath, writePath, fs::copy_options::overwrite_existing, error);
+    if (copied) {
+        fs::rename(writePath, ramPath, error);
+        copied = !error;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool current = m_promoting.erase(key) > 0;
+    if (copied && current) {
+        m_ramEntries[key] = file.identity.size;
+        LOG(INFO) << "promoted " << Asset::keyToString(key) << " to RAM cache tier, " << file.identity.size
+            << " bytes, tier now " << m_ramSize << " bytes.";
+        return ramPath;
+    }
+    if (!copied) {
+        LOG(ERROR) << "failed to copy " << diskPath << " into RAM cache tier: " << error.message();
+    }
+    if (current) {
+        m_ramSize -= file.identity.size;
+    }
+    fs::remove(writePath, error);
+    fs::remove(ramPath, error);
+    return fs::path();
+}
+
+void CacheManager::clearRamTier() {
+    m_ramEntries.clear();
+    m_promoting.clear();
+    m_accessCounts.clear();
+    m_accessesSinceAging = 0;
+    m_ramSize = 0;
+    if (m_ramPath.empty()) {
+        return;
+    }
+    std::error_code error;
+    for (auto& entry : fs::directory_iterator(m_ramPath, error)) {
+        if (fs::is_regular_file(entry.path())) {
+            fs::remove(entry.path(), error);
+        }
+    }
+}
+
+fs::path CacheManager::demote(uint64_t key) {
+    auto found = m_ramEntries.find(key);
+    if (found == m_ramEntries.end()) {
+        return fs::path();
+    }
+    m_ramSize -= found->second;
+    m_ramEntries.erase(found);
+    auto entry = m_entries.find(key);
+    return entry == m_entries.end() ? fs::path() : ramEntryPath(key, entry->second.extension);
+}
+
+bool CacheManager::makeRoomFor(size_t addedBytes) {
+    bool overHigh = false;
+    bool overMax = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        overHigh = m_currentSize + addedBytes > m_highWatermark;
+        overMax = m_currentSize + addedBytes > m_maxSize;
+    }
+    if (overHigh) {
+        wakeEvictionThread();
+    }
+    // The eviction thread normally keeps the cache well under its maximum size. Past that it has fallen behind, or is
+    // not running, so this download must wait on eviction to keep the cache bounded.
+    if (overMax) {
+        evict(m_maxSize - std::min(addedBytes, m_maxSize), 0);
+    }
+
+    size_t available = freeDiskSpace();
+    if (available >= addedBytes + m_minFreeBytes) {
+        return true;
+    }
+    LOG(WARNING) << "only " << available << " bytes free on disk, evicting to make room for " << addedBytes
+        << " bytes.";
+    // Fail now rather than part way through, if evicting everything that can be evicted does not free enough.
+    evict(m_maxSize, addedBytes + m_minFreeBytes - available);
+    return freeDiskSpace() >= addedBytes;
+}
+
+size_t CacheManager::evict(size_t targetSize, size_t freeBytes) {
+    std::vector<fs::path> filesToRemove;
+    size_t evicted = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t victim = 0;
+        while ((m_currentSize > targetSize || evicted < freeBytes) && m_policy->evict(&victim)) {
+            auto found = m_entries.find(victim);
+            if (found == m_entries.end()) {
+                continue;
             }
+            LOG(INFO) << "evicting " << Asset::keyToString(victim) << " from cache, " << found->second.identity.size
+                << " bytes.";
+            evicted += found->second.identity.size;
+            ++m_evictions;
+            m_evictedBytes += found->second.identity.size;
+            filesToRemove.push_back(entryPath(victim, found->second.extension));
+            removeContentChunks(victim);
+            removeEntry(victim);
         }
-        if (!fileToRemove.empty()) {
-            fs::remove(fileToRemove);
+        LOG(INFO) << "eviction process complete, totals now " << m_entries.size() << " entries, total "
+            << m_currentSize << " bytes.";
+        if (m_currentSize > targetSize && m_pinnedSize > 0) {
+            LOG(WARNING) << "pinned Assets hold " << m_pinnedSize << " bytes, keeping the cache over " << targetSize
+                << " bytes.";
         }
     }
 
-    LOG(INFO) << "eviction process complete, totals now " << m_extensionMap.size() << " entries, total " << 
-        m_currentSize << " bytes.";
+    for (const auto& path : filesToRemove) {
+        fs::remove(path);
+    }
+    return evicted;
+}
+
+size_t CacheManager::freeDiskSpace() const {
+    std::error_code error;
+    fs::space_info space = fs::space(m_cachePath, error);
+    if (error) {
+        return std::numeric_limits<size_t>::max();
+    }
+    return space.available;
+}
+
+void CacheManager::wakeEvictionThread() {
+    {
+        std::lock_guard<std::mutex> lock(m_evictionMutex);
+        m_evictionRequested = true;
+    }
+    m_evictionCondition.notify_one();
+}
+
+void CacheManager::stopEvictionThread() {
+    {
+        std::lock_guard<std::mutex> lock(m_evictionMutex);
+        m_evictionQuit = true;
+    }
+    m_evictionCondition.notify_all();
+    if (m_evictionThread.joinable()) {
+        m_evictionThread.join();
+    }
+}
+
+void CacheManager::evictionLoop() {
+    std::unique_lock<std::mutex> lock(m_evictionMutex);
+    while (!m_evictionQuit) {
+        m_evictionCondition.wait_for(lock, kEvictionInterval, [this] {
+            return m_evictionRequested || m_evictionQuit;
+        });
+        if (m_evictionQuit) {
+            break;
+        }
+        m_evictionRequested = false;
+        lock.unlock();
+
+        size_t available = freeDiskSpace();
+        size_t freeBytes = available < m_minFreeBytes ? m_minFreeBytes - available : 0;
+        bool overHigh = false;
+        {
+            std::lock_guard<std::mutex> cacheLock(m_mutex);
+            overHigh = m_currentSize > m_highWatermark;
+        }
+        if (overHigh || freeBytes > 0) {
+            evict(overHigh ? m_lowWatermark : std::numeric_limits<size_t>::max(), freeBytes);
+        }
+
+        lock.lock();
+    }
+}
+
+bool CacheManager::downloadChunks(uint64_t key, size_t fileSize, int fd, const fs::path& statePath,
+    DownloadState* state, size_t* downloadedSize, uint64_t* digest, bool* resumable) {
+    *resumable = false;
+    // Read back the chunks an earlier attempt wrote beyond the verified ones, to verify them in turn.
+    for (auto& pending : state->pending) {
+        size_t offset = pending.first * kDataChunkSize;
+        std::vector<uint8_t>& data = pending.second.first;
+        data.resize(std::min(kDataChunkSize, fileSize - offset));
+        if (pread(fd, data.data(), data.size(), offset) != static_cast<ssize_t>(data.size())) {
+            LOG(ERROR) << "error reading back chunk " << pending.first << " of partial download of "
+                << Asset::keyToString(key);
+            return false;
+        }
+    }
+    *downloadedSize = std::min(state->verifiedChunks * kDataChunkSize, fileSize);
+    *digest = XXH64_digest(&state->hashState);
+
+    std::mutex mutex;
+    // A request failed, but every chunk received is good, so the download can be resumed.
+    bool failed = false;
+    // A chunk failed verification, so the partial file cannot be trusted.
+    bool corrupt = false;
+    uint64_t unsaved = 0;
+    const uint64_t saveInterval = std::max(kDownloadStateBytes / kDataChunkSize, static_cast<size_t>(1));
+
+    // Each chunk carries the hash of the Asset data up to and including it, so chunks must be verified in order. Call
+    // with mutex held.
+    auto verify = [this, key, state, downloadedSize, digest](const uint8_t* data, size_t size, uint64_t expected) {
+        XXH64_update(&state->hashState, data, size);
+        *digest = XXH64_digest(&state->hashState);
+        if (*digest != expected) {
+            ++m_validationFailures;
+            LOG(ERROR) << "incremental hash validation for asset download " << Asset::keyToString(key)
+                << " chunk number " << state->verifiedChunks << " failed, computed " << Asset::keyToString(*digest)
+                << ", expected " << Asset::keyToString(expected);
+            return false;
+        }
+        *downloadedSize += size;
+        ++state->verifiedChunks;
+        return true;
+    };
+    auto drain = [state, &corrupt, &verify]() {
+        while (!corrupt && !state->pending.empty() && state->pending.begin()->first == state->verifiedChunks) {
+            const auto& next = state->pending.begin()->second;
+            corrupt = !verify(next.first.data(), next.first.size(), next.second);
+            state->pending.erase(state->pending.begin());
+        }
+    };
+
+    std::vector<uint64_t> missing;
+    for (uint64_t chunk = state->verifiedChunks; chunk < state->chunks; ++chunk) {
+        if (!state->isWritten(chunk)) {
+            missing.push_back(chunk);
+        }
+    }
+    drain();
+
+    m_httpClient->getAssetDataChunks(key, missing, m_downloadConcurrency, [this, key, fileSize, fd, &statePath, state,
+        &mutex, &failed, &corrupt, &unsaved, saveInterval, &verify, &drain](uint64_t chunkKey, uint64_t chunkNumber,
+        RecordPtr assetDataRecord) {
+        if (assetDataRecord->empty()) {
+            LOG(ERROR) << "error downloading chunk " << chunkNumber << " for Asset " << Asset::keyToString(chunkKey);
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+            return false;
+        }
+        const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(assetDataRecord->data().data());
+        const uint8_t* chunkData = flatAssetData->data()->data();
+        size_t chunkDataSize = flatAssetData->data()->size();
+
+        // Every chunk but the last is full, so each chunk has a fixed place in the file and can be written there as
+        // soon as it arrives, outside the lock. Its contents are only trusted once the hash check reaches it.
+        size_t offset = chunkNumber * kDataChunkSize;
+        if (offset > fileSize || chunkDataSize != std::min(kDataChunkSize, fileSize - offset)) {
+            LOG(ERROR) << "chunk " << chunkNumber << " for Asset " << Asset::keyToString(chunkKey) << " has wrong size "
+                << chunkDataSize;
+            std::lock_guard<std::mutex> lock(mutex);
+            corrupt = true;
+            return false;
+        }
+        m_downloadedBytes += chunkDataSize;
+        if (pwrite(fd, chunkData, chunkDataSize, offset) != static_cast<ssize_t>(chunkDataSize)) {
+            LOG(ERROR) << "error writing chunk " << chunkNumber << " for Asset " << Asset::keyToString(chunkKey);
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (corrupt) {
+            return false;
+        }
+        state->setWritten(chunkNumber);
+        if (chunkNumber == state->verifiedChunks) {
+            corrupt = !verify(chunkData, chunkDataSize, flatAssetData->hash());
+            drain();
+        } else {
+            state->pending.emplace(chunkNumber, std::make_pair(std::vector<uint8_t>(chunkData,
+                chunkData + chunkDataSize), flatAssetData->hash()));
+        }
+        // Save progress every so often, so that a crash loses at most the chunks received since.
+        if (!corrupt && ++unsaved >= saveInterval) {
+            unsaved = 0;
+            if (fdatasync(fd) == 0) {
+                writeDownloadState(statePath, key, fileSize, *state);
+            }
+        }
+        return !corrupt && !failed;
+    });
+
+    if (corrupt) {
+        return false;
+    }
+    // A response that never arrived leaves a gap, which the chunks after it cannot be verified past.
+    if (state->verifiedChunks != state->chunks) {
+        LOG(ERROR) << "download of Asset " << Asset::keyToString(key) << " stopped with " << state->verifiedChunks
+            << " of " << state->chunks << " chunks verified.";
+        // The data must reach the disk before the state that describes it.
+        *resumable = fdatasync(fd) == 0 && writeDownloadState(statePath, key, fileSize, *state);
+        return false;
+    }
+    return true;
+}
+
+// static
+bool CacheManager::readDownloadState(const fs::path& statePath, uint64_t key, size_t fileSize, DownloadState* state) {
+    std::ifstream file(statePath, std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    DownloadStateHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(DownloadStateHeader)) ||
+        std::memcmp(header.magic, kDownloadStateMagic, sizeof(kDownloadStateMagic)) != 0 ||
+        header.version != kDownloadStateVersion || header.hashStateSize != sizeof(XXH64_state_t) ||
+        header.key != key || header.fileSize != fileSize || header.chunks != state->chunks ||
+        header.verifiedChunks > header.chunks) {
+        LOG(INFO) << "discarding mismatched download state " << statePath;
+        return false;
+    }
+    std::string body((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (body.size() != sizeof(XXH64_state_t) + header.pendingCount * sizeof(PendingChunkRecord) +
+        state->written.size() || XXH64(body.data(), body.size(), 0) != header.checksum) {
+        LOG(WARNING) << "discarding corrupt download state " << statePath;
+        return false;
+    }
+
+    const char* data = body.data();
+    std::memcpy(&state->hashState, data, sizeof(XXH64_state_t));
+    data += sizeof(XXH64_state_t);
+    for (uint64_t i = 0; i < header.pendingCount; ++i) {
+        PendingChunkRecord record;
+        std::memcpy(&record, data, sizeof(PendingChunkRecord));
+        data += sizeof(PendingChunkRecord);
+        if (record.chunk <= header.verifiedChunks || record.chunk >= header.chunks) {
+            LOG(WARNING) << "discarding malformed download state " << statePath;
+            return false;
+        }
+        state->pending[record.chunk] = std::make_pair(std::vector<uint8_t>(), record.hash);
+    }
+    std::memcpy(state->written.data(), data, state->written.size());
+    state->verifiedChunks = header.verifiedChunks;
+    return true;
+}
+
+// static
+bool CacheManager::writeDownloadState(const fs::path& statePath, uint64_t key, size_t fileSize,
+    const DownloadState& state) {
+    std::string body(reinterpret_cast<const char*>(&state.hashState), sizeof(XXH64_state_t));
+    for (const auto& pending : state.pending) {
+        PendingChunkRecord record{ pending.first, pending.second.second };
+        body.append(reinterpret_cast<const char*>(&record), sizeof(PendingChunkRecord));
+    }
+    body.append(reinterpret_cast<const char*>(state.written.data()), state.written.size());
+
+    DownloadStateHeader header;
+    std::memcpy(header.magic, kDownloadStateMagic, sizeof(kDownloadStateMagic));
+    header.version = kDownloadStateVersion;
+    header.hashStateSize = sizeof(XXH64_state_t);
+    header.key = key;
+    header.fileSize = fileSize;
+    header.chunks = state.chunks;
+    header.verifiedChunks = state.verifiedChunks;
+    header.pendingCount = state.pending.size();
+    header.checksum = XXH64(body.data(), body.size(), 0);
+
+    fs::path writePath = statePath;
+    writePath += ".tmp";
+    {
+        std::ofstream file(writePath, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(DownloadStateHeader));
+        file.write(body.data(), body.size());
+        if (!file) {
+            LOG(ERROR) << "error writing download state " << writePath;
+            return false;
+        }
+    }
+    std::error_code error;
+    fs::rename(writePath, statePath, error);
+    if (error) {
+        LOG(ERROR) << "failed to rename download state " << writePath << ": " << error.message();
+        return false;
+    }
+    return true;
+}
+
+uint64_t CacheManager::downloadContentChunks(uint64_t key, uint64_t manifestPages, int fd,
+    std::vector<ContentChunker::ManifestEntry>* entries, bool* ok) {
+    // The manifest lists every chunk with its hash and size, and is small next to the data it describes.
+    for (uint64_t page = 0; *ok && page < manifestPages; ++page) {
+        m_httpClient->getAssetData(key, page, [entries, ok](uint64_t pageKey, uint64_t pageNumber,
+            RecordPtr pageRecord) {
+            if (pageRecord->empty()) {
+                LOG(ERROR) << "error downloading manifest page " << pageNumber << " for "
+                    << Asset::keyToString(pageKey);
+                *ok = false;
+                return;
+            }
+            const Data::FlatAssetData* pageData = Data::GetFlatAssetData(pageRecord->data().data());
+            if (!pageData->data() ||
+                XXH64(pageData->data()->data(), pageData->data()->size(), 0) != pageData->hash() ||
+                !ContentChunker::parseManifestPage(pageData->data()->data(), pageData->data()->size(), entries)) {
+                LOG(ERROR) << "corrupt manifest page " << pageNumber << " for " << Asset::keyToString(pageKey);
+                *ok = false;
+            }
+        });
+    }
+
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    auto append = [hashState, fd, ok](const uint8_t* data, size_t size) {
+        XXH64_update(hashState, data, size);
+        if (::write(fd, data, size) != static_cast<ssize_t>(size)) {
+            LOG(ERROR) << "error writing " << size << " bytes of content chunk data.";
+            *ok = false;
+        }
+    };
+
+    size_t reused = 0;
+    std::vector<uint8_t> localChunk;
+    for (size_t i = 0; *ok && i < entries->size(); ++i) {
+        const ContentChunker::ManifestEntry& entry = (*entries)[i];
+        if (readLocalContentChunk(entry.hash, entry.size, &localChunk)) {
+            append(localChunk.data(), localChunk.size());
+            m_reusedBytes += localChunk.size();
+            ++reused;
+            continue;
+        }
+        m_httpClient->getContentChunk(entry.hash, [this, &entry, &append, ok](uint64_t hash, RecordPtr chunkRecord) {
+            if (chunkRecord->empty()) {
+                LOG(ERROR) << "error downloading content chunk " << Asset::keyToString(hash);
+                *ok = false;
+                return;
+            }
+            const Data::FlatAssetData* flatAssetData = Data::GetFlatAssetData(chunkRecord->data().data());
+            if (!flatAssetData->data() || flatAssetData->data()->size() != entry.size ||
+                XXH64(flatAssetData->data()->data(), entry.size, 0) != hash) {
+                LOG(ERROR) << "hash validation of content chunk " << Asset::keyToString(hash) << " failed.";
+                ++m_validationFailures;
+                *ok = false;
+                return;
+            }
+            m_downloadedBytes += entry.size;
+            append(flatAssetData->data()->data(), entry.size);
+        });
+    }
+
+    uint64_t digest = XXH64_digest(hashState);
+    XXH64_freeState(hashState);
+    LOG(INFO) << "assembled Asset " << Asset::keyToString(key) << " from " << entries->size() << " content chunks, "
+        << reused << " of them copied from cached files.";
+    return digest;
+}
+
+bool CacheManager::readLocalContentChunk(uint64_t hash, uint32_t size, std::vector<uint8_t>* chunk) {
+    fs::path sourcePath;
+    uint64_t offset = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto location = m_contentChunks.find(hash);
+        if (location == m_contentChunks.end()) {
+            return false;
+        }
+        auto found = m_entries.find(location->second.key);
+        if (found == m_entries.end()) {
+            return false;
+        }
+        sourcePath = entryPath(found->first, found->second.extension);
+        offset = location->second.offset;
+    }
+
+    std::ifstream inFile(sourcePath, std::ios::in | std::ios::binary);
+    chunk->resize(size);
+    if (!inFile || !inFile.seekg(offset) || !inFile.read(reinterpret_cast<char*>(chunk->data()), size)) {
+        return false;
+    }
+    // The source file may have been evicted since the lookup, so only trust data that still matches its hash.
+    return XXH64(chunk->data(), size, 0) == hash;
+}
+
+std::string CacheManager::statsReport() {
+    std::string report;
+    uint64_t hits = m_hits;
+    uint64_t misses = m_misses;
+    report += "hits " + std::to_string(hits) + "\n";
+    report += "ram_hits " + std::to_string(m_ramHits) + "\n";
+    report += "misses " + std::to_string(misses) + "\n";
+    if (hits + misses) {
+        report += "hit_rate " + std::to_string(static_cast<double>(hits) / (hits + misses)) + "\n";
+    }
+    report += "downloads " + std::to_string(m_completedDownloads) + "\n";
+    report += "download_failures " + std::to_string(m_downloadFailures) + "\n";
+    report += "downloaded_bytes " + std::to_string(m_downloadedBytes) + "\n";
+    report += "reused_chunk_bytes " + std::to_string(m_reusedBytes) + "\n";
+    report += "evictions " + std::to_string(m_evictions) + "\n";
+    report += "evicted_bytes " + std::to_string(m_evictedBytes) + "\n";
+    report += "validation_failures " + std::to_string(m_validationFailures) + "\n";
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        report += "policy " + std::string(m_policy->name()) + "\n";
+        report += "entries " + std::to_string(m_entries.size()) + "\n";
+        report += "size_bytes " + std::to_string(m_currentSize) + "\n";
+        report += "max_size_bytes " + std::to_string(m_maxSize) + "\n";
+        report += "pinned_bytes " + std::to_string(m_pinnedSize) + "\n";
+        report += "ram_entries " + std::to_string(m_ramEntries.size()) + "\n";
+        report += "ram_size_bytes " + std::to_string(m_ramSize) + "\n";
+    }
+    report += "free_disk_bytes " + std::to_string(freeDiskSpace()) + "\n";
+    report += "latency_chunk_download " + m_httpClient->chunkLatency().summary() + "\n";
+    report += "latency_asset_download " + m_downloadLatency.summary() + "\n";
+    return report;
+}
+
+void CacheManager::shutdown() {
+    stopEvictionThread();
+    writeManifest();
+}
+
+// static
+bool CacheManager::readIdentity(const fs::path& path, FileIdentity* identity) {
+    struct stat status;
+    if (::stat(path.c_str(), &status) != 0) {
+        return false;
+    }
+    identity->inode = status.st_ino;
+    identity->size = status.st_size;
+    identity->modified = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    return true;
+}
+
+fs::path CacheManager::entryPath(uint64_t key, const std::string& extension) const {
+    return m_cachePath / fs::path(Asset::keyToString(key) + extension);
+}
+
+void CacheManager::addEntry(const CacheFile& file) {
+    if (m_entries.count(file.key)) {
+        removeEntry(file.key);
+    }
+    m_entries[file.key] = file;
+    if (m_pins.count(file.key)) {
+        m_pinnedSize += file.identity.size;
+    } else {
+        m_policy->insert(file.key, file.identity.size);
+    }
+    m_currentSize += file.identity.size;
+}
+
+void CacheManager::removeEntry(uint64_t key) {
+    auto found = m_entries.find(key);
+    if (found == m_entries.end()) {
+        return;
+    }
+    // The RAM copy goes with its entry. Removing a file from a RAM-backed filesystem never waits on a disk.
+    fs::path ramCopy = demote(key);
+    if (!ramCopy.empty()) {
+        std::error_code error;
+        fs::remove(ramCopy, error);
+    }
+    if (m_promoting.erase(key)) {
+        m_ramSize -= found->second.identity.size;
+    }
+    m_accessCounts.erase(key);
+    if (m_pins.count(key)) {
+        m_pinnedSize -= found->second.identity.size;
+    } else {
+        m_policy->remove(key);
+    }
+    m_currentSize -= found->second.identity.size;
+    m_entries.erase(found);
+}
+
+void CacheManager::pin(uint64_t pinSet, const std::vector<uint64_t>& keys) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_pinSets.find(pinSet);
+    if (found != m_pinSets.end()) {
+        std::unordered_set<uint64_t> previous;
+        previous.swap(found->second);
+        for (auto key : previous) {
+            removePin(pinSet, key);
+        }
+    }
+    for (auto key : keys) {
+        addPin(pinSet, key);
+    }
+    LOG(INFO) << "pinned " << keys.size() << " Assets in set " << Asset::keyToString(pinSet) << ", pinned Assets now "
+        << m_pinnedSize << " bytes.";
+    if (m_pinnedSize > m_maxSize) {
+        LOG(ERROR) << "pinned Assets hold " << m_pinnedSize << " bytes, more than the cache limit of " << m_maxSize
+            << " bytes.";
+    }
+    writePins();
+}
+
+size_t CacheManager::unpin(uint64_t pinSet) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_pinSets.find(pinSet);
+    if (found == m_pinSets.end()) {
+        return 0;
+    }
+    std::unordered_set<uint64_t> keys;
+    keys.swap(found->second);
+    for (auto key : keys) {
+        removePin(pinSet, key);
+    }
+    m_pinSets.erase(pinSet);
+    LOG(INFO) << "unpinned " << keys.size() << " Assets in set " << Asset::keyToString(pinSet) << ", pinned Assets now "
+        << m_pinnedSize << " bytes.";
+    writePins();
+    return keys.size();
+}
+
+bool CacheManager::isPinned(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pins.count(key) > 0;
+}
+
+size_t CacheManager::pinnedSize() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pinnedSize;
+}
+
+void CacheManager::addPin(uint64_t pinSet, uint64_t key) {
+    if (!m_pinSets[pinSet].insert(key).second) {
+        return;
+    }
+    if (m_pins[key]++ > 0) {
+        return;
+    }
+    auto found = m_entries.find(key);
+    if (found != m_entries.end()) {
+        m_policy->remove(key);
+        m_pinnedSize += found->second.identity.size;
+    }
+}
+
+void CacheManager::removePin(uint64_t pinSet, uint64_t key) {
+    auto set = m_pinSets.find(pinSet);
+    if (set != m_pinSets.end()) {
+        set->second.erase(key);
+    }
+    auto pins = m_pins.find(key);
+    if (pins == m_pins.end() || --pins->second > 0) {
+        return;
+    }
+    m_pins.erase(pins);
+    auto found = m_entries.find(key);
+    if (found != m_entries.end()) {
+        m_pinnedSize -= found->second.identity.size;
+        m_policy->insert(key, found->second.identity.size);
+    }
+}
+
+void CacheManager::readPins() {
+    std::ifstream pins(m_cachePath / kPinsName);
+    std::string pinSet;
+    std::string key;
+    size_t count = 0;
+    while (pins >> pinSet >> key) {
+        addPin(Asset::stringToKey(pinSet), Asset::stringToKey(key));
+        ++count;
+    }
+    if (count) {
+        LOG(INFO) << "read " << count << " pinned Assets from " << (m_cachePath / kPinsName);
+    }
+}
+
+void CacheManager::writePins() {
+    // Written beside the pins file and renamed over it, so that a crash leaves either the old pins or the new.
+    fs::path pinsPath = m_cachePath / kPinsName;
+    fs::path writePath = pinsPath;
+    writePath += ".tmp";
+    {
+        std::ofstream pins(writePath, std::ios::out | std::ios::trunc);
+        for (const auto& set : m_pinSets) {
+            for (auto key : set.second) {
+                pins << Asset::keyToString(set.first) << " " << Asset::keyToString(key) << "\n";
+            }
+        }
+        if (!pins.flush()) {
+            LOG(ERROR) << "error writing cache pins " << writePath;
+            return;
+        }
+    }
+    std::error_code error;
+    fs::rename(writePath, pinsPath, error);
+    if (error) {
+        LOG(ERROR) << "failed to rename cache pins " << writePath << ": " << error.message();
+    }
+}
+
+bool CacheManager::readManifest(std::unordered_map<uint64_t, CacheFile>* files) {
+    std::ifstream manifest(m_cachePath / kManifestName, std::ios::in | std::ios::binary);
+    if (!manifest) {
+        return false;
+    }
+    ManifestHeader header;
+    if (!manifest.read(reinterpret_cast<char*>(&header), sizeof(ManifestHeader)) ||
+        std::memcmp(header.magic, kManifestMagic, sizeof(kManifestMagic)) != 0 || header.version != kManifestVersion) {
+        LOG(WARNING) << "ignoring cache manifest with bad header.";
+        return false;
+    }
+    std::string body((std::istreambuf_iterator<char>(manifest)), std::istreambuf_iterator<char>());
+    if (XXH64(body.data(), body.size(), 0) != header.checksum) {
+        LOG(WARNING) << "ignoring cache manifest with bad checksum.";
+        return false;
+    }
+
+    size_t offset = 0;
+    for (uint64_t i = 0; i < header.count; ++i) {
+        ManifestRecord record;
+        if (offset + sizeof(ManifestRecord) > body.size()) {
+            break;
+        }
+        std::memcpy(&record, body.data() + offset, sizeof(ManifestRecord));
+        offset += sizeof(ManifestRecord);
+        if (offset + record.extensionSize > body.size()) {
+            break;
+        }
+        CacheFile& file = (*files)[record.key];
+        file.key = record.key;
+        file.extension.assign(body.data() + offset, record.extensionSize);
+        file.identity.inode = record.inode;
+        file.identity.size = record.size;
+        file.identity.modified = record.modified;
+        file.lastAccess = record.lastAccess;
+        file.verified = record.verified != 0;
+        offset += record.extensionSize;
+    }
+    if (files->size() != header.count) {
+        LOG(WARNING) << "ignoring malformed cache manifest.";
+        files->clear();
+        return false;
+    }
+    return true;
+}
+
+void CacheManager::writeManifest() {
+    std::lock_guard<std::mutex> journalLock(m_journalMutex);
+    std::string body;
+    ManifestHeader header;
+    std::memcpy(header.magic, kManifestMagic, sizeof(kManifestMagic));
+    header.version = kManifestVersion;
+    header.reserved = 0;
+    header.count = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_entries) {
+            const CacheFile& file = entry.second;
+            ManifestRecord record{ file.key, file.identity.inode, file.identity.size, file.identity.modified,
+                file.lastAccess, file.verified ? 1u : 0u, static_cast<uint32_t>(file.extension.size()) };
+            body.append(reinterpret_cast<const char*>(&record), sizeof(ManifestRecord));
+            body.append(file.extension);
+            ++header.count;
+        }
+        // Every pending access is already reflected in the entries.
+        m_pendingAccesses.clear();
+    }
+    header.checksum = XXH64(body.data(), body.size(), 0);
+
+    // The rename must not reach the disk before the data it names, or a crash could leave a truncated manifest.
+    fs::path manifestPath = m_cachePath / kManifestName;
+    fs::path writePath = manifestPath;
+    writePath += ".tmp";
+    int fd = ::open(writePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0;
+    if (ok) {
+        ok = ::write(fd, &header, sizeof(ManifestHeader)) == sizeof(ManifestHeader) &&
+            ::write(fd, body.data(), body.size()) == static_cast<ssize_t>(body.size()) && ::fsync(fd) == 0;
+        ::close(fd);
+    }
+    if (!ok) {
+        LOG(ERROR) << "error writing cache manifest " << writePath;
+        fs::remove(writePath);
+        return;
+    }
+    std::error_code error;
+    fs::rename(writePath, manifestPath, error);
+    if (error) {
+        LOG(ERROR) << "failed to rename cache manifest " << writePath << ": " << error.message();
+        return;
+    }
+
+    // The manifest now holds every access recorded in the journal, so start the journal afresh.
+    std::ofstream journal(m_cachePath / kJournalName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!journal) {
+        LOG(ERROR) << "error truncating cache journal.";
+    }
+}
+
+void CacheManager::applyJournal() {
+    std::lock_guard<std::mutex> journalLock(m_journalMutex);
+    std::ifstream journal(m_cachePath / kJournalName, std::ios::in | std::ios::binary);
+    JournalRecord record;
+    size_t applied = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Later records supersede earlier ones. A record torn by a crash is simply not read.
+    while (journal.read(reinterpret_cast<char*>(&record), sizeof(JournalRecord))) {
+        auto found = m_entries.find(record.key);
+        if (found != m_entries.end() && record.lastAccess > found->second.lastAccess) {
+            found->second.lastAccess = record.lastAccess;
+            ++applied;
+        }
+    }
+
+    trackEntries();
+    LOG(INFO) << "applied " << applied << " access times from cache journal.";
+}
+
+void CacheManager::trackEntries() {
+    std::vector<const CacheFile*> order;
+    order.reserve(m_entries.size());
+    for (const auto& entry : m_entries) {
+        order.push_back(&entry.second);
+    }
+    std::sort(order.begin(), order.end(), [](const CacheFile* a, const CacheFile* b) {
+        return a->lastAccess < b->lastAccess;
+    });
+    m_policy->clear();
+    for (auto file : order) {
+        if (!m_pins.count(file->key)) {
+            m_policy->insert(file->key, file->identity.size);
+        }
+    }
+}
+
+void CacheManager::flushJournal() {
+    std::lock_guard<std::mutex> journalLock(m_journalMutex);
+    std::vector<JournalRecord> records;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        records.swap(m_pendingAccesses);
+    }
+    if (records.empty()) {
+        return;
+    }
+    std::ofstream journal(m_cachePath / kJournalName, std::ios::out | std::ios::binary | std::ios::app);
+    journal.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(JournalRecord));
+    if (!journal) {
+        LOG(ERROR) << "error appending " << records.size() << " records to cache journal.";
+    }
+}
+
+void CacheManager::addContentChunks(uint64_t key, const std::vector<ContentChunker::ManifestEntry>& entries) {
+    if (entries.empty()) {
+        return;
+    }
+    auto& hashes = m_assetContentChunks[key];
+    uint64_t offset = 0;
+    for (const auto& entry : entries) {
+        // Only the first cached copy of a chunk is indexed, and only that file's entry removes it again.
+        if (m_contentChunks.emplace(entry.hash, ChunkLocation{ key, offset }).second) {
+            hashes.push_back(entry.hash);
+        }
+        offset += entry.size;
+    }
+}
+
+void CacheManager::removeContentChunks(uint64_t key) {
+    auto found = m_assetContentChunks.find(key);
+    if (found == m_assetContentChunks.end()) {
+        return;
+    }
+    for (auto hash : found->second) {
+        m_contentChunks.erase(hash);
+    }
+    m_assetContentChunks.erase(found);
 }
 
 }  // namespace Confab
@@ -1,14 +1,24 @@
 #ifndef SRC_CONFAB_SRC_CACHE_MANAGER_HPP_
 #define SRC_CONFAB_SRC_CACHE_MANAGER_HPP_
 
+#include "CachePolicy.hpp"
+#include "ContentChunker.hpp"
+#include "LatencyHistogram.hpp"
+#include "SingleFlight.hpp"
+
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <experimental/filesystem>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace fs = std::experimental::filesystem;
 
@@ -16,73 +26,544 @@ namespace Confab {
 
 class HttpClient;
 
-/*! Manages a file cache of file-based Assets, using an LRU eviction strategy to maintain a fixed maximum size.
- *  Uses HttpClient to download AssetData chunks not in the cache.
+/*! Manages a file cache of file-based Assets, evicting entries chosen by a CachePolicy to maintain a fixed maximum
+ *  size. Uses HttpClient to download AssetData chunks not in the cache.
+ *
+ * The policy tracks entries entirely in memory, so a cache hit updates it without touching the filesystem, and
+ * eviction removes the entries it chooses without stating any files.
+ *
+ * Pinned entries are exempt from eviction, and are not tracked by the policy while pinned. Assets are pinned in named
+ * pin sets, such as the Assets of a list, and stay pinned while any pin set holds them. Pin sets are saved in the cache
+ * directory, so they survive a restart.
+ *
+ * Eviction runs on a background thread once started by startEvictionThread(). It wakes when the cache grows past a
+ * high watermark, or free disk space falls below a reserve, and evicts until the cache is down to a low watermark and
+ * the reserve is free again, so that requests rarely wait on deleting files. A download only evicts on its own thread
+ * when the cache would otherwise exceed its maximum size, or the disk could not fit the download.
+ *
+ * Small Assets read often can also be copied into an optional second tier, a directory on a RAM-backed filesystem
+ * such as tmpfs, so that loading them again reads memory instead of disk. Each small Asset counts its recent accesses,
+ * and is promoted into the RAM tier once it reaches a threshold and has been used more often than the RAM entries it
+ * would displace, which are demoted by deleting their RAM copies. Counts are halved periodically, so that Assets no
+ * longer in use give way to new ones. The disk file stays the cache entry in every other respect.
+ *
+ * Hits, misses, downloads, evictions and validation failures are counted, and download latencies recorded, for
+ * statsReport().
+ *
+ * A manifest in the cache directory records every cached file with its last access time, the inode, size and
+ * modification time it had when last seen, and whether its contents have been verified against its Asset key. It is
+ * written atomically at startup and shutdown, and access times in between are appended in batches to a journal. At
+ * startup, files whose identity still matches a verified manifest record are trusted without being hashed again.
  */
 class CacheManager {
 public:
     /*! Constructs a cache manager to manage cache files out of the provided directory.
      *
      * \param cachePath A path to the cache directory.
-     * \param maxSize The size in bytes at which to start evicting least recently used cache entries.
+     * \param maxSize The size in bytes at which to start evicting cache entries.
      * \param httpClient A pointer to the HttpClient object, for downloaded resources not in cache.
      */
     CacheManager(const fs::path& cachePath, size_t maxSize, std::shared_ptr<HttpClient> httpClient);
 
+    /*! Destructs a CacheManager, stopping the eviction thread if running.
+     */
+    ~CacheManager();
+
     /*! Enumerates any existing files, and computes the total size of the cache so far. Can take significant time
      *  depending on the number of files in the cache and their size, particularly with validation enabled.
      *
+     * With validation enabled, files are hashed on a pool of threads and each is added to the cache as soon as it is
+     * verified, so the cache can be used from other threads while this is still running.
+     *
      * \param validate Hash every file in the cache to ensure validity, deleting any invalid entries. Can add
      *                 significant time to the cache initialization process.
+     * \param numThreads Number of threads hashing files during validation.
      */
-    void checkExistingEntries(bool validate);
+    void checkExistingEntries(bool validate, size_t numThreads);
 
     /*! Returns a path to an existing file cache entry, and updates modification time of that entry, if it exists,
-     * or an empty path if no such record exists.
+     * or an empty path if no such record exists. The path is of the RAM tier copy of the entry if it has one, and the
+     * access may promote the entry into the RAM tier.
      *
      * \param key The Asset key associated with this cache entry.
+     * \param countLookup If true the lookup counts as a hit or miss in statsReport(), and towards promoting the entry
+     *                    into the RAM tier. Background lookups, such as those of prefetches, pass false so that both
+     *                    reflect only loads asked for.
      * \return The path of the existing entry, or an empty path if entry does not exist.
      */
-    fs::path checkCache(uint64_t key);
+    fs::path checkCache(uint64_t key, bool countLookup);
 
     /*! If needed, makes room by evicting old entries first, then downloads AssetData chunks of the provided Asset
-     * until complete, then returns a path to the newly created cache entry, or an empty path on error. Note that it
-     * does not checkCache first, meaning it will clobber any existing file and re-download.
+     * until complete, then returns a path to the newly created cache entry, or an empty path on error.
+     *
+     * Concurrent calls for the same Asset share a single download and all return its result. A download that finds
+     * the Asset already cached, for instance by a shared download that finished just before it started, returns the
+     * cached file instead of downloading it again.
+     *
+     * Content-chunked Assets are assembled from the content chunks listed in their manifest. Chunks already present in
+     * another cached file are copied from that file instead of downloaded.
      *
      * \param key The Asset key to download AssetData chunks for.
      * \param fileSize The size of the Asset in bytes.
      * \param chunks The number of chunks to download.
+     * \param manifestPages The number of manifest pages of a content-chunked Asset, or 0 for a regular Asset.
      * \param fileExtension The extension to append to the filename when complete, including the dot.
      * \return The path to the file, or an empty path on error.
      */
-    fs::path download(uint64_t key, size_t fileSize, uint64_t chunks, const std::string& fileExtension);
+    fs::path download(uint64_t key, size_t fileSize, uint64_t chunks, uint64_t manifestPages,
+        const std::string& fileExtension);
+
+    /*! Sets the number of AssetData chunk requests a download keeps outstanding at once.
+     *
+     * \param concurrency The number of requests, at least 1.
+     */
+    void setDownloadConcurrency(size_t concurrency) { m_downloadConcurrency = concurrency; }
+
+    /*! Replaces the policy choosing which entries to evict, which is LRU by default. The new policy starts with every
+     * cached entry in order of last access, and without any other history.
+     *
+     * \param policy The new policy, made with makeCachePolicy().
+     */
+    void setPolicy(std::unique_ptr<CachePolicy> policy);
+
+    /*! Starts the eviction thread.
+     *
+     * \param highWatermark Fraction of the maximum size above which the eviction thread starts evicting.
+     * \param lowWatermark Fraction of the maximum size the eviction thread evicts down to.
+     * \param minFreeBytes Free space to keep on the filesystem holding the cache, evicting if it falls below.
+     */
+    void startEvictionThread(double highWatermark, double lowWatermark, size_t minFreeBytes);
+
+    /*! Enables the RAM tier. Call before checkExistingEntries().
+     *
+     * \param ramPath A directory on a RAM-backed filesystem, created if needed. Files already in it are removed.
+     * \param maxSize The size limit of the RAM tier in bytes.
+     * \param maxAssetSize The largest Asset in bytes to copy into the RAM tier.
+     * \param promoteAccesses The number of recent accesses after which an Asset is copied into the RAM tier.
+     * \return true on success, false if the directory could not be created, leaving the RAM tier disabled.
+     */
+    bool setRamTier(const fs::path& ramPath, size_t maxSize, size_t maxAssetSize, uint32_t promoteAccesses);
+
+    /*! Pins Assets, exempting them from eviction whether they are cached now or downloaded later. Replaces any Assets
+     * already in the pin set. Logs an error if the cached pinned Assets alone exceed the maximum cache size, in which
+     * case the cache grows beyond it.
+     *
+     * \param pinSet Identifies the pin set, such as a list key for the Assets of a list, or an Asset key for a single
+     *               Asset.
+     * \param keys The Asset keys to pin.
+     */
+    void pin(uint64_t pinSet, const std::vector<uint64_t>& keys);
+
+    /*! Removes a pin set. Its Assets that are not in another pin set become subject to eviction again, as if just
+     * accessed.
+     *
+     * \param pinSet Identifies the pin set.
+     * \return The number of Assets in the pin set, or 0 if there was no such pin set.
+     */
+    size_t unpin(uint64_t pinSet);
+
+    /*! Returns true if an Asset is in any pin set.
+     */
+    bool isPinned(uint64_t key);
+
+    /*! Total size in bytes of the cached Assets that are pinned.
+     */
+    size_t pinnedSize();
+
+    /*! Formats a plain text report of the cache, with one "name value" pair per line. Includes lookup, download,
+     * eviction and validation failure counts since startup, the current sizes of the cache and its tiers, free disk
+     * space, and the latencies of chunk requests and of whole Asset downloads.
+     *
+     * \return The report.
+     */
+    std::string statsReport();
+
+    /*! Stops the eviction thread, then writes the manifest, so that the next run starts with the same eviction order
+     * and need not validate the files cached during this one. Call before exiting.
+     */
+    void shutdown();
 
 private:
-    /*! Evict items from the cache until the size of the cache is smaller than the maximum size plus the addedBytes.
+    /*! Name of the access journal in the cache directory. Files starting with a dot are never treated as cache entries.
+     */
+    static constexpr const char* kJournalName = ".access-journal";
+
+    /*! Name of the manifest in the cache directory.
+     */
+    static constexpr const char* kManifestName = ".manifest";
+
+    /*! Name of the file saving the pin sets in the cache directory.
+     */
+    static constexpr const char* kPinsName = ".pins";
+
+    /*! Number of unrecorded accesses after which a cache hit writes them to the journal.
+     */
+    static constexpr size_t kJournalFlushAccesses = 1024;
+
+    /*! Extension of the hidden temporary files that downloads are written to before being renamed into place.
+     */
+    static constexpr const char* kDownloadExtension = ".download";
+
+    /*! Extension of the hidden files holding the saved progress of interrupted downloads.
+     */
+    static constexpr const char* kPartialExtension = ".partial";
+
+    /*! How long an interrupted download is kept for a retry to resume, from when its progress was last saved.
+     */
+    static constexpr std::chrono::hours kPartialDownloadLifetime = std::chrono::hours(24);
+
+    /*! Amount of data received between saves of the progress of a download.
+     */
+    static constexpr size_t kDownloadStateBytes = 4 * 1024 * 1024;
+
+    /*! Default number of AssetData chunk requests a download keeps outstanding at once.
+     */
+    static constexpr size_t kDefaultDownloadConcurrency = 4;
+
+    /*! Amount of a cache file read ahead at a time while validating it.
+     */
+    static constexpr size_t kValidationStride = 8 * 1024 * 1024;
+
+    /*! How often the eviction thread checks free disk space when not woken, as other programs can fill the disk.
+     */
+    static constexpr std::chrono::seconds kEvictionInterval = std::chrono::seconds(30);
+
+    /*! Number of accesses to Assets small enough for the RAM tier after which their access counts are halved.
+     */
+    static constexpr size_t kRamAgingAccesses = 4096;
+
+    /*! Identifies the contents of a file without reading it. Any write to the file, or replacement of it, changes its
+     * identity.
+     */
+    struct FileIdentity {
+        uint64_t inode = 0;
+        uint64_t size = 0;
+        // Nanoseconds since the epoch of the last modification.
+        int64_t modified = 0;
+
+        bool operator==(const FileIdentity& other) const {
+            return inode == other.inode && size == other.size && modified == other.modified;
+        }
+    };
+
+    /*! A file in the cache directory, as found on disk or recorded in the manifest.
+     */
+    struct CacheFile {
+        uint64_t key = 0;
+        std::string extension;
+        FileIdentity identity;
+        // Seconds since the epoch of the last access.
+        int64_t lastAccess = 0;
+        // True if the contents are known to hash to the key.
+        bool verified = false;
+    };
+
+    /*! One access journal record.
+     */
+    struct JournalRecord {
+        uint64_t key;
+        int64_t lastAccess;
+    };
+
+    /*! Hashes a file found at startup and adds it to the cache if valid, or removes it if not.
+     */
+    void validateFile(const CacheFile& file);
+
+    /*! Checks that the contents of a file hash to its Asset key, and splits it into content chunks.
+     *
+     * \param path The path of the file.
+     * \param file The file to check.
+     * \param entries Set to the content chunks of the file.
+     * \return true if the file is valid.
+     */
+    static bool hashFile(const fs::path& path, const CacheFile& file,
+        std::vector<ContentChunker::ManifestEntry>* entries);
+
+    /*! Reads the identity of a file from the filesystem.
+     *
+     * \return true on success, false if the file could not be stated.
+     */
+    static bool readIdentity(const fs::path& path, FileIdentity* identity);
+
+    /*! Implements download(), for the one caller of each set of concurrent calls that actually downloads the Asset.
+     */
+    fs::path downloadFile(uint64_t key, size_t fileSize, uint64_t chunks, uint64_t manifestPages,
+        const std::string& fileExtension);
+
+    /*! Returns the path of the cache file for an Asset.
+     */
+    fs::path entryPath(uint64_t key, const std::string& extension) const;
+
+    /*! Adds a new entry and tracks it in the policy, replacing any existing entry for the same key. Call with m_mutex
+     * held.
+     */
+    void addEntry(const CacheFile& file);
+
+    /*! Removes an entry from the index and the policy, if present, without removing its file. Call with m_mutex held.
+     */
+    void removeEntry(uint64_t key);
+
+    /*! Tracks every entry afresh in the policy, in order of last access, so that recency-based policies evict the
+     * least recently used first. Call with m_mutex held.
+     */
+    void trackEntries();
+
+    /*! Reads the manifest written by a previous run.
+     *
+     * \param files Set to the files recorded in the manifest, by Asset key.
+     * \return true on success, false if there is no manifest or it is corrupt.
+     */
+    bool readManifest(std::unordered_map<uint64_t, CacheFile>* files);
+
+    /*! Atomically replaces the manifest with one recording every cached file, then truncates the journal.
+     */
+    void writeManifest();
+
+    /*! Applies the access times in the journal to the cache entries, then tracks them afresh in the policy.
+     */
+    void applyJournal();
+
+    /*! Appends the accesses recorded since the last flush to the journal.
+     */
+    void flushJournal();
+
+    /*! Adds an Asset to a pin set, moving it out of the policy if it is cached and was not already pinned. Call with
+     * m_mutex held.
+     */
+    void addPin(uint64_t pinSet, uint64_t key);
+
+    /*! Removes an Asset from a pin set, returning it to the policy if it is cached and no longer pinned. Call with
+     * m_mutex held.
+     */
+    void removePin(uint64_t pinSet, uint64_t key);
+
+    /*! Reads the pin sets saved by writePins(), adding them to any pin sets already made. Call with m_mutex held.
+     */
+    void readPins();
+
+    /*! Atomically saves every pin set, as lines of "<pin set> <asset key>". Call with m_mutex held.
+     */
+    void writePins();
+
+    /*! Returns the path of the RAM tier copy of an Asset.
+     */
+    fs::path ramEntryPath(uint64_t key, const std::string& extension) const;
+
+    /*! Counts an access to a cache entry, and decides whether to promote it into the RAM tier, demoting the RAM entries
+     * it displaces. Call with m_mutex held.
+     *
+     * \param key The Asset key accessed.
+     * \param file The cache entry of the Asset.
+     * \param demoted Appended with the paths of the RAM copies to remove once m_mutex is released.
+     * \return true if the entry should be copied into the RAM tier, in which case it is added to m_promoting.
+     */
+    bool countRamAccess(uint64_t key, const CacheFile& file, std::vector<fs::path>* demoted);
+
+    /*! Copies a cache file into the RAM tier, returning the path of the copy, or an empty path on error or if the entry
+     * was removed during the copy.
+     */
+    fs::path promote(uint64_t key, const fs::path& diskPath, const CacheFile& file);
+
+    /*! Removes every file in the RAM tier directory and forgets the RAM tier entries and access counts. Call with
+     * m_mutex held.
+     */
+    void clearRamTier();
+
+    /*! Forgets the RAM copy of an Asset, if any, returning its path so that it can be removed once m_mutex is released,
+     * or an empty path if there is no copy. Call with m_mutex held.
+     */
+    fs::path demote(uint64_t key);
+
+    /*! Prepares for a download of addedBytes, waking the eviction thread if the download takes the cache past the high
+     * watermark. Evicts on the calling thread if the cache would otherwise exceed the maximum size, or if there is less
+     * free disk space than the download needs plus the reserve.
+     *
+     * \param addedBytes The number of bytes about to be added to the cache.
+     * \return true if the disk has room for addedBytes, false if it does not even after evicting.
+     */
+    bool makeRoomFor(size_t addedBytes);
+
+    /*! Evicts entries until the cache is at most targetSize bytes and at least freeBytes have been evicted, or there
+     * is nothing left to evict, removing their files on the calling thread.
+     *
+     * \return The number of bytes evicted.
+     */
+    size_t evict(size_t targetSize, size_t freeBytes);
+
+    /*! Returns the number of bytes free on the filesystem holding the cache, or the maximum size_t if unknown.
+     */
+    size_t freeDiskSpace() const;
+
+    /*! Wakes the eviction thread, if running.
+     */
+    void wakeEvictionThread();
+
+    /*! Stops the eviction thread, if running, and waits for it to exit.
+     */
+    void stopEvictionThread();
+
+    /*! Body of the eviction thread.
+     */
+    void evictionLoop();
+
+    /*! Progress of a download of a regular Asset, saved beside its partial file so that an interrupted download can
+     * resume.
+     */
+    struct DownloadState;
+
+    /*! Downloads the AssetData chunks of a regular Asset that state does not already hold, with several requests in
+     * flight, writing each chunk at its offset in the file and checking the incremental hash of each in order as the
+     * chunks before it arrive.
+     *
+     * \param key The Asset key to download.
+     * \param fileSize The size of the Asset in bytes.
+     * \param fd The file to write the Asset data to, readable and writable.
+     * \param statePath Where to save the progress of the download.
+     * \param state The progress of the download so far, updated as chunks arrive.
+     * \param downloadedSize Set to the number of bytes downloaded and verified.
+     * \param digest Set to the XXH64 hash of the data verified.
+     * \param resumable Set to true if the download failed, but saved its progress for a later attempt to resume.
+     * \return true on success, false on error.
+     */
+    bool downloadChunks(uint64_t key, size_t fileSize, int fd, const fs::path& statePath, DownloadState* state,
+        size_t* downloadedSize, uint64_t* digest, bool* resumable);
+
+    /*! Reads the saved progress of an interrupted download.
+     *
+     * \param statePath The path the progress was saved to.
+     * \param key The Asset key being downloaded.
+     * \param fileSize The size of the Asset in bytes.
+     * \param state Progress for the number of chunks of the Asset, updated with the saved progress.
+     * \return true on success, false if there is no saved progress or it describes a different download.
+     */
+    static bool readDownloadState(const fs::path& statePath, uint64_t key, size_t fileSize, DownloadState* state);
+
+    /*! Atomically saves the progress of a download.
+     *
+     * \return true on success, false on error.
+     */
+    static bool writeDownloadState(const fs::path& statePath, uint64_t key, size_t fileSize,
+        const DownloadState& state);
+
+    /*! Writes the data of a content-chunked Asset to a file, reading chunks from other cached files where possible.
+     *
+     * \param key The Asset key to download.
+     * \param manifestPages The number of manifest pages to download.
+     * \param fd The file to write the Asset data to, from its current offset.
+     * \param entries Set to the manifest entries of the Asset.
+     * \param ok Set to false on error.
+     * \return The XXH64 hash of the data written, which is only correct if ok is true on return.
+     */
+    uint64_t downloadContentChunks(uint64_t key, uint64_t manifestPages, int fd,
+        std::vector<ContentChunker::ManifestEntry>* entries, bool* ok);
+
+    /*! Reads a content chunk from a cached file, if any cached file holds it.
+     *
+     * \param hash The hash of the content chunk.
+     * \param size The size of the content chunk.
+     * \param chunk Set to the chunk contents, which have been checked against hash.
+     * \return true if the chunk was read, false if no cached file holds it.
+     */
+    bool readLocalContentChunk(uint64_t hash, uint32_t size, std::vector<uint8_t>* chunk);
+
+    /*! Records where each of the content chunks of a cached file are, so other downloads can reuse them. Call with
+     * m_mutex held.
      *
-     * \param addedBytes The number of bytes to ensure the cache will have room for without exceeding the maximum size
-     *                   parameter.
+     * \param key The Asset key of the cached file.
+     * \param entries The content chunks of the file, in order.
      */
-    void makeRoomFor(size_t addedBytes);
+    void addContentChunks(uint64_t key, const std::vector<ContentChunker::ManifestEntry>& entries);
+
+    /*! Forgets the content chunks of a cached file that is being removed. Call with m_mutex held.
+     *
+     * \param key The Asset key of the cached file.
+     */
+    void removeContentChunks(uint64_t key);
 
     const fs::path m_cachePath;
     size_t m_maxSize;
     std::shared_ptr<HttpClient> m_httpClient;
+    size_t m_downloadConcurrency;
 
     size_t m_currentSize;
+    // Cache sizes at which the eviction thread starts, and stops, evicting. Both are the maximum size until started.
+    size_t m_highWatermark;
+    size_t m_lowWatermark;
+    // Free disk space to keep, evicting if needed.
+    size_t m_minFreeBytes;
 
-    // Protects both priority queue and map.
+    std::thread m_evictionThread;
+    std::mutex m_evictionMutex;
+    std::condition_variable m_evictionCondition;
+    bool m_evictionRequested;
+    bool m_evictionQuit;
+
+    // Protects the cache entries, policy, pending journal records and content chunk index.
     std::mutex m_mutex;
 
-    // We monitor access time of cache entries by updating the modified time for each request for a cache asset. This
-    // queue allows for quick extraction of the oldest entry by access time for efficient cache eviction.
-    using TimePath = std::pair<std::chrono::system_clock::time_point, fs::path>;
-    std::priority_queue<TimePath> m_timeQueue;
+    // Every cached file by Asset key. Presence in this map indicates presence in the cache.
+    std::unordered_map<uint64_t, CacheFile> m_entries;
+    // Chooses entries to evict, tracking every entry in m_entries that is not pinned.
+    std::unique_ptr<CachePolicy> m_policy;
+    // The Asset keys in each pin set, by pin set.
+    std::unordered_map<uint64_t, std::unordered_set<uint64_t>> m_pinSets;
+    // The number of pin sets holding each pinned Asset, by Asset key.
+    std::unordered_map<uint64_t, size_t> m_pins;
+    // Total size of the cached pinned entries, which m_currentSize includes.
+    size_t m_pinnedSize;
+
+    // The RAM tier, disabled while m_ramPath is empty.
+    fs::path m_ramPath;
+    size_t m_ramMaxSize;
+    size_t m_ramMaxAssetSize;
+    uint32_t m_ramPromoteAccesses;
+    // Total size of the files in the RAM tier.
+    size_t m_ramSize;
+    // Size of the RAM copy of each Asset in the RAM tier, by Asset key.
+    std::unordered_map<uint64_t, size_t> m_ramEntries;
+    // Assets being copied into the RAM tier. A key removed from here during the copy discards it.
+    std::unordered_set<uint64_t> m_promoting;
+    // Recent accesses to each cached Asset small enough for the RAM tier, by Asset key.
+    std::unordered_map<uint64_t, uint32_t> m_accessCounts;
+    size_t m_accessesSinceAging;
+
+    // Statistics since startup, reported by statsReport().
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_ramHits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_completedDownloads;
+    std::atomic<uint64_t> m_downloadFailures;
+    // Bytes received from the server, and bytes of content chunks copied from cached files instead.
+    std::atomic<uint64_t> m_downloadedBytes;
+    std::atomic<uint64_t> m_reusedBytes;
+    std::atomic<uint64_t> m_evictions;
+    std::atomic<uint64_t> m_evictedBytes;
+    // Cached files and downloads whose data did not hash to the value expected.
+    std::atomic<uint64_t> m_validationFailures;
+    LatencyHistogram m_downloadLatency;
+
+    // Downloads in progress, by Asset key.
+    SingleFlight<uint64_t, fs::path> m_downloads;
+
+    // Keys of the files found at startup that are still waiting to be validated.
+    std::unordered_set<uint64_t> m_validating;
+    // Keys of the Assets being written to their temporary files, which the startup scan must leave alone.
+    std::unordered_set<uint64_t> m_writing;
+
+    // Accesses not yet written to the journal.
+    std::vector<JournalRecord> m_pendingAccesses;
+    // Serializes writes to the journal file.
+    std::mutex m_journalMutex;
 
-    // The asset files are stored with extensions, so this map keeps the extension, if any, associated with the asset
-    // key. Even with no extension, presence in this map indicates presence in the cache.
-    using ExtensionMap = std::unordered_map<uint64_t, std::string>;
-    ExtensionMap m_extensionMap;
+    // Where to find a copy of each content chunk among the cached files. Files validated at startup and content-chunked
+    // Assets downloaded since are indexed, and the index entries of a file are removed along with it.
+    struct ChunkLocation {
+        uint64_t key;
+        uint64_t offset;
+    };
+    std::unordered_map<uint64_t, ChunkLocation> m_contentChunks;
+    // The content chunks indexed for each cached file, by Asset key.
+    std::unordered_map<uint64_t, std::vector<uint64_t>> m_assetContentChunks;
 };
 
 }  // namespace Confab
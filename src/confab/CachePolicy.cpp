@@ -0,0 +1,400 @@
+#include "CachePolicy.hpp"
+
+#include <algorithm>
+#include <array>
+#include <list>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+/*! Evicts the least recently used object.
+ */
+class LruPolicy : public Confab::CachePolicy {
+public:
+    void insert(uint64_t key, uint64_t /* size */) override {
+        m_order.push_front(key);
+        m_index[key] = m_order.begin();
+    }
+
+    void access(uint64_t key) override {
+        auto found = m_index.find(key);
+        if (found != m_index.end()) {
+            m_order.splice(m_order.begin(), m_order, found->second);
+        }
+    }
+
+    void remove(uint64_t key) override {
+        auto found = m_index.find(key);
+        if (found != m_index.end()) {
+            m_order.erase(found->second);
+            m_index.erase(found);
+        }
+    }
+
+    bool evict(uint64_t* key) override {
+        if (m_order.empty()) {
+            return false;
+        }
+        *key = m_order.back();
+        m_index.erase(*key);
+        m_order.pop_back();
+        return true;
+    }
+
+    void clear() override {
+        m_order.clear();
+        m_index.clear();
+    }
+
+    const char* name() const override { return "lru"; }
+
+private:
+    // Most recently used first.
+    std::list<uint64_t> m_order;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> m_index;
+};
+
+/*! Evicts the object with the lowest priority, keeping objects ordered by a priority computed on every access. Ties
+ * go to the least recently accessed object.
+ */
+class PriorityPolicy : public Confab::CachePolicy {
+public:
+    void insert(uint64_t key, uint64_t size) override {
+        Entry& entry = m_entries[key];
+        entry.size = size;
+        entry.count = 1;
+        rank(key, &entry);
+    }
+
+    void access(uint64_t key) override {
+        auto found = m_entries.find(key);
+        if (found != m_entries.end()) {
+            m_order.erase(Rank{ found->second.priority, found->second.sequence, key });
+            ++found->second.count;
+            rank(key, &found->second);
+        }
+    }
+
+    void remove(uint64_t key) override {
+        auto found = m_entries.find(key);
+        if (found != m_entries.end()) {
+            m_order.erase(Rank{ found->second.priority, found->second.sequence, key });
+            m_entries.erase(found);
+        }
+    }
+
+    bool evict(uint64_t* key) override {
+        if (m_order.empty()) {
+            return false;
+        }
+        auto lowest = m_order.begin();
+        *key = std::get<2>(*lowest);
+        evicted(std::get<0>(*lowest));
+        m_order.erase(lowest);
+        m_entries.erase(*key);
+        return true;
+    }
+
+    void clear() override {
+        m_order.clear();
+        m_entries.clear();
+        m_sequence = 0;
+    }
+
+protected:
+    /*! The priority of an object, which is evicted before objects of higher priority.
+     */
+    virtual double priority(uint64_t count, uint64_t size) const = 0;
+
+    /*! Called with the priority of each evicted object.
+     */
+    virtual void evicted(double /* priority */) {}
+
+private:
+    struct Entry {
+        uint64_t size;
+        uint64_t count;
+        double priority;
+        uint64_t sequence;
+    };
+    // Priority, then access sequence number, then key.
+    typedef std::tuple<double, uint64_t, uint64_t> Rank;
+
+    void rank(uint64_t key, Entry* entry) {
+        entry->priority = priority(entry->count, entry->size);
+        entry->sequence = m_sequence++;
+        m_order.insert(Rank{ entry->priority, entry->sequence, key });
+    }
+
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::set<Rank> m_order;
+    uint64_t m_sequence = 0;
+};
+
+/*! Evicts the least frequently used object.
+ */
+class LfuPolicy : public PriorityPolicy {
+public:
+    const char* name() const override { return "lfu"; }
+
+protected:
+    double priority(uint64_t count, uint64_t /* size */) const override {
+        return static_cast<double>(count);
+    }
+};
+
+/*! Greedy-Dual-Size-Frequency, which gives each object a priority of its access count divided by its size, plus an
+ * inflation value that rises to the priority of each object evicted. Objects accessed recently are ranked against the
+ * higher inflation, so frequently used objects that stop being used eventually give way.
+ */
+class GdsfPolicy : public PriorityPolicy {
+public:
+    void clear() override {
+        PriorityPolicy::clear();
+        m_inflation = 0.0;
+    }
+
+    const char* name() const override { return "gdsf"; }
+
+protected:
+    double priority(uint64_t count, uint64_t size) const override {
+        return m_inflation + static_cast<double>(count) / static_cast<double>(std::max(size, static_cast<uint64_t>(1)));
+    }
+
+    void evicted(double priority) override {
+        m_inflation = std::max(m_inflation, priority);
+    }
+
+private:
+    double m_inflation = 0.0;
+};
+
+/*! Estimates the recent access frequency of keys in a fixed amount of memory, with a count-min sketch of 4-bit
+ * counters. Every counter is halved after a number of increments proportional to the sketch width, so the estimates
+ * follow changes in popularity.
+ */
+class FrequencySketch {
+public:
+    static constexpr uint8_t kMaxCount = 15;
+
+    explicit FrequencySketch(size_t width) :
+        m_mask(width - 1),
+        m_resetAfter(10 * width),
+        m_increments(0) {
+        for (auto& row : m_rows) {
+            row.assign(width, 0);
+        }
+    }
+
+    void increment(uint64_t key) {
+        for (size_t i = 0; i < kRows; ++i) {
+            uint8_t& counter = m_rows[i][index(key, i)];
+            if (counter < kMaxCount) {
+                ++counter;
+            }
+        }
+        if (++m_increments >= m_resetAfter) {
+            for (auto& row : m_rows) {
+                for (auto& counter : row) {
+                    counter /= 2;
+                }
+            }
+            m_increments /= 2;
+        }
+    }
+
+    uint8_t estimate(uint64_t key) const {
+        uint8_t count = kMaxCount;
+        for (size_t i = 0; i < kRows; ++i) {
+            count = std::min(count, m_rows[i][index(key, i)]);
+        }
+        return count;
+    }
+
+    void clear() {
+        for (auto& row : m_rows) {
+            std::fill(row.begin(), row.end(), 0);
+        }
+        m_increments = 0;
+    }
+
+private:
+    static constexpr size_t kRows = 4;
+
+    size_t index(uint64_t key, size_t row) const {
+        // SplitMix64 finalizer, seeded differently for each row.
+        uint64_t hash = key + (row + 1) * 0x9e3779b97f4a7c15ULL;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return (hash ^ (hash >> 31)) & m_mask;
+    }
+
+    std::array<std::vector<uint8_t>, kRows> m_rows;
+    size_t m_mask;
+    size_t m_resetAfter;
+    size_t m_increments;
+};
+
+/*! W-TinyLFU. New objects enter a window LRU sized at a small fraction of the cache. Objects pushed out of the window
+ * are candidates for the main cache, a segmented LRU of probation and protected segments, and are admitted only if
+ * their estimated frequency is higher than that of the main cache's next victim; otherwise the candidate is evicted
+ * instead. Objects hit while on probation move to the protected segment, whose oldest objects fall back to probation
+ * when it outgrows its share of the main cache.
+ */
+class TinyLfuPolicy : public Confab::CachePolicy {
+public:
+    explicit TinyLfuPolicy(uint64_t capacity) :
+        m_sketch(sketchWidth(capacity)),
+        m_windowCapacity(capacity / 100),
+        m_mainCapacity(capacity - m_windowCapacity),
+        m_protectedCapacity(m_mainCapacity / 5 * 4),
+        m_segmentBytes{ 0, 0, 0 } {
+    }
+
+    void insert(uint64_t key, uint64_t size) override {
+        m_sketch.increment(key);
+        m_segments[kWindow].push_front(key);
+        m_entries[key] = Entry{ kWindow, m_segments[kWindow].begin(), size };
+        m_segmentBytes[kWindow] += size;
+    }
+
+    void access(uint64_t key) override {
+        auto found = m_entries.find(key);
+        if (found == m_entries.end()) {
+            return;
+        }
+        m_sketch.increment(key);
+        Entry& entry = found->second;
+        if (entry.segment == kProbation) {
+            move(&entry, kProtected);
+            // Demote the oldest protected objects back to probation, keeping at least the object just promoted.
+            while (m_segmentBytes[kProtected] > m_protectedCapacity && m_segments[kProtected].size() > 1) {
+                move(&m_entries[m_segments[kProtected].back()], kProbation);
+            }
+        } else {
+            move(&entry, entry.segment);
+        }
+    }
+
+    void remove(uint64_t key) override {
+        auto found = m_entries.find(key);
+        if (found != m_entries.end()) {
+            m_segments[found->second.segment].erase(found->second.position);
+            m_segmentBytes[found->second.segment] -= found->second.size;
+            m_entries.erase(found);
+        }
+    }
+
+    bool evict(uint64_t* key) override {
+        while (m_segmentBytes[kWindow] > m_windowCapacity && !m_segments[kWindow].empty()) {
+            uint64_t candidate = m_segments[kWindow].back();
+            Entry& candidateEntry = m_entries[candidate];
+            // Candidates join the main cache unopposed while it has room.
+            if (m_segmentBytes[kProbation] + m_segmentBytes[kProtected] + candidateEntry.size <= m_mainCapacity) {
+                move(&candidateEntry, kProbation);
+                continue;
+            }
+            Segment victimSegment = m_segments[kProbation].empty() ? kProtected : kProbation;
+            if (m_segments[victimSegment].empty()) {
+                move(&candidateEntry, kProbation);
+                continue;
+            }
+            uint64_t victim = m_segments[victimSegment].back();
+            if (m_sketch.estimate(candidate) > m_sketch.estimate(victim)) {
+                move(&candidateEntry, kProbation);
+                *key = victim;
+            } else {
+                *key = candidate;
+            }
+            remove(*key);
+            return true;
+        }
+        for (auto segment : { kProbation, kProtected, kWindow }) {
+            if (!m_segments[segment].empty()) {
+                *key = m_segments[segment].back();
+                remove(*key);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void clear() override {
+        for (size_t i = 0; i < kSegments; ++i) {
+            m_segments[i].clear();
+            m_segmentBytes[i] = 0;
+        }
+        m_entries.clear();
+        m_sketch.clear();
+    }
+
+    const char* name() const override { return "tinylfu"; }
+
+private:
+    enum Segment : size_t {
+        kWindow = 0,
+        kProbation = 1,
+        kProtected = 2
+    };
+    static constexpr size_t kSegments = 3;
+
+    struct Entry {
+        Segment segment;
+        std::list<uint64_t>::iterator position;
+        uint64_t size;
+    };
+
+    /*! Sizes the sketch for the number of objects a cache of capacity bytes might hold, assuming objects of at least
+     * 64 KB, in a power of two number of counters.
+     */
+    static size_t sketchWidth(uint64_t capacity) {
+        size_t width = 1024;
+        while (width < capacity / (64 * 1024) && width < (static_cast<size_t>(1) << 24)) {
+            width *= 2;
+        }
+        return width;
+    }
+
+    /*! Moves an entry to the front of a segment.
+     */
+    void move(Entry* entry, Segment segment) {
+        m_segments[segment].splice(m_segments[segment].begin(), m_segments[entry->segment], entry->position);
+        m_segmentBytes[entry->segment] -= entry->size;
+        m_segmentBytes[segment] += entry->size;
+        entry->segment = segment;
+    }
+
+    FrequencySketch m_sketch;
+    uint64_t m_windowCapacity;
+    uint64_t m_mainCapacity;
+    uint64_t m_protectedCapacity;
+    // Most recently used first in each segment.
+    std::array<std::list<uint64_t>, kSegments> m_segments;
+    std::array<uint64_t, kSegments> m_segmentBytes;
+    std::unordered_map<uint64_t, Entry> m_entries;
+};
+
+}  // namespace
+
+namespace Confab {
+
+std::unique_ptr<CachePolicy> makeCachePolicy(const std::string& name, uint64_t capacity) {
+    if (name == "lru") {
+        return std::unique_ptr<CachePolicy>(new LruPolicy);
+    } else if (name == "lfu") {
+        return std::unique_ptr<CachePolicy>(new LfuPolicy);
+    } else if (name == "gdsf") {
+        return std::unique_ptr<CachePolicy>(new GdsfPolicy);
+    } else if (name == "tinylfu") {
+        return std::unique_ptr<CachePolicy>(new TinyLfuPolicy(capacity));
+    }
+    return nullptr;
+}
+
+std::vector<std::string> cachePolicyNames() {
+    return { "lru", "lfu", "gdsf", "tinylfu" };
+}
+
+}  // namespace Confab
@@ -0,0 +1,82 @@
+#ifndef SRC_CONFAB_CACHE_POLICY_HPP_
+#define SRC_CONFAB_CACHE_POLICY_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Confab {
+
+/*! Decides which objects a size-limited cache evicts, tracking the objects in the cache by key and size.
+ *
+ * The cache tells the policy about every object it adds, every hit, and every object it removes for its own reasons,
+ * and asks the policy for a victim whenever it is over its size limit. Every object added stays in the cache until it
+ * is chosen as a victim or removed, as a file cache must hold a file that has just been requested. Policies that filter
+ * admission do so when choosing victims, by weighing newly added objects against the objects already established in
+ * the cache.
+ *
+ * Policies are not thread-safe, and expect the cache to serialize calls.
+ */
+class CachePolicy {
+public:
+    virtual ~CachePolicy() = default;
+
+    /*! Starts tracking an object just added to the cache, which counts as an access to it.
+     *
+     * \param key Identifies the object, and must not already be tracked.
+     * \param size The size of the object in bytes.
+     */
+    virtual void insert(uint64_t key, uint64_t size) = 0;
+
+    /*! Records a cache hit on an object.
+     *
+     * \param key Identifies the object, which does nothing if it is not tracked.
+     */
+    virtual void access(uint64_t key) = 0;
+
+    /*! Stops tracking an object removed from the cache other than by evict().
+     *
+     * \param key Identifies the object, which does nothing if it is not tracked.
+     */
+    virtual void remove(uint64_t key) = 0;
+
+    /*! Chooses an object to evict, and stops tracking it.
+     *
+     * \param key Set to the key of the object to evict.
+     * \return true if an object was chosen, false if no objects are tracked.
+     */
+    virtual bool evict(uint64_t* key) = 0;
+
+    /*! Stops tracking every object, and forgets any history kept about them.
+     */
+    virtual void clear() = 0;
+
+    /*! The name of the policy, as accepted by makeCachePolicy().
+     */
+    virtual const char* name() const = 0;
+};
+
+/*! Makes a cache policy.
+ *
+ * \param name The policy to make, one of:
+ *             - "lru" evicts the least recently used object.
+ *             - "lfu" evicts the least frequently used object, the least recently used among equals.
+ *             - "gdsf" (Greedy-Dual-Size-Frequency) evicts the object with the fewest accesses per byte, aged so that
+ *               objects not accessed for a while give way to newer ones. Favours many small objects over few large
+ *               ones, for the best object hit ratio.
+ *             - "tinylfu" (W-TinyLFU) keeps new objects in a small LRU window, and admits an object leaving the window
+ *               to the main cache only if its estimated access frequency beats that of the main cache's next victim.
+ *               Resists scans, such as a one-off pass over a large sample pack, flushing the working set.
+ * \param capacity The size limit of the cache in bytes, which policies may use to size their internal structures.
+ * \return The new policy, or nullptr if name is not recognized.
+ */
+std::unique_ptr<CachePolicy> makeCachePolicy(const std::string& name, uint64_t capacity);
+
+/*! The names of every policy accepted by makeCachePolicy().
+ */
+std::vector<std::string> cachePolicyNames();
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CACHE_POLICY_HPP_
@@ -0,0 +1,116 @@
+#include "CachePolicy.hpp"
+#include "CacheSimulator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const uint64_t kMegabyte = 1024 * 1024;
+
+uint64_t evictOne(Confab::CachePolicy* policy) {
+    uint64_t key = 0;
+    EXPECT_TRUE(policy->evict(&key));
+    return key;
+}
+
+}  // namespace
+
+TEST(CachePolicyTest, EveryPolicyTracksAndForgets) {
+    for (const auto& name : Confab::cachePolicyNames()) {
+        std::unique_ptr<Confab::CachePolicy> policy = Confab::makeCachePolicy(name, 100 * kMegabyte);
+        ASSERT_TRUE(policy) << name;
+        EXPECT_EQ(name, policy->name());
+
+        uint64_t key = 0;
+        EXPECT_FALSE(policy->evict(&key));
+        policy->insert(1, kMegabyte);
+        policy->insert(2, kMegabyte);
+        policy->insert(3, kMegabyte);
+        policy->remove(2);
+        // Unknown keys are ignored.
+        policy->remove(42);
+        policy->access(42);
+
+        std::vector<uint64_t> evicted;
+        while (policy->evict(&key)) {
+            evicted.push_back(key);
+        }
+        EXPECT_EQ(2, evicted.size()) << name;
+        EXPECT_EQ(evicted.end(), std::find(evicted.begin(), evicted.end(), 2)) << name;
+
+        policy->insert(4, kMegabyte);
+        policy->clear();
+        EXPECT_FALSE(policy->evict(&key)) << name;
+    }
+    EXPECT_FALSE(Confab::makeCachePolicy("fifo", kMegabyte));
+}
+
+TEST(CachePolicyTest, LruEvictsLeastRecentlyUsed) {
+    std::unique_ptr<Confab::CachePolicy> policy = Confab::makeCachePolicy("lru", 100 * kMegabyte);
+    policy->insert(1, kMegabyte);
+    policy->insert(2, kMegabyte);
+    policy->insert(3, kMegabyte);
+    policy->access(1);
+    EXPECT_EQ(2, evictOne(policy.get()));
+    EXPECT_EQ(3, evictOne(policy.get()));
+    EXPECT_EQ(1, evictOne(policy.get()));
+}
+
+TEST(CachePolicyTest, LfuEvictsLeastFrequentlyUsed) {
+    std::unique_ptr<Confab::CachePolicy> policy = Confab::makeCachePolicy("lfu", 100 * kMegabyte);
+    policy->insert(1, kMegabyte);
+    policy->insert(2, kMegabyte);
+    policy->insert(3, kMegabyte);
+    policy->access(1);
+    policy->access(1);
+    policy->access(3);
+    policy->access(2);
+    // 2 and 3 are tied, and 3 was used less recently.
+    EXPECT_EQ(3, evictOne(policy.get()));
+    EXPECT_EQ(2, evictOne(policy.get()));
+    EXPECT_EQ(1, evictOne(policy.get()));
+}
+
+TEST(CachePolicyTest, GdsfEvictsLargerObjectsFirst) {
+    std::unique_ptr<Confab::CachePolicy> policy = Confab::makeCachePolicy("gdsf", 100 * kMegabyte);
+    policy->insert(1, 10 * kMegabyte);
+    policy->insert(2, kMegabyte);
+    policy->insert(3, 10 * kMegabyte);
+    policy->access(3);
+    EXPECT_EQ(1, evictOne(policy.get()));
+    EXPECT_EQ(3, evictOne(policy.get()));
+    // Priorities are raised to those already evicted, but a new large object still ranks below a small one.
+    policy->insert(4, 10 * kMegabyte);
+    EXPECT_EQ(4, evictOne(policy.get()));
+    EXPECT_EQ(2, evictOne(policy.get()));
+}
+
+TEST(CachePolicyTest, TinyLfuResistsScans) {
+    // A working set of ten objects used every round, and a scan through thirty objects never seen again.
+    std::vector<Confab::CacheTraceRecord> trace;
+    uint64_t scanKey = 1000;
+    for (int round = 0; round < 20; ++round) {
+        for (uint64_t key = 1; key <= 10; ++key) {
+            trace.push_back({ 0, key, kMegabyte });
+        }
+        for (int i = 0; i < 30; ++i) {
+            trace.push_back({ 0, scanKey++, kMegabyte });
+        }
+    }
+
+    // The cache holds twice the working set, but less than one round, so LRU always evicts the working set first.
+    uint64_t capacity = 20 * kMegabyte;
+    std::unique_ptr<Confab::CachePolicy> lru = Confab::makeCachePolicy("lru", capacity);
+    Confab::CacheSimulation lruResult = Confab::simulateCache(lru.get(), capacity, trace);
+    EXPECT_EQ(0, lruResult.hits);
+
+    std::unique_ptr<Confab::CachePolicy> tinyLfu = Confab::makeCachePolicy("tinylfu", capacity);
+    Confab::CacheSimulation tinyLfuResult = Confab::simulateCache(tinyLfu.get(), capacity, trace);
+    // Everything but the first round of the working set should hit.
+    EXPECT_GE(tinyLfuResult.hits, 180);
+    EXPECT_EQ(tinyLfuResult.hits * kMegabyte, tinyLfuResult.hitBytes);
+}
@@ -0,0 +1,77 @@
+#include "CacheSimulator.hpp"
+
+#include "Asset.hpp"
+#include "CachePolicy.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <unordered_map>
+
+namespace Confab {
+
+bool CacheTraceWriter::open(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_trace.open(path, std::ios::out | std::ios::app);
+    return m_trace.good();
+}
+
+void CacheTraceWriter::append(uint64_t key, uint64_t size) {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Flushed on every line, so that a trace is complete up to the moment confab stops, however it stops.
+    m_trace << now << " " << Asset::keyToString(key) << " " << size << std::endl;
+}
+
+bool readCacheTrace(const fs::path& path, std::vector<CacheTraceRecord>* records) {
+    std::ifstream trace(path);
+    if (!trace) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(trace, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        CacheTraceRecord record;
+        std::string keyString;
+        if (!(fields >> record.time >> keyString >> record.size)) {
+            return false;
+        }
+        record.key = Asset::stringToKey(keyString);
+        records->push_back(record);
+    }
+    return true;
+}
+
+CacheSimulation simulateCache(CachePolicy* policy, uint64_t capacity, const std::vector<CacheTraceRecord>& trace) {
+    CacheSimulation simulation;
+    std::unordered_map<uint64_t, uint64_t> cached;
+    uint64_t cachedBytes = 0;
+    for (const auto& record : trace) {
+        ++simulation.requests;
+        simulation.requestedBytes += record.size;
+        if (cached.count(record.key)) {
+            ++simulation.hits;
+            simulation.hitBytes += record.size;
+            policy->access(record.key);
+            continue;
+        }
+        uint64_t victim = 0;
+        while (cachedBytes + record.size > capacity && policy->evict(&victim)) {
+            auto found = cached.find(victim);
+            if (found != cached.end()) {
+                cachedBytes -= found->second;
+                cached.erase(found);
+                ++simulation.evictions;
+            }
+        }
+        cached[record.key] = record.size;
+        cachedBytes += record.size;
+        policy->insert(record.key, record.size);
+    }
+    return simulation;
+}
+
+}  // namespace Confab
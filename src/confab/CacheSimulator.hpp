@@ -0,0 +1,99 @@
+#ifndef SRC_CONFAB_CACHE_SIMULATOR_HPP_
+#define SRC_CONFAB_CACHE_SIMULATOR_HPP_
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+class CachePolicy;
+
+/*! One request for an Asset file in a recorded access trace.
+ */
+struct CacheTraceRecord {
+    /*! Milliseconds since the epoch of the request.
+     */
+    int64_t time;
+
+    /*! The Asset key requested.
+     */
+    uint64_t key;
+
+    /*! The size of the Asset in bytes.
+     */
+    uint64_t size;
+};
+
+/*! Appends Asset file requests to a trace file, as lines of "<milliseconds since epoch> <asset key> <size>". Thread
+ * safe.
+ */
+class CacheTraceWriter {
+public:
+    /*! Opens a trace file for appending, creating it if needed.
+     *
+     * \param path The path of the trace file.
+     * \return true on success, false on error.
+     */
+    bool open(const fs::path& path);
+
+    /*! Appends a request to the trace, timestamped now.
+     *
+     * \param key The Asset key requested.
+     * \param size The size of the Asset in bytes.
+     */
+    void append(uint64_t key, uint64_t size);
+
+private:
+    std::mutex m_mutex;
+    std::ofstream m_trace;
+};
+
+/*! Reads a trace file written by CacheTraceWriter.
+ *
+ * \param path The path of the trace file.
+ * \param records A vector to append the requests to, in the order recorded.
+ * \return true on success, false if the file could not be read or has a malformed line.
+ */
+bool readCacheTrace(const fs::path& path, std::vector<CacheTraceRecord>* records);
+
+/*! The outcome of replaying a trace against a cache policy.
+ */
+struct CacheSimulation {
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    uint64_t requestedBytes = 0;
+    uint64_t hitBytes = 0;
+    uint64_t evictions = 0;
+
+    /*! The fraction of requests that were hits.
+     */
+    double objectHitRatio() const {
+        return requests ? static_cast<double>(hits) / static_cast<double>(requests) : 0.0;
+    }
+
+    /*! The fraction of requested bytes served by hits.
+     */
+    double byteHitRatio() const {
+        return requestedBytes ? static_cast<double>(hitBytes) / static_cast<double>(requestedBytes) : 0.0;
+    }
+};
+
+/*! Replays a trace against a cache policy, as CacheManager would: a miss evicts until the requested Asset fits within
+ * the capacity, or the cache is empty, then adds it.
+ *
+ * \param policy The policy to simulate, which should be tracking no objects.
+ * \param capacity The size limit of the simulated cache in bytes.
+ * \param trace The requests to replay, in order.
+ * \return The hits and misses of the replay.
+ */
+CacheSimulation simulateCache(CachePolicy* policy, uint64_t capacity, const std::vector<CacheTraceRecord>& trace);
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CACHE_SIMULATOR_HPP_
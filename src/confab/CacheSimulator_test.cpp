@@ -0,0 +1,72 @@
+#include "CacheSimulator.hpp"
+
+#include "CachePolicy.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+fs::path makeTracePath() {
+    return fs::temp_directory_path() / ("confab-cache-trace-test-" + std::to_string(getpid()));
+}
+
+}  // namespace
+
+TEST(CacheSimulatorTest, TraceRoundTrip) {
+    fs::path path = makeTracePath();
+    fs::remove(path);
+    {
+        Confab::CacheTraceWriter writer;
+        ASSERT_TRUE(writer.open(path));
+        writer.append(0x1234, 100);
+        writer.append(0xfedcba9876543210, 1ULL << 40);
+    }
+    {
+        // Opening again appends.
+        Confab::CacheTraceWriter writer;
+        ASSERT_TRUE(writer.open(path));
+        writer.append(0x1234, 100);
+    }
+
+    std::vector<Confab::CacheTraceRecord> trace;
+    ASSERT_TRUE(Confab::readCacheTrace(path, &trace));
+    ASSERT_EQ(3, trace.size());
+    EXPECT_EQ(0x1234, trace[0].key);
+    EXPECT_EQ(100, trace[0].size);
+    EXPECT_EQ(0xfedcba9876543210, trace[1].key);
+    EXPECT_EQ(1ULL << 40, trace[1].size);
+    EXPECT_LE(trace[0].time, trace[2].time);
+
+    std::ofstream(path, std::ios::out | std::ios::app) << "not a record\n";
+    EXPECT_FALSE(Confab::readCacheTrace(path, &trace));
+    fs::remove(path);
+    EXPECT_FALSE(Confab::readCacheTrace(path, &trace));
+}
+
+TEST(CacheSimulatorTest, CountsHitsAndEvictions) {
+    std::vector<Confab::CacheTraceRecord> trace = {
+        { 0, 1, 40 },
+        { 0, 2, 40 },
+        { 0, 1, 40 },
+        // Evicts 2, the least recently used.
+        { 0, 3, 40 },
+        { 0, 1, 40 },
+        { 0, 2, 40 },
+        // Larger than the cache, so evicts everything but is still added.
+        { 0, 4, 200 },
+        { 0, 4, 200 },
+    };
+    std::unique_ptr<Confab::CachePolicy> policy = Confab::makeCachePolicy("lru", 100);
+    Confab::CacheSimulation simulation = Confab::simulateCache(policy.get(), 100, trace);
+    EXPECT_EQ(8, simulation.requests);
+    EXPECT_EQ(3, simulation.hits);
+    EXPECT_EQ(640, simulation.requestedBytes);
+    EXPECT_EQ(280, simulation.hitBytes);
+    EXPECT_EQ(4, simulation.evictions);
+    EXPECT_DOUBLE_EQ(3.0 / 8.0, simulation.objectHitRatio());
+}
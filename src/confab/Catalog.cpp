@@ -0,0 +1,289 @@
+#include "Catalog.hpp"
+
+#include "glog/logging.h"
+#include "xxhash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+static const char kCatalogMagic[8] = { 'c', 'o', 'n', 'f', 'a', 'b', 'c', 't' };
+static const uint32_t kCatalogVersion = 1;
+
+/*! Fixed header at the start of every catalog file. All offsets are from the start of the file.
+ */
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t keysOffset;
+    uint64_t slotsOffset;
+    uint64_t blobsOffset;
+    uint64_t fileSize;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(CatalogHeader) == 64, "catalog header layout must be stable across builds");
+
+inline size_t alignUp(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+/*! Copies sorted[] into eytzinger[] in breadth-first tree order, where the children of 1-based node k are 2k and
+ * 2k + 1. Returns the index of the next sorted element to place.
+ */
+size_t fillEytzinger(const std::vector<size_t>& sorted, size_t i, size_t k, std::vector<size_t>* eytzinger) {
+    if (k <= sorted.size()) {
+        i = fillEytzinger(sorted, i, 2 * k, eytzinger);
+        (*eytzinger)[k - 1] = sorted[i++];
+        i = fillEytzinger(sorted, i, (2 * k) + 1, eytzinger);
+    }
+    return i;
+}
+
+}  // namespace
+
+namespace Confab {
+
+/*! Owns a read-only memory mapping of a catalog file, unmapping it on destruction.
+ */
+class Catalog::Mapping {
+public:
+    Mapping(const uint8_t* data, size_t size) : m_data(data), m_size(size) { }
+    ~Mapping() { munmap(const_cast<uint8_t*>(m_data), m_size); }
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+/*! Record pointing into a mapped catalog, which keeps the mapping alive for as long as the record exists.
+ */
+class CatalogRecord : public Record {
+public:
+    CatalogRecord(std::shared_ptr<const void> mapping, const uint8_t* data, size_t size) :
+        m_mapping(mapping),
+        m_data(data, size) {
+    }
+
+    ~CatalogRecord() override { }
+
+    bool empty() const override { return false; }
+
+    const SizedPointer data() const override { return m_data; }
+
+    const SizedPointer key() const override { return SizedPointer(); }
+
+private:
+    std::shared_ptr<const void> m_mapping;
+    const SizedPointer m_data;
+};
+
+Catalog::Catalog() :
+    m_keys(nullptr),
+    m_slots(nullptr),
+    m_count(0) {
+}
+
+Catalog::~Catalog() {
+}
+
+bool Catalog::open(const fs::path& path, bool verifyChecksum) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(INFO) << "no catalog file at " << path;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(CatalogHeader)) {
+        LOG(ERROR) << "catalog file " << path << " too small for header.";
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "failed to map catalog file " << path;
+        return false;
+    }
+    auto mapping = std::make_shared<Mapping>(static_cast<const uint8_t*>(mapped), fileSize);
+
+    const CatalogHeader* header = reinterpret_cast<const CatalogHeader*>(mapping->data());
+    if (std::memcmp(header->magic, kCatalogMagic, sizeof(kCatalogMagic)) != 0 || header->version != kCatalogVersion) {
+        LOG(ERROR) << "catalog file " << path << " has unrecognized magic or version.";
+        return false;
+    }
+    // Each Asset takes a key and a two-word slot ahead of the blobs, which bounds the count before it is multiplied.
+    if (header->count > (fileSize - sizeof(CatalogHeader)) / (3 * sizeof(uint64_t))) {
+        LOG(ERROR) << "catalog file " << path << " header count " << header->count << " too large for file.";
+        return false;
+    }
+    size_t count = header->count;
+    if (header->fileSize != fileSize || header->keysOffset != sizeof(CatalogHeader) ||
+        header->slotsOffset != header->keysOffset + (count * sizeof(uint64_t)) ||
+        header->blobsOffset != header->slotsOffset + (count * 2 * sizeof(uint64_t)) ||
+        header->blobsOffset > fileSize) {
+        LOG(ERROR) << "catalog file " << path << " header does not match file layout.";
+        return false;
+    }
+
+    if (verifyChecksum) {
+        uint64_t checksum = XXH64(mapping->data() + sizeof(CatalogHeader), fileSize - sizeof(CatalogHeader), 0);
+        if (checksum != header->checksum) {
+            LOG(ERROR) << "catalog file " << path << " failed checksum verification.";
+            return false;
+        }
+    }
+
+    // Bounds-check every record up front, so that find() can trust the slots.
+    const uint64_t* slots = reinterpret_cast<const uint64_t*>(mapping->data() + header->slotsOffset);
+    for (size_t i = 0; i < count; ++i) {
+        // Compared without adding offset and size, which a corrupt record could overflow.
+        if (slots[2 * i] < header->blobsOffset || slots[2 * i] > fileSize ||
+            slots[(2 * i) + 1] > fileSize - slots[2 * i]) {
+            LOG(ERROR) << "catalog file " << path << " record " << i << " out of bounds.";
+            return false;
+        }
+    }
+
+    // The catalog is searched at random, so readahead beyond the pages touched would be wasted.
+    madvise(mapped, fileSize, MADV_RANDOM);
+
+    m_mapping = mapping;
+    m_keys = reinterpret_cast<const uint64_t*>(mapping->data() + header->keysOffset);
+    m_slots = slots;
+    m_count = count;
+    LOG(INFO) << "opened catalog " << path << " with " << m_count << " Assets.";
+    return true;
+}
+
+void Catalog::close() {
+    m_mapping.reset();
+    m_keys = nullptr;
+    m_slots = nullptr;
+    m_count = 0;
+}
+
+RecordPtr Catalog::find(uint64_t key) const {
+    // Descend the implicit tree, going right when the node is smaller than key. At the bottom, the 1-based index of
+    // the smallest key not less than the search key is recovered by discarding the trailing right turns, plus one.
+    size_t k = 1;
+    while (k <= m_count) {
+        // Eight keys fit in a cache line, so the descendants four levels down share a line and can be fetched early.
+        __builtin_prefetch(m_keys + (16 * k));
+        k = (2 * k) + (m_keys[k - 1] < key ? 1 : 0);
+    }
+    k >>= __builtin_ffsll(~static_cast<long long>(k));
+    if (k == 0 || m_keys[k - 1] != key) {
+        return makeEmptyRecord();
+    }
+    const uint64_t* slot = m_slots + (2 * (k - 1));
+    return RecordPtr(new CatalogRecord(m_mapping, m_mapping->data() + slot[0], slot[1]));
+}
+
+size_t Catalog::size() const {
+    return m_count;
+}
+
+uint64_t Catalog::checksum() const {
+    if (!m_mapping) {
+        return 0;
+    }
+    return reinterpret_cast<const CatalogHeader*>(m_mapping->data())->checksum;
+}
+
+SizedPointer Catalog::bytes() const {
+    if (!m_mapping) {
+        return SizedPointer();
+    }
+    return SizedPointer(m_mapping->data(), m_mapping->size());
+}
+
+void CatalogBuilder::add(uint64_t key, const SizedPointer& flatAsset) {
+    m_keys.push_back(key);
+    m_records.emplace_back(m_blobs.size(), flatAsset.size());
+    m_blobs.append(flatAsset.dataChar(), flatAsset.size());
+    m_blobs.resize(alignUp(m_blobs.size()), '\0');
+}
+
+bool CatalogBuilder::write(const fs::path& path) {
+    // Sort by key, keeping only the most recently added record for any duplicated key.
+    std::vector<size_t> order(m_keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return m_keys[a] < m_keys[b]; });
+    std::vector<size_t> sorted;
+    sorted.reserve(order.size());
+    for (auto index : order) {
+        if (sorted.size() && m_keys[sorted.back()] == m_keys[index]) {
+            sorted.back() = index;
+        } else {
+            sorted.push_back(index);
+        }
+    }
+
+    std::vector<size_t> eytzinger(sorted.size());
+    fillEytzinger(sorted, 0, 1, &eytzinger);
+
+    CatalogHeader header;
+    std::memcpy(header.magic, kCatalogMagic, sizeof(kCatalogMagic));
+    header.version = kCatalogVersion;
+    header.reserved = 0;
+    header.count = eytzinger.size();
+    header.keysOffset = sizeof(CatalogHeader);
+    header.slotsOffset = header.keysOffset + (header.count * sizeof(uint64_t));
+    header.blobsOffset = header.slotsOffset + (header.count * 2 * sizeof(uint64_t));
+    header.fileSize = header.blobsOffset + m_blobs.size();
+
+    std::string body;
+    body.reserve(header.fileSize - sizeof(CatalogHeader));
+    for (auto index : eytzinger) {
+        body.append(reinterpret_cast<const char*>(&m_keys[index]), sizeof(uint64_t));
+    }
+    for (auto index : eytzinger) {
+        uint64_t slot[2] = { header.blobsOffset + m_records[index].first, m_records[index].second };
+        body.append(reinterpret_cast<const char*>(slot), sizeof(slot));
+    }
+    body.append(m_blobs);
+    header.checksum = XXH64(body.data(), body.size(), 0);
+
+    fs::path writePath = path;
+    writePath += ".tmp";
+    {
+        std::ofstream outFile(writePath, std::ios::binary | std::ios::trunc);
+        if (!outFile) {
+            LOG(ERROR) << "failed to open catalog file " << writePath << " for writing.";
+            return false;
+        }
+        outFile.write(reinterpret_cast<const char*>(&header), sizeof(CatalogHeader));
+        outFile.write(body.data(), body.size());
+        if (!outFile) {
+            LOG(ERROR) << "error writing catalog file " << writePath;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(writePath, path, error);
+    if (error) {
+        LOG(ERROR) << "failed to rename catalog file " << writePath << " to " << path << ": " << error.message();
+        return false;
+    }
+    LOG(INFO) << "wrote catalog " << path << " with " << header.count << " Assets, " << header.fileSize << " bytes.";
+    return true;
+}
+
+}  // namespace Confab
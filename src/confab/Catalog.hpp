@@ -0,0 +1,122 @@
+#ifndef SRC_CONFAB_CATALOG_HPP_
+#define SRC_CONFAB_CATALOG_HPP_
+
+#include "Record.hpp"
+#include "SizedPointer.hpp"
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+namespace Confab {
+
+/*! Read-only, memory-mapped snapshot of FlatAsset records, for answering Asset metadata lookups without a database.
+ *
+ * A catalog file is a fixed header, followed by a fixed-width array of Asset keys in Eytzinger (breadth-first binary
+ * tree) order, a parallel array of offsets and sizes, then the serialized FlatAsset records themselves, each aligned
+ * to 8 bytes. Opening a catalog only maps the file and validates the header, so lookups are available immediately and
+ * the pages holding records are faulted in by the kernel on first access. The Eytzinger order keeps the top levels of
+ * the search tree packed together in cache, and lets the next levels be prefetched during the search.
+ *
+ * Catalogs are immutable once written. Build a new one with CatalogBuilder and replace the file to update it.
+ */
+class Catalog {
+public:
+    /*! Constructs an empty Catalog. Call open() to map a catalog file.
+     */
+    Catalog();
+
+    /*! Destructs a Catalog. Records returned by find() remain valid after the Catalog is destroyed.
+     */
+    ~Catalog();
+
+    /*! Maps a catalog file into memory.
+     *
+     * \param path The path of the catalog file to open.
+     * \param verifyChecksum If true, reads the entire file to verify its checksum before returning. Use for catalog
+     *                       files from untrusted sources, such as a fresh download.
+     * \return true on success, false if the file is missing or malformed.
+     */
+    bool open(const fs::path& path, bool verifyChecksum);
+
+    /*! Unmaps the catalog file, if open.
+     */
+    void close();
+
+    /*! Looks up the FlatAsset record stored under key. Unlike AssetDatabase::findAsset(), does not follow deprecation.
+     *
+     * \param key The Asset key to look up.
+     * \return A non-owning pointer to the FlatAsset record, or an empty Record if not found.
+     */
+    RecordPtr find(uint64_t key) const;
+
+    /*! The number of Assets in the catalog.
+     *
+     * \return The count of records, or 0 if not open.
+     */
+    size_t size() const;
+
+    /*! The checksum recorded in the catalog header, which identifies the catalog contents.
+     *
+     * \return The XXH64 hash of the catalog file contents after the header, or 0 if not open.
+     */
+    uint64_t checksum() const;
+
+    /*! The entire mapped catalog file, for serving to downstream clients.
+     *
+     * \return A pointer to the mapped bytes, or an empty pointer if not open.
+     */
+    SizedPointer bytes() const;
+
+    /// @cond UNDOCUMENTED
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    class Mapping;
+
+    std::shared_ptr<Mapping> m_mapping;
+    const uint64_t* m_keys;
+    const uint64_t* m_slots;
+    size_t m_count;
+};
+
+/*! Accumulates FlatAsset records and writes them out as a Catalog file.
+ */
+class CatalogBuilder {
+public:
+    /*! Adds a record to the catalog being built. The record is copied.
+     *
+     * \param key The Asset key.
+     * \param flatAsset The serialized FlatAsset record.
+     */
+    void add(uint64_t key, const SizedPointer& flatAsset);
+
+    /*! The number of records added so far.
+     *
+     * \return The count of records.
+     */
+    size_t size() const { return m_keys.size(); }
+
+    /*! Writes the catalog to a temporary file beside path, then renames it over path, so that readers never observe
+     * a partially written catalog.
+     *
+     * \param path The destination path of the catalog file.
+     * \return true on success, false on error.
+     */
+    bool write(const fs::path& path);
+
+private:
+    std::vector<uint64_t> m_keys;
+    std::vector<std::pair<size_t, size_t>> m_records;
+    std::string m_blobs;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CATALOG_HPP_
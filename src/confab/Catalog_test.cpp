@@ -0,0 +1,126 @@
+#include "Catalog.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+fs::path makeCatalogPath() {
+    return fs::temp_directory_path() / ("confab-catalog-test-" + std::to_string(getpid()));
+}
+
+std::string recordString(Confab::RecordPtr record) {
+    return std::string(record->data().dataChar(), record->data().size());
+}
+
+}  // namespace
+
+TEST(CatalogTest, EmptyCatalog) {
+    fs::path path = makeCatalogPath();
+    Confab::CatalogBuilder builder;
+    ASSERT_TRUE(builder.write(path));
+
+    Confab::Catalog catalog;
+    ASSERT_TRUE(catalog.open(path, true));
+    EXPECT_EQ(0, catalog.size());
+    EXPECT_TRUE(catalog.find(0)->empty());
+    EXPECT_TRUE(catalog.find(42)->empty());
+    fs::remove(path);
+}
+
+TEST(CatalogTest, FindsEveryKey) {
+    fs::path path = makeCatalogPath();
+    Confab::CatalogBuilder builder;
+    // An odd count that is not one less than a power of two exercises an incomplete bottom level of the tree.
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        std::string value = "asset-" + std::to_string(i * 7919);
+        builder.add(i * 7919, Confab::SizedPointer(value.data(), value.size()));
+    }
+    ASSERT_TRUE(builder.write(path));
+
+    Confab::Catalog catalog;
+    ASSERT_TRUE(catalog.open(path, true));
+    EXPECT_EQ(1000, catalog.size());
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        auto record = catalog.find(i * 7919);
+        ASSERT_FALSE(record->empty());
+        EXPECT_EQ("asset-" + std::to_string(i * 7919), recordString(record));
+        EXPECT_EQ(0, reinterpret_cast<uintptr_t>(record->data().data()) % 8);
+        EXPECT_TRUE(catalog.find((i * 7919) + 1)->empty());
+    }
+    EXPECT_TRUE(catalog.find(0)->empty());
+    EXPECT_TRUE(catalog.find(UINT64_MAX)->empty());
+    fs::remove(path);
+}
+
+TEST(CatalogTest, LaterDuplicateWins) {
+    fs::path path = makeCatalogPath();
+    Confab::CatalogBuilder builder;
+    builder.add(5, Confab::SizedPointer("old", 3));
+    builder.add(3, Confab::SizedPointer("three", 5));
+    builder.add(5, Confab::SizedPointer("new", 3));
+    ASSERT_TRUE(builder.write(path));
+
+    Confab::Catalog catalog;
+    ASSERT_TRUE(catalog.open(path, true));
+    EXPECT_EQ(2, catalog.size());
+    EXPECT_EQ("new", recordString(catalog.find(5)));
+    EXPECT_EQ("three", recordString(catalog.find(3)));
+    fs::remove(path);
+}
+
+TEST(CatalogTest, RecordOutlivesCatalog) {
+    fs::path path = makeCatalogPath();
+    Confab::CatalogBuilder builder;
+    builder.add(1, Confab::SizedPointer("one", 3));
+    ASSERT_TRUE(builder.write(path));
+
+    Confab::RecordPtr record;
+    {
+        Confab::Catalog catalog;
+        ASSERT_TRUE(catalog.open(path, false));
+        record = catalog.find(1);
+    }
+    fs::remove(path);
+    EXPECT_EQ("one", recordString(record));
+}
+
+TEST(CatalogTest, RejectsCorruptFile) {
+    fs::path path = makeCatalogPath();
+    Confab::CatalogBuilder builder;
+    builder.add(1, Confab::SizedPointer("one", 3));
+    ASSERT_TRUE(builder.write(path));
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-1, std::ios::end);
+        file.put('x');
+    }
+
+    Confab::Catalog catalog;
+    EXPECT_FALSE(catalog.open(path, true));
+    EXPECT_EQ(0, catalog.size());
+    fs::remove(path);
+}
+
+TEST(CatalogTest, RejectsOverflowingCount) {
+    fs::path path = makeCatalogPath();
+    Confab::CatalogBuilder builder;
+    builder.add(1, Confab::SizedPointer("one", 3));
+    ASSERT_TRUE(builder.write(path));
+    {
+        // Multiplied by the key and slot sizes this count wraps around to the offsets of a single record.
+        uint64_t count = (1ULL << 61) + 1;
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(16);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+
+    Confab::Catalog catalog;
+    EXPECT_FALSE(catalog.open(path, false));
+    EXPECT_EQ(0, catalog.size());
+    fs::remove(path);
+}
@@ -0,0 +1,114 @@
+#include "ChangeFeedFollower.hpp"
+
+#include "AssetDatabase.hpp"
+#include "HttpClient.hpp"
+#include "SizedPointer.hpp"
+
+#include "glog/logging.h"
+
+#include <utility>
+#include <vector>
+
+namespace Confab {
+
+ChangeFeedFollower::ChangeFeedFollower(std::shared_ptr<AssetDatabase> assetDatabase,
+    const std::string& primaryAddress) :
+    m_assetDatabase(assetDatabase),
+    m_httpClient(new HttpClient(primaryAddress, HttpClient::kDefaultConnections)),
+    m_quit(false) {
+}
+
+ChangeFeedFollower::~ChangeFeedFollower() {
+    stop();
+    m_httpClient->shutdown();
+}
+
+void ChangeFeedFollower::start(std::chrono::milliseconds pollInterval) {
+    stop();
+    m_quit = false;
+    {
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        m_status.running = true;
+        m_status.appliedSequence = m_assetDatabase->changeFeedSequence();
+    }
+    m_thread = std::thread(&ChangeFeedFollower::followLoop, this, pollInterval);
+}
+
+void ChangeFeedFollower::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        m_quit = true;
+    }
+    m_quitCondition.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    m_status.running = false;
+}
+
+ChangeFeedFollower::Status ChangeFeedFollower::status() {
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    return m_status;
+}
+
+void ChangeFeedFollower::followLoop(std::chrono::milliseconds pollInterval) {
+    LOG(INFO) << "following change feed from sequence " << m_assetDatabase->changeFeedSequence() + 1;
+    while (true) {
+        // Keep going without a pause while there are records to apply, so a standby that fell behind catches up.
+        if (!followOnce() && !waitFor(pollInterval)) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        if (m_quit) {
+            break;
+        }
+    }
+    LOG(INFO) << "stopped following change feed at sequence " << m_assetDatabase->changeFeedSequence();
+}
+
+bool ChangeFeedFollower::followOnce() {
+    uint64_t nextSequence = m_assetDatabase->changeFeedSequence() + 1;
+    uint64_t oldestSequence = 0;
+    uint64_t latestSequence = 0;
+    std::vector<std::pair<uint64_t, size_t>> entries;
+    if (!m_httpClient->getChangeFeed(nextSequence, &oldestSequence, &latestSequence, &entries)) {
+        return false;
+    }
+
+    bool needsReseed = latestSequence >= nextSequence && (entries.empty() || entries.front().first != nextSequence);
+    {
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        m_status.primarySequence = latestSequence;
+        if (needsReseed && !m_status.needsReseed) {
+            LOG(ERROR) << "primary change feed starts at sequence " << oldestSequence << " but standby needs "
+                << nextSequence << ", standby must be seeded from a copy of the primary database.";
+        }
+        m_status.needsReseed = needsReseed;
+    }
+    if (needsReseed) {
+        return false;
+    }
+
+    size_t applied = 0;
+    for (const auto& entry : entries) {
+        std::string record;
+        if (!m_httpClient->getChangeFeedRecord(entry.first, entry.second, &record)) {
+            break;
+        }
+        if (!m_assetDatabase->applyChangeFeedRecord(entry.first, SizedPointer(record.data(), record.size()))) {
+            break;
+        }
+        ++applied;
+        std::lock_guard<std::mutex> lock(m_statusMutex);
+        m_status.appliedSequence = entry.first;
+    }
+    return applied > 0;
+}
+
+bool ChangeFeedFollower::waitFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(m_quitMutex);
+    return !m_quitCondition.wait_for(lock, duration, [this] { return m_quit; });
+}
+
+}  // namespace Confab
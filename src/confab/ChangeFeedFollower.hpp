@@ -0,0 +1,103 @@
+#ifndef SRC_CONFAB_CHANGE_FEED_FOLLOWER_HPP_
+#define SRC_CONFAB_CHANGE_FEED_FOLLOWER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Confab {
+
+class AssetDatabase;
+class HttpClient;
+
+/*! Background thread keeping a standby AssetDatabase up to date with a primary confab server, by tailing the primary's
+ * change feed over HTTP and applying each record in sequence order.
+ *
+ * The standby resumes from its own change feed sequence number after a restart. If the primary has already trimmed
+ * the records the standby needs, the follower stops making progress and logs an error, and the standby must be seeded
+ * again from a copy of the primary's database directory.
+ */
+class ChangeFeedFollower {
+public:
+    /*! Summary of replication progress.
+     */
+    struct Status {
+        /*! True if the following thread is running.
+         */
+        bool running = false;
+
+        /*! The sequence number of the last record applied to the standby database.
+         */
+        uint64_t appliedSequence = 0;
+
+        /*! The latest sequence number reported by the primary.
+         */
+        uint64_t primarySequence = 0;
+
+        /*! True if the primary no longer has the next record the standby needs.
+         */
+        bool needsReseed = false;
+    };
+
+    /*! Constructs a ChangeFeedFollower.
+     *
+     * \param assetDatabase The opened standby database, which must have a nonzero change feed retention.
+     * \param primaryAddress The address of the primary server, such as "http://sclork-s01.local:9080".
+     */
+    ChangeFeedFollower(std::shared_ptr<AssetDatabase> assetDatabase, const std::string& primaryAddress);
+
+    /*! Destructs a ChangeFeedFollower, stopping the thread if running.
+     */
+    ~ChangeFeedFollower();
+
+    /*! Starts the following thread.
+     *
+     * \param pollInterval Time to wait before polling the primary again, once the standby has caught up.
+     */
+    void start(std::chrono::milliseconds pollInterval);
+
+    /*! Stops the following thread. Blocks until any record being downloaded is applied or abandoned.
+     */
+    void stop();
+
+    /*! Returns a copy of the current replication status.
+     *
+     * \return The replication status.
+     */
+    Status status();
+
+    /// @cond UNDOCUMENTED
+    ChangeFeedFollower(const ChangeFeedFollower&) = delete;
+    ChangeFeedFollower& operator=(const ChangeFeedFollower&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    void followLoop(std::chrono::milliseconds pollInterval);
+
+    /*! Fetches and applies the next batch of records from the primary. Returns true if any records were applied.
+     */
+    bool followOnce();
+
+    /*! Waits for the provided duration, returning false early if stop() was called.
+     */
+    bool waitFor(std::chrono::milliseconds duration);
+
+    std::shared_ptr<AssetDatabase> m_assetDatabase;
+    std::unique_ptr<HttpClient> m_httpClient;
+
+    std::thread m_thread;
+    std::mutex m_quitMutex;
+    std::condition_variable m_quitCondition;
+    bool m_quit;
+
+    std::mutex m_statusMutex;
+    Status m_status;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CHANGE_FEED_FOLLOWER_HPP_
@@ -7,6 +7,8 @@
 
 #include "glog/logging.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <memory>
 #include <pthread.h>
@@ -22,6 +24,21 @@ DEFINE_string(data_directory, "../data/confab", "Path where confab will store th
 DEFINE_bool(create_new_database, false, "If true confab will make a new database, if false confab will expect the "
     "database to already exist.");
 DEFINE_int32(database_cache_size_mb, 4, "Size in megabytes of the memory cache the database should use.");
+DEFINE_string(storage_engine, "leveldb", "Storage engine for the database, either leveldb, or memory to keep all data "
+    "in memory and discard it on exit, for testing and benchmarking without disk I/O.");
+DEFINE_int32(gc_interval_minutes, 0, "Minutes between database garbage collection passes, or 0 to disable garbage "
+    "collection.");
+DEFINE_int32(gc_retention_depth, 0, "Number of deprecated versions of an Asset to keep during garbage collection, "
+    "older versions are deleted. If 0 all versions are kept.");
+DEFINE_int32(gc_batch_kb, 64, "Size in kilobytes of each batch of deletions written during garbage collection.");
+DEFINE_int32(gc_pause_ms, 50, "Pause in milliseconds between garbage collection deletion batches.");
+DEFINE_int32(list_cursor_ttl_seconds, 60, "Seconds a list cursor may go unread before it is closed automatically.");
+DEFINE_int32(change_feed_retention, 0, "Number of recent database writes to keep in the change feed for standby "
+    "servers to replicate, or 0 to disable the change feed. Set on a primary serving standbys, such as 65536, and "
+    "required on a standby.");
+DEFINE_string(replicate_from, "", "Address of a primary confab-asset-server, such as http://sclork-s01.local:9080. "
+    "If set this server runs as a hot standby, replicating the primary's database and refusing uploads.");
+DEFINE_int32(replication_poll_ms, 500, "Milliseconds between polls of the primary's change feed once caught up.");
 
 const char* kConfigKey = "confab-db-config";
 
@@ -108,10 +125,32 @@ bool ConfabCommon::openDatabase() {
     m_assetDatabase.reset(new Confab::AssetDatabase);
 
     if (!m_assetDatabase->open((FLAGS_data_directory + "/db").c_str(), FLAGS_create_new_database,
-        FLAGS_database_cache_size_mb * 1024 * 1024)) {
+        FLAGS_database_cache_size_mb * 1024 * 1024, FLAGS_storage_engine)) {
         return false;
     }
 
+    m_assetDatabase->setListCursorTimeout(std::chrono::seconds(std::max(FLAGS_list_cursor_ttl_seconds, 1)));
+    // A standby keeps each record it applies under the primary's sequence number, which needs the change feed on.
+    if (!FLAGS_replicate_from.empty() && FLAGS_change_feed_retention <= 0) {
+        LOG(ERROR) << "--change_feed_retention must be nonzero on a standby of " << FLAGS_replicate_from;
+        return false;
+    }
+    m_assetDatabase->setChangeFeedRetention(std::max(FLAGS_change_feed_retention, 0));
+
+    // A standby receives the deletions made by the primary's garbage collector through the change feed. Collecting
+    // locally would write out of sequence with the primary.
+    if (!FLAGS_replicate_from.empty()) {
+        if (FLAGS_gc_interval_minutes > 0) {
+            LOG(INFO) << "garbage collection disabled on standby of " << FLAGS_replicate_from;
+        }
+    } else if (FLAGS_gc_interval_minutes > 0) {
+        Confab::AssetDatabase::GarbageCollectionOptions gcOptions;
+        gcOptions.retentionDepth = std::max(FLAGS_gc_retention_depth, 0);
+        gcOptions.maxBatchBytes = std::max(FLAGS_gc_batch_kb, 1) * 1024;
+        gcOptions.batchPause = std::chrono::milliseconds(std::max(FLAGS_gc_pause_ms, 0));
+        m_assetDatabase->startGarbageCollector(std::chrono::minutes(FLAGS_gc_interval_minutes), gcOptions);
+    }
+
     /*
     // If a new database we write the configuration information for the first time. If an existing database we validate
     // that the version written is equal to or older than our current version.
@@ -7,6 +7,8 @@
 #include <memory>
 
 DECLARE_string(data_directory);
+DECLARE_string(replicate_from);
+DECLARE_int32(replication_poll_ms);
 
 namespace Confab {
 
@@ -0,0 +1,86 @@
+#include "ContentChunker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+/*! A chunk boundary is placed where all of these bits of the rolling hash are zero, which happens once every 1024
+ * bytes on average. The top bits are used because they depend on all of the last 64 bytes.
+ */
+static constexpr uint64_t kBoundaryMask = 0xffc0000000000000ull;
+
+/*! Builds the table of random values the gear hash adds for each byte value. The values only need to be well mixed,
+ * but must never change, or previously stored chunks will no longer match newly chunked data.
+ */
+std::array<uint64_t, 256> makeGearTable() {
+    std::array<uint64_t, 256> table;
+    // SplitMix64, from a fixed seed.
+    uint64_t state = 0x636f6e666162ull;
+    for (auto& entry : table) {
+        state += 0x9e3779b97f4a7c15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        entry = z ^ (z >> 31);
+    }
+    return table;
+}
+
+}  // namespace
+
+namespace Confab {
+
+constexpr size_t ContentChunker::kMinChunkSize;
+constexpr size_t ContentChunker::kMaxChunkSize;
+constexpr size_t ContentChunker::kManifestEntrySize;
+constexpr size_t ContentChunker::kManifestEntriesPerPage;
+constexpr size_t ContentChunker::kMaxHashesPerQuery;
+
+// static
+size_t ContentChunker::nextChunkSize(const uint8_t* data, size_t size) {
+    static const std::array<uint64_t, 256> gearTable = makeGearTable();
+    if (size <= kMinChunkSize) {
+        return size;
+    }
+
+    size_t limit = std::min(size, kMaxChunkSize);
+    uint64_t hash = 0;
+    // Bytes before the minimum size can't end a chunk, but the last 64 of them still fill the hash window.
+    size_t offset = kMinChunkSize - 64;
+    for (; offset < kMinChunkSize; ++offset) {
+        hash = (hash << 1) + gearTable[data[offset]];
+    }
+    for (; offset < limit; ++offset) {
+        hash = (hash << 1) + gearTable[data[offset]];
+        if ((hash & kBoundaryMask) == 0) {
+            return offset + 1;
+        }
+    }
+    return limit;
+}
+
+// static
+void ContentChunker::appendManifestEntry(const ManifestEntry& entry, std::vector<uint8_t>* page) {
+    size_t offset = page->size();
+    page->resize(offset + kManifestEntrySize);
+    std::memcpy(page->data() + offset, &entry.hash, sizeof(uint64_t));
+    std::memcpy(page->data() + offset + sizeof(uint64_t), &entry.size, sizeof(uint32_t));
+}
+
+// static
+bool ContentChunker::parseManifestPage(const uint8_t* data, size_t size, std::vector<ManifestEntry>* entries) {
+    if (size % kManifestEntrySize != 0) {
+        return false;
+    }
+    for (size_t offset = 0; offset < size; offset += kManifestEntrySize) {
+        ManifestEntry entry;
+        std::memcpy(&entry.hash, data + offset, sizeof(uint64_t));
+        std::memcpy(&entry.size, data + offset + sizeof(uint64_t), sizeof(uint32_t));
+        entries->push_back(entry);
+    }
+    return true;
+}
+
+}  // namespace Confab
@@ -0,0 +1,87 @@
+#ifndef SRC_CONFAB_CONTENT_CHUNKER_HPP_
+#define SRC_CONFAB_CONTENT_CHUNKER_HPP_
+
+#include "Constants.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Confab {
+
+/*! Splits Asset data into chunks at boundaries chosen by the content itself, so that chunks can be shared between
+ * Assets with data in common.
+ *
+ * Boundaries are found with a gear rolling hash over a window of the last 64 bytes, cutting where the top bits of the
+ * hash are all zero. Because a boundary depends only on nearby bytes, an insertion or deletion in one part of a file
+ * changes only the chunks around it, and the rest of the file splits into the same chunks as before. Chunks are at
+ * least kMinChunkSize bytes, averaging about twice that, and never more than kMaxChunkSize so that every chunk fits in
+ * a single FlatAssetData record.
+ *
+ * Content-chunked Assets store their data chunks under the XXH64 hash of the chunk contents, and their list of chunks
+ * in manifest pages. Each manifest page lists up to kManifestEntriesPerPage chunks as a packed array of 8-byte hash
+ * and 4-byte size pairs, both little-endian.
+ */
+class ContentChunker {
+public:
+    /*! One entry of a content-chunked Asset manifest.
+     */
+    struct ManifestEntry {
+        /*! The XXH64 hash of the chunk contents, which is the key the chunk is stored under.
+         */
+        uint64_t hash;
+
+        /*! The size of the chunk contents in bytes.
+         */
+        uint32_t size;
+    };
+
+    /*! Smallest chunk produced, except for the final chunk of the data.
+     */
+    static constexpr size_t kMinChunkSize = 1024;
+
+    /*! Largest chunk produced.
+     */
+    static constexpr size_t kMaxChunkSize = kDataChunkSize;
+
+    /*! Size in bytes of a serialized ManifestEntry.
+     */
+    static constexpr size_t kManifestEntrySize = sizeof(uint64_t) + sizeof(uint32_t);
+
+    /*! Maximum number of entries in a single manifest page.
+     */
+    static constexpr size_t kManifestEntriesPerPage = kDataChunkSize / kManifestEntrySize;
+
+    /*! Maximum number of hashes in a single query for missing content chunks. Hashes are sent as lines of 16 hex
+     * digits, so that both the query and the reply fit within a single page.
+     */
+    static constexpr size_t kMaxHashesPerQuery = 200;
+
+    /*! Finds the end of the chunk starting at the beginning of data.
+     *
+     * \param data The data remaining to chunk.
+     * \param size The number of bytes remaining.
+     * \return The size of the next chunk, which is size if the remaining data is a single chunk.
+     */
+    static size_t nextChunkSize(const uint8_t* data, size_t size);
+
+    /*! Appends a serialized entry to a manifest page.
+     *
+     * \param entry The entry to append.
+     * \param page The page to append to.
+     */
+    static void appendManifestEntry(const ManifestEntry& entry, std::vector<uint8_t>* page);
+
+    /*! Parses a manifest page.
+     *
+     * \param data The page contents.
+     * \param size The size of the page in bytes.
+     * \param entries A vector to append the entries of the page to.
+     * \return false if the page size is not a whole number of entries, true otherwise.
+     */
+    static bool parseManifestPage(const uint8_t* data, size_t size, std::vector<ManifestEntry>* entries);
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_CONTENT_CHUNKER_HPP_
@@ -0,0 +1,96 @@
+#include "ContentChunker.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> randomBytes(size_t size, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    return bytes;
+}
+
+/*! Splits data into chunks, returning the offset of each chunk boundary.
+ */
+std::vector<size_t> chunkOffsets(const std::vector<uint8_t>& data) {
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    while (offset < data.size()) {
+        offset += Confab::ContentChunker::nextChunkSize(data.data() + offset, data.size() - offset);
+        offsets.push_back(offset);
+    }
+    return offsets;
+}
+
+}  // namespace
+
+TEST(ContentChunkerTest, ChunkSizesWithinBounds) {
+    auto data = randomBytes(1024 * 1024, 1);
+    auto offsets = chunkOffsets(data);
+    ASSERT_FALSE(offsets.empty());
+    EXPECT_EQ(data.size(), offsets.back());
+    size_t previous = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        size_t chunkSize = offsets[i] - previous;
+        EXPECT_LE(chunkSize, Confab::ContentChunker::kMaxChunkSize);
+        if (i + 1 < offsets.size()) {
+            EXPECT_GE(chunkSize, Confab::ContentChunker::kMinChunkSize);
+        }
+        previous = offsets[i];
+    }
+    // Boundaries should mostly be found by content rather than forced at the maximum size.
+    size_t averageSize = data.size() / offsets.size();
+    EXPECT_GT(averageSize, Confab::ContentChunker::kMinChunkSize);
+    EXPECT_LT(averageSize, Confab::ContentChunker::kMaxChunkSize);
+
+    // Data smaller than the minimum chunk size is a single chunk.
+    EXPECT_EQ(100, Confab::ContentChunker::nextChunkSize(data.data(), 100));
+}
+
+TEST(ContentChunkerTest, InsertionOnlyChangesNearbyChunks) {
+    auto data = randomBytes(512 * 1024, 2);
+    auto original = chunkOffsets(data);
+
+    // Insert a few bytes near the middle, then compare boundaries after the insertion point, shifted back.
+    std::vector<uint8_t> edited(data);
+    size_t insertAt = data.size() / 2;
+    std::vector<uint8_t> insertion = { 1, 2, 3, 4, 5, 6, 7 };
+    edited.insert(edited.begin() + insertAt, insertion.begin(), insertion.end());
+    auto changed = chunkOffsets(edited);
+
+    std::set<size_t> originalSet(original.begin(), original.end());
+    size_t shared = 0;
+    for (size_t offset : changed) {
+        if (offset < insertAt) {
+            shared += originalSet.count(offset);
+        } else if (offset >= insertAt + insertion.size()) {
+            shared += originalSet.count(offset - insertion.size());
+        }
+    }
+    // All but a couple of chunks around the insertion should be unchanged.
+    EXPECT_GE(shared + 3, original.size());
+}
+
+TEST(ContentChunkerTest, ManifestRoundTrip) {
+    std::vector<uint8_t> page;
+    Confab::ContentChunker::appendManifestEntry({ 0x0123456789abcdefull, 2877 }, &page);
+    Confab::ContentChunker::appendManifestEntry({ 42, 1024 }, &page);
+    EXPECT_EQ(2 * Confab::ContentChunker::kManifestEntrySize, page.size());
+
+    std::vector<Confab::ContentChunker::ManifestEntry> entries;
+    ASSERT_TRUE(Confab::ContentChunker::parseManifestPage(page.data(), page.size(), &entries));
+    ASSERT_EQ(2, entries.size());
+    EXPECT_EQ(0x0123456789abcdefull, entries[0].hash);
+    EXPECT_EQ(2877, entries[0].size);
+    EXPECT_EQ(42, entries[1].hash);
+    EXPECT_EQ(1024, entries[1].size);
+
+    EXPECT_FALSE(Confab::ContentChunker::parseManifestPage(page.data(), page.size() - 1, &entries));
+}
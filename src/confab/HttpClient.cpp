@@ -1,7 +1,9 @@
 #include "HttpClient.hpp"
 
 #include "Asset.hpp"
+#include "Catalog.hpp"
 #include "Constants.hpp"
+#include "ContentChunker.hpp"
 #include "Record.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
@@ -14,11 +16,20 @@
 #include "pistache/client.h"
 #include "xxhash.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <deque>
 #include <experimental/filesystem>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <fstream>
 #include <limits>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_set>
 
 namespace fs = std::experimental::filesystem;
 
@@ -72,13 +83,51 @@ private:
     const SizedPointer m_data;
 };
 
-HttpClient::HttpClient(const std::string& serverAddress) :
+namespace {
+
+/*! Decodes and verifies the response to an AssetData request, then calls back with the record, or an empty Record on
+ * error.
+ */
+template<typename Callback>
+void handleAssetDataResponse(uint64_t key, uint64_t chunk, const std::string& request,
+    Pistache::Http::Response& response, Callback& callback) {
+    if (response.code() == Pistache::Http::Code::Ok) {
+        LOG(INFO) << "received Ok response for AssetData request " << request << ", " << response.body().size()
+            << " bytes ";
+        uint8_t decoded[kPageSize];
+        size_t decodedSize;
+        base64_decode(response.body().c_str(), response.body().size(), reinterpret_cast<char*>(decoded),
+            &decodedSize, 0);
+        RecordPtr flatAssetData(new ClientRecord(decoded, decodedSize));
+        auto verifier = flatbuffers::Verifier(decoded, decodedSize);
+        if (Data::VerifyFlatAssetDataBuffer(verifier)) {
+            callback(key, chunk, flatAssetData);
+        } else {
+            LOG(ERROR) << "failed to verify server-provided data for AssetData request " << request;
+            callback(key, chunk, makeEmptyRecord());
+        }
+    } else {
+        LOG(ERROR) << "error code " << response.code() << " on AssetData request " << request;
+        callback(key, chunk, makeEmptyRecord());
+    }
+}
+
+std::string assetDataRequest(const std::string& serverAddress, uint64_t key, uint64_t chunk) {
+    char numBuf[32];
+    snprintf(numBuf, 32, "%" PRIu64, chunk);
+    return serverAddress + "/asset/data/" + Asset::keyToString(key) + "/" + std::string(numBuf);
+}
+
+}  // namespace
+
+HttpClient::HttpClient(const std::string& serverAddress, size_t connections) :
     m_serverAddress(serverAddress),
     m_client(new Pistache::Http::Client),
-    m_distribution(0, std::numeric_limits<uint64_t>::max()) {
+    m_distribution(0, std::numeric_limits<uint64_t>::max()),
+    m_contentChunking(false) {
     auto opts = Pistache::Http::Client::options()
         .keepAlive(true)
-        .maxConnectionsPerHost(4)
+        .maxConnectionsPerHost(connections)
         .threads(4);
     m_client->init(opts);
 }
@@ -148,40 +197,63 @@ void HttpClient::getNamedAsset(const std::string& name, std::function<void(Recor
     barrier.wait();
 }
 
+void HttpClient::searchAssetNames(const std::string& query, bool fuzzy, size_t maxResults,
+    std::function<void(const std::string&)> callback) {
+    searchNames("asset", query, fuzzy, maxResults, callback);
+}
+
 void HttpClient::getAssetData(uint64_t key, uint64_t chunk,
     std::function<void(uint64_t, uint64_t, RecordPtr)> callback) {
-    char numBuf[32];
-    snprintf(numBuf, 32, "%" PRIu64, chunk);
-    std::string request = m_serverAddress + "/asset/data/" + Asset::keyToString(key) + "/" + std::string(numBuf);
+    std::string request = assetDataRequest(m_serverAddress, key, chunk);
     LOG(INFO) << "issuing AssetData request to " << request;
 
+    LatencyHistogram::Timer timer(&m_chunkLatency);
     auto promise = m_client->get(request).send();
     promise.then([&key, &chunk, &callback, &request](Pistache::Http::Response response) {
-        if (response.code() == Pistache::Http::Code::Ok) {
-            LOG(INFO) << "received Ok response for AssetData request " << request << ", " << response.body().size()
-                << " bytes ";
-            uint8_t decoded[kPageSize];
-            size_t decodedSize;
-            base64_decode(response.body().c_str(), response.body().size(), reinterpret_cast<char*>(decoded),
-                &decodedSize, 0);
-            RecordPtr flatAssetData(new ClientRecord(decoded, decodedSize));
-            auto verifier = flatbuffers::Verifier(decoded, decodedSize);
-            if (Data::VerifyFlatAssetDataBuffer(verifier)) {
-                callback(key, chunk, flatAssetData);
-            } else {
-                LOG(ERROR) << "failed to verify server-provided data for AssetData request " << request;
-                callback(key, chunk, makeEmptyRecord());
-            }
-        } else {
-            LOG(ERROR) << "error code " << response.code() << " on AssetData request " << request;
-            callback(key, chunk, makeEmptyRecord());
-        }
+        handleAssetDataResponse(key, chunk, request, response, callback);
     }, Pistache::Async::NoExcept);
 
     Pistache::Async::Barrier barrier(promise);
     barrier.wait();
 }
 
+void HttpClient::getAssetDataChunks(uint64_t key, const std::vector<uint64_t>& chunks, size_t maxInFlight,
+    std::function<bool(uint64_t, uint64_t, RecordPtr)> callback) {
+    std::atomic<bool> proceed(true);
+    auto handler = [&callback, &proceed](uint64_t chunkKey, uint64_t chunkNumber, RecordPtr record) {
+        if (!callback(chunkKey, chunkNumber, record)) {
+            proceed = false;
+        }
+    };
+
+    // Requests complete roughly in the order issued, so waiting on the oldest keeps about maxInFlight outstanding.
+    std::deque<Pistache::Async::Promise<Pistache::Http::Response>> inFlight;
+    maxInFlight = std::max(maxInFlight, static_cast<size_t>(1));
+    for (size_t i = 0; i < chunks.size() && proceed; ++i) {
+        uint64_t chunk = chunks[i];
+        std::string request = assetDataRequest(m_serverAddress, key, chunk);
+        LOG(INFO) << "issuing AssetData request to " << request;
+        auto issued = std::chrono::steady_clock::now();
+        auto promise = m_client->get(request).send();
+        promise.then([this, key, chunk, request, issued, &handler](Pistache::Http::Response response) {
+            handleAssetDataResponse(key, chunk, request, response, handler);
+            m_chunkLatency.record(std::chrono::steady_clock::now() - issued);
+        }, Pistache::Async::NoExcept);
+        inFlight.push_back(std::move(promise));
+
+        if (inFlight.size() >= maxInFlight) {
+            Pistache::Async::Barrier<Pistache::Http::Response> barrier(inFlight.front());
+            barrier.wait();
+            inFlight.pop_front();
+        }
+    }
+
+    for (auto& promise : inFlight) {
+        Pistache::Async::Barrier<Pistache::Http::Response> barrier(promise);
+        barrier.wait();
+    }
+}
+
 uint64_t HttpClient::postInlineAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
         const std::string& listIds, uint64_t size, const uint8_t* inlineData) {
     if (size > kSingleChunkDataSize) {
@@ -243,6 +315,10 @@ uint64_t HttpClient::postFileAsset(Asset::Type type, const std::string& name, ui
         return 0;
     }
 
+    if (m_contentChunking) {
+        return postContentChunkedFile(type, name, author, deprecates, listIds, assetFile, fileSize);
+    }
+
     // First we must hash the file. This means we will be traversing this file twice, first for a hash and then second
     // for the upload. This could be avoided at the cost of loading the file entirely in to memory, or possibly by
     // designing some incremental upload that specifies the Asset key *last*, but in the interest of simplicity the
@@ -457,17 +533,37 @@ void HttpClient::getNamedList(const std::string& name, std::function<void(Record
     barrier.wait();
 }
 
+void HttpClient::searchListNames(const std::string& query, bool fuzzy, size_t maxResults,
+    std::function<void(const std::string&)> callback) {
+    searchNames("list", query, fuzzy, maxResults, callback);
+}
+
 void HttpClient::getListItems(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback) {
-    std::string request = m_serverAddress + "/list/items/" + Asset::keyToString(key) + "/" + Asset::keyToString(token);
-    LOG(INFO) << "issuing list items request to " << request;
+    getListText(m_serverAddress + "/list/items/" + Asset::keyToString(key) + "/" + Asset::keyToString(token), callback);
+}
+
+void HttpClient::getListItemsBefore(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback) {
+    getListText(m_serverAddress + "/list/prev/" + Asset::keyToString(key) + "/" + Asset::keyToString(token), callback);
+}
+
+void HttpClient::getListItemsAt(uint64_t key, uint64_t offset, std::function<void(const std::string&)> callback) {
+    getListText(m_serverAddress + "/list/at/" + Asset::keyToString(key) + "/" + std::to_string(offset), callback);
+}
+
+void HttpClient::getListSize(uint64_t key, std::function<void(const std::string&)> callback) {
+    getListText(m_serverAddress + "/list/size/" + Asset::keyToString(key), callback);
+}
+
+void HttpClient::getListText(const std::string& request, std::function<void(const std::string&)> callback) {
+    LOG(INFO) << "issuing list request to " << request;
 
     auto promise = m_client->get(request).send();
     promise.then([&callback, &request](Pistache::Http::Response response) {
         if (response.code() == Pistache::Http::Code::Ok) {
-            LOG(INFO) << "received Ok response for list items request " << request;
+            LOG(INFO) << "received Ok response for list request " << request;
             callback(response.body());
         } else {
-            LOG(ERROR) << "error code " << response.code() << " on list items request " << request;
+            LOG(ERROR) << "error code " << response.code() << " on list request " << request;
             callback("");
         }
     }, Pistache::Async::NoExcept);
@@ -517,6 +613,370 @@ uint64_t HttpClient::postList(const std::string& name) {
     return ok ? key : 0;
 }
 
+void HttpClient::getContentChunk(uint64_t hash, std::function<void(uint64_t, RecordPtr)> callback) {
+    std::string request = m_serverAddress + "/chunk/data/" + Asset::keyToString(hash);
+    LOG(INFO) << "issuing content chunk request to " << request;
+
+    LatencyHistogram::Timer timer(&m_chunkLatency);
+    auto promise = m_client->get(request).send();
+    promise.then([&hash, &callback, &request](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            uint8_t decoded[kPageSize];
+            size_t decodedSize;
+            base64_decode(response.body().c_str(), response.body().size(), reinterpret_cast<char*>(decoded),
+                &decodedSize, 0);
+            RecordPtr flatAssetData(new ClientRecord(decoded, decodedSize));
+            auto verifier = flatbuffers::Verifier(decoded, decodedSize);
+            if (Data::VerifyFlatAssetDataBuffer(verifier)) {
+                callback(hash, flatAssetData);
+            } else {
+                LOG(ERROR) << "failed to verify server-provided data for content chunk request " << request;
+                callback(hash, makeEmptyRecord());
+            }
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on content chunk request " << request;
+            callback(hash, makeEmptyRecord());
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+}
+
+uint64_t HttpClient::postContentChunkedFile(Asset::Type type, const std::string& name, uint64_t author,
+        uint64_t deprecates, const std::string& listIds, const fs::path& assetFile, size_t fileSize) {
+    // Chunk boundaries depend on the bytes on either side of them, so map the whole file rather than reading it in
+    // fixed size pieces.
+    int fd = open(assetFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "error opening file: " << assetFile << " for content chunking";
+        return 0;
+    }
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "error mapping file: " << assetFile << " for content chunking";
+        return 0;
+    }
+    const uint8_t* fileData = static_cast<const uint8_t*>(mapped);
+
+    uint64_t key = XXH64(fileData, fileSize, 0);
+    std::string keyString = Asset::keyToString(key);
+    std::vector<ContentChunker::ManifestEntry> entries;
+    // The offset in the file of the first occurrence of each distinct chunk, in file order.
+    std::vector<std::pair<uint64_t, size_t>> distinct;
+    std::unordered_set<uint64_t> seen;
+    for (size_t offset = 0; offset < fileSize;) {
+        size_t chunkSize = ContentChunker::nextChunkSize(fileData + offset, fileSize - offset);
+        ContentChunker::ManifestEntry entry = { XXH64(fileData + offset, chunkSize, 0),
+            static_cast<uint32_t>(chunkSize) };
+        entries.push_back(entry);
+        if (seen.insert(entry.hash).second) {
+            distinct.emplace_back(entry.hash, offset);
+        }
+        offset += chunkSize;
+    }
+    LOG(INFO) << "computed key " << keyString << " for asset file " << assetFile << ", " << entries.size()
+        << " content chunks, " << distinct.size() << " distinct.";
+
+    std::unordered_set<uint64_t> missing;
+    bool ok = true;
+    for (size_t i = 0; ok && i < distinct.size(); i += ContentChunker::kMaxHashesPerQuery) {
+        std::vector<uint64_t> hashes;
+        for (size_t j = i; j < std::min(distinct.size(), i + ContentChunker::kMaxHashesPerQuery); ++j) {
+            hashes.push_back(distinct[j].first);
+        }
+        ok = findMissingContentChunks(hashes, &missing);
+    }
+    LOG(INFO) << "server is missing " << missing.size() << " of " << distinct.size() << " content chunks for "
+        << keyString;
+
+    // The chunks go up first, so that the Asset never refers to chunks the server does not have.
+    flatbuffers::FlatBufferBuilder builder(kPageSize);
+    for (size_t i = 0; ok && i < distinct.size(); ++i) {
+        uint64_t hash = distinct[i].first;
+        if (!missing.count(hash)) {
+            continue;
+        }
+        size_t offset = distinct[i].second;
+        size_t chunkSize = ContentChunker::nextChunkSize(fileData + offset, fileSize - offset);
+        builder.Clear();
+        auto flatData = builder.CreateVector(fileData + offset, chunkSize);
+        Data::FlatAssetDataBuilder assetDataBuilder(builder);
+        assetDataBuilder.add_data(flatData);
+        assetDataBuilder.add_hash(hash);
+        builder.Finish(assetDataBuilder.Finish());
+        ok = postRecord(m_serverAddress + "/chunk/data/" + Asset::keyToString(hash), builder.GetBufferPointer(),
+            builder.GetSize());
+    }
+    munmap(mapped, fileSize);
+
+    size_t manifestPages = (entries.size() + ContentChunker::kManifestEntriesPerPage - 1) /
+        ContentChunker::kManifestEntriesPerPage;
+    if (ok) {
+        Asset asset(type);
+        asset.setKey(key);
+        asset.setName(name);
+        asset.setFileExtension(assetFile.extension());
+        asset.setAuthor(author);
+        asset.setDeprecates(deprecates);
+        asset.setSize(fileSize);
+        asset.setChunks(entries.size());
+        asset.setManifestPages(manifestPages);
+        asset.parseListIds(listIds);
+        builder.Clear();
+        asset.flatten(builder);
+        ok = postRecord(m_serverAddress + "/asset/id/" + keyString, builder.GetBufferPointer(), builder.GetSize());
+    }
+
+    // Manifest pages are stored as the data chunks of the Asset.
+    std::vector<uint8_t> page;
+    for (size_t pageNumber = 0; ok && pageNumber < manifestPages; ++pageNumber) {
+        page.clear();
+        size_t end = std::min(entries.size(), (pageNumber + 1) * ContentChunker::kManifestEntriesPerPage);
+        for (size_t i = pageNumber * ContentChunker::kManifestEntriesPerPage; i < end; ++i) {
+            ContentChunker::appendManifestEntry(entries[i], &page);
+        }
+        builder.Clear();
+        auto flatData = builder.CreateVector(page.data(), page.size());
+        Data::FlatAssetDataBuilder assetDataBuilder(builder);
+        assetDataBuilder.add_data(flatData);
+        assetDataBuilder.add_hash(XXH64(page.data(), page.size(), 0));
+        builder.Finish(assetDataBuilder.Finish());
+        char numBuf[32];
+        snprintf(numBuf, 32, "%zu", pageNumber);
+        ok = postRecord(m_serverAddress + "/asset/data/" + keyString + "/" + std::string(numBuf),
+            builder.GetBufferPointer(), builder.GetSize());
+    }
+
+    if (!ok) {
+        LOG(ERROR) << "error uploading content-chunked file " << assetFile << " to server.";
+        return 0;
+    }
+    LOG(INFO) << "completed successful upload of content-chunked file Asset " << keyString << " from " << assetFile
+        << ", sent " << missing.size() << " of " << entries.size() << " chunks.";
+    return key;
+}
+
+bool HttpClient::findMissingContentChunks(const std::vector<uint64_t>& hashes, std::unordered_set<uint64_t>* missing) {
+    std::string request = m_serverAddress + "/chunk/missing";
+    std::string query;
+    for (auto hash : hashes) {
+        query += Asset::keyToString(hash) + "\n";
+    }
+
+    bool ok = true;
+    // As with name searches, the hashes go in the body of the request.
+    auto promise = m_client->get(request).body(query).send();
+    promise.then([&request, &ok, missing](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            std::istringstream lines(response.body());
+            std::string line;
+            while (std::getline(lines, line)) {
+                if (line.size()) {
+                    missing->insert(Asset::stringToKey(line));
+                }
+            }
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on missing content chunk request " << request;
+            ok = false;
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+    return ok;
+}
+
+bool HttpClient::postRecord(const std::string& request, const uint8_t* data, size_t size) {
+    char base64[kPageSize];
+    size_t encodedSize = 0;
+    base64_encode(reinterpret_cast<const char*>(data), size, base64, &encodedSize, 0);
+    CHECK_LT(encodedSize, kPageSize) << "encoded record larger than page size";
+    LOG(INFO) << "sending POST to " << request << ", " << encodedSize << " bytes.";
+
+    bool ok = true;
+    auto promise = m_client->post(request)
+        .body(std::string(base64, encodedSize))
+        .send();
+    promise.then([&request, &ok](Pistache::Http::Response response) {
+        if (response.code() != Pistache::Http::Code::Ok) {
+            LOG(ERROR) << "error code " << response.code() << " on post " << request;
+            ok = false;
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+    return ok;
+}
+
+void HttpClient::searchNames(const std::string& table, const std::string& query, bool fuzzy, size_t maxResults,
+    std::function<void(const std::string&)> callback) {
+    char numBuf[32];
+    snprintf(numBuf, 32, "%zu", maxResults);
+    std::string request = m_serverAddress + "/" + table + "/search/" + (fuzzy ? "fuzzy" : "prefix") + "/" +
+        std::string(numBuf);
+    LOG(INFO) << "issuing name search for '" << query << "' request to " << request;
+
+    // As with named lookups the query goes in the body of the request to avoid URL encoding issues.
+    auto promise = m_client->get(request).body(query).send();
+    promise.then([&callback, &request](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            LOG(INFO) << "received Ok response for name search request " << request;
+            callback(response.body());
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on name search request " << request;
+            callback("");
+        }
+    }, Pistache::Async::NoExcept);
+
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+}
+
+bool HttpClient::downloadCatalog(const fs::path& path, uint64_t currentChecksum) {
+    std::string request = m_serverAddress + "/catalog/info";
+    LOG(INFO) << "issuing catalog info request to " << request;
+
+    std::string checksumString;
+    size_t size = 0;
+    uint64_t chunks = 0;
+    auto promise = m_client->get(request).send();
+    promise.then([&request, &checksumString, &size, &chunks](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            std::istringstream info(response.body());
+            info >> checksumString >> size >> chunks;
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on catalog info request " << request;
+        }
+    }, Pistache::Async::NoExcept);
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+
+    if (checksumString.empty() || chunks == 0) {
+        return false;
+    }
+    if (Asset::stringToKey(checksumString) == currentChecksum) {
+        LOG(INFO) << "catalog " << checksumString << " is current, skipping download.";
+        return false;
+    }
+
+    LOG(INFO) << "downloading catalog " << checksumString << ", " << size << " bytes in " << chunks << " chunks.";
+    fs::path downloadPath = path;
+    downloadPath += ".download";
+    std::ofstream outFile(downloadPath, std::ios::binary | std::ios::trunc);
+    if (!outFile) {
+        LOG(ERROR) << "unable to open catalog download file " << downloadPath;
+        return false;
+    }
+
+    bool ok = true;
+    for (uint64_t chunk = 0; ok && chunk < chunks; ++chunk) {
+        char numBuf[32];
+        snprintf(numBuf, 32, "%" PRIu64, chunk);
+        std::string chunkRequest = m_serverAddress + "/catalog/chunk/" + checksumString + "/" + std::string(numBuf);
+        auto chunkPromise = m_client->get(chunkRequest).send();
+        chunkPromise.then([&chunkRequest, &outFile, &ok](Pistache::Http::Response response) {
+            if (response.code() == Pistache::Http::Code::Ok) {
+                char decoded[kPageSize];
+                size_t decodedSize;
+                base64_decode(response.body().c_str(), response.body().size(), decoded, &decodedSize, 0);
+                outFile.write(decoded, decodedSize);
+            } else {
+                // Most likely the server published a newer catalog during the download, the next refresh gets it.
+                LOG(ERROR) << "error code " << response.code() << " on catalog chunk request " << chunkRequest;
+                ok = false;
+            }
+        }, Pistache::Async::NoExcept);
+        Pistache::Async::Barrier chunkBarrier(chunkPromise);
+        chunkBarrier.wait();
+    }
+    outFile.close();
+
+    if (ok) {
+        Catalog verify;
+        ok = verify.open(downloadPath, true) && verify.checksum() == Asset::stringToKey(checksumString);
+        if (!ok) {
+            LOG(ERROR) << "downloaded catalog " << checksumString << " failed verification.";
+        }
+    }
+    if (!ok) {
+        fs::remove(downloadPath);
+        return false;
+    }
+
+    std::error_code error;
+    fs::rename(downloadPath, path, error);
+    if (error) {
+        LOG(ERROR) << "failed to move downloaded catalog into place at " << path << ": " << error.message();
+        return false;
+    }
+    return true;
+}
+
+bool HttpClient::getChangeFeed(uint64_t fromSequence, uint64_t* oldestSequence, uint64_t* latestSequence,
+    std::vector<std::pair<uint64_t, size_t>>* entries) {
+    char numBuf[32];
+    snprintf(numBuf, 32, "%" PRIu64, fromSequence);
+    std::string request = m_serverAddress + "/feed/" + std::string(numBuf);
+
+    bool ok = false;
+    auto promise = m_client->get(request).send();
+    promise.then([&request, &ok, oldestSequence, latestSequence, entries](Pistache::Http::Response response) {
+        if (response.code() == Pistache::Http::Code::Ok) {
+            std::istringstream feed(response.body());
+            ok = static_cast<bool>(feed >> *oldestSequence >> *latestSequence);
+            uint64_t sequence = 0;
+            size_t size = 0;
+            while (feed >> sequence >> size) {
+                entries->emplace_back(sequence, size);
+            }
+        } else {
+            LOG(ERROR) << "error code " << response.code() << " on change feed request " << request;
+        }
+    }, Pistache::Async::NoExcept);
+    Pistache::Async::Barrier barrier(promise);
+    barrier.wait();
+    return ok;
+}
+
+bool HttpClient::getChangeFeedRecord(uint64_t sequence, size_t size, std::string* record) {
+    record->clear();
+    record->reserve(size);
+    char numBuf[32];
+    snprintf(numBuf, 32, "%" PRIu64, sequence);
+    std::string recordRequest = m_serverAddress + "/feed/record/" + std::string(numBuf) + "/";
+
+    bool ok = true;
+    uint64_t chunks = (size + kDataChunkSize - 1) / kDataChunkSize;
+    for (uint64_t chunk = 0; ok && chunk < chunks; ++chunk) {
+        snprintf(numBuf, 32, "%" PRIu64, chunk);
+        std::string chunkRequest = recordRequest + std::string(numBuf);
+        auto chunkPromise = m_client->get(chunkRequest).send();
+        chunkPromise.then([&chunkRequest, record, &ok](Pistache::Http::Response response) {
+            if (response.code() == Pistache::Http::Code::Ok) {
+                char decoded[kPageSize];
+                size_t decodedSize;
+                base64_decode(response.body().c_str(), response.body().size(), decoded, &decodedSize, 0);
+                record->append(decoded, decodedSize);
+            } else {
+                LOG(ERROR) << "error code " << response.code() << " on change feed request " << chunkRequest;
+                ok = false;
+            }
+        }, Pistache::Async::NoExcept);
+        Pistache::Async::Barrier chunkBarrier(chunkPromise);
+        chunkBarrier.wait();
+    }
+
+    if (ok && record->size() != size) {
+        LOG(ERROR) << "change feed record " << sequence << " downloaded " << record->size() << " bytes, expected "
+            << size;
+        ok = false;
+    }
+    return ok;
+}
+
 void HttpClient::shutdown() {
     m_client->shutdown();
 }
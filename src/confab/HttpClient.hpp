@@ -2,6 +2,7 @@
 #define SRC_CONFAB_HTTP_CLIENT_HPP_
 
 #include "Asset.hpp"
+#include "LatencyHistogram.hpp"
 #include "Record.hpp"
 
 #include <experimental/filesystem>
@@ -9,6 +10,9 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace fs = std::experimental::filesystem;
 
@@ -24,12 +28,18 @@ namespace Confab {
  */
 class HttpClient {
 public:
+    /*! Number of connections to the server kept open by clients that make few concurrent requests.
+     */
+    static constexpr size_t kDefaultConnections = 4;
+
     /*! Construct a new HttpClient for use in upstream communication.
      *
      * \param serverAddress The address part of the URLs that the client will construct, such as
      *                      "http://sclork-s01.local:9080".
+     * \param connections The maximum number of connections to keep open to the server. Requests beyond this number
+     *                    wait for a connection to become free.
      */
-    HttpClient(const std::string& serverAddress);
+    HttpClient(const std::string& serverAddress, size_t connections);
 
     /*! Destructs an HttpClient.
      */
@@ -56,6 +66,17 @@ public:
      */
     void getNamedAsset(const std::string& name, std::function<void(RecordPtr)> callback);
 
+    /*! Searches Asset names on the server. Blocks until return.
+     *
+     * \param query The full or partial name to search for.
+     * \param fuzzy If true, requests a similarity search instead of a prefix search.
+     * \param maxResults The maximum number of results the server should return.
+     * \param callback The function to call with the results, as a string of "<asset key> <name>\n" lines, which will
+     *                 be empty if nothing matched or on error.
+     */
+    void searchAssetNames(const std::string& query, bool fuzzy, size_t maxResults,
+        std::function<void(const std::string&)> callback);
+
     /*! Retrieves an asset data chunk from the server. Blocks until an outcome is resolved.
      *
      * \param key The asset key associated with these AssetData records.
@@ -65,6 +86,22 @@ public:
      */
     void getAssetData(uint64_t key, uint64_t chunk, std::function<void(uint64_t, uint64_t, RecordPtr)> callback);
 
+    /*! Retrieves a set of asset data chunks from the server, keeping several requests outstanding at once so that
+     * the transfer is limited by bandwidth rather than by round trips. Blocks until every request issued has been
+     * called back.
+     *
+     * Chunks are called back as they arrive, which may be out of order and from several threads at once.
+     *
+     * \param key The asset key associated with these AssetData records.
+     * \param chunks The chunk numbers to download, requested in this order.
+     * \param maxInFlight The maximum number of requests outstanding at once.
+     * \param callback The function to call as each FlatAssetData record is downloaded, with the key of the asset, the
+     *                 chunk number, and the FlatAssetData record, or an empty Record on error. Returning false stops
+     *                 any further requests from being issued.
+     */
+    void getAssetDataChunks(uint64_t key, const std::vector<uint64_t>& chunks, size_t maxInFlight,
+        std::function<bool(uint64_t, uint64_t, RecordPtr)> callback);
+
     /*! Uploads a new Asset with inline data to the server. Blocking.
      *
      * \param type The Asset type.
@@ -92,6 +129,26 @@ public:
     uint64_t postFileAsset(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
             const std::string& listIds, const fs::path& assetFile);
 
+    /*! Chooses how postFileAsset() uploads file data. With content chunking enabled files are split into
+     * content-defined chunks, and only the chunks the server does not already hold are uploaded, which saves most of
+     * the transfer when posting a new version of an Asset that differs from an earlier one in only a few places.
+     *
+     * \param enabled If true, upload files as content-chunked Assets.
+     */
+    void setContentChunking(bool enabled) { m_contentChunking = enabled; }
+
+    /*! Retrieves a content chunk from the server, by the hash of its contents. Blocks until an outcome is resolved.
+     *
+     * \param hash The hash of the content chunk, as listed in the manifest of a content-chunked Asset.
+     * \param callback The function to call when the FlatAssetData record is downloaded, with the hash of the chunk and
+     *                 the FlatAssetData record, or an empty Record on error.
+     */
+    void getContentChunk(uint64_t hash, std::function<void(uint64_t, RecordPtr)> callback);
+
+    /*! Latencies of AssetData and content chunk requests, from issuing each request to handling its response.
+     */
+    const LatencyHistogram& chunkLatency() const { return m_chunkLatency; }
+
     /*! Requests a list metadata entry from the server. Blocking.
      *
      * \param key The key of the list to retrieve.
@@ -106,6 +163,16 @@ public:
      */
     void getNamedList(const std::string& name, std::function<void(RecordPtr)> callback);
 
+    /*! Searches List names on the server. Blocks until return.
+     *
+     * \param query The full or partial name to search for.
+     * \param fuzzy If true, requests a similarity search instead of a prefix search.
+     * \param maxResults The maximum number of results the server should return.
+     * \param callback The function to call with the results, as a string of "<list key> <name>\n" lines.
+     */
+    void searchListNames(const std::string& query, bool fuzzy, size_t maxResults,
+        std::function<void(const std::string&)> callback);
+
     /*! Requests the most recent list items from the server. Blocking.
      *
      * \param key The key of the list to retrieve.
@@ -114,6 +181,29 @@ public:
      */
     void getListItems(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback);
 
+    /*! Requests list items before a token from the server, most recent first. Blocking.
+     *
+     * \param key The key of the list to retrieve.
+     * \param token The list token marker to iterate backwards from (can be kEndList to start at the end).
+     * \param callback The function to callback with list items as a string of "<token> <asset key>\n" pairs.
+     */
+    void getListItemsBefore(uint64_t key, uint64_t token, std::function<void(const std::string&)> callback);
+
+    /*! Requests list items starting at a position in the list from the server. Blocking.
+     *
+     * \param key The key of the list to retrieve.
+     * \param offset The position in the list of the first item to return, where 0 is the first item.
+     * \param callback The function to callback with list items as a string of "<token> <asset key>\n" pairs.
+     */
+    void getListItemsAt(uint64_t key, uint64_t offset, std::function<void(const std::string&)> callback);
+
+    /*! Requests the number of items in a list from the server. Blocking.
+     *
+     * \param key The key of the list to count.
+     * \param callback The function to callback with the count as a decimal string, or an empty string on error.
+     */
+    void getListSize(uint64_t key, std::function<void(const std::string&)> callback);
+
     /*! Uploads a new List to the server. Blocking.
      *
      * \param name The name of the list. If non-unique, will clobber old list name (but not old list).
@@ -121,15 +211,79 @@ public:
      */
     uint64_t postList(const std::string& name);
 
+    /*! Downloads the most recent Catalog published by the server, if it differs from the one already held. Blocking.
+     *
+     * The download is written beside path and only renamed over it after its checksum verifies, so a failed or
+     * interrupted download leaves any existing catalog at path untouched.
+     *
+     * \param path Where to store the downloaded catalog file.
+     * \param currentChecksum The checksum of the catalog already held, or 0 if none.
+     * \return true if a new catalog was written to path, false if the catalog is unchanged or on error.
+     */
+    bool downloadCatalog(const fs::path& path, uint64_t currentChecksum);
+
+    /*! Lists records in the server's change feed, for replicating its database to a standby. Blocking.
+     *
+     * \param fromSequence The sequence number of the first record to list.
+     * \param oldestSequence Set to the oldest sequence number the server still keeps.
+     * \param latestSequence Set to the latest sequence number the server has written.
+     * \param entries A vector to append <sequence, size> pairs for the listed records to.
+     * \return true on success, false on error.
+     */
+    bool getChangeFeed(uint64_t fromSequence, uint64_t* oldestSequence, uint64_t* latestSequence,
+        std::vector<std::pair<uint64_t, size_t>>* entries);
+
+    /*! Downloads a single change feed record from the server, in chunks. Blocking.
+     *
+     * \param sequence The sequence number of the record.
+     * \param size The size of the record in bytes, as listed by getChangeFeed().
+     * \param record Set to the contents of the record.
+     * \return true on success, false on error or if the server has trimmed the record.
+     */
+    bool getChangeFeedRecord(uint64_t sequence, size_t size, std::string* record);
+
     /*! Closes any pending requests and shuts down.
      */
     void shutdown();
 
 private:
+    /*! Shared implementation of list requests returning a plain text body, calls back with an empty string on error.
+     */
+    void getListText(const std::string& request, std::function<void(const std::string&)> callback);
+
+    /*! Shared implementation of name searches, table should be either "asset" or "list".
+     */
+    void searchNames(const std::string& table, const std::string& query, bool fuzzy, size_t maxResults,
+        std::function<void(const std::string&)> callback);
+
+    /*! Implements postFileAsset() when content chunking is enabled.
+     */
+    uint64_t postContentChunkedFile(Asset::Type type, const std::string& name, uint64_t author, uint64_t deprecates,
+        const std::string& listIds, const fs::path& assetFile, size_t fileSize);
+
+    /*! Asks the server which of up to ContentChunker::kMaxHashesPerQuery content chunks it does not hold.
+     *
+     * \param hashes The hashes of the chunks to ask about.
+     * \param missing A set to add the hashes of the chunks the server lacks to.
+     * \return true on success, false on error.
+     */
+    bool findMissingContentChunks(const std::vector<uint64_t>& hashes, std::unordered_set<uint64_t>* missing);
+
+    /*! Base64 encodes a serialized record and posts it to the server. Blocking.
+     *
+     * \param request The full URL to post to.
+     * \param data The serialized record.
+     * \param size The size of the record in bytes, which must encode to less than kPageSize.
+     * \return true on success, false on error.
+     */
+    bool postRecord(const std::string& request, const uint8_t* data, size_t size);
+
     const std::string m_serverAddress;
     std::unique_ptr<Pistache::Http::Client> m_client;
     std::random_device m_randomDevice;
     std::uniform_int_distribution<uint64_t> m_distribution;
+    bool m_contentChunking;
+    LatencyHistogram m_chunkLatency;
 };
 
 }  // namespace Confab
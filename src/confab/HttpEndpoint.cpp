@@ -2,7 +2,12 @@
 
 #include "Asset.hpp"
 #include "AssetDatabase.hpp"
+#include "AssetScrubber.hpp"
+#include "AsyncAssetDatabase.hpp"
+#include "Catalog.hpp"
+#include "ChangeFeedFollower.hpp"
 #include "Constants.hpp"
+#include "ContentChunker.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 #include "schemas/FlatList_generated.h"
@@ -12,6 +17,28 @@
 #include "pistache/endpoint.h"
 #include "pistache/router.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/*! Upper bound on the number of name search results returned for a single request.
+ */
+static const size_t kMaxSearchResults = 64;
+
+/*! Upper bound on the number of change feed records listed for a single request.
+ */
+static const size_t kMaxFeedEntries = 64;
+
+}  // namespace
+
 namespace Confab {
 
 /*! Handler class for processing incoming HTTP requests. Uses the Pistache Router to connect specific REST-style API
@@ -23,12 +50,15 @@ public:
      *
      * \param listenPort The TCP port to listen on for HTTP requests.
      * \param numThreads The number of threads to use to listen on the port.
-     * \param assetDatabase A pointer to the shared AssetDatabase instance.
+     * \param assetDatabase A pointer to the shared AsyncAssetDatabase instance, which requests are handed off to.
      */
-    HttpHandler(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase) :
+    HttpHandler(int listenPort, int numThreads, std::shared_ptr<AsyncAssetDatabase> assetDatabase) :
         m_listenPort(listenPort),
         m_numThreads(numThreads),
-        m_assetDatabase(assetDatabase) { }
+        m_assetDatabase(assetDatabase),
+        m_publisherQuit(false),
+        m_standby(false),
+        m_backupBlockBytes(0) { }
 
     /*! Setup HTTP URL routes and initialize server.
      */
@@ -46,11 +76,21 @@ public:
         Pistache::Rest::Routes::Get(m_router, "/asset/name", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getNamedAsset, this));
 
+        Pistache::Rest::Routes::Get(m_router, "/asset/search/:mode/:limit", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::searchAssetNames, this));
+
         Pistache::Rest::Routes::Get(m_router, "/asset/data/:key/:chunk", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getAssetData, this));
         Pistache::Rest::Routes::Post(m_router, "/asset/data/:key/:chunk", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::postAssetData, this));
 
+        Pistache::Rest::Routes::Get(m_router, "/chunk/data/:hash", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getContentChunk, this));
+        Pistache::Rest::Routes::Post(m_router, "/chunk/data/:hash", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::postContentChunk, this));
+        Pistache::Rest::Routes::Get(m_router, "/chunk/missing", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getMissingContentChunks, this));
+
         Pistache::Rest::Routes::Get(m_router, "/list/id/:key", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getList, this));
         Pistache::Rest::Routes::Post(m_router, "/list/id/:key", Pistache::Rest::Routes::bind(
@@ -59,8 +99,100 @@ public:
         Pistache::Rest::Routes::Get(m_router, "/list/name", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getNamedList, this));
 
+        Pistache::Rest::Routes::Get(m_router, "/list/search/:mode/:limit", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::searchListNames, this));
+
         Pistache::Rest::Routes::Get(m_router, "/list/items/:key/:from", Pistache::Rest::Routes::bind(
             &HttpEndpoint::HttpHandler::getListItems, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/list/prev/:key/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getListItemsBefore, this));
+        Pistache::Rest::Routes::Get(m_router, "/list/size/:key", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getListSize, this));
+        Pistache::Rest::Routes::Get(m_router, "/list/at/:key/:offset", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getListItemsAt, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/list/cursor/:key/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::openListCursor, this));
+        Pistache::Rest::Routes::Get(m_router, "/list/page/:cursor", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getListPage, this));
+        Pistache::Rest::Routes::Delete(m_router, "/list/cursor/:cursor", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::closeListCursor, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/catalog/info", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getCatalogInfo, this));
+        Pistache::Rest::Routes::Get(m_router, "/catalog/chunk/:checksum/:chunk", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getCatalogChunk, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/admin/scrub", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getScrubStatus, this));
+        Pistache::Rest::Routes::Get(m_router, "/admin/replication", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getReplicationStatus, this));
+        Pistache::Rest::Routes::Get(m_router, "/admin/backup", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getBackupStatus, this));
+        Pistache::Rest::Routes::Post(m_router, "/admin/backup", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::postBackup, this));
+        Pistache::Rest::Routes::Get(m_router, "/admin/stats", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getDatabaseStats, this));
+        Pistache::Rest::Routes::Get(m_router, "/admin/stats/scan", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::scanDatabaseStats, this));
+
+        Pistache::Rest::Routes::Get(m_router, "/feed/:from", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getChangeFeed, this));
+        Pistache::Rest::Routes::Get(m_router, "/feed/record/:sequence/:chunk", Pistache::Rest::Routes::bind(
+            &HttpEndpoint::HttpHandler::getChangeFeedRecord, this));
+    }
+
+    /*! Starts the background integrity scrubber, reporting through /admin/scrub.
+     *
+     * \param bytesPerSecond Maximum rate to read Asset data at while scrubbing.
+     * \param passInterval Time to wait between complete passes over the database.
+     */
+    void startScrubber(size_t bytesPerSecond, std::chrono::seconds passInterval) {
+        m_scrubber.reset(new AssetScrubber(m_assetDatabase->assetDatabase(), bytesPerSecond));
+        m_scrubber->start(passInterval);
+    }
+
+    /*! Starts a thread that exports a fresh catalog immediately and then every interval, serving the most recent one.
+     *
+     * \param path Where to write the catalog file.
+     * \param interval Time between exports.
+     */
+    void startCatalogPublisher(const std::string& path, std::chrono::seconds interval) {
+        stopCatalogPublisher();
+        m_publisherQuit = false;
+        m_publisherThread = std::thread([this, path, interval] {
+            while (true) {
+                publishCatalog(path);
+                std::unique_lock<std::mutex> lock(m_publisherMutex);
+                if (m_publisherCondition.wait_for(lock, interval, [this] { return m_publisherQuit; })) {
+                    break;
+                }
+            }
+        });
+    }
+
+    /*! Allows online backups to be started through /admin/backup.
+     *
+     * \param directory The directory to write backup archives into.
+     * \param blockBytes Approximate size of each archive block.
+     */
+    void enableBackups(const std::string& directory, size_t blockBytes) {
+        std::lock_guard<std::mutex> lock(m_backupMutex);
+        m_backupDirectory = directory;
+        m_backupBlockBytes = blockBytes;
+    }
+
+    /*! Makes this server a standby of another, replicating its database from the primary's change feed. Uploads are
+     * refused while following the primary.
+     *
+     * \param primaryAddress The address of the primary server.
+     * \param pollInterval Time between polls of the primary once caught up.
+     */
+    void startReplication(const std::string& primaryAddress, std::chrono::milliseconds pollInterval) {
+        m_standby = true;
+        m_follower.reset(new ChangeFeedFollower(m_assetDatabase->assetDatabase(), primaryAddress));
+        m_follower->start(pollInterval);
     }
 
     /*! Starts a thread that will listen on the provided TCP port and process incoming requests for storage and
@@ -81,6 +213,16 @@ public:
     /*! Stops serving threads, closes ports.
      */
     void shutdown() {
+        if (m_scrubber) {
+            m_scrubber->stop();
+        }
+        stopCatalogPublisher();
+        if (m_follower) {
+            m_follower->stop();
+        }
+        if (m_backupThread.joinable()) {
+            m_backupThread.join();
+        }
         m_server->shutdown();
     }
 
@@ -89,74 +231,73 @@ private:
         auto keyString = request.param(":key").as<std::string>();
         LOG(INFO) << "processing HTTP GET request for /asset/id/" << keyString;
         uint64_t key = Asset::stringToKey(keyString);
-        RecordPtr record = m_assetDatabase->findAsset(key);
-        if (record->empty()) {
-            LOG(ERROR) << "HTTP get request for Asset " << keyString << " not found, returning 404.";
-            response.headers().add<Pistache::Http::Header::Server>("confab");
-            response.send(Pistache::Http::Code::Not_Found);
-        } else {
-            LOG(INFO) << "HTTP get request returning Asset data for " << keyString;
-            char base64[kPageSize];
-            size_t encodedSize = 0;
-            base64_encode(reinterpret_cast<const char*>(record->data().data()), record->data().size(), base64,
-                &encodedSize, 0);
-            if (encodedSize >= kPageSize) {
-                LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->findAsset(key, [keyString, writer](RecordPtr record) {
+            if (record->empty()) {
+                LOG(ERROR) << "HTTP get request for Asset " << keyString << " not found, returning 404.";
+                writer->headers().add<Pistache::Http::Header::Server>("confab");
+                writer->send(Pistache::Http::Code::Not_Found);
+            } else {
+                LOG(INFO) << "HTTP get request returning Asset data for " << keyString;
+                sendRecord(record, writer.get());
             }
-            response.headers().add<Pistache::Http::Header::Server>("confab");
-            response.send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
-        }
+        });
     }
 
     void postAsset(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        if (refuseOnStandby(&response)) {
+            return;
+        }
         auto keyString = request.param(":key").as<std::string>();
         uint64_t key = Asset::stringToKey(keyString);
-        uint8_t decoded[kPageSize];
+        std::vector<uint8_t> decoded(kPageSize);
         size_t decodedSize;
-        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded), &decodedSize, 0);
-        SizedPointer postedData(decoded, decodedSize);
-        LOG(INFO) << "processing HTTP POST request for /asset/id/" << keyString << ", " << postedData.size() << " bytes.";
+        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded.data()),
+            &decodedSize, 0);
+        decoded.resize(decodedSize);
+        LOG(INFO) << "processing HTTP POST request for /asset/id/" << keyString << ", " << decodedSize << " bytes.";
 
         // Sanity-check the provided serialized FlatAsset data.
-        auto verifier = flatbuffers::Verifier(postedData.data(), postedData.size());
-        bool status = Data::VerifyFlatAssetBuffer(verifier);
-        if (status) {
+        auto verifier = flatbuffers::Verifier(decoded.data(), decoded.size());
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        if (Data::VerifyFlatAssetBuffer(verifier)) {
             LOG(INFO) << "verified FlatAsset " << keyString;
-            status = m_assetDatabase->storeAsset(key, postedData);
+            m_assetDatabase->storeAsset(key, std::move(decoded), [keyString, writer](bool status) {
+                sendStoreStatus(status, "asset " + keyString, writer.get());
+            });
         } else {
             LOG(ERROR) << "posted data did not verify for asset " << keyString;
-        }
-
-        response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (status) {
-            LOG(INFO) << "sending OK response after storing asset " << keyString;
-            response.send(Pistache::Http::Code::Ok);
-        } else {
-            LOG(ERROR) << "sending error response after failure to store asset " << keyString;
-            response.send(Pistache::Http::Code::Internal_Server_Error);
+            sendStoreStatus(false, "asset " + keyString, writer.get());
         }
     }
 
     void getNamedAsset(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto name = request.body();
         LOG(INFO) << "processing HTTP GET request for /asset/name/" << name;
-        RecordPtr record = m_assetDatabase->findNamedAsset(name);
-        if (record->empty()) {
-            LOG(ERROR) << "HTTP get request for named Asset " << name << " not found, returning 404.";
-            response.headers().add<Pistache::Http::Header::Server>("confab");
-            response.send(Pistache::Http::Code::Not_Found);
-        } else {
-            LOG(INFO) << "HTTP get request returning named asset data for " << name;
-            char base64[kPageSize];
-            size_t encodedSize = 0;
-            base64_encode(reinterpret_cast<const char*>(record->data().data()), record->data().size(), base64,
-                &encodedSize, 0);
-            if (encodedSize >= kPageSize) {
-                LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->findNamedAsset(name, [name, writer](RecordPtr record) {
+            if (record->empty()) {
+                LOG(ERROR) << "HTTP get request for named Asset " << name << " not found, returning 404.";
+                writer->headers().add<Pistache::Http::Header::Server>("confab");
+                writer->send(Pistache::Http::Code::Not_Found);
+            } else {
+                LOG(INFO) << "HTTP get request returning named asset data for " << name;
+                sendRecord(record, writer.get());
             }
-            response.headers().add<Pistache::Http::Header::Server>("confab");
-            response.send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
-        }
+        });
+    }
+
+    void searchAssetNames(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto mode = request.param(":mode").as<std::string>();
+        auto limit = request.param(":limit").as<size_t>();
+        // Like named lookups, the query is supplied in the request body to avoid URL encoding issues.
+        auto query = request.body();
+        LOG(INFO) << "processing HTTP GET request for /asset/search/" << mode << "/" << limit << " '" << query << "'";
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->searchAssetNames(query, mode == "fuzzy", std::min(limit, kMaxSearchResults),
+            [writer](std::vector<NameIndex::Match> matches) {
+                sendNameMatches(matches, writer.get());
+            });
     }
 
     void getAssetData(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
@@ -164,126 +305,183 @@ private:
         auto chunk = request.param(":chunk").as<uint64_t>();
         LOG(INFO) << "processing HTTP GET request for /asset/data/" << keyString << "/" << chunk;
         uint64_t key = Asset::stringToKey(keyString);
-        RecordPtr assetData = m_assetDatabase->loadAssetDataChunk(key, chunk);
-        response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (assetData->empty()) {
-            LOG(ERROR) << "HTTP get request for Asset Data " << keyString << " chunk " << chunk
-                << " not found, returning 404.";
-            response.send(Pistache::Http::Code::Not_Found);
-        } else {
-            LOG(INFO) << "HTTP get request for Asset Data " << keyString << " chunk " << chunk
-                << " returning Asset Data.";
-            char base64[kPageSize];
-            size_t encodedSize = 0;
-            base64_encode(reinterpret_cast<const char*>(assetData->data().data()), assetData->data().size(), base64,
-                &encodedSize, 0);
-            if (encodedSize >= kPageSize) {
-                LOG(ERROR) << "encoded Size: " << encodedSize << " exceeds buffer size " << kPageSize;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->loadAssetDataChunk(key, chunk, [keyString, chunk, writer](RecordPtr assetData) {
+            if (assetData->empty()) {
+                LOG(ERROR) << "HTTP get request for Asset Data " << keyString << " chunk " << chunk
+                    << " not found, returning 404.";
+                writer->headers().add<Pistache::Http::Header::Server>("confab");
+                writer->send(Pistache::Http::Code::Not_Found);
             } else {
-                LOG(INFO) << "sending " << encodedSize << " bytes of Asset Data.";
+                LOG(INFO) << "HTTP get request for Asset Data " << keyString << " chunk " << chunk
+                    << " returning Asset Data.";
+                sendRecord(assetData, writer.get());
             }
-            response.send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
-        }
+        });
     }
 
     void postAssetData(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        if (refuseOnStandby(&response)) {
+            return;
+        }
         auto keyString = request.param(":key").as<std::string>();
         auto chunk = request.param(":chunk").as<uint64_t>();
         LOG(INFO) << "processing HTTP POST request for /asset/data/" << keyString << "/" << chunk;
         uint64_t key = Asset::stringToKey(keyString);
-        uint8_t decoded[kPageSize];
+        std::vector<uint8_t> decoded(kPageSize);
         size_t decodedSize;
-        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded), &decodedSize, 0);
-        auto verifier = flatbuffers::Verifier(decoded, decodedSize);
-        bool status = Data::VerifyFlatAssetDataBuffer(verifier);
-        if (status) {
+        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded.data()),
+            &decodedSize, 0);
+        decoded.resize(decodedSize);
+        auto verifier = flatbuffers::Verifier(decoded.data(), decoded.size());
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        std::string description = "asset " + keyString + " data chunk " + std::to_string(chunk);
+        if (Data::VerifyFlatAssetDataBuffer(verifier)) {
             LOG(INFO) << "verified FlatAssetData " << keyString << " chunk " << chunk;
-            SizedPointer postedData(decoded, decodedSize);
-            status = m_assetDatabase->storeAssetDataChunk(key, chunk, postedData);
+            m_assetDatabase->storeAssetDataChunk(key, chunk, std::move(decoded), [description, writer](bool status) {
+                sendStoreStatus(status, description, writer.get());
+            });
         } else {
             LOG(ERROR) << "posted data did not verify for asset data " << keyString << " chunk " << chunk;
+            sendStoreStatus(false, description, writer.get());
         }
-        response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (status) {
-            LOG(INFO) << "sending OK response after storing asset " << keyString << " data chunk " << chunk;
-            response.send(Pistache::Http::Code::Ok);
+    }
+
+    void getContentChunk(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto hashString = request.param(":hash").as<std::string>();
+        LOG(INFO) << "processing HTTP GET request for /chunk/data/" << hashString;
+        uint64_t hash = Asset::stringToKey(hashString);
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->loadContentChunk(hash, [hashString, writer](RecordPtr chunkData) {
+            if (chunkData->empty()) {
+                LOG(ERROR) << "HTTP get request for content chunk " << hashString << " not found, returning 404.";
+                writer->headers().add<Pistache::Http::Header::Server>("confab");
+                writer->send(Pistache::Http::Code::Not_Found);
+            } else {
+                sendRecord(chunkData, writer.get());
+            }
+        });
+    }
+
+    void postContentChunk(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        if (refuseOnStandby(&response)) {
+            return;
+        }
+        auto hashString = request.param(":hash").as<std::string>();
+        LOG(INFO) << "processing HTTP POST request for /chunk/data/" << hashString;
+        uint64_t hash = Asset::stringToKey(hashString);
+        std::vector<uint8_t> decoded(kPageSize);
+        size_t decodedSize;
+        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded.data()),
+            &decodedSize, 0);
+        decoded.resize(decodedSize);
+        auto verifier = flatbuffers::Verifier(decoded.data(), decoded.size());
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        std::string description = "content chunk " + hashString;
+        if (Data::VerifyFlatAssetDataBuffer(verifier)) {
+            m_assetDatabase->storeContentChunk(hash, std::move(decoded), [description, writer](bool status) {
+                sendStoreStatus(status, description, writer.get());
+            });
         } else {
-            LOG(ERROR) << "sending error response after failure to store asset " << keyString << " data chunk "
-                << chunk;
-            response.send(Pistache::Http::Code::Internal_Server_Error);
+            LOG(ERROR) << "posted data did not verify for content chunk " << hashString;
+            sendStoreStatus(false, description, writer.get());
         }
     }
 
+    void getMissingContentChunks(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        // The hashes to look for are supplied in the request body, one per line.
+        std::vector<uint64_t> hashes;
+        const std::string& body = request.body();
+        size_t start = 0;
+        while (start < body.size() && hashes.size() < ContentChunker::kMaxHashesPerQuery) {
+            size_t end = body.find('\n', start);
+            if (end == std::string::npos) {
+                end = body.size();
+            }
+            if (end > start) {
+                hashes.push_back(Asset::stringToKey(body.substr(start, end - start)));
+            }
+            start = end + 1;
+        }
+        LOG(INFO) << "processing HTTP GET request for /chunk/missing with " << hashes.size() << " hashes.";
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->findMissingContentChunks(std::move(hashes), [writer](std::vector<uint64_t> missing) {
+            std::string missingList;
+            for (auto hash : missing) {
+                missingList += Asset::keyToString(hash) + "\n";
+            }
+            writer->headers().add<Pistache::Http::Header::Server>("confab");
+            writer->send(Pistache::Http::Code::Ok, missingList, MIME(Text, Plain));
+        });
+    }
+
     void getList(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto keyString = request.param(":key").as<std::string>();
         LOG(INFO) << "processing GET request for /list/id " << keyString;
         uint64_t key = Asset::stringToKey(keyString);
-        RecordPtr listData = m_assetDatabase->loadList(key);
-        response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (listData->empty()) {
-            LOG(ERROR) << "get frequest for list " << keyString << " not found, 404.";
-            response.send(Pistache::Http::Code::Not_Found);
-        } else {
-            LOG(INFO) << "get request for list " << keyString << " returning list data.";
-            char base64[kPageSize];
-            size_t encodedSize = 0;
-            base64_encode(reinterpret_cast<const char*>(listData->data().data()), listData->data().size(), base64,
-                &encodedSize, 0);
-            if (encodedSize >= kPageSize) {
-                LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->loadList(key, [keyString, writer](RecordPtr listData) {
+            if (listData->empty()) {
+                LOG(ERROR) << "get frequest for list " << keyString << " not found, 404.";
+                writer->headers().add<Pistache::Http::Header::Server>("confab");
+                writer->send(Pistache::Http::Code::Not_Found);
             } else {
-                LOG(INFO) << "sending " << encodedSize << " bytes of List data.";
+                LOG(INFO) << "get request for list " << keyString << " returning list data.";
+                sendRecord(listData, writer.get());
             }
-            response.send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
-        }
+        });
     }
 
     void postList(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        if (refuseOnStandby(&response)) {
+            return;
+        }
         auto keyString = request.param(":key").as<std::string>();
         LOG(INFO) << "processing POST request for /list/id " << keyString;
         uint64_t key = Asset::stringToKey(keyString);
-        uint8_t decoded[kPageSize];
+        std::vector<uint8_t> decoded(kPageSize);
         size_t decodedSize;
-        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded), &decodedSize, 0);
-        auto verifier = flatbuffers::Verifier(decoded, decodedSize);
-        bool status = Data::VerifyFlatListBuffer(verifier);
-        if (status) {
+        base64_decode(request.body().data(), request.body().size(), reinterpret_cast<char*>(decoded.data()),
+            &decodedSize, 0);
+        decoded.resize(decodedSize);
+        auto verifier = flatbuffers::Verifier(decoded.data(), decoded.size());
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        if (Data::VerifyFlatListBuffer(verifier)) {
             LOG(INFO) << "verified FlatList " << keyString;
-            SizedPointer postedData(decoded, decodedSize);
-            status = m_assetDatabase->storeList(key, postedData);
+            m_assetDatabase->storeList(key, std::move(decoded), [keyString, writer](bool status) {
+                sendStoreStatus(status, "list " + keyString, writer.get());
+            });
         } else {
             LOG(ERROR) << "posted data did not verify for list " << keyString;
-        }
-        response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (status) {
-            LOG(INFO) << "sending OK  response after storing list " << keyString;
-            response.send(Pistache::Http::Code::Ok);
-        } else {
-            LOG(ERROR) << "sending error response after failure to store list " << keyString;
-            response.send(Pistache::Http::Code::Internal_Server_Error);
+            sendStoreStatus(false, "list " + keyString, writer.get());
         }
     }
 
     void getNamedList(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
         auto name = request.body();
         LOG(INFO) << "processing GET request for /list/name '" << name << "'.";
-        RecordPtr listData = m_assetDatabase->findNamedList(name);
-        response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (listData->empty()) {
-            LOG(ERROR) << "get request for list named " << name << " not found, 404.";
-            response.send(Pistache::Http::Code::Not_Found);
-        } else {
-            char base64[kPageSize];
-            size_t encodedSize = 0;
-            base64_encode(reinterpret_cast<const char*>(listData->data().data()), listData->data().size(), base64,
-                &encodedSize, 0);
-            if (encodedSize >= kPageSize) {
-                LOG(ERROR) << "encoded Size: " << encodedSize << " exceeds buffer size " << kPageSize;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->findNamedList(name, [name, writer](RecordPtr listData) {
+            if (listData->empty()) {
+                LOG(ERROR) << "get request for list named " << name << " not found, 404.";
+                writer->headers().add<Pistache::Http::Header::Server>("confab");
+                writer->send(Pistache::Http::Code::Not_Found);
             } else {
-                LOG(INFO) << "sending " << encodedSize << " bytes of Asset Data.";
+                sendRecord(listData, writer.get());
             }
-            response.send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
-        }
+        });
+    }
+
+    void searchListNames(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto mode = request.param(":mode").as<std::string>();
+        auto limit = request.param(":limit").as<size_t>();
+        auto query = request.body();
+        LOG(INFO) << "processing HTTP GET request for /list/search/" << mode << "/" << limit << " '" << query << "'";
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->searchListNames(query, mode == "fuzzy", std::min(limit, kMaxSearchResults),
+            [writer](std::vector<NameIndex::Match> matches) {
+                sendNameMatches(matches, writer.get());
+            });
     }
 
     void getListItems(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
@@ -293,30 +491,452 @@ private:
 
         uint64_t key = Asset::stringToKey(keyString);
         uint64_t token = Asset::stringToKey(fromString);
-        std::array<uint64_t, kPageSize / 17> pairs;
-        size_t numPairs = m_assetDatabase->getListNext(key, token, pairs.size() / 2, pairs.data());
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->getListNext(key, token, (kPageSize / 17) / 2,
+            [keyString, writer](std::vector<uint64_t> pairs) {
+                if (pairs.empty()) {
+                    LOG(ERROR) << "error retrieving iterator pair list for " << keyString;
+                    writer->headers().add<Pistache::Http::Header::Server>("confab");
+                    writer->send(Pistache::Http::Code::Internal_Server_Error);
+                } else {
+                    LOG(INFO) << "sending " << pairs.size() / 2 << " tokens back to client on list " << keyString;
+                    sendListPairs(pairs, writer.get());
+                }
+            });
+    }
+
+    void getListItemsBefore(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing get /list/prev/" << keyString << "/" << fromString;
+
+        uint64_t key = Asset::stringToKey(keyString);
+        uint64_t token = Asset::stringToKey(fromString);
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->getListPrev(key, token, (kPageSize / 17) / 2,
+            [keyString, writer](std::vector<uint64_t> pairs) {
+                if (pairs.empty()) {
+                    LOG(ERROR) << "error retrieving reverse iterator pair list for " << keyString;
+                    writer->headers().add<Pistache::Http::Header::Server>("confab");
+                    writer->send(Pistache::Http::Code::Internal_Server_Error);
+                } else {
+                    LOG(INFO) << "sending " << pairs.size() / 2 << " tokens back to client on list " << keyString;
+                    sendListPairs(pairs, writer.get());
+                }
+            });
+    }
+
+    void getListSize(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        LOG(INFO) << "processing get /list/size/" << keyString;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->getListSize(Asset::stringToKey(keyString), [writer](size_t size) {
+            writer->headers().add<Pistache::Http::Header::Server>("confab");
+            writer->send(Pistache::Http::Code::Ok, std::to_string(size) + "\n", MIME(Text, Plain));
+        });
+    }
+
+    void getListItemsAt(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        auto offset = request.param(":offset").as<size_t>();
+        LOG(INFO) << "processing get /list/at/" << keyString << "/" << offset;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->getListAt(Asset::stringToKey(keyString), offset, (kPageSize / 17) / 2,
+            [keyString, writer](std::vector<uint64_t> pairs) {
+                LOG(INFO) << "sending " << pairs.size() / 2 << " tokens back to client on list " << keyString;
+                sendListPairs(pairs, writer.get());
+            });
+    }
+
+    void openListCursor(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto keyString = request.param(":key").as<std::string>();
+        auto fromString = request.param(":from").as<std::string>();
+        LOG(INFO) << "processing get /list/cursor/" << keyString << "/" << fromString;
+
+        uint64_t key = Asset::stringToKey(keyString);
+        uint64_t token = Asset::stringToKey(fromString);
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->openListCursor(key, token, [keyString, writer](uint64_t cursorId) {
+            writer->headers().add<Pistache::Http::Header::Server>("confab");
+            if (cursorId == 0) {
+                LOG(ERROR) << "unable to open cursor on list " << keyString << ", returning 404.";
+                writer->send(Pistache::Http::Code::Not_Found);
+            } else {
+                writer->send(Pistache::Http::Code::Ok, Asset::keyToString(cursorId) + "\n", MIME(Text, Plain));
+            }
+        });
+    }
+
+    void getListPage(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto cursorString = request.param(":cursor").as<std::string>();
+        LOG(INFO) << "processing get /list/page/" << cursorString;
+
+        uint64_t cursorId = Asset::stringToKey(cursorString);
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->readListCursor(cursorId, (kPageSize / 17) / 2,
+            [cursorString, writer](std::vector<uint64_t> pairs) {
+                if (pairs.empty()) {
+                    // Cursors expire, so the client is expected to open a new one from the last token it received.
+                    LOG(INFO) << "list cursor " << cursorString << " unknown or expired, returning 404.";
+                    writer->headers().add<Pistache::Http::Header::Server>("confab");
+                    writer->send(Pistache::Http::Code::Not_Found);
+                } else {
+                    LOG(INFO) << "sending " << pairs.size() / 2 << " tokens back to client on cursor " << cursorString;
+                    sendListPairs(pairs, writer.get());
+                }
+            });
+    }
+
+    void closeListCursor(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto cursorString = request.param(":cursor").as<std::string>();
+        LOG(INFO) << "processing delete /list/cursor/" << cursorString;
+        m_assetDatabase->closeListCursor(Asset::stringToKey(cursorString));
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        response.send(Pistache::Http::Code::Ok);
+    }
+
+    void getCatalogInfo(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(INFO) << "processing HTTP GET request for /catalog/info";
+        std::shared_ptr<Catalog> catalog = currentCatalog();
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        if (!catalog) {
+            LOG(ERROR) << "no catalog published, returning 404.";
+            response.send(Pistache::Http::Code::Not_Found);
+            return;
+        }
+        size_t size = catalog->bytes().size();
+        size_t chunks = (size + kDataChunkSize - 1) / kDataChunkSize;
+        response.send(Pistache::Http::Code::Ok, Asset::keyToString(catalog->checksum()) + " " + std::to_string(size) +
+            " " + std::to_string(chunks) + "\n", MIME(Text, Plain));
+    }
+
+    void getCatalogChunk(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto checksumString = request.param(":checksum").as<std::string>();
+        auto chunk = request.param(":chunk").as<uint64_t>();
+        LOG(INFO) << "processing HTTP GET request for /catalog/chunk/" << checksumString << "/" << chunk;
+        std::shared_ptr<Catalog> catalog = currentCatalog();
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        // Chunks are requested by checksum so that a download can never mix chunks from two different catalogs.
+        if (!catalog || catalog->checksum() != Asset::stringToKey(checksumString) ||
+            chunk * kDataChunkSize >= catalog->bytes().size()) {
+            LOG(ERROR) << "catalog chunk " << checksumString << "/" << chunk << " not available, returning 404.";
+            response.send(Pistache::Http::Code::Not_Found);
+            return;
+        }
+        SizedPointer bytes = catalog->bytes();
+        size_t offset = chunk * kDataChunkSize;
+        size_t chunkSize = std::min(static_cast<size_t>(kDataChunkSize), bytes.size() - offset);
+        char base64[kPageSize];
+        size_t encodedSize = 0;
+        base64_encode(bytes.dataChar() + offset, chunkSize, base64, &encodedSize, 0);
+        response.send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
+    }
+
+    void getScrubStatus(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(INFO) << "processing HTTP GET request for /admin/scrub";
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        if (!m_scrubber) {
+            response.send(Pistache::Http::Code::Not_Found);
+            return;
+        }
+        AssetScrubber::Status status = m_scrubber->status();
+        std::string report = "running " + std::to_string(status.running ? 1 : 0) + "\n";
+        report += "passes_completed " + std::to_string(status.passesCompleted) + "\n";
+        report += "assets_checked " + std::to_string(status.assetsChecked) + "\n";
+        report += "bytes_checked " + std::to_string(status.bytesChecked) + "\n";
+        report += "cursor " + Asset::keyToString(status.cursor) + "\n";
+        report += "corrupt_assets " + std::to_string(status.corruptAssets.size()) + "\n";
+        for (const auto& corrupt : status.corruptAssets) {
+            std::string line = "corrupt " + Asset::keyToString(corrupt.first) + " " + corrupt.second + "\n";
+            if (report.size() + line.size() >= kPageSize) {
+                break;
+            }
+            report += line;
+        }
+        response.send(Pistache::Http::Code::Ok, report, MIME(Text, Plain));
+    }
+
+    void getReplicationStatus(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(INFO) << "processing HTTP GET request for /admin/replication";
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        std::string report = "role " + std::string(m_standby ? "standby" : "primary") + "\n";
+        report += "sequence " + std::to_string(m_assetDatabase->assetDatabase()->changeFeedSequence()) + "\n";
+        if (m_follower) {
+            ChangeFeedFollower::Status status = m_follower->status();
+            report += "following " + std::to_string(status.running ? 1 : 0) + "\n";
+            report += "primary_sequence " + std::to_string(status.primarySequence) + "\n";
+            report += "needs_reseed " + std::to_string(status.needsReseed ? 1 : 0) + "\n";
+        }
+        response.send(Pistache::Http::Code::Ok, report, MIME(Text, Plain));
+    }
+
+    void postBackup(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(INFO) << "processing HTTP POST request for /admin/backup";
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        std::lock_guard<std::mutex> lock(m_backupMutex);
+        if (m_backupDirectory.empty()) {
+            response.send(Pistache::Http::Code::Not_Found);
+            return;
+        }
+        if (m_backupStatus.running) {
+            LOG(ERROR) << "backup to " << m_backupStatus.path << " already running, returning 409.";
+            response.send(Pistache::Http::Code::Conflict);
+            return;
+        }
+        if (m_backupThread.joinable()) {
+            m_backupThread.join();
+        }
+
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        std::string path = m_backupDirectory + "/confab-" +
+            std::to_string(std::chrono::duration_cast<std::chrono::seconds>(now).count()) + ".backup";
+        m_backupStatus = BackupStatus();
+        m_backupStatus.running = true;
+        m_backupStatus.path = path;
+        size_t blockBytes = m_backupBlockBytes;
+        // The backup reads a snapshot, so requests keep being served from the live database while it runs.
+        m_backupThread = std::thread([this, path, blockBytes] {
+            auto startTime = std::chrono::steady_clock::now();
+            uint64_t records = 0;
+            bool succeeded = m_assetDatabase->assetDatabase()->writeBackup(path, blockBytes, &records);
+            auto elapsed = std::chrono::steady_clock::now() - startTime;
+            std::lock_guard<std::mutex> lock(m_backupMutex);
+            m_backupStatus.running = false;
+            m_backupStatus.succeeded = succeeded;
+            m_backupStatus.records = records;
+            m_backupStatus.seconds = std::chrono::duration<double>(elapsed).count();
+        });
+        response.send(Pistache::Http::Code::Accepted, path + "\n", MIME(Text, Plain));
+    }
+
+    void getBackupStatus(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(INFO) << "processing HTTP GET request for /admin/backup";
+        response.headers().add<Pistache::Http::Header::Server>("confab");
+        std::lock_guard<std::mutex> lock(m_backupMutex);
+        if (m_backupDirectory.empty()) {
+            response.send(Pistache::Http::Code::Not_Found);
+            return;
+        }
+        std::string report = "running " + std::to_string(m_backupStatus.running ? 1 : 0) + "\n";
+        if (!m_backupStatus.path.empty()) {
+            report += "path " + m_backupStatus.path + "\n";
+        }
+        if (!m_backupStatus.running && !m_backupStatus.path.empty()) {
+            report += "succeeded " + std::to_string(m_backupStatus.succeeded ? 1 : 0) + "\n";
+            report += "records " + std::to_string(m_backupStatus.records) + "\n";
+            report += "seconds " + std::to_string(m_backupStatus.seconds) + "\n";
+        }
+        response.send(Pistache::Http::Code::Ok, report, MIME(Text, Plain));
+    }
+
+    void getDatabaseStats(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        LOG(INFO) << "processing HTTP GET request for /admin/stats";
+        sendDatabaseStats(false, std::move(response));
+    }
+
+    void scanDatabaseStats(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        // Counting keys reads every record in the database, so is only done when explicitly asked for.
+        LOG(INFO) << "processing HTTP GET request for /admin/stats/scan";
+        sendDatabaseStats(true, std::move(response));
+    }
+
+    void sendDatabaseStats(bool countKeys, Pistache::Http::ResponseWriter response) {
         response.headers().add<Pistache::Http::Header::Server>("confab");
-        if (numPairs == 0) {
-            LOG(ERROR) << "error retrieving iterator pair list for " << keyString;
-            response.send(Pistache::Http::Code::Internal_Server_Error);
+        std::string stats = m_assetDatabase->assetDatabase()->statsReport(countKeys);
+        std::string report;
+        size_t lineStart = 0;
+        while (lineStart < stats.size()) {
+            size_t lineEnd = stats.find('\n', lineStart);
+            lineEnd = lineEnd == std::string::npos ? stats.size() : lineEnd + 1;
+            if (report.size() + lineEnd - lineStart >= kPageSize) {
+                break;
+            }
+            report += stats.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd;
+        }
+        response.send(Pistache::Http::Code::Ok, report, MIME(Text, Plain));
+    }
+
+    void getChangeFeed(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto fromSequence = request.param(":from").as<uint64_t>();
+        LOG(INFO) << "processing HTTP GET request for /feed/" << fromSequence;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        m_assetDatabase->getChangeFeed(fromSequence, kMaxFeedEntries, [writer](
+            std::vector<AssetDatabase::ChangeFeedEntry> entries, uint64_t oldestSequence, uint64_t latestSequence) {
+            std::string feed = std::to_string(oldestSequence) + " " + std::to_string(latestSequence) + "\n";
+            for (const auto& entry : entries) {
+                feed += std::to_string(entry.sequence) + " " + std::to_string(entry.size) + "\n";
+            }
+            writer->headers().add<Pistache::Http::Header::Server>("confab");
+            writer->send(Pistache::Http::Code::Ok, feed, MIME(Text, Plain));
+        });
+    }
+
+    void getChangeFeedRecord(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+        auto sequence = request.param(":sequence").as<uint64_t>();
+        auto chunk = request.param(":chunk").as<uint64_t>();
+        LOG(INFO) << "processing HTTP GET request for /feed/record/" << sequence << "/" << chunk;
+        auto writer = std::make_shared<Pistache::Http::ResponseWriter>(std::move(response));
+        // Records can be larger than a page, so like catalogs they are sent in slices of kDataChunkSize.
+        m_assetDatabase->loadChangeFeedRecord(sequence, [sequence, chunk, writer](RecordPtr record) {
+            writer->headers().add<Pistache::Http::Header::Server>("confab");
+            if (record->empty() || chunk * kDataChunkSize >= record->data().size()) {
+                LOG(ERROR) << "change feed record " << sequence << " chunk " << chunk << " not found, returning 404.";
+                writer->send(Pistache::Http::Code::Not_Found);
+                return;
+            }
+            size_t offset = chunk * kDataChunkSize;
+            size_t chunkSize = std::min(static_cast<size_t>(kDataChunkSize), record->data().size() - offset);
+            char base64[kPageSize];
+            size_t encodedSize = 0;
+            base64_encode(record->data().dataChar() + offset, chunkSize, base64, &encodedSize, 0);
+            writer->send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
+        });
+    }
+
+    /*! Sends a Service Unavailable response if this server is a standby, which only takes writes from its primary.
+     * Returns true if the request was refused.
+     */
+    bool refuseOnStandby(Pistache::Http::ResponseWriter* response) {
+        if (!m_standby) {
+            return false;
+        }
+        LOG(ERROR) << "refusing upload to standby server, returning 503.";
+        response->headers().add<Pistache::Http::Header::Server>("confab");
+        response->send(Pistache::Http::Code::Service_Unavailable);
+        return true;
+    }
+
+    void publishCatalog(const std::string& path) {
+        size_t assetCount = 0;
+        if (!m_assetDatabase->assetDatabase()->exportCatalog(path, &assetCount)) {
+            LOG(ERROR) << "failed to export catalog to " << path;
+            return;
+        }
+        std::shared_ptr<Catalog> catalog(new Catalog);
+        if (!catalog->open(path, false)) {
+            LOG(ERROR) << "failed to open exported catalog " << path;
+            return;
+        }
+        LOG(INFO) << "publishing catalog " << Asset::keyToString(catalog->checksum()) << " with " << assetCount
+            << " Assets.";
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        m_catalog = catalog;
+    }
+
+    std::shared_ptr<Catalog> currentCatalog() {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        return m_catalog;
+    }
+
+    void stopCatalogPublisher() {
+        {
+            std::lock_guard<std::mutex> lock(m_publisherMutex);
+            m_publisherQuit = true;
+        }
+        m_publisherCondition.notify_all();
+        if (m_publisherThread.joinable()) {
+            m_publisherThread.join();
+        }
+    }
+
+    /*! Sends the contents of a Record base64-encoded, as a successful response.
+     */
+    static void sendRecord(RecordPtr record, Pistache::Http::ResponseWriter* response) {
+        char base64[kPageSize];
+        size_t encodedSize = 0;
+        base64_encode(reinterpret_cast<const char*>(record->data().data()), record->data().size(), base64,
+            &encodedSize, 0);
+        if (encodedSize >= kPageSize) {
+            LOG(ERROR) << "encoded size: " << encodedSize << " exceeds buffer size " << kPageSize;
+        } else {
+            LOG(INFO) << "sending " << encodedSize << " bytes of record data.";
+        }
+        response->headers().add<Pistache::Http::Header::Server>("confab");
+        response->send(Pistache::Http::Code::Ok, std::string(base64, encodedSize), MIME(Text, Plain));
+    }
+
+    /*! Sends an empty response with a status code reflecting the result of a store operation.
+     */
+    static void sendStoreStatus(bool status, const std::string& description, Pistache::Http::ResponseWriter* response) {
+        response->headers().add<Pistache::Http::Header::Server>("confab");
+        if (status) {
+            LOG(INFO) << "sending OK response after storing " << description;
+            response->send(Pistache::Http::Code::Ok);
         } else {
-            LOG(INFO) << "sending " << numPairs << " tokens back to client on list " << keyString;
-            std::string pairList;
-            for (auto i = 0; i < numPairs; ++i) {
-                pairList += Asset::keyToString(pairs[i * 2]) + " " + Asset::keyToString(pairs[(i * 2) + 1]) + "\n";
+            LOG(ERROR) << "sending error response after failure to store " << description;
+            response->send(Pistache::Http::Code::Internal_Server_Error);
+        }
+    }
+
+    /*! Sends list <token, key> pairs as "<token> <key>\n" lines, as a successful response.
+     */
+    static void sendListPairs(const std::vector<uint64_t>& pairs, Pistache::Http::ResponseWriter* response) {
+        std::string pairList;
+        for (size_t i = 0; i < pairs.size(); i += 2) {
+            pairList += Asset::keyToString(pairs[i]) + " " + Asset::keyToString(pairs[i + 1]) + "\n";
+        }
+        response->headers().add<Pistache::Http::Header::Server>("confab");
+        response->send(Pistache::Http::Code::Ok, pairList, MIME(Text, Plain));
+    }
+
+    /*! Sends name search results as "<key> <name>\n" lines, truncated to fit within a single page.
+     */
+    static void sendNameMatches(const std::vector<NameIndex::Match>& matches,
+        Pistache::Http::ResponseWriter* response) {
+        std::string matchList;
+        size_t sent = 0;
+        for (const auto& match : matches) {
+            std::string line = Asset::keyToString(match.key) + " " + match.name + "\n";
+            if (matchList.size() + line.size() >= kPageSize) {
+                LOG(WARNING) << "truncating name search results at " << matchList.size() << " bytes, " << sent
+                    << " of " << matches.size() << " matches.";
+                break;
             }
-            response.send(Pistache::Http::Code::Ok, pairList, MIME(Text, Plain));
+            matchList += line;
+            ++sent;
         }
+        LOG(INFO) << "sending " << sent << " name search results.";
+        response->headers().add<Pistache::Http::Header::Server>("confab");
+        response->send(Pistache::Http::Code::Ok, matchList, MIME(Text, Plain));
     }
 
     int m_listenPort;
     int m_numThreads;
-    std::shared_ptr<AssetDatabase> m_assetDatabase;
+    std::shared_ptr<AsyncAssetDatabase> m_assetDatabase;
     std::shared_ptr<Pistache::Http::Endpoint> m_server;
     Pistache::Rest::Router m_router;
+
+    // The published catalog is replaced wholesale, requests in flight keep the previous one alive until done.
+    std::mutex m_catalogMutex;
+    std::shared_ptr<Catalog> m_catalog;
+
+    std::unique_ptr<AssetScrubber> m_scrubber;
+
+    std::thread m_publisherThread;
+    std::mutex m_publisherMutex;
+    std::condition_variable m_publisherCondition;
+    bool m_publisherQuit;
+
+    std::atomic<bool> m_standby;
+    std::unique_ptr<ChangeFeedFollower> m_follower;
+
+    // Outcome of the most recent backup started through /admin/backup.
+    struct BackupStatus {
+        bool running = false;
+        bool succeeded = false;
+        std::string path;
+        uint64_t records = 0;
+        double seconds = 0.0;
+    };
+    std::mutex m_backupMutex;
+    std::string m_backupDirectory;
+    size_t m_backupBlockBytes;
+    BackupStatus m_backupStatus;
+    std::thread m_backupThread;
 };
 
-HttpEndpoint::HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase) :
+HttpEndpoint::HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AsyncAssetDatabase> assetDatabase) :
     m_handler(new HttpHandler(listenPort, numThreads, assetDatabase)) {
 }
 
@@ -333,6 +953,22 @@ void HttpEndpoint::startServer() {
     m_handler->startServer();
 }
 
+void HttpEndpoint::startScrubber(size_t bytesPerSecond, std::chrono::seconds passInterval) {
+    m_handler->startScrubber(bytesPerSecond, passInterval);
+}
+
+void HttpEndpoint::startCatalogPublisher(const std::string& path, std::chrono::seconds interval) {
+    m_handler->startCatalogPublisher(path, interval);
+}
+
+void HttpEndpoint::enableBackups(const std::string& directory, size_t blockBytes) {
+    m_handler->enableBackups(directory, blockBytes);
+}
+
+void HttpEndpoint::startReplication(const std::string& primaryAddress, std::chrono::milliseconds pollInterval) {
+    m_handler->startReplication(primaryAddress, pollInterval);
+}
+
 void HttpEndpoint::shutdown() {
     m_handler->shutdown();
 }
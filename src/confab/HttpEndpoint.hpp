@@ -1,11 +1,14 @@
 #ifndef SRC_CONFAB_HTTP_ENDPOINT_HPP_
 #define SRC_CONFAB_HTTP_ENDPOINT_HPP_
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <string>
 
 namespace Confab {
 
-class AssetDatabase;
+class AsyncAssetDatabase;
 
 /*! Class for listening and responding to HTTP messages from multiple downstream Confab instances.
  */
@@ -16,9 +19,10 @@ public:
      *
      * \param listenPort The TCP port to listen on for HTTP requests.
      * \param numThreads The number of threads to use to listen on the port.
-     * \param assetDatabase A pointer to the shared AssetDatabase instance.
+     * \param assetDatabase A pointer to the shared AsyncAssetDatabase instance. Database requests are handed off to
+     *                      its I/O threads, so the listening threads are never blocked on database access.
      */
-    HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AssetDatabase> assetDatabase);
+    HttpEndpoint(int listenPort, int numThreads, std::shared_ptr<AsyncAssetDatabase> assetDatabase);
 
     /*! Destructs an HttpHandler. Declared here to let us use std::unique_ptr with forward-declared classes.
      */
@@ -29,6 +33,38 @@ public:
      */
     void startServerThread();
 
+    /*! Starts a background thread verifying stored Asset data, with its progress and any corrupt Assets found
+     * reported from the /admin/scrub route. Stopped by shutdown().
+     *
+     * \param bytesPerSecond Maximum rate to read Asset data at while scrubbing.
+     * \param passInterval Time to wait between complete passes over the database.
+     */
+    void startScrubber(size_t bytesPerSecond, std::chrono::seconds passInterval);
+
+    /*! Starts publishing Catalog snapshots of the database for clients to download from the /catalog routes. Exports
+     * one catalog immediately, then another every interval, until shutdown().
+     *
+     * \param path Where to write the catalog file.
+     * \param interval Time between catalog exports.
+     */
+    void startCatalogPublisher(const std::string& path, std::chrono::seconds interval);
+
+    /*! Allows online backups of the database to be started with a POST to /admin/backup, and their progress followed
+     * with a GET. Each backup is written from a consistent snapshot on its own thread while requests keep being
+     * served.
+     *
+     * \param directory The directory to write backup archives into.
+     * \param blockBytes Approximate size of each archive block.
+     */
+    void enableBackups(const std::string& directory, size_t blockBytes);
+
+    /*! Makes this server a hot standby of a primary server, applying the primary's change feed to the database as it
+     * grows. Uploads are refused with 503 Service Unavailable while replicating. Stopped by shutdown().
+     * \param primaryAddress The address of the primary server, such as "http://sclork-s01.local:9080".
+     * \param pollInterval Time between polls of the primary once the standby has caught up.
+     */
+    void startReplication(const std::string& primaryAddress, std::chrono::milliseconds pollInterval);
+
     /*! Stops serving threads, closes ports.
      */
     void shutdown();
@@ -0,0 +1,78 @@
+#include "LatencyHistogram.hpp"
+
+#include <cmath>
+
+namespace Confab {
+
+constexpr size_t LatencyHistogram::kBuckets;
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+    uint64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    size_t bucket = 0;
+    while (microseconds && bucket < kBuckets - 1) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_totalMicroseconds.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(),
+        std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (const auto& bucket : m_buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::chrono::microseconds LatencyHistogram::mean() const {
+    uint64_t total = count();
+    if (total == 0) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(m_totalMicroseconds.load(std::memory_order_relaxed) / total);
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double percentile) const {
+    std::array<uint64_t, kBuckets> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return std::chrono::microseconds(0);
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total)));
+    uint64_t seen = 0;
+    size_t bucket = 0;
+    for (; bucket < kBuckets - 1; ++bucket) {
+        seen += counts[bucket];
+        if (seen >= rank && seen > 0) {
+            break;
+        }
+    }
+    return std::chrono::microseconds(uint64_t(1) << bucket);
+}
+
+std::string LatencyHistogram::summary() const {
+    return "count " + std::to_string(count()) + " mean_us " + std::to_string(mean().count()) + " p50_us " +
+        std::to_string(percentile(50.0).count()) + " p90_us " + std::to_string(percentile(90.0).count()) +
+        " p99_us " + std::to_string(percentile(99.0).count()) + " p999_us " +
+        std::to_string(percentile(99.9).count());
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_totalMicroseconds.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace Confab
@@ -0,0 +1,93 @@
+#ifndef SRC_CONFAB_LATENCY_HISTOGRAM_HPP_
+#define SRC_CONFAB_LATENCY_HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Confab {
+
+/*! Counts operation latencies in buckets of doubling width, cheaply enough to record every database operation.
+ *
+ * Bucket 0 holds latencies under 1 microsecond, and bucket i holds those from 2^(i-1) up to 2^i microseconds, with the
+ * last bucket also holding anything longer. Recording is a few relaxed atomic increments, so any number of threads can
+ * record at once. Readers see a consistent enough picture for monitoring, but not an atomic snapshot of all buckets.
+ */
+class LatencyHistogram {
+public:
+    /*! Number of buckets, enough to resolve latencies up to about half an hour.
+     */
+    static constexpr size_t kBuckets = 32;
+
+    /*! Records the time from construction to destruction in a histogram.
+     */
+    class Timer {
+    public:
+        /*! Starts timing.
+         *
+         * \param histogram The histogram to record in, which must outlive the Timer.
+         */
+        explicit Timer(LatencyHistogram* histogram) :
+            m_histogram(histogram),
+            m_start(std::chrono::steady_clock::now()) { }
+
+        /*! Records the elapsed time.
+         */
+        ~Timer() { m_histogram->record(std::chrono::steady_clock::now() - m_start); }
+
+        /// @cond UNDOCUMENTED
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+        /// @endcond UNDOCUMENTED
+
+    private:
+        LatencyHistogram* m_histogram;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    LatencyHistogram();
+
+    /*! Adds a latency to the histogram.
+     *
+     * \param latency The latency to add.
+     */
+    void record(std::chrono::nanoseconds latency);
+
+    /*! The number of latencies recorded.
+     */
+    uint64_t count() const;
+
+    /*! The mean of the latencies recorded, or zero if none have been.
+     */
+    std::chrono::microseconds mean() const;
+
+    /*! Estimates a percentile of the latencies recorded, as the upper bound of the bucket holding it.
+     *
+     * \param percentile The percentile to estimate, from 0 to 100.
+     * \return The estimated latency, or zero if none have been recorded.
+     */
+    std::chrono::microseconds percentile(double percentile) const;
+
+    /*! Formats the count, mean and 50th, 90th, 99th and 99.9th percentiles on one line, in microseconds.
+     */
+    std::string summary() const;
+
+    /*! Removes all recorded latencies.
+     */
+    void reset();
+
+    /// @cond UNDOCUMENTED
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> m_buckets;
+    std::atomic<uint64_t> m_totalMicroseconds;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_LATENCY_HISTOGRAM_HPP_
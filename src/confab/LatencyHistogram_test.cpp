@@ -0,0 +1,54 @@
+#include "LatencyHistogram.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(LatencyHistogramTest, EmptyHistogram) {
+    Confab::LatencyHistogram histogram;
+    EXPECT_EQ(0, histogram.count());
+    EXPECT_EQ(0, histogram.mean().count());
+    EXPECT_EQ(0, histogram.percentile(50.0).count());
+}
+
+TEST(LatencyHistogramTest, PercentilesAreBucketUpperBounds) {
+    Confab::LatencyHistogram histogram;
+    // 90 fast operations between 16 and 32 microseconds, and 10 slow ones between 1024 and 2048.
+    for (int i = 0; i < 90; ++i) {
+        histogram.record(std::chrono::microseconds(20));
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.record(std::chrono::microseconds(1500));
+    }
+    EXPECT_EQ(100, histogram.count());
+    EXPECT_EQ((90 * 20 + 10 * 1500) / 100, histogram.mean().count());
+    EXPECT_EQ(32, histogram.percentile(50.0).count());
+    EXPECT_EQ(32, histogram.percentile(90.0).count());
+    EXPECT_EQ(2048, histogram.percentile(91.0).count());
+    EXPECT_EQ(2048, histogram.percentile(100.0).count());
+
+    // Sub-microsecond latencies land in the first bucket, and very long ones in the last.
+    histogram.reset();
+    histogram.record(std::chrono::nanoseconds(500));
+    EXPECT_EQ(1, histogram.percentile(100.0).count());
+    histogram.record(std::chrono::hours(10));
+    EXPECT_EQ(uint64_t(1) << (Confab::LatencyHistogram::kBuckets - 1), histogram.percentile(100.0).count());
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecording) {
+    Confab::LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&histogram] {
+            for (int j = 0; j < 10000; ++j) {
+                Confab::LatencyHistogram::Timer timer(&histogram);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(40000, histogram.count());
+}
@@ -0,0 +1,122 @@
+#include "LevelDBStorageEngine.hpp"
+
+#include "glog/logging.h"
+#include "leveldb/cache.h"
+#include "leveldb/db.h"
+#include "leveldb/write_batch.h"
+
+#include <atomic>
+#include <memory>
+
+namespace Confab {
+
+/*! Wraps the LevelDB LRU block cache to count lookup hits and misses, which LevelDB does not report itself.
+ */
+class LevelDBStorageEngine::CountingCache : public leveldb::Cache {
+public:
+    explicit CountingCache(size_t capacity) :
+        m_cache(leveldb::NewLRUCache(capacity)),
+        m_hits(0),
+        m_misses(0) { }
+    ~CountingCache() override { }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge,
+        void (*deleter)(const leveldb::Slice& key, void* value)) override {
+        return m_cache->Insert(key, value, charge, deleter);
+    }
+
+    Handle* Lookup(const leveldb::Slice& key) override {
+        Handle* handle = m_cache->Lookup(key);
+        if (handle) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        return handle;
+    }
+
+    void Release(Handle* handle) override { m_cache->Release(handle); }
+    void* Value(Handle* handle) override { return m_cache->Value(handle); }
+    void Erase(const leveldb::Slice& key) override { m_cache->Erase(key); }
+    uint64_t NewId() override { return m_cache->NewId(); }
+    void Prune() override { m_cache->Prune(); }
+    size_t TotalCharge() const override { return m_cache->TotalCharge(); }
+
+    uint64_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<leveldb::Cache> m_cache;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+};
+
+LevelDBStorageEngine::LevelDBStorageEngine() {
+}
+
+LevelDBStorageEngine::~LevelDBStorageEngine() {
+    m_database.reset();
+    m_blockCache.reset();
+}
+
+bool LevelDBStorageEngine::open(const char* path, bool createNew, int cacheSize) {
+    leveldb::Options options;
+    options.create_if_missing = createNew;
+    options.error_if_exists = createNew;
+    if (cacheSize > 0) {
+        m_blockCache.reset(new CountingCache(cacheSize));
+        options.block_cache = m_blockCache.get();
+    }
+
+    leveldb::DB* database = nullptr;
+    leveldb::Status status = leveldb::DB::Open(options, path, &database);
+    if (!status.ok()) {
+        LOG(ERROR) << "Failure opening or creating database at '" << path << "'. LevelDB status: " << status.ToString();
+        return false;
+    }
+
+    LOG(INFO) << "Opened database file at '" << path << "'.";
+    m_database.reset(database);
+    return true;
+}
+
+leveldb::Status LevelDBStorageEngine::get(const leveldb::ReadOptions& options, const leveldb::Slice& key,
+    std::string* value) {
+    return m_database->Get(options, key, value);
+}
+
+leveldb::Iterator* LevelDBStorageEngine::newIterator(const leveldb::ReadOptions& options) {
+    return m_database->NewIterator(options);
+}
+
+leveldb::Status LevelDBStorageEngine::write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) {
+    return m_database->Write(options, batch);
+}
+
+const leveldb::Snapshot* LevelDBStorageEngine::getSnapshot() {
+    return m_database->GetSnapshot();
+}
+
+void LevelDBStorageEngine::releaseSnapshot(const leveldb::Snapshot* snapshot) {
+    m_database->ReleaseSnapshot(snapshot);
+}
+
+bool LevelDBStorageEngine::getProperty(const leveldb::Slice& property, std::string* value) {
+    return m_database->GetProperty(property, value);
+}
+
+void LevelDBStorageEngine::getApproximateSizes(const leveldb::Range* ranges, int count, uint64_t* sizes) {
+    m_database->GetApproximateSizes(ranges, count, sizes);
+}
+
+StorageEngine::CacheStats LevelDBStorageEngine::cacheStats() {
+    CacheStats stats;
+    if (m_blockCache) {
+        stats.hits = m_blockCache->hits();
+        stats.misses = m_blockCache->misses();
+        stats.usage = m_blockCache->TotalCharge();
+    }
+    return stats;
+}
+
+}  // namespace Confab
@@ -0,0 +1,48 @@
+#ifndef SRC_CONFAB_LEVELDB_STORAGE_ENGINE_HPP_
+#define SRC_CONFAB_LEVELDB_STORAGE_ENGINE_HPP_
+
+#include "StorageEngine.hpp"
+
+#include <memory>
+
+namespace leveldb {
+    class Cache;
+    class DB;
+}
+
+namespace Confab {
+
+/*! StorageEngine persisting to a LevelDB database directory.
+ */
+class LevelDBStorageEngine : public StorageEngine {
+public:
+    LevelDBStorageEngine();
+    ~LevelDBStorageEngine() override;
+
+    bool open(const char* path, bool createNew, int cacheSize) override;
+    leveldb::Status get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override;
+    leveldb::Iterator* newIterator(const leveldb::ReadOptions& options) override;
+    leveldb::Status write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) override;
+    const leveldb::Snapshot* getSnapshot() override;
+    void releaseSnapshot(const leveldb::Snapshot* snapshot) override;
+    bool getProperty(const leveldb::Slice& property, std::string* value) override;
+    void getApproximateSizes(const leveldb::Range* ranges, int count, uint64_t* sizes) override;
+    CacheStats cacheStats() override;
+    const char* name() const override { return "leveldb"; }
+
+    /// @cond UNDOCUMENTED
+    LevelDBStorageEngine(const LevelDBStorageEngine&) = delete;
+    LevelDBStorageEngine& operator=(const LevelDBStorageEngine&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    class CountingCache;
+
+    // The block cache must outlive the database using it, so is declared first.
+    std::unique_ptr<CountingCache> m_blockCache;
+    std::unique_ptr<leveldb::DB> m_database;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_LEVELDB_STORAGE_ENGINE_HPP_
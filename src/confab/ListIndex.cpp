@@ -0,0 +1,83 @@
+#include "ListIndex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace Confab {
+
+void ListIndex::insert(const Entry& entry) {
+    Pair pair = { entry.token, entry.assetKey };
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto& list = m_lists[entry.listKey];
+    auto position = std::lower_bound(list.byKey.begin(), list.byKey.end(), pair, databaseOrder);
+    if (position != list.byKey.end() && *position == pair) {
+        return;
+    }
+    list.byKey.insert(position, pair);
+    list.byToken.insert(std::lower_bound(list.byToken.begin(), list.byToken.end(), pair), pair);
+}
+
+void ListIndex::remove(const Entry& entry) {
+    Pair pair = { entry.token, entry.assetKey };
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto found = m_lists.find(entry.listKey);
+    if (found == m_lists.end()) {
+        return;
+    }
+    auto& list = found->second;
+    auto position = std::lower_bound(list.byKey.begin(), list.byKey.end(), pair, databaseOrder);
+    if (position != list.byKey.end() && *position == pair) {
+        list.byKey.erase(position);
+        list.byToken.erase(std::lower_bound(list.byToken.begin(), list.byToken.end(), pair));
+    }
+    if (list.byKey.empty()) {
+        m_lists.erase(found);
+    }
+}
+
+void ListIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_lists.clear();
+}
+
+size_t ListIndex::size(uint64_t listKey) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto found = m_lists.find(listKey);
+    return found == m_lists.end() ? 0 : found->second.byKey.size();
+}
+
+size_t ListIndex::getAt(uint64_t listKey, size_t offset, size_t maxPairs, uint64_t* listOut) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto found = m_lists.find(listKey);
+    if (found == m_lists.end() || offset >= found->second.byKey.size()) {
+        return 0;
+    }
+    size_t pairs = std::min(maxPairs, found->second.byKey.size() - offset);
+    std::memcpy(listOut, found->second.byKey.data() + offset, pairs * sizeof(Pair));
+    return pairs;
+}
+
+size_t ListIndex::getBefore(uint64_t listKey, uint64_t beforeToken, size_t maxPairs, uint64_t* listOut) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto found = m_lists.find(listKey);
+    if (found == m_lists.end()) {
+        return 0;
+    }
+    const auto& byToken = found->second.byToken;
+    // The first entry with a token of beforeToken or more, so every entry before it is returned, newest first.
+    auto end = std::lower_bound(byToken.begin(), byToken.end(), Pair{ beforeToken, 0 });
+    size_t pairs = std::min(maxPairs, static_cast<size_t>(end - byToken.begin()));
+    for (size_t i = 0; i < pairs; ++i) {
+        --end;
+        listOut[i * 2] = (*end)[0];
+        listOut[(i * 2) + 1] = (*end)[1];
+    }
+    return pairs;
+}
+
+bool ListIndex::databaseOrder(const Pair& a, const Pair& b) {
+    return std::memcmp(a.data(), b.data(), sizeof(Pair)) < 0;
+}
+
+}  // namespace Confab
@@ -0,0 +1,113 @@
+#ifndef SRC_CONFAB_LIST_INDEX_HPP_
+#define SRC_CONFAB_LIST_INDEX_HPP_
+
+#include <array>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Confab {
+
+/*! In-memory position index over the entries of every List, supporting constant-time list length, access to list
+ * entries by offset, and access to the most recently added entries.
+ *
+ * Entries of each List are kept in a vector sorted in the same order as the List entry keys in the database, so the
+ * offset of an entry here is its position when iterating the List from the beginning. Because tokens are stored
+ * little-endian in those keys, that is not the order entries were added in, so each List also keeps its entries in a
+ * second vector sorted by token. The sentinel entries at the beginning and end of each List are not indexed. Safe to
+ * call from multiple threads, and is updated incrementally as entries are stored and deleted.
+ */
+class ListIndex {
+public:
+    /*! A single entry in a List.
+     */
+    struct Entry {
+        /*! The key of the List containing the entry.
+         */
+        uint64_t listKey;
+
+        /*! The List token of the entry, the time it was added.
+         */
+        uint64_t token;
+
+        /*! The key of the Asset the entry refers to.
+         */
+        uint64_t assetKey;
+    };
+
+    /*! Constructs an empty ListIndex.
+     */
+    ListIndex() = default;
+
+    /*! Adds an entry to the index. Adding an entry already present does nothing.
+     *
+     * \param entry The entry to add.
+     */
+    void insert(const Entry& entry);
+
+    /*! Removes an entry from the index, if present.
+     *
+     * \param entry The entry to remove.
+     */
+    void remove(const Entry& entry);
+
+    /*! Removes all entries from the index.
+     */
+    void clear();
+
+    /*! The number of entries in a List.
+     *
+     * \param listKey The key of the List to count.
+     * \return The number of entries in the List, or 0 if the List is unknown.
+     */
+    size_t size(uint64_t listKey) const;
+
+    /*! Populates the provided buffer with <token, key> pairs from a List, starting at an offset.
+     *
+     * \param listKey The key of the List to draw from.
+     * \param offset The position of the first entry to return, where 0 is the first entry in the List.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the ordered list.
+     * \return The number of pairs written into listOut, which is 0 if offset is at or past the end of the List.
+     */
+    size_t getAt(uint64_t listKey, size_t offset, size_t maxPairs, uint64_t* listOut) const;
+
+    /*! Populates the provided buffer with <token, key> pairs from a List with tokens less than beforeToken, in
+     * decreasing token order, so that the most recently added entries come first.
+     *
+     * \param listKey The key of the List to draw from.
+     * \param beforeToken Only entries with tokens less than this are returned. Pass kEndList for the most recent.
+     * \param maxPairs The maximum number of <token, key> pairs to put into listOut.
+     * \param listOut A pointer to a buffer to hold the list, in reverse order.
+     * \return The number of pairs written into listOut, which is 0 if no entry is older than beforeToken.
+     */
+    size_t getBefore(uint64_t listKey, uint64_t beforeToken, size_t maxPairs, uint64_t* listOut) const;
+
+    /// @cond UNDOCUMENTED
+    ListIndex(const ListIndex&) = delete;
+    ListIndex& operator=(const ListIndex&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    // A <token, key> pair, laid out as in the List entry database key.
+    using Pair = std::array<uint64_t, 2>;
+
+    /*! The entries of a single List, in both orders.
+     */
+    struct List {
+        std::vector<Pair> byKey;
+        std::vector<Pair> byToken;
+    };
+
+    /*! Orders pairs as the database orders the bytes of their keys, which is not numerical order.
+     */
+    static bool databaseOrder(const Pair& a, const Pair& b);
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<uint64_t, List> m_lists;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_LIST_INDEX_HPP_
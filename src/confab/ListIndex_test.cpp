@@ -0,0 +1,83 @@
+#include "ListIndex.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+TEST(ListIndexTest, EmptyIndex) {
+    Confab::ListIndex index;
+    uint64_t pairs[2];
+    EXPECT_EQ(0, index.size(1));
+    EXPECT_EQ(0, index.getAt(1, 0, 1, pairs));
+}
+
+TEST(ListIndexTest, CountsEachList) {
+    Confab::ListIndex index;
+    index.insert({ 1, 100, 7 });
+    index.insert({ 1, 200, 8 });
+    index.insert({ 2, 100, 7 });
+    // Storing the same entry twice does not count it twice.
+    index.insert({ 1, 200, 8 });
+    EXPECT_EQ(2, index.size(1));
+    EXPECT_EQ(1, index.size(2));
+
+    index.remove({ 1, 100, 7 });
+    index.remove({ 1, 300, 9 });
+    EXPECT_EQ(1, index.size(1));
+    index.remove({ 2, 100, 7 });
+    EXPECT_EQ(0, index.size(2));
+}
+
+TEST(ListIndexTest, OffsetsFollowDatabaseKeyOrder) {
+    Confab::ListIndex index;
+    std::vector<uint64_t> tokens = { 0x0200, 0x0101, 0x0003, 0x0102 };
+    for (auto token : tokens) {
+        index.insert({ 5, token, token + 1 });
+    }
+
+    // Tokens are stored little-endian in the database keys, so entries sort by their lowest byte first.
+    uint64_t pairs[8];
+    ASSERT_EQ(4, index.getAt(5, 0, 4, pairs));
+    EXPECT_EQ(0x0200, pairs[0]);
+    EXPECT_EQ(0x0201, pairs[1]);
+    EXPECT_EQ(0x0101, pairs[2]);
+    EXPECT_EQ(0x0102, pairs[4]);
+    EXPECT_EQ(0x0003, pairs[6]);
+
+    ASSERT_EQ(2, index.getAt(5, 2, 4, pairs));
+    EXPECT_EQ(0x0102, pairs[0]);
+    EXPECT_EQ(0x0003, pairs[2]);
+    EXPECT_EQ(0x0004, pairs[3]);
+
+    EXPECT_EQ(1, index.getAt(5, 1, 1, pairs));
+    EXPECT_EQ(0x0101, pairs[0]);
+    EXPECT_EQ(0, index.getAt(5, 4, 4, pairs));
+}
+
+TEST(ListIndexTest, GetBeforeReturnsNewestFirst) {
+    Confab::ListIndex index;
+    std::vector<uint64_t> tokens = { 0x0200, 0x0101, 0x0003, 0x0102 };
+    for (auto token : tokens) {
+        index.insert({ 5, token, token + 1 });
+    }
+
+    // Unlike getAt(), entries come back in numerical token order, newest first.
+    uint64_t pairs[8];
+    ASSERT_EQ(3, index.getBefore(5, UINT64_MAX, 3, pairs));
+    EXPECT_EQ(0x0200, pairs[0]);
+    EXPECT_EQ(0x0201, pairs[1]);
+    EXPECT_EQ(0x0102, pairs[2]);
+    EXPECT_EQ(0x0101, pairs[4]);
+
+    // Continuing from the oldest token returned gives the rest, without repeating it.
+    ASSERT_EQ(1, index.getBefore(5, 0x0101, 4, pairs));
+    EXPECT_EQ(0x0003, pairs[0]);
+    EXPECT_EQ(0x0004, pairs[1]);
+    EXPECT_EQ(0, index.getBefore(5, 0x0003, 4, pairs));
+
+    index.remove({ 5, 0x0200, 0x0201 });
+    ASSERT_EQ(1, index.getBefore(5, UINT64_MAX, 1, pairs));
+    EXPECT_EQ(0x0102, pairs[0]);
+    EXPECT_EQ(0, index.getBefore(6, UINT64_MAX, 4, pairs));
+}
@@ -0,0 +1,351 @@
+#include "MemoryStorageEngine.hpp"
+
+#include "glog/logging.h"
+#include "leveldb/db.h"
+#include "leveldb/iterator.h"
+#include "leveldb/write_batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace {
+
+/*! Maximum number of levels in the skip list, enough for many millions of versions with a branching factor of 4.
+ */
+static const int kMaxHeight = 12;
+
+/*! Orders two keys bytewise as unsigned characters, the same order LevelDB uses.
+ */
+inline int compareKeys(const leveldb::Slice& a, const leveldb::Slice& b) {
+    int result = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    if (result == 0) {
+        if (a.size() < b.size()) {
+            return -1;
+        } else if (a.size() > b.size()) {
+            return 1;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+namespace Confab {
+
+/*! A single version of a key. Nodes are immutable once linked into the list, apart from their next pointers.
+ */
+struct MemoryStorageEngine::Node {
+    Node(const leveldb::Slice& nodeKey, uint64_t nodeSequence, bool nodeDeletion, const leveldb::Slice& nodeValue,
+        int height) :
+        key(nodeKey.data(), nodeKey.size()),
+        value(nodeValue.data(), nodeValue.size()),
+        sequence(nodeSequence),
+        deletion(nodeDeletion),
+        next(new std::atomic<Node*>[height]()) { }
+
+    Node* getNext(int level) const { return next[level].load(std::memory_order_acquire); }
+    void setNext(int level, Node* node) { next[level].store(node, std::memory_order_release); }
+
+    /*! Orders this version relative to the version of key at sequence. Versions are ordered by key, and then newest
+     * first, so that the first version of a key found at or after a sequence number is the one visible at it.
+     */
+    int compare(const leveldb::Slice& otherKey, uint64_t otherSequence) const {
+        int result = compareKeys(key, otherKey);
+        if (result == 0) {
+            if (sequence > otherSequence) {
+                return -1;
+            } else if (sequence < otherSequence) {
+                return 1;
+            }
+        }
+        return result;
+    }
+
+    const std::string key;
+    const std::string value;
+    const uint64_t sequence;
+    const bool deletion;
+    std::unique_ptr<std::atomic<Node*>[]> next;
+};
+
+/*! Adds the operations of a WriteBatch to the list as new versions, with consecutive sequence numbers.
+ */
+class MemoryStorageEngine::Inserter : public leveldb::WriteBatch::Handler {
+public:
+    Inserter(MemoryStorageEngine* engine, uint64_t sequence) : m_engine(engine), m_sequence(sequence) { }
+    ~Inserter() override { }
+
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+        m_engine->insert(key, ++m_sequence, false, value);
+    }
+
+    void Delete(const leveldb::Slice& key) override {
+        m_engine->insert(key, ++m_sequence, true, leveldb::Slice());
+    }
+
+    uint64_t sequence() const { return m_sequence; }
+
+private:
+    MemoryStorageEngine* m_engine;
+    uint64_t m_sequence;
+};
+
+/*! Iterates over the newest version of each key visible at a sequence number, skipping deleted keys.
+ */
+class MemoryStorageEngine::Iterator : public leveldb::Iterator {
+public:
+    Iterator(const MemoryStorageEngine* engine, uint64_t sequence) :
+        m_engine(engine),
+        m_sequence(sequence),
+        m_node(nullptr) { }
+    ~Iterator() override { }
+
+    bool Valid() const override { return m_node != nullptr; }
+
+    void SeekToFirst() override {
+        m_node = m_engine->m_head->getNext(0);
+        forwardToVisible();
+    }
+
+    void SeekToLast() override {
+        m_node = listNode(m_engine->findLast());
+        backwardToVisible();
+    }
+
+    void Seek(const leveldb::Slice& target) override {
+        m_node = m_engine->findGreaterOrEqual(target, m_sequence, nullptr);
+        forwardToVisible();
+    }
+
+    void Next() override {
+        m_node = skipKey(m_node);
+        forwardToVisible();
+    }
+
+    void Prev() override {
+        m_node = listNode(m_engine->findLessThan(m_node->key));
+        backwardToVisible();
+    }
+
+    leveldb::Slice key() const override { return leveldb::Slice(m_node->key); }
+    leveldb::Slice value() const override { return leveldb::Slice(m_node->value); }
+    leveldb::Status status() const override { return leveldb::Status::OK(); }
+
+private:
+    Node* listNode(Node* node) const { return node == m_engine->m_head ? nullptr : node; }
+
+    /*! Returns the first node of the key following the key of node.
+     */
+    Node* skipKey(Node* node) const {
+        Node* next = node->getNext(0);
+        while (next && next->key == node->key) {
+            next = next->getNext(0);
+        }
+        return next;
+    }
+
+    /*! Moves forward from m_node to the first version visible at m_sequence whose key is not deleted.
+     */
+    void forwardToVisible() {
+        while (m_node) {
+            if (m_node->sequence > m_sequence) {
+                m_node = m_node->getNext(0);
+            } else if (m_node->deletion) {
+                m_node = skipKey(m_node);
+            } else {
+                return;
+            }
+        }
+    }
+
+    /*! Moves from any version of a key in m_node to its version visible at m_sequence, or if the key is not visible
+     * backward to the nearest previous key that is.
+     */
+    void backwardToVisible() {
+        while (m_node) {
+            Node* visible = m_engine->findGreaterOrEqual(m_node->key, m_sequence, nullptr);
+            if (visible && visible->key == m_node->key && !visible->deletion) {
+                m_node = visible;
+                return;
+            }
+            m_node = listNode(m_engine->findLessThan(m_node->key));
+        }
+    }
+
+    const MemoryStorageEngine* m_engine;
+    uint64_t m_sequence;
+    Node* m_node;
+};
+
+/*! A snapshot is just the last sequence number published when it was taken, as versions are never reclaimed.
+ */
+class MemoryStorageEngine::Snapshot : public leveldb::Snapshot {
+public:
+    explicit Snapshot(uint64_t snapshotSequence) : sequence(snapshotSequence) { }
+    ~Snapshot() override { }
+
+    const uint64_t sequence;
+};
+
+MemoryStorageEngine::MemoryStorageEngine() :
+    m_head(new Node(leveldb::Slice(), 0, false, leveldb::Slice(), kMaxHeight)),
+    m_maxHeight(1),
+    m_lastSequence(0) {
+}
+
+MemoryStorageEngine::~MemoryStorageEngine() {
+    Node* node = m_head;
+    while (node) {
+        Node* next = node->getNext(0);
+        delete node;
+        node = next;
+    }
+}
+
+bool MemoryStorageEngine::open(const char* path, bool /* createNew */, int /* cacheSize */) {
+    LOG(INFO) << "Opened in-memory database, nothing will be saved to '" << path << "'.";
+    return true;
+}
+
+leveldb::Status MemoryStorageEngine::get(const leveldb::ReadOptions& options, const leveldb::Slice& key,
+    std::string* value) {
+    Node* node = findGreaterOrEqual(key, readSequence(options), nullptr);
+    if (node && compareKeys(node->key, key) == 0 && !node->deletion) {
+        value->assign(node->value);
+        return leveldb::Status::OK();
+    }
+    return leveldb::Status::NotFound(key);
+}
+
+leveldb::Iterator* MemoryStorageEngine::newIterator(const leveldb::ReadOptions& options) {
+    return new Iterator(this, readSequence(options));
+}
+
+leveldb::Status MemoryStorageEngine::write(const leveldb::WriteOptions& /* options */, leveldb::WriteBatch* batch) {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Inserter inserter(this, m_lastSequence.load(std::memory_order_relaxed));
+    leveldb::Status status = batch->Iterate(&inserter);
+    // Versions linked in above are invisible to readers until their sequence numbers are published here. If the batch
+    // failed part way the sequence numbers are still published, as LevelDB would have applied the same prefix.
+    m_lastSequence.store(inserter.sequence(), std::memory_order_release);
+    return status;
+}
+
+const leveldb::Snapshot* MemoryStorageEngine::getSnapshot() {
+    return new Snapshot(m_lastSequence.load(std::memory_order_acquire));
+}
+
+void MemoryStorageEngine::releaseSnapshot(const leveldb::Snapshot* snapshot) {
+    delete static_cast<const Snapshot*>(snapshot);
+}
+
+bool MemoryStorageEngine::getProperty(const leveldb::Slice& /* property */, std::string* /* value */) {
+    return false;
+}
+
+void MemoryStorageEngine::getApproximateSizes(const leveldb::Range* ranges, int count, uint64_t* sizes) {
+    // There is no file layout to estimate from, so count the live keys and values in each range exactly.
+    std::unique_ptr<leveldb::Iterator> iterator(newIterator(leveldb::ReadOptions()));
+    for (int i = 0; i < count; ++i) {
+        sizes[i] = 0;
+        for (iterator->Seek(ranges[i].start); iterator->Valid() && compareKeys(iterator->key(), ranges[i].limit) < 0;
+            iterator->Next()) {
+            sizes[i] += iterator->key().size() + iterator->value().size();
+        }
+    }
+}
+
+uint64_t MemoryStorageEngine::readSequence(const leveldb::ReadOptions& options) const {
+    if (options.snapshot) {
+        return static_cast<const Snapshot*>(options.snapshot)->sequence;
+    }
+    return m_lastSequence.load(std::memory_order_acquire);
+}
+
+MemoryStorageEngine::Node* MemoryStorageEngine::findGreaterOrEqual(const leveldb::Slice& key, uint64_t sequence,
+    Node** prev) const {
+    Node* node = m_head;
+    int level = m_maxHeight.load(std::memory_order_relaxed) - 1;
+    while (true) {
+        Node* next = node->getNext(level);
+        if (next && next->compare(key, sequence) < 0) {
+            node = next;
+        } else {
+            if (prev) {
+                prev[level] = node;
+            }
+            if (level == 0) {
+                return next;
+            }
+            --level;
+        }
+    }
+}
+
+MemoryStorageEngine::Node* MemoryStorageEngine::findLessThan(const leveldb::Slice& key) const {
+    // Versions of a key are ordered newest first, so the largest sequence number sorts before all of them.
+    uint64_t newest = std::numeric_limits<uint64_t>::max();
+    Node* node = m_head;
+    int level = m_maxHeight.load(std::memory_order_relaxed) - 1;
+    while (true) {
+        Node* next = node->getNext(level);
+        if (next && next->compare(key, newest) < 0) {
+            node = next;
+        } else if (level == 0) {
+            return node;
+        } else {
+            --level;
+        }
+    }
+}
+
+MemoryStorageEngine::Node* MemoryStorageEngine::findLast() const {
+    Node* node = m_head;
+    int level = m_maxHeight.load(std::memory_order_relaxed) - 1;
+    while (true) {
+        Node* next = node->getNext(level);
+        if (next) {
+            node = next;
+        } else if (level == 0) {
+            return node;
+        } else {
+            --level;
+        }
+    }
+}
+
+void MemoryStorageEngine::insert(const leveldb::Slice& key, uint64_t sequence, bool deletion,
+    const leveldb::Slice& value) {
+    Node* prev[kMaxHeight];
+    findGreaterOrEqual(key, sequence, prev);
+
+    int height = randomHeight();
+    int maxHeight = m_maxHeight.load(std::memory_order_relaxed);
+    if (height > maxHeight) {
+        for (int level = maxHeight; level < height; ++level) {
+            prev[level] = m_head;
+        }
+        // Readers seeing the new height before the new node is linked find null pointers from m_head at the new
+        // levels, and simply move down a level.
+        m_maxHeight.store(height, std::memory_order_relaxed);
+    }
+
+    Node* node = new Node(key, sequence, deletion, value, height);
+    for (int level = 0; level < height; ++level) {
+        node->next[level].store(prev[level]->getNext(level), std::memory_order_relaxed);
+        prev[level]->setNext(level, node);
+    }
+}
+
+int MemoryStorageEngine::randomHeight() {
+    int height = 1;
+    while (height < kMaxHeight && (m_random() % 4) == 0) {
+        ++height;
+    }
+    return height;
+}
+
+}  // namespace Confab
@@ -0,0 +1,82 @@
+#ifndef SRC_CONFAB_MEMORY_STORAGE_ENGINE_HPP_
+#define SRC_CONFAB_MEMORY_STORAGE_ENGINE_HPP_
+
+#include "StorageEngine.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+namespace Confab {
+
+/*! StorageEngine holding all data in memory, for hermetic tests and for benchmarks that exclude disk I/O. Nothing is
+ * persisted, the store starts empty every time it is opened.
+ *
+ * Data is kept in a multi-version skip list. Every write adds new versions of its keys, tagged with a sequence number,
+ * and deletions add tombstone versions. Readers never lock: they see the newest version of each key no newer than the
+ * sequence number of their snapshot, and a batch becomes visible all at once when the last sequence number is
+ * published after all of its versions are linked in. Writers are serialized by a mutex. Old versions are never
+ * reclaimed, so memory use grows with every write until the engine is destroyed.
+ */
+class MemoryStorageEngine : public StorageEngine {
+public:
+    MemoryStorageEngine();
+    ~MemoryStorageEngine() override;
+
+    bool open(const char* path, bool createNew, int cacheSize) override;
+    leveldb::Status get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override;
+    leveldb::Iterator* newIterator(const leveldb::ReadOptions& options) override;
+    leveldb::Status write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) override;
+    const leveldb::Snapshot* getSnapshot() override;
+    void releaseSnapshot(const leveldb::Snapshot* snapshot) override;
+    bool getProperty(const leveldb::Slice& property, std::string* value) override;
+    void getApproximateSizes(const leveldb::Range* ranges, int count, uint64_t* sizes) override;
+    CacheStats cacheStats() override { return CacheStats(); }
+    const char* name() const override { return "memory"; }
+
+    /// @cond UNDOCUMENTED
+    MemoryStorageEngine(const MemoryStorageEngine&) = delete;
+    MemoryStorageEngine& operator=(const MemoryStorageEngine&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    struct Node;
+    class Inserter;
+    class Iterator;
+    class Snapshot;
+
+    /*! The sequence number to read at, from the snapshot in options or else the latest.
+     */
+    uint64_t readSequence(const leveldb::ReadOptions& options) const;
+
+    /*! Returns the first node at or after the version of key at sequence, or nullptr if none. If prev is non-null it
+     * is filled with the last node before that position at every level.
+     */
+    Node* findGreaterOrEqual(const leveldb::Slice& key, uint64_t sequence, Node** prev) const;
+
+    /*! Returns the last node before any version of key, or m_head if none.
+     */
+    Node* findLessThan(const leveldb::Slice& key) const;
+
+    /*! Returns the last node in the list, or m_head if empty.
+     */
+    Node* findLast() const;
+
+    /*! Links a new version into the list. Call with m_writeMutex held.
+     */
+    void insert(const leveldb::Slice& key, uint64_t sequence, bool deletion, const leveldb::Slice& value);
+
+    int randomHeight();
+
+    Node* m_head;
+    std::atomic<int> m_maxHeight;
+    std::atomic<uint64_t> m_lastSequence;
+
+    std::mutex m_writeMutex;
+    std::minstd_rand m_random;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_MEMORY_STORAGE_ENGINE_HPP_
@@ -0,0 +1,196 @@
+#include "MemoryStorageEngine.hpp"
+
+#include "leveldb/db.h"
+#include "leveldb/iterator.h"
+#include "leveldb/write_batch.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void put(Confab::StorageEngine* engine, const std::string& key, const std::string& value) {
+    leveldb::WriteBatch batch;
+    batch.Put(key, value);
+    ASSERT_TRUE(engine->write(leveldb::WriteOptions(), &batch).ok());
+}
+
+void remove(Confab::StorageEngine* engine, const std::string& key) {
+    leveldb::WriteBatch batch;
+    batch.Delete(key);
+    ASSERT_TRUE(engine->write(leveldb::WriteOptions(), &batch).ok());
+}
+
+std::vector<std::string> scanKeys(Confab::StorageEngine* engine, const leveldb::ReadOptions& options) {
+    std::vector<std::string> keys;
+    std::unique_ptr<leveldb::Iterator> iterator(engine->newIterator(options));
+    for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+        keys.push_back(iterator->key().ToString());
+    }
+    return keys;
+}
+
+}  // namespace
+
+TEST(MemoryStorageEngineTest, PutGetDelete) {
+    Confab::MemoryStorageEngine engine;
+    ASSERT_TRUE(engine.open("unused", true, 0));
+    std::string value;
+    EXPECT_TRUE(engine.get(leveldb::ReadOptions(), "a", &value).IsNotFound());
+
+    put(&engine, "a", "first");
+    ASSERT_TRUE(engine.get(leveldb::ReadOptions(), "a", &value).ok());
+    EXPECT_EQ("first", value);
+
+    put(&engine, "a", "second");
+    ASSERT_TRUE(engine.get(leveldb::ReadOptions(), "a", &value).ok());
+    EXPECT_EQ("second", value);
+
+    remove(&engine, "a");
+    EXPECT_TRUE(engine.get(leveldb::ReadOptions(), "a", &value).IsNotFound());
+    EXPECT_TRUE(scanKeys(&engine, leveldb::ReadOptions()).empty());
+}
+
+TEST(MemoryStorageEngineTest, IteratesInBytewiseOrder) {
+    Confab::MemoryStorageEngine engine;
+    ASSERT_TRUE(engine.open("unused", true, 0));
+    // High bytes must sort after low ones, as they do in LevelDB, and prefixes before longer keys.
+    put(&engine, std::string("\xff", 1), "high");
+    put(&engine, "ab", "long");
+    put(&engine, "a", "short");
+    put(&engine, std::string("\x01", 1), "low");
+    remove(&engine, "ab");
+    put(&engine, "b", "b");
+
+    std::vector<std::string> expected = { std::string("\x01", 1), "a", "b", std::string("\xff", 1) };
+    EXPECT_EQ(expected, scanKeys(&engine, leveldb::ReadOptions()));
+
+    std::unique_ptr<leveldb::Iterator> iterator(engine.newIterator(leveldb::ReadOptions()));
+    iterator->SeekToLast();
+    std::vector<std::string> reversed;
+    for (; iterator->Valid(); iterator->Prev()) {
+        reversed.push_back(iterator->key().ToString());
+    }
+    EXPECT_EQ(std::vector<std::string>(expected.rbegin(), expected.rend()), reversed);
+
+    iterator->Seek("aa");
+    ASSERT_TRUE(iterator->Valid());
+    EXPECT_EQ("b", iterator->key().ToString());
+    iterator->Prev();
+    ASSERT_TRUE(iterator->Valid());
+    EXPECT_EQ("a", iterator->key().ToString());
+    EXPECT_EQ("short", iterator->value().ToString());
+}
+
+TEST(MemoryStorageEngineTest, SnapshotsSeeOnlyEarlierWrites) {
+    Confab::MemoryStorageEngine engine;
+    ASSERT_TRUE(engine.open("unused", true, 0));
+    put(&engine, "a", "old");
+    put(&engine, "b", "old");
+
+    leveldb::ReadOptions options;
+    options.snapshot = engine.getSnapshot();
+    std::unique_ptr<leveldb::Iterator> implicit(engine.newIterator(leveldb::ReadOptions()));
+    put(&engine, "a", "new");
+    remove(&engine, "b");
+    put(&engine, "c", "new");
+
+    std::string value;
+    ASSERT_TRUE(engine.get(options, "a", &value).ok());
+    EXPECT_EQ("old", value);
+    ASSERT_TRUE(engine.get(options, "b", &value).ok());
+    EXPECT_TRUE(engine.get(options, "c", &value).IsNotFound());
+    EXPECT_EQ(std::vector<std::string>({ "a", "b" }), scanKeys(&engine, options));
+
+    // An iterator made without a snapshot reads as of when it was made.
+    implicit->SeekToLast();
+    ASSERT_TRUE(implicit->Valid());
+    EXPECT_EQ("b", implicit->key().ToString());
+
+    EXPECT_EQ(std::vector<std::string>({ "a", "c" }), scanKeys(&engine, leveldb::ReadOptions()));
+    engine.releaseSnapshot(options.snapshot);
+}
+
+TEST(MemoryStorageEngineTest, BatchesApplyInOrder) {
+    Confab::MemoryStorageEngine engine;
+    ASSERT_TRUE(engine.open("unused", true, 0));
+    leveldb::WriteBatch batch;
+    batch.Put("a", "first");
+    batch.Delete("a");
+    batch.Put("a", "last");
+    batch.Put("b", "b");
+    batch.Delete("b");
+    ASSERT_TRUE(engine.write(leveldb::WriteOptions(), &batch).ok());
+
+    std::string value;
+    ASSERT_TRUE(engine.get(leveldb::ReadOptions(), "a", &value).ok());
+    EXPECT_EQ("last", value);
+    EXPECT_TRUE(engine.get(leveldb::ReadOptions(), "b", &value).IsNotFound());
+}
+
+TEST(MemoryStorageEngineTest, ApproximateSizesCountLiveRecords) {
+    Confab::MemoryStorageEngine engine;
+    ASSERT_TRUE(engine.open("unused", true, 0));
+    put(&engine, "a1", "12345");
+    put(&engine, "a2", "123");
+    put(&engine, "b1", "1");
+    remove(&engine, "a2");
+
+    leveldb::Range ranges[] = { leveldb::Range("a", "b"), leveldb::Range("b", "c"), leveldb::Range("c", "d") };
+    uint64_t sizes[3];
+    engine.getApproximateSizes(ranges, 3, sizes);
+    EXPECT_EQ(7, sizes[0]);
+    EXPECT_EQ(3, sizes[1]);
+    EXPECT_EQ(0, sizes[2]);
+    std::string value;
+    EXPECT_FALSE(engine.getProperty("leveldb.stats", &value));
+}
+
+TEST(MemoryStorageEngineTest, ReadersNeverSeePartialBatches) {
+    Confab::MemoryStorageEngine engine;
+    ASSERT_TRUE(engine.open("unused", true, 0));
+    const int kBatches = 2000;
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+
+    // Each batch adds one key under each of two prefixes, so every consistent scan finds as many of one as the other.
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&engine, &done, &torn] {
+            while (!done) {
+                int aKeys = 0;
+                int bKeys = 0;
+                std::unique_ptr<leveldb::Iterator> iterator(engine.newIterator(leveldb::ReadOptions()));
+                for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next()) {
+                    if (iterator->key()[0] == 'a') {
+                        ++aKeys;
+                    } else {
+                        ++bKeys;
+                    }
+                }
+                if (aKeys != bKeys) {
+                    ++torn;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < kBatches; ++i) {
+        leveldb::WriteBatch batch;
+        batch.Put("a" + std::to_string(i), "value");
+        batch.Put("b" + std::to_string(i), "value");
+        ASSERT_TRUE(engine.write(leveldb::WriteOptions(), &batch).ok());
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, torn);
+    EXPECT_EQ(2 * kBatches, scanKeys(&engine, leveldb::ReadOptions()).size());
+}
@@ -0,0 +1,152 @@
+#include "NameIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+namespace {
+
+/*! Fraction of query trigrams a name must share with the query to be returned as a match. Coverage of the query
+ * rather than full set similarity is used so that short partial names, as typed into a GUI, still match long names.
+ */
+static const float kMinimumCoverage = 0.5f;
+
+/*! Score bonus given to names that begin with the query, so that plain prefix matches sort ahead of fuzzy ones.
+ */
+static const float kPrefixBonus = 1.0f;
+
+inline std::string normalize(const std::string& name) {
+    std::string normal(name.size(), ' ');
+    std::transform(name.begin(), name.end(), normal.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return normal;
+}
+
+}  // namespace
+
+namespace Confab {
+
+void NameIndex::insert(const std::string& name, uint64_t key) {
+    if (name.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> trigrams;
+    makeTrigrams(name, &trigrams);
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto existing = m_nameToEntry.find(name);
+    if (existing != m_nameToEntry.end()) {
+        // Names are unique, re-storing a name only re-points it at a new key.
+        m_entries[existing->second].key = key;
+        return;
+    }
+
+    uint32_t entryNumber = static_cast<uint32_t>(m_entries.size());
+    m_entries.push_back(Entry{name, key, false});
+    m_nameToEntry.emplace(name, entryNumber);
+    for (auto trigram : trigrams) {
+        m_postings[trigram].push_back(entryNumber);
+    }
+}
+
+void NameIndex::remove(const std::string& name) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto existing = m_nameToEntry.find(name);
+    if (existing == m_nameToEntry.end()) {
+        return;
+    }
+    m_entries[existing->second].removed = true;
+    m_nameToEntry.erase(existing);
+}
+
+void NameIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_entries.clear();
+    m_nameToEntry.clear();
+    m_postings.clear();
+}
+
+size_t NameIndex::search(const std::string& query, size_t maxResults, std::vector<Match>* matches) const {
+    if (query.empty() || maxResults == 0) {
+        return 0;
+    }
+
+    std::vector<uint32_t> trigrams;
+    makeTrigrams(query, &trigrams);
+    std::string normalQuery = normalize(query);
+
+    std::vector<Match> candidates;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+        // Count the query trigrams each entry shares, by walking the posting list of each query trigram.
+        std::unordered_map<uint32_t, uint32_t> shared;
+        for (auto trigram : trigrams) {
+            auto postings = m_postings.find(trigram);
+            if (postings == m_postings.end()) {
+                continue;
+            }
+            for (auto entryNumber : postings->second) {
+                ++shared[entryNumber];
+            }
+        }
+
+        for (const auto& hit : shared) {
+            float coverage = static_cast<float>(hit.second) / static_cast<float>(trigrams.size());
+            if (coverage < kMinimumCoverage) {
+                continue;
+            }
+            const Entry& entry = m_entries[hit.first];
+            if (entry.removed) {
+                continue;
+            }
+            float score = coverage;
+            if (normalize(entry.name).compare(0, normalQuery.size(), normalQuery) == 0) {
+                score += kPrefixBonus;
+            }
+            candidates.push_back(Match{entry.name, entry.key, score});
+        }
+    }
+
+    // Highest scores first, with shorter names breaking ties as they are the closer match to the query.
+    size_t resultCount = std::min(maxResults, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + resultCount, candidates.end(),
+        [](const Match& a, const Match& b) {
+            if (a.score != b.score) {
+                return a.score > b.score;
+            }
+            if (a.name.size() != b.name.size()) {
+                return a.name.size() < b.name.size();
+            }
+            return a.name < b.name;
+        });
+
+    matches->insert(matches->end(), candidates.begin(), candidates.begin() + resultCount);
+    return resultCount;
+}
+
+size_t NameIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_nameToEntry.size();
+}
+
+// static
+void NameIndex::makeTrigrams(const std::string& name, std::vector<uint32_t>* trigrams) {
+    // Pad with two leading spaces and one trailing, so that the start of the name is weighted more heavily and names
+    // shorter than three characters still produce trigrams.
+    std::string padded = "  " + normalize(name) + " ";
+    trigrams->clear();
+    trigrams->reserve(padded.size() - 2);
+    for (size_t i = 0; i + 2 < padded.size(); ++i) {
+        uint32_t trigram = (static_cast<uint32_t>(static_cast<uint8_t>(padded[i])) << 16) |
+                           (static_cast<uint32_t>(static_cast<uint8_t>(padded[i + 1])) << 8) |
+                           static_cast<uint32_t>(static_cast<uint8_t>(padded[i + 2]));
+        trigrams->push_back(trigram);
+    }
+    std::sort(trigrams->begin(), trigrams->end());
+    trigrams->erase(std::unique(trigrams->begin(), trigrams->end()), trigrams->end());
+}
+
+}  // namespace Confab
@@ -0,0 +1,101 @@
+#ifndef SRC_CONFAB_NAME_INDEX_HPP_
+#define SRC_CONFAB_NAME_INDEX_HPP_
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Confab {
+
+/*! In-memory trigram index over Asset or List names, supporting fuzzy matching of partial or misspelled names.
+ *
+ * Names are normalized to lower case and padded, then broken into overlapping three-character sequences. Each trigram
+ * maps to a posting list of the names that contain it. A search counts the trigrams shared between the query and each
+ * candidate name, so a search costs time proportional to the posting lists of the query trigrams, not to the number
+ * of names indexed. Safe to call from multiple threads, and is updated incrementally as new names are stored.
+ */
+class NameIndex {
+public:
+    /*! A single name search result.
+     */
+    struct Match {
+        /*! The matched name, as stored.
+         */
+        std::string name;
+
+        /*! The key the name currently refers to.
+         */
+        uint64_t key;
+
+        /*! Relevance of the match, higher is better. Names that start with the query score above 1.0.
+         */
+        float score;
+    };
+
+    /*! Constructs an empty NameIndex.
+     */
+    NameIndex() = default;
+
+    /*! Adds a name to the index, or updates the key associated with it if the name is already present.
+     *
+     * \param name The name to index. Empty names are ignored.
+     * \param key The key the name refers to.
+     */
+    void insert(const std::string& name, uint64_t key);
+
+    /*! Removes a name from the index, if present.
+     *
+     * \param name The name to remove.
+     */
+    void remove(const std::string& name);
+
+    /*! Removes all names from the index.
+     */
+    void clear();
+
+    /*! Finds the names most similar to the query.
+     *
+     * \param query The partial or approximate name to look for.
+     * \param maxResults The maximum number of matches to return.
+     * \param matches A vector to append the matches to, in descending order of score.
+     * \return The number of matches appended.
+     */
+    size_t search(const std::string& query, size_t maxResults, std::vector<Match>* matches) const;
+
+    /*! The number of names in the index.
+     *
+     * \return The count of unique names indexed.
+     */
+    size_t size() const;
+
+    /// @cond UNDOCUMENTED
+    NameIndex(const NameIndex&) = delete;
+    NameIndex& operator=(const NameIndex&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    /*! Computes the unique trigrams of a name, after normalization.
+     *
+     * \param name The name to break into trigrams.
+     * \param trigrams Output vector of unique trigrams, each packed into the low 24 bits of a uint32_t.
+     */
+    static void makeTrigrams(const std::string& name, std::vector<uint32_t>* trigrams);
+
+    struct Entry {
+        std::string name;
+        uint64_t key;
+        // Removed entries stay in the posting lists, which are append-only, but are skipped during search.
+        bool removed;
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, uint32_t> m_nameToEntry;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_NAME_INDEX_HPP_
@@ -0,0 +1,93 @@
+#include "NameIndex.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(NameIndexTest, EmptyIndex) {
+    Confab::NameIndex index;
+    std::vector<Confab::NameIndex::Match> matches;
+    EXPECT_EQ(0, index.search("kick", 10, &matches));
+    EXPECT_EQ(0, index.search("", 10, &matches));
+    EXPECT_TRUE(matches.empty());
+    EXPECT_EQ(0, index.size());
+}
+
+TEST(NameIndexTest, PartialNameMatches) {
+    Confab::NameIndex index;
+    index.insert("kick_808_heavy", 1);
+    index.insert("snare_tight", 2);
+    index.insert("Kick Acoustic", 3);
+    EXPECT_EQ(3, index.size());
+
+    std::vector<Confab::NameIndex::Match> matches;
+    ASSERT_EQ(2, index.search("kick", 10, &matches));
+    // Both names start with the query ignoring case, so the shorter name sorts first.
+    EXPECT_EQ("Kick Acoustic", matches[0].name);
+    EXPECT_EQ(3, matches[0].key);
+    EXPECT_EQ("kick_808_heavy", matches[1].name);
+    EXPECT_EQ(1, matches[1].key);
+}
+
+TEST(NameIndexTest, MisspelledNameMatches) {
+    Confab::NameIndex index;
+    index.insert("thunderstorm field recording", 10);
+    index.insert("tambourine", 11);
+
+    std::vector<Confab::NameIndex::Match> matches;
+    ASSERT_EQ(1, index.search("thundrstorm", 10, &matches));
+    EXPECT_EQ(10, matches[0].key);
+    EXPECT_LT(matches[0].score, 1.0f);
+}
+
+TEST(NameIndexTest, PrefixMatchesRankFirst) {
+    Confab::NameIndex index;
+    index.insert("big drum", 1);
+    index.insert("drum loop", 2);
+
+    std::vector<Confab::NameIndex::Match> matches;
+    ASSERT_EQ(2, index.search("drum", 10, &matches));
+    EXPECT_EQ(2, matches[0].key);
+    EXPECT_EQ(1, matches[1].key);
+}
+
+TEST(NameIndexTest, ReinsertUpdatesKey) {
+    Confab::NameIndex index;
+    index.insert("set list", 1);
+    index.insert("set list", 2);
+    EXPECT_EQ(1, index.size());
+
+    std::vector<Confab::NameIndex::Match> matches;
+    ASSERT_EQ(1, index.search("set list", 10, &matches));
+    EXPECT_EQ(2, matches[0].key);
+}
+
+TEST(NameIndexTest, MaxResults) {
+    Confab::NameIndex index;
+    index.insert("pad one", 1);
+    index.insert("pad two", 2);
+    index.insert("pad three", 3);
+
+    std::vector<Confab::NameIndex::Match> matches;
+    EXPECT_EQ(2, index.search("pad", 2, &matches));
+    EXPECT_EQ(2, matches.size());
+    index.clear();
+    EXPECT_EQ(0, index.size());
+}
+
+TEST(NameIndexTest, RemoveName) {
+    Confab::NameIndex index;
+    index.insert("hat open", 1);
+    index.insert("hat closed", 2);
+    index.remove("hat open");
+    index.remove("not present");
+    EXPECT_EQ(1, index.size());
+
+    std::vector<Confab::NameIndex::Match> matches;
+    ASSERT_EQ(1, index.search("hat", 10, &matches));
+    EXPECT_EQ(2, matches[0].key);
+
+    index.insert("hat open", 3);
+    matches.clear();
+    EXPECT_EQ(2, index.search("hat", 10, &matches));
+}
@@ -3,8 +3,11 @@
 #include "Asset.hpp"
 #include "AssetDatabase.hpp"
 #include "CacheManager.hpp"
+#include "CacheSimulator.hpp"
+#include "Catalog.hpp"
 #include "Constants.hpp"
 #include "HttpClient.hpp"
+#include "Prefetcher.hpp"
 #include "schemas/FlatAsset_generated.h"
 #include "schemas/FlatAssetData_generated.h"
 #include "schemas/FlatList_generated.h"
@@ -17,6 +20,9 @@
 
 #include <cstring>
 #include <future>
+#include <limits>
+#include <memory>
+#include <unordered_set>
 
 namespace Confab {
 
@@ -68,6 +74,24 @@ public:
                 std::async(std::launch::async, [this, name] {
                     m_handler->findNamedAsset(name);
                 });
+            } else if (std::strcmp("/assetSearch", message.AddressPattern()) == 0 ||
+                       std::strcmp("/listSearch", message.AddressPattern()) == 0) {
+                bool lists = std::strcmp("/listSearch", message.AddressPattern()) == 0;
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string query((arguments++)->AsString());
+                std::string mode((arguments++)->AsString());
+                int maxResults = (arguments++)->AsInt32();
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [" << message.AddressPattern() << " " << query << ", " << mode << ", "
+                    << maxResults << "]";
+
+                bool fuzzy = mode == "fuzzy";
+                std::async(std::launch::async, [this, lists, query, fuzzy, maxResults] {
+                    m_handler->searchNames(lists, query, fuzzy, maxResults);
+                });
             } else if (std::strcmp("/assetLoad", message.AddressPattern()) == 0) {
                 osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
                 std::string keyString((arguments++)->AsString());
@@ -187,6 +211,154 @@ public:
                 std::async(std::launch::async, [this, key, token] {
                     m_handler->nextList(key, token);
                 });
+            } else if (std::strcmp("/listPrev", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                uint64_t key = Asset::stringToKey(keyString);
+                std::string tokenString((arguments++)->AsString());
+                uint64_t token = Asset::stringToKey(tokenString);
+
+                LOG(INFO) << "processing [/listPrev, " << keyString << ", " << tokenString << "]";
+
+                std::async(std::launch::async, [this, key, token] {
+                    m_handler->prevList(key, token);
+                });
+            } else if (std::strcmp("/listAt", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                uint64_t key = Asset::stringToKey(keyString);
+                int offset = (arguments++)->AsInt32();
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/listAt, " << keyString << ", " << offset << "]";
+
+                std::async(std::launch::async, [this, key, offset] {
+                    m_handler->listAt(key, offset);
+                });
+            } else if (std::strcmp("/listPrefetch", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                uint64_t key = Asset::stringToKey(keyString);
+                int budgetMB = 0;
+                if (arguments != message.ArgumentsEnd()) {
+                    budgetMB = (arguments++)->AsInt32();
+                }
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/listPrefetch, " << keyString << ", " << budgetMB << "]";
+
+                if (key == 0) {
+                    LOG(ERROR) << "/listPrefetch got invalid key value: " << keyString;
+                } else {
+                    uint64_t budgetBytes = budgetMB > 0 ? static_cast<uint64_t>(budgetMB) * 1024ULL * 1024ULL : 0;
+                    m_handler->prefetchList(key, budgetBytes, false);
+                }
+            } else if (std::strcmp("/listPrefetchCancel", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/listPrefetchCancel, " << keyString << "]";
+
+                // An empty key cancels every prefetch. Cancelling only sets flags, so there is no need for a task.
+                if (keyString.empty()) {
+                    m_handler->m_prefetcher->cancelAll();
+                } else {
+                    m_handler->m_prefetcher->cancel(Asset::stringToKey(keyString));
+                }
+            } else if (std::strcmp("/listPin", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/listPin, " << keyString << "]";
+
+                uint64_t key = Asset::stringToKey(keyString);
+                if (key == 0) {
+                    LOG(ERROR) << "/listPin got invalid key value: " << keyString;
+                } else {
+                    m_handler->prefetchList(key, 0, true);
+                }
+            } else if (std::strcmp("/listUnpin", message.AddressPattern()) == 0 ||
+                       std::strcmp("/assetUnpin", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [" << message.AddressPattern() << ", " << keyString << "]";
+
+                // An Asset is pinned in a pin set of its own key, so both unpin the same way. Stop any download of the
+                // pinned Assets first, so that it does not go on filling the cache with Assets no longer wanted.
+                uint64_t key = Asset::stringToKey(keyString);
+                m_handler->m_prefetcher->cancel(key);
+                std::async(std::launch::async, [this, key] {
+                    m_handler->m_cacheManager->unpin(key);
+                });
+            } else if (std::strcmp("/assetPin", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/assetPin, " << keyString << "]";
+
+                uint64_t key = Asset::stringToKey(keyString);
+                if (key == 0) {
+                    LOG(ERROR) << "/assetPin got invalid key value: " << keyString;
+                } else {
+                    std::async(std::launch::async, [this, key] {
+                        m_handler->pinAsset(key);
+                    });
+                }
+            } else if (std::strcmp("/listSize", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                std::string keyString((arguments++)->AsString());
+                uint64_t key = Asset::stringToKey(keyString);
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/listSize, " << keyString << "]";
+
+                std::async(std::launch::async, [this, key] {
+                    m_handler->sizeList(key);
+                });
+            } else if (std::strcmp("/databaseStats", message.AddressPattern()) == 0) {
+                osc::ReceivedMessage::const_iterator arguments = message.ArgumentsBegin();
+                bool countKeys = false;
+                if (arguments != message.ArgumentsEnd()) {
+                    countKeys = (arguments++)->AsInt32() != 0;
+                }
+                if (arguments != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/databaseStats, " << countKeys << "]";
+
+                std::async(std::launch::async, [this, countKeys] {
+                    m_handler->databaseStats(countKeys);
+                });
+            } else if (std::strcmp("/cacheStats", message.AddressPattern()) == 0) {
+                if (message.ArgumentsBegin() != message.ArgumentsEnd()) {
+                    throw osc::ExcessArgumentException();
+                }
+
+                LOG(INFO) << "processing [/cacheStats]";
+
+                std::async(std::launch::async, [this] {
+                    m_handler->cacheStats();
+                });
             } else {
                 LOG(ERROR) << "OSC unknown message: " << message.AddressPattern();
             }
@@ -205,7 +377,13 @@ OscHandler::OscHandler(int listenPort, int sendPort, std::shared_ptr<AssetDataba
     m_sendPort(sendPort),
     m_assetDatabase(assetDatabase),
     m_httpClient(httpClient),
-    m_cacheManager(cacheManager) {
+    m_cacheManager(cacheManager),
+    m_prefetcher(new Prefetcher(httpClient, cacheManager, [this](uint64_t key) {
+        RecordPtr record = findLocalAsset(key);
+        return record->empty() ? fetchAsset(key) : record;
+    })),
+    m_prefetchBudget(Prefetcher::kDefaultBudgetBytes),
+    m_prefetchOnBrowse(false) {
 }
 
 OscHandler::~OscHandler() {
@@ -224,11 +402,49 @@ void OscHandler::run() {
 
 void OscHandler::shutdown() {
     m_listenSocket->AsynchronousBreak();
+    m_prefetcher->shutdown();
+}
+
+void OscHandler::setCatalog(std::shared_ptr<Catalog> catalog) {
+    std::atomic_store(&m_catalog, catalog);
+}
+
+void OscHandler::setAccessTrace(std::shared_ptr<CacheTraceWriter> trace) {
+    m_accessTrace = trace;
+}
+
+void OscHandler::setPrefetch(uint64_t budgetBytes, bool onBrowse) {
+    m_prefetchBudget = budgetBytes;
+    m_prefetchOnBrowse = onBrowse;
+}
+
+RecordPtr OscHandler::findLocalAsset(uint64_t key) {
+    std::shared_ptr<Catalog> catalog = std::atomic_load(&m_catalog);
+    if (catalog) {
+        RecordPtr record = catalog->find(key);
+        std::unordered_set<uint64_t> visited;
+        while (!record->empty()) {
+            uint64_t deprecatedBy = Data::GetFlatAsset(record->data().data())->deprecatedBy();
+            if (!deprecatedBy) {
+                LOG(INFO) << "catalog hit for asset " << Asset::keyToString(key);
+                return record;
+            }
+            // A malformed catalog could deprecate an Asset by one of its own successors. Leave it to the server.
+            if (!visited.insert(key).second) {
+                LOG(ERROR) << "catalog deprecation chain loops at asset " << Asset::keyToString(key);
+                return makeEmptyRecord();
+            }
+            key = deprecatedBy;
+            record = catalog->find(key);
+        }
+    }
+    // Either not in the catalog or deprecated by an Asset added since it was published.
+    return m_assetDatabase->findAsset(key);
 }
 
 void OscHandler::findAsset(uint64_t assetId) {
-    // First check database cache.
-    RecordPtr databaseAsset = m_assetDatabase->findAsset(assetId);
+    // First check catalog and database cache.
+    RecordPtr databaseAsset = findLocalAsset(assetId);
     if (!databaseAsset->empty()) {
         LOG(INFO) << "database cache hit for asset " << Asset::keyToString(assetId) << " sending to SC.";
         sendAsset(Asset::keyToString(assetId), databaseAsset);
@@ -236,21 +452,32 @@ void OscHandler::findAsset(uint64_t assetId) {
     }
 
     // Failing database cache, request from upstream server.
-    m_httpClient->getAsset(assetId, [this, assetId](uint64_t loadedKey, RecordPtr record) {
-        if (record->empty()) {
-            char buffer[kDataChunkSize];
-            osc::OutboundPacketStream p(buffer, kDataChunkSize);
-            LOG(ERROR) << "failed to retrieve Asset " << Asset::keyToString(assetId) << ".";
-            p << osc::BeginMessage("/assetError") << Asset::keyToString(assetId).c_str()
-                << "Failed to find asset associated with key." << osc::EndMessage;
-            m_transmitSocket->Send(p.Data(), p.Size());
-        } else {
-            // Store in database cache for future use.
-            m_assetDatabase->storeAsset(loadedKey, record->data());
-            // Send to client.
-            LOG(INFO) << "downloaded asset " << Asset::keyToString(assetId) << " cached and sending to SC.";
-            sendAsset(Asset::keyToString(assetId), record);
-        }
+    RecordPtr record = fetchAsset(assetId);
+    if (record->empty()) {
+        char buffer[kDataChunkSize];
+        osc::OutboundPacketStream p(buffer, kDataChunkSize);
+        LOG(ERROR) << "failed to retrieve Asset " << Asset::keyToString(assetId) << ".";
+        p << osc::BeginMessage("/assetError") << Asset::keyToString(assetId).c_str()
+            << "Failed to find asset associated with key." << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
+    } else {
+        LOG(INFO) << "downloaded asset " << Asset::keyToString(assetId) << " cached and sending to SC.";
+        sendAsset(Asset::keyToString(assetId), record);
+    }
+}
+
+RecordPtr OscHandler::fetchAsset(uint64_t key) {
+    return m_assetFetches.run(key, [this, key] {
+        RecordPtr fetched = makeEmptyRecord();
+        m_httpClient->getAsset(key, [this, &fetched](uint64_t loadedKey, RecordPtr record) {
+            if (!record->empty()) {
+                // Store in database cache for future use.
+                m_assetDatabase->storeAsset(loadedKey, record->data());
+                // The downloaded record only lives as long as this callback, and is shared with every waiting request.
+                fetched.reset(new CopiedRecord(record->data()));
+            }
+        });
+        return fetched;
     });
 }
 
@@ -276,32 +503,59 @@ void OscHandler::findNamedAsset(std::string name) {
     });
 }
 
+void OscHandler::searchNames(bool lists, std::string query, bool fuzzy, int maxResults) {
+    // Like named lookups, searches always go to the server for freshness.
+    auto sendResults = [this, lists, &query](const std::string& results) {
+        // Results can fill an entire page on their own, so leave room for the query and message overhead.
+        char buffer[2 * kPageSize];
+        osc::OutboundPacketStream p(buffer, 2 * kPageSize);
+        p << osc::BeginMessage(lists ? "/listSearchResults" : "/assetSearchResults") << query.c_str()
+            << results.c_str() << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
+    };
+    size_t limit = maxResults > 0 ? static_cast<size_t>(maxResults) : 0;
+    if (lists) {
+        m_httpClient->searchListNames(query, fuzzy, limit, sendResults);
+    } else {
+        m_httpClient->searchAssetNames(query, fuzzy, limit, sendResults);
+    }
+}
+
 void OscHandler::loadAsset(uint64_t key) {
     uint64_t downloadKey = 0;
-    fs::path assetPath = m_cacheManager->checkCache(key);
+    fs::path assetPath = m_cacheManager->checkCache(key, true);
+
+    if (!assetPath.empty() && m_accessTrace) {
+        std::error_code error;
+        uintmax_t size = fs::file_size(assetPath, error);
+        if (!error) {
+            m_accessTrace->append(key, size);
+        }
+    }
 
     if (assetPath.empty()) {
         LOG(INFO) << "file cache miss for asset " << Asset::keyToString(key) << ", downloading.";
+        // Hold off background prefetches until this load is done, so they don't compete with it for bandwidth.
+        m_prefetcher->foregroundStarted();
         size_t size = 0;
         uint64_t chunks = 0;
+        uint64_t manifestPages = 0;
         std::string fileExtension;
         // First check cache for this Asset.
-        RecordPtr asset = m_assetDatabase->findAsset(key);
+        RecordPtr asset = findLocalAsset(key);
         if (asset->empty()) {
             LOG(INFO) << "cache miss for asset " << Asset::keyToString(key);
-            m_httpClient->getAsset(key, [this, &downloadKey, &size, &chunks, &fileExtension](uint64_t loadedKey,
-                RecordPtr record) {
-                if (record->empty()) {
-                    LOG(ERROR) << "asset not found " << Asset::keyToString(loadedKey);
-                } else {
-                    m_assetDatabase->storeAsset(loadedKey, record->data());
-                    const Data::FlatAsset* flatAsset = Data::GetFlatAsset(record->data().data());
-                    downloadKey = loadedKey;
-                    size = flatAsset->size();
-                    chunks = flatAsset->chunks();
-                    fileExtension = flatAsset->fileExtension()->str();
-                }
-            });
+            RecordPtr record = fetchAsset(key);
+            if (record->empty()) {
+                LOG(ERROR) << "asset not found " << Asset::keyToString(key);
+            } else {
+                const Data::FlatAsset* flatAsset = Data::GetFlatAsset(record->data().data());
+                downloadKey = key;
+                size = flatAsset->size();
+                chunks = flatAsset->chunks();
+                manifestPages = flatAsset->manifestPages();
+                fileExtension = flatAsset->fileExtension()->str();
+            }
         } else {
             LOG(INFO) << "cache hit for asset " << Asset::keyToString(key);
             const Data::FlatAsset* flatAsset = Data::GetFlatAsset(asset->data().data());
@@ -309,17 +563,22 @@ void OscHandler::loadAsset(uint64_t key) {
             downloadKey = key;
             size = flatAsset->size();
             chunks = flatAsset->chunks();
+            manifestPages = flatAsset->manifestPages();
             fileExtension = flatAsset->fileExtension()->str();
         }
 
         // We should have extracted what we need from the asset to download now.
         if (downloadKey != 0) {
+            if (m_accessTrace) {
+                m_accessTrace->append(downloadKey, size);
+            }
             LOG(INFO) << "starting download for asset " << Asset::keyToString(downloadKey) << " for requested asset "
                 << Asset::keyToString(key) << ", " << size << " bytes, " << chunks << " chunks, " << fileExtension;
-            assetPath = m_cacheManager->download(downloadKey, size, chunks, fileExtension);
+            assetPath = m_cacheManager->download(downloadKey, size, chunks, manifestPages, fileExtension);
         } else {
             LOG(ERROR) << "unable to find Asset " << Asset::keyToString(key);
         }
+        m_prefetcher->foregroundFinished();
     }
 
     char buffer[kPageSize];
@@ -413,8 +672,91 @@ void OscHandler::nextList(uint64_t key, uint64_t token) {
         osc::OutboundPacketStream p(buffer, kPageSize);
         p << osc::BeginMessage("/listItems") << Asset::keyToString(key).c_str() << tokens.c_str() << osc::EndMessage;
         m_transmitSocket->Send(p.Data(), p.Size());
+        // Items browsed forwards are likely to be loaded soon, in order.
+        if (m_prefetchOnBrowse) {
+            m_prefetcher->prefetchListItems(key, tokens, m_prefetchBudget);
+        }
+    });
+}
+
+void OscHandler::prevList(uint64_t key, uint64_t token) {
+    m_httpClient->getListItemsBefore(key, token, [this, &key](const std::string& tokens) {
+        char buffer[kPageSize];
+        osc::OutboundPacketStream p(buffer, kPageSize);
+        p << osc::BeginMessage("/listItems") << Asset::keyToString(key).c_str() << tokens.c_str() << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
     });
 }
 
+void OscHandler::listAt(uint64_t key, int offset) {
+    if (offset < 0) {
+        LOG(ERROR) << "/listAt got negative offset " << offset;
+        offset = 0;
+    }
+    m_httpClient->getListItemsAt(key, offset, [this, &key](const std::string& tokens) {
+        char buffer[kPageSize];
+        osc::OutboundPacketStream p(buffer, kPageSize);
+        p << osc::BeginMessage("/listItems") << Asset::keyToString(key).c_str() << tokens.c_str() << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
+    });
+}
+
+void OscHandler::pinAsset(uint64_t key) {
+    m_cacheManager->pin(key, std::vector<uint64_t>{ key });
+    m_prefetcher->prefetchAssets(key, std::vector<uint64_t>{ key }, std::numeric_limits<uint64_t>::max());
+}
+
+void OscHandler::prefetchList(uint64_t key, uint64_t budgetBytes, bool pin) {
+    // Pinned Assets are wanted whatever their size, so only the cache size limit bounds them.
+    if (pin) {
+        budgetBytes = std::numeric_limits<uint64_t>::max();
+    } else if (budgetBytes == 0) {
+        budgetBytes = m_prefetchBudget;
+    }
+    m_prefetcher->prefetchList(key, budgetBytes, pin, [this, pin](uint64_t listKey, const Prefetcher::Result& result) {
+        char buffer[kPageSize];
+        osc::OutboundPacketStream p(buffer, kPageSize);
+        p << osc::BeginMessage(pin ? "/listPinned" : "/listPrefetched") << Asset::keyToString(listKey).c_str()
+            << Prefetcher::statusToString(result.status) << static_cast<int32_t>(result.downloaded)
+            << static_cast<int32_t>(result.cached) << static_cast<int32_t>(result.failed) << osc::EndMessage;
+        m_transmitSocket->Send(p.Data(), p.Size());
+    });
+}
+
+void OscHandler::sizeList(uint64_t key) {
+    m_httpClient->getListSize(key, [this, &key](const std::string& count) {
+        char buffer[kPageSize];
+        osc::OutboundPacketStream p(buffer, kPageSize);
+        if (count.empty()) {
+            p << osc::BeginMessage("/listError") << Asset::keyToString(key).c_str() << "error counting list."
+                << osc::EndMessage;
+        } else {
+            p << osc::BeginMessage("/listSizeResult") << Asset::keyToString(key).c_str()
+                << static_cast<int32_t>(std::stoll(count)) << osc::EndMessage;
+        }
+        m_transmitSocket->Send(p.Data(), p.Size());
+    });
+}
+
+void OscHandler::databaseStats(bool countKeys) {
+    std::string report = m_assetDatabase->statsReport(countKeys);
+    // Keep whole lines only, leaving room in the packet for the address and padding.
+    if (report.size() >= kPageSize) {
+        report.erase(report.rfind('\n', kPageSize - 1) + 1);
+    }
+    char buffer[2 * kPageSize];
+    osc::OutboundPacketStream p(buffer, 2 * kPageSize);
+    p << osc::BeginMessage("/databaseStats") << report.c_str() << osc::EndMessage;
+    m_transmitSocket->Send(p.Data(), p.Size());
+}
+
+void OscHandler::cacheStats() {
+    std::string report = m_cacheManager->statsReport();
+    char buffer[2 * kPageSize];
+    osc::OutboundPacketStream p(buffer, 2 * kPageSize);
+    p << osc::BeginMessage("/cacheStats") << report.c_str() << osc::EndMessage;
+    m_transmitSocket->Send(p.Data(), p.Size());
+}
+
 }  // namespace Confab
 
@@ -3,7 +3,9 @@
 
 #include "Asset.hpp"
 #include "Record.hpp"
+#include "SingleFlight.hpp"
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <thread>
@@ -16,7 +18,10 @@ namespace Confab {
 
 class AssetDatabase;
 class CacheManager;
+class CacheTraceWriter;
+class Catalog;
 class HttpClient;
+class Prefetcher;
 
 /*! Class for listening and responding to OSC messages from a single SuperCollider client.
  */
@@ -45,9 +50,42 @@ public:
      */
     void shutdown();
 
+    /*! Sets the Catalog to consult before the AssetDatabase for Asset metadata. Safe to call while running, to swap in
+     * a freshly downloaded catalog.
+     *
+     * \param catalog The opened Catalog, or nullptr to stop consulting a catalog.
+     */
+    void setCatalog(std::shared_ptr<Catalog> catalog);
+
+    /*! Configures background prefetching of list Assets into the file cache.
+     *
+     * \param budgetBytes The byte budget for a prefetch requested without one, and for each browsed page of a list.
+     * \param onBrowse If true, the Assets in each page of list items returned by /listNext are prefetched.
+     */
+    void setPrefetch(uint64_t budgetBytes, bool onBrowse);
+
+    /*! Records every /assetLoad request to a trace, for replay against different cache policies. Call before run().
+     *
+     * \param trace The trace to append to, or nullptr to stop recording.
+     */
+    void setAccessTrace(std::shared_ptr<CacheTraceWriter> trace);
+
 private:
     class OscListener;
 
+    /*! Looks up Asset metadata locally, first in the catalog and then in the AssetDatabase, following deprecation
+     * in both. Returns an empty record if the deprecation chain in the catalog loops, so the server is asked instead.
+     */
+    RecordPtr findLocalAsset(uint64_t key);
+
+    /*! Requests Asset metadata from the server and stores it in the AssetDatabase. Concurrent requests for the same key
+     * share a single server request.
+     *
+     * \param key The Asset key to request.
+     * \return An owning copy of the FlatAsset record, or an empty Record on error.
+     */
+    RecordPtr fetchAsset(uint64_t key);
+
     /*! Searches for an asset with provided id. Should run as a task.
      */
     void findAsset(uint64_t assetId);
@@ -56,10 +94,19 @@ private:
      */
     void findNamedAsset(std::string name);
 
+    /*! Searches Asset or List names on the server, returns the matches to SC. Should run as a task.
+     */
+    void searchNames(bool lists, std::string query, bool fuzzy, int maxResults);
+
     /*! Downloads an asset file to cache, provides path back to caller. Should run as a task.
      */
     void loadAsset(uint64_t key);
 
+    /*! Pins an Asset in the file cache, exempting it from eviction, and downloads it in the background if it is not
+     * already cached. Should run as a task.
+     */
+    void pinAsset(uint64_t key);
+
     /*! Processes an asset addition request for a given file path. Should run as a task.
      */
     void addAssetFile(Asset::Type type, int serialNumber, std::string name, uint64_t author, uint64_t deprecates,
@@ -87,11 +134,50 @@ private:
      */
     void nextList(uint64_t key, uint64_t token);
 
+    /*! Iterates backwards through elements in list before token, most recent first, returns to SC.
+     */
+    void prevList(uint64_t key, uint64_t token);
+
+    /*! Fetches elements in list starting at a position in the list, returns to SC.
+     */
+    void listAt(uint64_t key, int offset);
+
+    /*! Starts a background prefetch of the Assets in a list into the file cache, reporting the result to SC when it
+     * ends.
+     *
+     * \param key The list to prefetch.
+     * \param budgetBytes The most bytes to download, or 0 to use the configured budget.
+     * \param pin If true, pins the Assets in the list and downloads all of them regardless of budget.
+     */
+    void prefetchList(uint64_t key, uint64_t budgetBytes, bool pin);
+
+    /*! Counts the elements in a list, returns the count to SC.
+     */
+    void sizeList(uint64_t key);
+
+    /*! Reports statistics on the local database, as name and value lines, to SC.
+     *
+     * \param countKeys If true, also scans the database to count the keys and bytes under each key prefix.
+     */
+    void databaseStats(bool countKeys);
+
+    /*! Reports statistics on the file cache, as name and value lines, to SC.
+     */
+    void cacheStats();
+
     int m_listenPort;
     int m_sendPort;
     std::shared_ptr<AssetDatabase> m_assetDatabase;
     std::shared_ptr<HttpClient> m_httpClient;
     std::shared_ptr<CacheManager> m_cacheManager;
+    // Server requests for Asset metadata in progress, by Asset key.
+    SingleFlight<uint64_t, RecordPtr> m_assetFetches;
+    std::unique_ptr<Prefetcher> m_prefetcher;
+    std::atomic<uint64_t> m_prefetchBudget;
+    std::atomic<bool> m_prefetchOnBrowse;
+    std::shared_ptr<CacheTraceWriter> m_accessTrace;
+    // Accessed only with std::atomic_load and std::atomic_store, as it may be replaced while lookups are running.
+    std::shared_ptr<Catalog> m_catalog;
 
     std::unique_ptr<UdpTransmitSocket> m_transmitSocket;
     std::unique_ptr<OscListener> m_listener;
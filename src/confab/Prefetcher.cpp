@@ -0,0 +1,289 @@
+#include "Prefetcher.hpp"
+
+#include "Asset.hpp"
+#include "CacheManager.hpp"
+#include "Constants.hpp"
+#include "HttpClient.hpp"
+#include "schemas/FlatAsset_generated.h"
+
+#include "glog/logging.h"
+
+#include <sstream>
+
+namespace Confab {
+
+Prefetcher::Prefetcher(std::shared_ptr<HttpClient> httpClient, std::shared_ptr<CacheManager> cacheManager,
+    std::function<RecordPtr(uint64_t)> findAsset) :
+    m_httpClient(httpClient),
+    m_cacheManager(cacheManager),
+    m_findAsset(findAsset),
+    m_foregroundLoads(0),
+    m_threadPool(1) {
+}
+
+Prefetcher::~Prefetcher() {
+    shutdown();
+}
+
+bool Prefetcher::prefetchList(uint64_t listKey, uint64_t budgetBytes, bool pin,
+    std::function<void(uint64_t, const Result&)> callback) {
+    CancelFlag cancelled = addPrefetch(listKey);
+    bool queued = m_threadPool.post(ThreadPool::kLowPriority, [this, listKey, budgetBytes, pin, callback, cancelled] {
+        LOG(INFO) << (pin ? "pinning" : "prefetching") << " list " << Asset::keyToString(listKey)
+            << " with budget of " << budgetBytes << " bytes.";
+        Result result{ kComplete, 0, 0, 0, 0 };
+        uint64_t token = 0;
+        bool endOfList = false;
+        if (pin) {
+            // Pin the whole list before downloading any of it, so that the downloads cannot evict its Assets.
+            std::vector<uint64_t> keys;
+            while (!endOfList && !cancelled->load()) {
+                if (!readListPage(listKey, &token, &keys, &endOfList)) {
+                    result.status = kListError;
+                    break;
+                }
+            }
+            if (cancelled->load()) {
+                result.status = kCancelled;
+            }
+            if (result.status == kComplete) {
+                m_cacheManager->pin(listKey, keys);
+                for (auto key : keys) {
+                    if (!prefetchAsset(key, budgetBytes, cancelled, &result)) {
+                        break;
+                    }
+                }
+            }
+        } else {
+            // Download each page as it arrives, so that the first Assets in the list are cached soonest.
+            while (!endOfList && result.status == kComplete) {
+                std::vector<uint64_t> keys;
+                if (!readListPage(listKey, &token, &keys, &endOfList)) {
+                    result.status = kListError;
+                    break;
+                }
+                for (auto key : keys) {
+                    if (!prefetchAsset(key, budgetBytes, cancelled, &result)) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        LOG(INFO) << "prefetch of list " << Asset::keyToString(listKey) << " ended " << statusToString(result.status)
+            << ", " << result.cached << " cached, " << result.downloaded << " downloaded (" << result.downloadedBytes
+            << " bytes), " << result.failed << " failed.";
+        removePrefetch(listKey, cancelled);
+        if (callback) {
+            callback(listKey, result);
+        }
+    });
+    if (!queued) {
+        removePrefetch(listKey, cancelled);
+    }
+    return queued;
+}
+
+bool Prefetcher::prefetchListItems(uint64_t listKey, const std::string& items, uint64_t budgetBytes) {
+    std::vector<uint64_t> keys;
+    parseListItems(items, &keys, nullptr);
+    if (keys.empty()) {
+        return true;
+    }
+    return prefetchAssets(listKey, keys, budgetBytes);
+}
+
+bool Prefetcher::prefetchAssets(uint64_t listKey, const std::vector<uint64_t>& keys, uint64_t budgetBytes) {
+    CancelFlag cancelled = addPrefetch(listKey);
+    bool queued = m_threadPool.post(ThreadPool::kLowPriority, [this, listKey, keys, budgetBytes, cancelled] {
+        Result result{ kComplete, 0, 0, 0, 0 };
+        for (auto key : keys) {
+            if (!prefetchAsset(key, budgetBytes, cancelled, &result)) {
+                break;
+            }
+        }
+        if (result.downloaded > 0 || result.status != kComplete) {
+            LOG(INFO) << "prefetch of " << keys.size() << " items from list " << Asset::keyToString(listKey)
+                << " ended " << statusToString(result.status) << ", " << result.downloaded << " downloaded ("
+                << result.downloadedBytes << " bytes).";
+        }
+        removePrefetch(listKey, cancelled);
+    });
+    if (!queued) {
+        removePrefetch(listKey, cancelled);
+    }
+    return queued;
+}
+
+size_t Prefetcher::cancel(uint64_t listKey) {
+    size_t cancelledCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto range = m_prefetches.equal_range(listKey);
+        for (auto it = range.first; it != range.second; ++it) {
+            it->second->store(true);
+            ++cancelledCount;
+        }
+        m_prefetches.erase(range.first, range.second);
+    }
+    // Wake the worker if it is waiting for foreground loads to finish.
+    m_idle.notify_all();
+    return cancelledCount;
+}
+
+void Prefetcher::cancelAll() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& prefetch : m_prefetches) {
+            prefetch.second->store(true);
+        }
+        m_prefetches.clear();
+    }
+    m_idle.notify_all();
+}
+
+void Prefetcher::foregroundStarted() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_foregroundLoads;
+}
+
+void Prefetcher::foregroundFinished() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_foregroundLoads;
+    }
+    m_idle.notify_all();
+}
+
+void Prefetcher::shutdown() {
+    cancelAll();
+    m_threadPool.shutdown();
+}
+
+// static
+const char* Prefetcher::statusToString(Status status) {
+    switch (status) {
+    case kComplete:
+        return "complete";
+
+    case kCancelled:
+        return "cancelled";
+
+    case kOverBudget:
+        return "overBudget";
+
+    case kListError:
+        return "listError";
+    }
+
+    return "unknown";
+}
+
+// static
+bool Prefetcher::parseListItems(const std::string& items, std::vector<uint64_t>* keys, uint64_t* lastToken) {
+    std::istringstream lines(items);
+    std::string tokenString, keyString;
+    while (lines >> tokenString >> keyString) {
+        uint64_t token = Asset::stringToKey(tokenString);
+        if (token == kEndList) {
+            return true;
+        }
+        uint64_t key = Asset::stringToKey(keyString);
+        if (key != 0) {
+            keys->push_back(key);
+        }
+        if (lastToken) {
+            *lastToken = token;
+        }
+    }
+    return false;
+}
+
+Prefetcher::CancelFlag Prefetcher::addPrefetch(uint64_t listKey) {
+    CancelFlag cancelled(new std::atomic<bool>(false));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prefetches.emplace(listKey, cancelled);
+    return cancelled;
+}
+
+void Prefetcher::removePrefetch(uint64_t listKey, const CancelFlag& cancelled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto range = m_prefetches.equal_range(listKey);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == cancelled) {
+            m_prefetches.erase(it);
+            break;
+        }
+    }
+}
+
+bool Prefetcher::readListPage(uint64_t listKey, uint64_t* token, std::vector<uint64_t>* keys, bool* endOfList) {
+    std::string items;
+    m_httpClient->getListItems(listKey, *token, [&items](const std::string& tokens) {
+        items = tokens;
+    });
+    uint64_t lastToken = *token;
+    *endOfList = parseListItems(items, keys, &lastToken);
+    // A page with no items that doesn't end the list would request the same page again forever.
+    if (!*endOfList && lastToken == *token) {
+        LOG(ERROR) << "failed to retrieve items of list " << Asset::keyToString(listKey) << " after token "
+            << Asset::keyToString(*token);
+        return false;
+    }
+    *token = lastToken;
+    return true;
+}
+
+bool Prefetcher::prefetchAsset(uint64_t key, uint64_t budgetBytes, const CancelFlag& cancelled, Result* result) {
+    if (cancelled->load()) {
+        result->status = kCancelled;
+        return false;
+    }
+
+    // A hit also marks the file as recently used, protecting it from eviction by the downloads that follow.
+    if (!m_cacheManager->checkCache(key, false).empty()) {
+        ++result->cached;
+        return true;
+    }
+
+    RecordPtr record = m_findAsset(key);
+    if (record->empty()) {
+        LOG(ERROR) << "prefetch unable to find Asset " << Asset::keyToString(key);
+        ++result->failed;
+        return true;
+    }
+    const Data::FlatAsset* flatAsset = Data::GetFlatAsset(record->data().data());
+    // Inline Assets arrive with their metadata, and have no file to cache.
+    if (flatAsset->inlineData() || flatAsset->chunks() == 0) {
+        return true;
+    }
+    if (result->downloadedBytes + flatAsset->size() > budgetBytes) {
+        result->status = kOverBudget;
+        return false;
+    }
+    if (!waitForIdle(cancelled)) {
+        result->status = kCancelled;
+        return false;
+    }
+
+    fs::path path = m_cacheManager->download(key, flatAsset->size(), flatAsset->chunks(),
+        flatAsset->manifestPages(), flatAsset->fileExtension()->str());
+    if (path.empty()) {
+        LOG(ERROR) << "prefetch failed to download Asset " << Asset::keyToString(key);
+        ++result->failed;
+    } else {
+        ++result->downloaded;
+        result->downloadedBytes += flatAsset->size();
+    }
+    return true;
+}
+
+bool Prefetcher::waitForIdle(const CancelFlag& cancelled) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this, &cancelled] {
+        return m_foregroundLoads == 0 || cancelled->load();
+    });
+    return !cancelled->load();
+}
+
+}  // namespace Confab
@@ -0,0 +1,202 @@
+#ifndef SRC_CONFAB_PREFETCHER_HPP_
+#define SRC_CONFAB_PREFETCHER_HPP_
+
+#include "Record.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Confab {
+
+class CacheManager;
+class HttpClient;
+
+/*! Downloads the file Assets in a list into the CacheManager in the background, so that loading them later is a cache
+ * hit instead of a wait on the network.
+ *
+ * Prefetches run one Asset at a time on a single worker thread, in list order. They give way to foreground loads: no
+ * new Asset download starts while a foreground load is in progress, as bracketed by foregroundStarted() and
+ * foregroundFinished(). Downloads go through CacheManager::download(), so a foreground load of an Asset already being
+ * prefetched waits on that download rather than starting another.
+ *
+ * Each prefetch has a byte budget, counting only the Assets it downloads. It stops before the first download that
+ * would exceed the budget, so a prefetch never fills the cache with more than the caller asked for.
+ *
+ * A list prefetch can also pin the list's Assets in the CacheManager, in a pin set keyed by the list key. It then reads
+ * the whole list before downloading anything, so that every Asset is pinned before the downloads start to evict.
+ */
+class Prefetcher {
+public:
+    /*! Byte budget for prefetches when none is configured.
+     */
+    static constexpr uint64_t kDefaultBudgetBytes = 512ULL * 1024ULL * 1024ULL;
+
+    /*! How a prefetch ended.
+     */
+    enum Status {
+        /*! Every file Asset in the list, or in the items given, is now in the cache or failed to download.
+         */
+        kComplete,
+
+        /*! Stopped by cancel(), cancelAll() or shutdown().
+         */
+        kCancelled,
+
+        /*! Stopped before an Asset that would have exceeded the byte budget.
+         */
+        kOverBudget,
+
+        /*! Stopped because the list items could not be retrieved from the server.
+         */
+        kListError
+    };
+
+    /*! A summary of a finished prefetch.
+     */
+    struct Result {
+        Status status;
+        /*! Number of file Assets found in the cache, which are marked as recently used.
+         */
+        size_t cached;
+        /*! Number of file Assets downloaded.
+         */
+        size_t downloaded;
+        /*! Number of Assets whose metadata or data could not be retrieved.
+         */
+        size_t failed;
+        /*! Total size of the downloaded Assets in bytes.
+         */
+        uint64_t downloadedBytes;
+    };
+
+    /*! Constructs a Prefetcher and starts its worker thread.
+     *
+     * \param httpClient The HttpClient to request list items with.
+     * \param cacheManager The CacheManager to download Assets into.
+     * \param findAsset Returns the FlatAsset record for an Asset key, or an empty Record if it cannot be found.
+     */
+    Prefetcher(std::shared_ptr<HttpClient> httpClient, std::shared_ptr<CacheManager> cacheManager,
+        std::function<RecordPtr(uint64_t)> findAsset);
+
+    /*! Destructs a Prefetcher, calling shutdown() if it has not yet been called.
+     */
+    ~Prefetcher();
+
+    /*! Queues a prefetch of every Asset in a list, paging through the list items on the server.
+     *
+     * \param listKey The key of the list to prefetch.
+     * \param budgetBytes The most bytes to download for this prefetch.
+     * \param pin If true, pin the Assets in the list before downloading them, replacing any earlier pin of the list.
+     * \param callback Called on the worker thread with the result when the prefetch ends. Can be empty.
+     * \return true if the prefetch was queued, false if the Prefetcher is shut down.
+     */
+    bool prefetchList(uint64_t listKey, uint64_t budgetBytes, bool pin,
+        std::function<void(uint64_t, const Result&)> callback);
+
+    /*! Queues a prefetch of a page of list items already retrieved, as when a list is browsed.
+     *
+     * \param listKey The key of the list the items came from, which cancel() can use to stop the prefetch.
+     * \param items List items as a string of "<token> <asset key>\n" pairs, as returned by HttpClient::getListItems().
+     * \param budgetBytes The most bytes to download for this prefetch.
+     * \return true if the prefetch was queued, false if the Prefetcher is shut down.
+     */
+    bool prefetchListItems(uint64_t listKey, const std::string& items, uint64_t budgetBytes);
+
+    /*! Queues a prefetch of Assets by key.
+     *
+     * \param listKey The key that cancel() can use to stop the prefetch, such as the list the Assets came from.
+     * \param keys The Asset keys to prefetch, in order.
+     * \param budgetBytes The most bytes to download for this prefetch.
+     * \return true if the prefetch was queued, false if the Prefetcher is shut down.
+     */
+    bool prefetchAssets(uint64_t listKey, const std::vector<uint64_t>& keys, uint64_t budgetBytes);
+
+    /*! Cancels all queued and running prefetches of a list. A download already in progress runs to completion, as a
+     * foreground load may be sharing it, but no further Assets are started.
+     *
+     * \param listKey The key of the list to stop prefetching.
+     * \return The number of prefetches cancelled.
+     */
+    size_t cancel(uint64_t listKey);
+
+    /*! Cancels all queued and running prefetches.
+     */
+    void cancelAll();
+
+    /*! Called before a foreground load that may download, holding off new prefetch downloads until the matching call
+     * to foregroundFinished().
+     */
+    void foregroundStarted();
+
+    /*! Called after a foreground load, once for each call to foregroundStarted().
+     */
+    void foregroundFinished();
+
+    /*! Cancels all prefetches and waits for the worker thread to stop.
+     */
+    void shutdown();
+
+    /*! Converts a Status to a short human-readable string.
+     */
+    static const char* statusToString(Status status);
+
+    /*! Parses list items from a string of "<token> <asset key>\n" pairs.
+     *
+     * \param items The list items, as returned by HttpClient::getListItems().
+     * \param keys A vector to append the Asset keys to, in list order.
+     * \param lastToken If non-null, set to the token of the last item parsed, or left unchanged if there are none.
+     * \return true if the items end with the <kEndList, kEndList> pair marking the end of the list.
+     */
+    static bool parseListItems(const std::string& items, std::vector<uint64_t>* keys, uint64_t* lastToken);
+
+    /// @cond UNDOCUMENTED
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    typedef std::shared_ptr<std::atomic<bool>> CancelFlag;
+
+    /*! Registers a new prefetch of listKey, returning the flag that cancels it.
+     */
+    CancelFlag addPrefetch(uint64_t listKey);
+
+    /*! Forgets a finished prefetch.
+     */
+    void removePrefetch(uint64_t listKey, const CancelFlag& cancelled);
+
+    /*! Requests the page of list items after token, appending their Asset keys to keys and advancing token to the
+     * last item. Returns false if the page could not be retrieved.
+     */
+    bool readListPage(uint64_t listKey, uint64_t* token, std::vector<uint64_t>* keys, bool* endOfList);
+
+    /*! Prefetches one Asset, adding to result. Returns false if the prefetch should stop.
+     */
+    bool prefetchAsset(uint64_t key, uint64_t budgetBytes, const CancelFlag& cancelled, Result* result);
+
+    /*! Waits until no foreground loads are in progress. Returns false if cancelled while waiting.
+     */
+    bool waitForIdle(const CancelFlag& cancelled);
+
+    std::shared_ptr<HttpClient> m_httpClient;
+    std::shared_ptr<CacheManager> m_cacheManager;
+    std::function<RecordPtr(uint64_t)> m_findAsset;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    size_t m_foregroundLoads;
+    // Queued and running prefetches by list key.
+    std::unordered_multimap<uint64_t, CancelFlag> m_prefetches;
+    ThreadPool m_threadPool;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_PREFETCHER_HPP_
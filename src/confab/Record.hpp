@@ -4,6 +4,7 @@
 #include "SizedPointer.hpp"
 
 #include <memory>
+#include <string>
 
 namespace Confab {
 
@@ -62,6 +63,38 @@ public:
     const SizedPointer key() const override { return SizedPointer(); }
 };
 
+/*! Record holding its own copy of some data, to share a Record beyond the lifetime of the store it came from.
+ */
+class CopiedRecord : public Record {
+public:
+    /*! Constructs a Record holding a copy of the provided data.
+     *
+     * \param data The data to copy.
+     */
+    explicit CopiedRecord(const SizedPointer& data) :
+        m_data(data.dataChar(), data.size()) {
+    }
+
+    ~CopiedRecord() override = default;
+
+    /*! Always reports a non-empty Record.
+     * \return Always false.
+     */
+    bool empty() const override { return false; }
+
+    /*! Returns a pointer to the copied data, valid for the lifetime of this Record.
+     */
+    const SizedPointer data() const override { return SizedPointer(m_data.data(), m_data.size()); }
+
+    /*! Returns an empty key pointer.
+     * \return Always empty key pointer.
+     */
+    const SizedPointer key() const override { return SizedPointer(); }
+
+private:
+    const std::string m_data;
+};
+
 /*! Convenience routine to quickly construct an always empty RecordPtr.
  * \return A new EmptyRecord.
  */
@@ -0,0 +1,106 @@
+#ifndef SRC_CONFAB_SINGLE_FLIGHT_HPP_
+#define SRC_CONFAB_SINGLE_FLIGHT_HPP_
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+namespace Confab {
+
+/*! Coalesces concurrent calls for the same key, so that the work for a key runs at most once at a time and every
+ * caller that arrives while it is running shares its result.
+ *
+ * Only calls that overlap are coalesced. A call made after the work for its key has finished runs the work again, so
+ * callers that can use an earlier result should check for one within the work itself.
+ *
+ * \tparam Key Identifies the work, and must be hashable.
+ * \tparam Result The result of the work, which is copied to every caller sharing it.
+ */
+template<typename Key, typename Result>
+class SingleFlight {
+public:
+    /*! Constructs a SingleFlight with no work in flight.
+     */
+    SingleFlight() = default;
+
+    /*! Runs work for key, unless work for key is already running on another thread, in which case waits for that to
+     * finish and returns its result instead. If the work throws, every caller sharing it receives the exception.
+     *
+     * \param key Identifies the work.
+     * \param work Computes the result, called only if no work for key is in flight.
+     * \return The result of the work for key.
+     */
+    Result run(const Key& key, std::function<Result()> work) {
+        std::shared_future<Result> result;
+        std::promise<Result> promise;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto found = m_inFlight.find(key);
+            if (found != m_inFlight.end()) {
+                ++found->second.waiting;
+                result = found->second.result;
+            } else {
+                m_inFlight.emplace(key, Flight{ promise.get_future().share(), 0 });
+            }
+        }
+        if (result.valid()) {
+            return result.get();
+        }
+
+        // Forget the flight before publishing its result, so that calls arriving afterwards start afresh rather than
+        // attaching to a finished flight.
+        try {
+            Result value = work();
+            finish(key);
+            promise.set_value(value);
+            return value;
+        } catch (...) {
+            finish(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    /*! The number of callers waiting on the work in flight for key, not counting the caller running it.
+     *
+     * \param key Identifies the work.
+     * \return The number of waiting callers, or 0 if no work for key is in flight.
+     */
+    size_t waiting(const Key& key) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_inFlight.find(key);
+        return found != m_inFlight.end() ? found->second.waiting : 0;
+    }
+
+    /*! The number of keys with work in flight.
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_inFlight.size();
+    }
+
+    /// @cond UNDOCUMENTED
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    struct Flight {
+        std::shared_future<Result> result;
+        size_t waiting;
+    };
+
+    void finish(const Key& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight.erase(key);
+    }
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, Flight> m_inFlight;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_SINGLE_FLIGHT_HPP_
@@ -0,0 +1,82 @@
+#include "SingleFlight.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(SingleFlightTest, RunsWorkWhenNothingInFlight) {
+    Confab::SingleFlight<int, std::string> flight;
+    int calls = 0;
+    EXPECT_EQ("one", flight.run(1, [&calls] { ++calls; return std::string("one"); }));
+    EXPECT_EQ("two", flight.run(2, [&calls] { ++calls; return std::string("two"); }));
+    // Calls that do not overlap each run the work.
+    EXPECT_EQ("one", flight.run(1, [&calls] { ++calls; return std::string("one"); }));
+    EXPECT_EQ(3, calls);
+    EXPECT_EQ(0, flight.size());
+}
+
+TEST(SingleFlightTest, ConcurrentCallsShareOneRun) {
+    Confab::SingleFlight<int, int> flight;
+    std::atomic<int> calls(0);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    auto work = [&calls, released] {
+        ++calls;
+        released.wait();
+        return 42;
+    };
+
+    const int kCallers = 8;
+    std::vector<std::future<int>> results;
+    results.push_back(std::async(std::launch::async, [&flight, &work] { return flight.run(7, work); }));
+    while (flight.size() == 0) {
+        std::this_thread::yield();
+    }
+    for (int i = 1; i < kCallers; ++i) {
+        results.push_back(std::async(std::launch::async, [&flight, &work] { return flight.run(7, work); }));
+    }
+    while (flight.waiting(7) < kCallers - 1) {
+        std::this_thread::yield();
+    }
+
+    // Work for a different key is not held up by the flight in progress.
+    EXPECT_EQ(3, flight.run(8, [] { return 3; }));
+
+    release.set_value();
+    for (auto& result : results) {
+        EXPECT_EQ(42, result.get());
+    }
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(0, flight.size());
+}
+
+TEST(SingleFlightTest, ExceptionsReachEveryWaiter) {
+    Confab::SingleFlight<int, int> flight;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    auto work = [released]() -> int {
+        released.wait();
+        throw std::runtime_error("failed");
+    };
+
+    std::future<int> first = std::async(std::launch::async, [&flight, &work] { return flight.run(1, work); });
+    while (flight.size() == 0) {
+        std::this_thread::yield();
+    }
+    std::future<int> second = std::async(std::launch::async, [&flight, &work] { return flight.run(1, work); });
+    while (flight.waiting(1) == 0) {
+        std::this_thread::yield();
+    }
+    release.set_value();
+    EXPECT_THROW(first.get(), std::runtime_error);
+    EXPECT_THROW(second.get(), std::runtime_error);
+
+    // A failed flight does not linger.
+    EXPECT_EQ(0, flight.size());
+    EXPECT_EQ(5, flight.run(1, [] { return 5; }));
+}
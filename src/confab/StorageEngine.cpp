@@ -0,0 +1,17 @@
+#include "StorageEngine.hpp"
+
+#include "LevelDBStorageEngine.hpp"
+#include "MemoryStorageEngine.hpp"
+
+namespace Confab {
+
+std::unique_ptr<StorageEngine> makeStorageEngine(const std::string& name) {
+    if (name == "leveldb") {
+        return std::unique_ptr<StorageEngine>(new LevelDBStorageEngine);
+    } else if (name == "memory") {
+        return std::unique_ptr<StorageEngine>(new MemoryStorageEngine);
+    }
+    return nullptr;
+}
+
+}  // namespace Confab
@@ -0,0 +1,130 @@
+#ifndef SRC_CONFAB_STORAGE_ENGINE_HPP_
+#define SRC_CONFAB_STORAGE_ENGINE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace leveldb {
+    class Iterator;
+    class Slice;
+    class Snapshot;
+    class Status;
+    class WriteBatch;
+    struct Range;
+    struct ReadOptions;
+    struct WriteOptions;
+}
+
+namespace Confab {
+
+/*! Interface to the ordered key-value store underneath AssetDatabase.
+ *
+ * Engines provide point reads, ordered range scans through iterators, atomic batch writes, and consistent read
+ * snapshots. Keys are ordered bytewise as unsigned characters. The LevelDB Slice, WriteBatch, Iterator and Snapshot
+ * types serve as the common vocabulary between AssetDatabase and every engine, so records loaded through any engine are
+ * wrapped the same way.
+ */
+class StorageEngine {
+public:
+    virtual ~StorageEngine() = default;
+
+    /*! Opens or creates the store.
+     *
+     * \param path A path to a directory where the store keeps its files, if any.
+     * \param createNew If true, treat an existing store at path as an error. If false, expect one to exist.
+     * \param cacheSize Size in bytes of any read cache the engine keeps, or <= 0 for none.
+     * \return true on success, false on error.
+     */
+    virtual bool open(const char* path, bool createNew, int cacheSize) = 0;
+
+    /*! Reads the value of a single key.
+     *
+     * \param options Read options, including an optional snapshot to read from.
+     * \param key The key to read.
+     * \param value Set to the value stored under key.
+     * \return OK if found, NotFound if absent, or another error status.
+     */
+    virtual leveldb::Status get(const leveldb::ReadOptions& options, const leveldb::Slice& key,
+        std::string* value) = 0;
+
+    /*! Makes a new iterator over the store, initially not positioned. Without a snapshot in options the iterator
+     * reads from an implicit snapshot taken now. The caller owns the iterator, and must delete it before the engine.
+     *
+     * \param options Read options, including an optional snapshot to read from.
+     * \return A new iterator.
+     */
+    virtual leveldb::Iterator* newIterator(const leveldb::ReadOptions& options) = 0;
+
+    /*! Applies every operation in batch atomically, in order.
+     *
+     * \param options Write options.
+     * \param batch The operations to apply.
+     * \return OK on success, or an error status.
+     */
+    virtual leveldb::Status write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) = 0;
+
+    /*! Takes a snapshot of the current state of the store, which must be released with releaseSnapshot().
+     *
+     * \return The new snapshot.
+     */
+    virtual const leveldb::Snapshot* getSnapshot() = 0;
+
+    /*! Releases a snapshot returned by getSnapshot().
+     *
+     * \param snapshot The snapshot to release.
+     */
+    virtual void releaseSnapshot(const leveldb::Snapshot* snapshot) = 0;
+
+    /*! Reads an engine-specific property, such as "leveldb.stats" for the LevelDB engine.
+     *
+     * \param property The name of the property.
+     * \param value Set to the value of the property.
+     * \return false if the engine does not know the property, true otherwise.
+     */
+    virtual bool getProperty(const leveldb::Slice& property, std::string* value) = 0;
+
+    /*! Estimates the storage used by the keys in each of a set of ranges, including any compression.
+     *
+     * \param ranges The ranges of keys, each including its start key and excluding its limit key.
+     * \param count The number of ranges.
+     * \param sizes An array of count sizes to set to the approximate number of bytes in each range.
+     */
+    virtual void getApproximateSizes(const leveldb::Range* ranges, int count, uint64_t* sizes) = 0;
+
+    /*! Counters for the engine's read cache.
+     */
+    struct CacheStats {
+        /*! Number of lookups that found their entry in the cache.
+         */
+        uint64_t hits = 0;
+
+        /*! Number of lookups that did not.
+         */
+        uint64_t misses = 0;
+
+        /*! Bytes currently held in the cache.
+         */
+        uint64_t usage = 0;
+    };
+
+    /*! Reads the counters of the engine's read cache, which are all zero if it has none.
+     */
+    virtual CacheStats cacheStats() = 0;
+
+    /*! The name of the engine, as accepted by makeStorageEngine().
+     */
+    virtual const char* name() const = 0;
+};
+
+/*! Makes an unopened storage engine.
+ *
+ * \param name The engine to make, either "leveldb" for the persistent LevelDB store, or "memory" for a store held
+ *             entirely in memory and lost on exit, for tests and benchmarks that exclude disk I/O.
+ * \return The new engine, or nullptr if name is not recognized.
+ */
+std::unique_ptr<StorageEngine> makeStorageEngine(const std::string& name);
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_STORAGE_ENGINE_HPP_
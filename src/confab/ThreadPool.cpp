@@ -0,0 +1,82 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace Confab {
+
+ThreadPool::ThreadPool(size_t numThreads) :
+    m_highPriorityRun(0),
+    m_quit(false) {
+    numThreads = std::max(numThreads, static_cast<size_t>(1));
+    m_threads.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        m_threads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+bool ThreadPool::post(Priority priority, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_quit) {
+            return false;
+        }
+        m_queues[priority].push_back(std::move(task));
+    }
+    m_condition.notify_one();
+    return true;
+}
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_threads.clear();
+}
+
+size_t ThreadPool::queueDepth() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queues[kHighPriority].size() + m_queues[kLowPriority].size();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] {
+                return m_quit || !m_queues[kHighPriority].empty() || !m_queues[kLowPriority].empty();
+            });
+
+            auto& high = m_queues[kHighPriority];
+            auto& low = m_queues[kLowPriority];
+            if (high.empty() && low.empty()) {
+                // Only reachable once m_quit is set, after the queues have drained.
+                return;
+            }
+
+            if (!high.empty() && (low.empty() || m_highPriorityRun < kHighPriorityBurst)) {
+                task = std::move(high.front());
+                high.pop_front();
+                ++m_highPriorityRun;
+            } else {
+                task = std::move(low.front());
+                low.pop_front();
+                m_highPriorityRun = 0;
+            }
+        }
+        task();
+    }
+}
+
+}  // namespace Confab
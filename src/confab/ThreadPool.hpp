@@ -0,0 +1,84 @@
+#ifndef SRC_CONFAB_THREAD_POOL_HPP_
+#define SRC_CONFAB_THREAD_POOL_HPP_
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Confab {
+
+/*! Fixed-size pool of worker threads serving tasks from prioritized queues.
+ *
+ * Tasks are queued into one of two lanes. Workers always prefer the high priority lane, but to keep the low priority
+ * lane from starving under sustained load a waiting low priority task is run after every kHighPriorityBurst
+ * consecutive high priority tasks.
+ */
+class ThreadPool {
+public:
+    /*! Task queues, in order of preference.
+     */
+    enum Priority : size_t {
+        /*! Small, latency-sensitive work such as metadata lookups.
+         */
+        kHighPriority = 0,
+
+        /*! Bulk work such as data chunk transfers.
+         */
+        kLowPriority = 1
+    };
+
+    /*! Number of consecutive high priority tasks run before a waiting low priority task is given a turn.
+     */
+    static constexpr size_t kHighPriorityBurst = 8;
+
+    /*! Constructs a ThreadPool and starts its worker threads.
+     *
+     * \param numThreads The number of worker threads to start, at least one thread is always started.
+     */
+    explicit ThreadPool(size_t numThreads);
+
+    /*! Destructs a ThreadPool, calling shutdown() if it has not yet been called.
+     */
+    ~ThreadPool();
+
+    /*! Queues a task for execution on a worker thread.
+     *
+     * \param priority Which lane to queue the task on.
+     * \param task The function to call. Tasks posted after shutdown() are dropped.
+     * \return true if the task was queued, false if the pool is shut down.
+     */
+    bool post(Priority priority, std::function<void()> task);
+
+    /*! Stops accepting new tasks, waits for all queued tasks to complete, then joins the worker threads.
+     */
+    void shutdown();
+
+    /*! The number of tasks waiting in all lanes, not including those currently running.
+     *
+     * \return The count of queued tasks.
+     */
+    size_t queueDepth() const;
+
+    /// @cond UNDOCUMENTED
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    /// @endcond UNDOCUMENTED
+
+private:
+    void workerLoop();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::array<std::deque<std::function<void()>>, 2> m_queues;
+    size_t m_highPriorityRun;
+    bool m_quit;
+    std::vector<std::thread> m_threads;
+};
+
+}  // namespace Confab
+
+#endif  // SRC_CONFAB_THREAD_POOL_HPP_
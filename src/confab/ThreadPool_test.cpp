@@ -0,0 +1,79 @@
+#include "ThreadPool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <vector>
+
+TEST(ThreadPoolTest, RunsAllTasksBeforeShutdown) {
+    std::atomic<int> count(0);
+    {
+        Confab::ThreadPool pool(4);
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_TRUE(pool.post(i % 2 ? Confab::ThreadPool::kHighPriority : Confab::ThreadPool::kLowPriority,
+                [&count] { ++count; }));
+        }
+        pool.shutdown();
+        EXPECT_FALSE(pool.post(Confab::ThreadPool::kHighPriority, [&count] { ++count; }));
+    }
+    EXPECT_EQ(100, count);
+}
+
+TEST(ThreadPoolTest, HighPriorityRunsFirst) {
+    Confab::ThreadPool pool(1);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> start;
+    // Occupy the only worker so the following tasks all queue up.
+    pool.post(Confab::ThreadPool::kHighPriority, [released, &start] {
+        start.set_value();
+        released.wait();
+    });
+    start.get_future().wait();
+
+    std::mutex orderMutex;
+    std::vector<int> order;
+    auto record = [&orderMutex, &order](int value) {
+        return [&orderMutex, &order, value] {
+            std::lock_guard<std::mutex> lock(orderMutex);
+            order.push_back(value);
+        };
+    };
+    pool.post(Confab::ThreadPool::kLowPriority, record(0));
+    pool.post(Confab::ThreadPool::kHighPriority, record(1));
+    pool.post(Confab::ThreadPool::kHighPriority, record(2));
+    EXPECT_EQ(3, pool.queueDepth());
+
+    release.set_value();
+    pool.shutdown();
+    EXPECT_EQ(std::vector<int>({1, 2, 0}), order);
+}
+
+TEST(ThreadPoolTest, LowPriorityNotStarved) {
+    Confab::ThreadPool pool(1);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    pool.post(Confab::ThreadPool::kHighPriority, [released] { released.wait(); });
+
+    std::mutex orderMutex;
+    std::vector<int> order;
+    pool.post(Confab::ThreadPool::kLowPriority, [&orderMutex, &order] {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order.push_back(-1);
+    });
+    for (int i = 0; i < 20; ++i) {
+        pool.post(Confab::ThreadPool::kHighPriority, [&orderMutex, &order, i] {
+            std::lock_guard<std::mutex> lock(orderMutex);
+            order.push_back(i);
+        });
+    }
+
+    release.set_value();
+    pool.shutdown();
+    ASSERT_EQ(21, order.size());
+    // The blocking task counted as the first of the burst, so the low priority task runs after kHighPriorityBurst - 1
+    // more high priority tasks.
+    EXPECT_EQ(-1, order[Confab::ThreadPool::kHighPriorityBurst - 1]);
+}
@@ -0,0 +1,82 @@
+#include "AsyncAssetDatabase.hpp"
+#include "ConfabCommon.hpp"
+#include "Constants.hpp"
+#include "HttpEndpoint.hpp"
+#include "common/Version.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include <experimental/filesystem>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+DEFINE_int32(http_port, 9080, "TCP port to listen on for HTTP requests from confab clients and standby servers.");
+DEFINE_int32(http_threads, 4, "Number of threads listening for HTTP requests.");
+DEFINE_int32(database_threads, 0, "Number of threads running database requests, or 0 to use one per processor.");
+DEFINE_int32(catalog_interval_minutes, 60, "Minutes between exports of the Asset catalog that clients download at "
+    "startup, or 0 to not publish a catalog.");
+DEFINE_int32(scrub_rate_mb, 0, "Megabytes per second of Asset data the background integrity scrubber may read, or 0 "
+    "to not scrub.");
+DEFINE_int32(scrub_interval_hours, 24, "Hours to wait between complete integrity scrubbing passes over the database.");
+DEFINE_string(backup_directory, "", "If set, a directory to write online backup archives into when one is requested "
+    "with a POST to /admin/backup. If empty, backups are disabled.");
+DEFINE_int32(backup_block_kb, 4096, "Approximate size in kilobytes of each block of a backup archive.");
+
+int main(int argc, char* argv[]) {
+    Confab::ConfabCommon common;
+    if (!common.initialize(argc, argv)) {
+        return -1;
+    }
+
+    LOG(INFO) << "Starting confab-asset-server v" << Confab::confabVersion.toString() << " on pid " << getpid();
+
+    size_t databaseThreads = FLAGS_database_threads > 0 ? FLAGS_database_threads :
+        std::max(1u, std::thread::hardware_concurrency());
+    std::shared_ptr<Confab::AsyncAssetDatabase> assetDatabase(new Confab::AsyncAssetDatabase(common.assetDatabase(),
+        databaseThreads));
+    Confab::HttpEndpoint endpoint(FLAGS_http_port, std::max(FLAGS_http_threads, 1), assetDatabase);
+
+    if (FLAGS_catalog_interval_minutes > 0) {
+        endpoint.startCatalogPublisher(FLAGS_data_directory + "/catalog",
+            std::chrono::minutes(FLAGS_catalog_interval_minutes));
+    }
+
+    if (FLAGS_scrub_rate_mb > 0) {
+        endpoint.startScrubber(static_cast<size_t>(FLAGS_scrub_rate_mb) * 1024 * 1024,
+            std::chrono::hours(std::max(FLAGS_scrub_interval_hours, 0)));
+    }
+
+    if (!FLAGS_backup_directory.empty()) {
+        std::error_code error;
+        std::experimental::filesystem::create_directories(FLAGS_backup_directory, error);
+        if (error) {
+            LOG(ERROR) << "unable to create backup directory " << FLAGS_backup_directory << ", backups disabled: "
+                << error.message();
+        } else {
+            LOG(INFO) << "online backups enabled into " << FLAGS_backup_directory;
+            endpoint.enableBackups(FLAGS_backup_directory,
+                static_cast<size_t>(std::max(FLAGS_backup_block_kb, 1)) * 1024);
+        }
+    }
+
+    if (!FLAGS_replicate_from.empty()) {
+        LOG(INFO) << "running as hot standby of " << FLAGS_replicate_from;
+        endpoint.startReplication(FLAGS_replicate_from,
+            std::chrono::milliseconds(std::max(FLAGS_replication_poll_ms, 1)));
+    }
+
+    LOG(INFO) << "Serving HTTP requests on port " << FLAGS_http_port << " with " << FLAGS_http_threads << " threads.";
+    endpoint.startServerThread();
+
+    common.waitForTerminationSignal();
+
+    LOG(INFO) << "Termination signal caught, stopping confab-asset-server normally.";
+    endpoint.shutdown();
+    assetDatabase->shutdown();
+    common.shutdown();
+    return 0;
+}
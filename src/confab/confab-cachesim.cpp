@@ -0,0 +1,71 @@
+#include "CachePolicy.hpp"
+#include "CacheSimulator.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+DEFINE_string(trace_file, "", "Path of an Asset access trace, as recorded by confab with --cache_trace_file.");
+DEFINE_string(policies, "lru,lfu,gdsf,tinylfu", "Comma-separated list of cache policies to simulate.");
+DEFINE_string(cache_sizes_gb, "4", "Comma-separated list of cache sizes in gigabytes to simulate each policy at, "
+    "which can be fractional.");
+
+namespace {
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    FLAGS_logtostderr = true;
+    google::InitGoogleLogging(argv[0]);
+
+    std::vector<Confab::CacheTraceRecord> trace;
+    if (FLAGS_trace_file.empty() || !Confab::readCacheTrace(FLAGS_trace_file, &trace)) {
+        LOG(ERROR) << "unable to read trace file " << FLAGS_trace_file;
+        return -1;
+    }
+
+    std::vector<uint64_t> capacities;
+    for (const auto& size : splitList(FLAGS_cache_sizes_gb)) {
+        double gigabytes = std::stod(size);
+        if (gigabytes <= 0.0) {
+            LOG(ERROR) << "bad cache size " << size;
+            return -1;
+        }
+        capacities.push_back(static_cast<uint64_t>(gigabytes * 1024.0 * 1024.0 * 1024.0));
+    }
+
+    std::printf("%zu requests\n", trace.size());
+    std::printf("%-10s %12s %12s %12s %12s\n", "policy", "size (GB)", "object hits", "byte hits", "evictions");
+    for (auto capacity : capacities) {
+        for (const auto& name : splitList(FLAGS_policies)) {
+            std::unique_ptr<Confab::CachePolicy> policy = Confab::makeCachePolicy(name, capacity);
+            if (!policy) {
+                LOG(ERROR) << "unknown cache policy " << name;
+                return -1;
+            }
+            Confab::CacheSimulation simulation = Confab::simulateCache(policy.get(), capacity, trace);
+            std::printf("%-10s %12.2f %11.2f%% %11.2f%% %12llu\n", name.c_str(),
+                static_cast<double>(capacity) / (1024.0 * 1024.0 * 1024.0), 100.0 * simulation.objectHitRatio(),
+                100.0 * simulation.byteHitRatio(), static_cast<unsigned long long>(simulation.evictions));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include "Asset.hpp"
+#include "AssetDatabase.hpp"
+#include "ConfabCommon.hpp"
+#include "Constants.hpp"
+#include "SizedPointer.hpp"
+#include "ThreadPool.hpp"
+#include "common/Version.hpp"
+#include "schemas/FlatAssetData_generated.h"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "xxhash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <experimental/filesystem>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+DEFINE_string(import_directory, "", "Path of a directory tree to import. Every regular file in it is stored as an "
+    "Asset, named by its path relative to the directory without the file extension.");
+DEFINE_string(import_type, "sample", "Asset type of the imported files, one of snippet, image, yaml, or sample.");
+DEFINE_string(import_list_ids, "", "Comma-separated list of List keys to add every imported Asset to.");
+DEFINE_int32(import_threads, 0, "Number of threads hashing and chunking files, or 0 to use one per processor.");
+DEFINE_int32(import_batch_mb, 4, "Size in megabytes of each database write batch.");
+DEFINE_string(restore_backup, "", "Path of a backup archive, written by a server through /admin/backup, to restore "
+    "into an empty database instead of importing a directory. Uses --import_threads and --import_sync.");
+DEFINE_bool(import_sync, false, "If true each write batch waits for the data to reach stable storage. Slower, but "
+    "an interrupted import loses nothing already reported as imported.");
+
+namespace {
+
+/*! Hands out BulkWriters to import tasks, so that small files imported on different threads share large batches
+ * instead of each writing its own.
+ */
+class WriterPool {
+public:
+    WriterPool(std::shared_ptr<Confab::AssetDatabase> assetDatabase, size_t maxBatchBytes, bool sync) :
+        m_assetDatabase(assetDatabase),
+        m_maxBatchBytes(maxBatchBytes),
+        m_sync(sync) {
+    }
+
+    std::unique_ptr<Confab::AssetDatabase::BulkWriter> acquire() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_writers.empty()) {
+            return m_assetDatabase->makeBulkWriter(m_maxBatchBytes, m_sync);
+        }
+        auto writer = std::move(m_writers.back());
+        m_writers.pop_back();
+        return writer;
+    }
+
+    void release(std::unique_ptr<Confab::AssetDatabase::BulkWriter> writer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writers.push_back(std::move(writer));
+    }
+
+    /*! Flushes every writer, returning false if any flush failed.
+     */
+    bool flushAll(uint64_t* bytesWritten) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool ok = true;
+        *bytesWritten = 0;
+        for (auto& writer : m_writers) {
+            ok = writer->flush() && ok;
+            *bytesWritten += writer->bytesWritten();
+        }
+        return ok;
+    }
+
+private:
+    std::shared_ptr<Confab::AssetDatabase> m_assetDatabase;
+    size_t m_maxBatchBytes;
+    bool m_sync;
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Confab::AssetDatabase::BulkWriter>> m_writers;
+};
+
+/*! Imports a single file as an Asset, adding its data chunks and then its FlatAsset record to writer. Returns the Asset
+ * key, or 0 on error.
+ */
+uint64_t importFile(const fs::path& file, const std::string& name, Confab::AssetDatabase::BulkWriter* writer) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "error opening file " << file << " for import.";
+        return 0;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        LOG(ERROR) << "rejecting import of empty or unreadable file " << file;
+        ::close(fd);
+        return 0;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG(ERROR) << "failed to map file " << file << " for import.";
+        return 0;
+    }
+    // Both passes below read the file front to back, so the mapping lets the file come off the disk only once.
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+    const uint8_t* fileData = static_cast<const uint8_t*>(mapped);
+
+    // The Asset key is the hash of the entire file, and is needed to store the first chunk, so hash the whole file
+    // first and then hash it again incrementally while chunking.
+    uint64_t key = XXH64(fileData, fileSize, 0);
+
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    flatbuffers::FlatBufferBuilder builder(Confab::kPageSize);
+    bool ok = true;
+    uint64_t chunkHash = 0;
+    size_t chunk = 0;
+    for (size_t offset = 0; ok && offset < fileSize; offset += Confab::kDataChunkSize) {
+        size_t chunkSize = std::min(Confab::kDataChunkSize, fileSize - offset);
+        builder.Clear();
+        auto flatData = builder.CreateVector(fileData + offset, chunkSize);
+        XXH64_update(hashState, fileData + offset, chunkSize);
+        chunkHash = XXH64_digest(hashState);
+        Confab::Data::FlatAssetDataBuilder assetDataBuilder(builder);
+        assetDataBuilder.add_data(flatData);
+        assetDataBuilder.add_hash(chunkHash);
+        builder.Finish(assetDataBuilder.Finish());
+        ok = writer->addAssetDataChunk(key, chunk, Confab::SizedPointer(builder.GetBufferPointer(),
+            builder.GetSize()));
+        ++chunk;
+    }
+    XXH64_freeState(hashState);
+    munmap(mapped, fileSize);
+
+    if (!ok || chunkHash != key) {
+        LOG(ERROR) << "error importing data chunks of file " << file;
+        return 0;
+    }
+
+    // The Asset record is added after all of its chunks, so it is never written to the database without them.
+    Confab::Asset asset(Confab::Asset::typeStringToEnum(FLAGS_import_type));
+    asset.setKey(key);
+    asset.setName(name);
+    asset.setFileExtension(file.extension());
+    asset.setSize(fileSize);
+    asset.setChunks((fileSize / Confab::kDataChunkSize) + 1);
+    asset.parseListIds(FLAGS_import_list_ids);
+    builder.Clear();
+    asset.flatten(builder);
+    if (!writer->addAsset(key, Confab::SizedPointer(builder.GetBufferPointer(), builder.GetSize()))) {
+        LOG(ERROR) << "error importing Asset record of file " << file;
+        return 0;
+    }
+    return key;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Confab::ConfabCommon common;
+    if (!common.initialize(argc, argv)) {
+        return -1;
+    }
+
+    LOG(INFO) << "Starting confab-import v" << Confab::confabVersion.toString() << " on pid " << getpid();
+
+    size_t threads = FLAGS_import_threads > 0 ? FLAGS_import_threads :
+        std::max(1u, std::thread::hardware_concurrency());
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (!FLAGS_restore_backup.empty()) {
+        LOG(INFO) << "restoring backup " << FLAGS_restore_backup << " with " << threads << " threads.";
+        uint64_t records = 0;
+        bool restored = common.assetDatabase()->restoreBackup(FLAGS_restore_backup, threads, FLAGS_import_sync,
+            &records);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (restored) {
+            LOG(INFO) << "restored " << records << " records in " << seconds << " seconds.";
+        }
+        common.shutdown();
+        return restored ? 0 : -1;
+    }
+
+    fs::path importDirectory(FLAGS_import_directory);
+    if (FLAGS_import_directory.empty() || !fs::is_directory(importDirectory)) {
+        LOG(ERROR) << "import directory " << importDirectory << " is not a directory.";
+        common.shutdown();
+        return -1;
+    }
+    if (Confab::Asset::typeStringToEnum(FLAGS_import_type) == Confab::Asset::kInvalid) {
+        LOG(ERROR) << "unrecognized import type " << FLAGS_import_type;
+        common.shutdown();
+        return -1;
+    }
+
+    WriterPool writers(common.assetDatabase(), static_cast<size_t>(FLAGS_import_batch_mb) * 1024 * 1024,
+        FLAGS_import_sync);
+    std::atomic<uint64_t> filesImported(0);
+    std::atomic<uint64_t> filesFailed(0);
+    std::atomic<uint64_t> bytesImported(0);
+
+    LOG(INFO) << "importing " << importDirectory << " with " << threads << " threads.";
+    {
+        Confab::ThreadPool pool(threads);
+        for (const auto& entry : fs::recursive_directory_iterator(importDirectory)) {
+            if (!fs::is_regular_file(entry.status())) {
+                continue;
+            }
+            fs::path file = entry.path();
+            fs::path relative = file.string().substr(importDirectory.string().size());
+            std::string name = (relative.parent_path() / relative.stem()).string();
+            name.erase(0, name.find_first_not_of('/'));
+            pool.post(Confab::ThreadPool::kHighPriority, [&writers, &filesImported, &filesFailed, &bytesImported,
+                    file, name] {
+                auto writer = writers.acquire();
+                uint64_t key = importFile(file, name, writer.get());
+                writers.release(std::move(writer));
+                if (key) {
+                    LOG(INFO) << "imported " << file << " as Asset " << Confab::Asset::keyToString(key) << " named "
+                        << name;
+                    ++filesImported;
+                    bytesImported += fs::file_size(file);
+                } else {
+                    ++filesFailed;
+                }
+            });
+        }
+        pool.shutdown();
+    }
+
+    uint64_t bytesWritten = 0;
+    bool flushed = writers.flushAll(&bytesWritten);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG(INFO) << "imported " << filesImported << " files, " << bytesImported << " bytes in " << seconds << " seconds ("
+        << (bytesImported / (1024.0 * 1024.0)) / std::max(seconds, 0.001) << " MB/s), " << bytesWritten
+        << " bytes written to database, " << filesFailed << " files failed.";
+
+    common.shutdown();
+    return (flushed && filesFailed == 0) ? 0 : -1;
+}
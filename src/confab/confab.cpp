@@ -1,4 +1,7 @@
 #include "CacheManager.hpp"
+#include "CachePolicy.hpp"
+#include "CacheSimulator.hpp"
+#include "Catalog.hpp"
 #include "ConfabCommon.hpp"
 #include "Constants.hpp"
 #include "HttpClient.hpp"
@@ -9,18 +12,55 @@
 #include "glog/logging.h"
 
 #include <experimental/filesystem>
+#include <algorithm>
 #include <future>
 #include <memory>
+#include <thread>
 
 DEFINE_bool(validate_file_cache, true, "If true confab will check the hash of every file in the cache, removing any "
         "files that are detected corrupt.");
 
+DEFINE_int32(cache_validation_threads, 0, "Number of threads hashing cached files at startup, or 0 to use one per "
+    "processor.");
+
 DEFINE_int32(max_cache_size_gb, 4, "Maximum size of Asset file cache in gigabytes");
+DEFINE_string(cache_policy, "lru", "Policy choosing which Asset files to evict from the cache, one of lru, lfu, gdsf, "
+    "or tinylfu. Compare them on a recorded trace with confab-cachesim.");
+DEFINE_double(cache_high_watermark, 0.95, "Fraction of --max_cache_size_gb above which the background eviction thread "
+    "starts evicting Asset files.");
+DEFINE_double(cache_low_watermark, 0.85, "Fraction of --max_cache_size_gb the background eviction thread evicts down "
+    "to.");
+DEFINE_int32(cache_min_free_disk_mb, 1024, "Megabytes of disk space to keep free on the filesystem holding the cache, "
+    "evicting Asset files if needed.");
+DEFINE_string(cache_trace_file, "", "If set, a path to append a line to for every /assetLoad request, for replaying "
+    "with confab-cachesim.");
+DEFINE_string(ram_cache_path, "", "If set, a directory on a RAM-backed filesystem such as /dev/shm to copy small, "
+    "frequently loaded Asset files into, so loading them again does not read the disk. Files in it are removed at "
+    "startup.");
+DEFINE_int32(ram_cache_size_mb, 256, "Maximum size of the RAM cache tier in megabytes.");
+DEFINE_int32(ram_cache_max_asset_kb, 1024, "Largest Asset file in kilobytes to copy into the RAM cache tier.");
+DEFINE_int32(ram_cache_promote_loads, 2, "Number of recent loads of an Asset after which it is copied into the RAM "
+    "cache tier.");
 DEFINE_int32(osc_listen_port, 4248, "UDP port on localhost to listen for incoming OSC commands from SuperCollider.");
 DEFINE_int32(osc_respond_port, 4249, "UDP port on localhost to send response messages to SuperCollider.");
 
+DEFINE_bool(refresh_catalog, true, "If true confab will download the server's latest Asset catalog at startup, if it "
+    "differs from the local copy.");
+
 DEFINE_string(server_url, "http://sclork-s01.local:9080", "Address for HTTP communication with Confab server.");
 
+DEFINE_int32(download_concurrency, 8, "Number of AssetData chunk requests kept outstanding at once while downloading "
+    "a file Asset.");
+
+DEFINE_int32(prefetch_budget_mb, 512, "Most megabytes of Assets downloaded by a list prefetch that does not give its "
+    "own budget, and by the prefetch of each page of a list browsed with /listNext.");
+
+DEFINE_bool(prefetch_on_browse, true, "If true confab downloads the Assets in each page of a list browsed with "
+    "/listNext into the file cache in the background.");
+
+DEFINE_bool(content_chunking, false, "If true confab uploads files split into content-defined chunks, sending only "
+    "the chunks the server does not already have.");
+
 int main(int argc, char* argv[]) {
     Confab::ConfabCommon common;
     if (!common.initialize(argc, argv)) {
@@ -29,25 +69,78 @@ int main(int argc, char* argv[]) {
 
     LOG(INFO) << "Starting confab v" << Confab::confabVersion.toString() << " on pid " << getpid();
 
-    std::shared_ptr<Confab::HttpClient> httpClient(new Confab::HttpClient(FLAGS_server_url));
+    size_t downloadConcurrency = std::max(FLAGS_download_concurrency, 1);
+    std::shared_ptr<Confab::HttpClient> httpClient(new Confab::HttpClient(FLAGS_server_url, downloadConcurrency));
+    httpClient->setContentChunking(FLAGS_content_chunking);
     uint64_t maxCache = static_cast<uint64_t>(FLAGS_max_cache_size_gb) * 1024ULL * 1024ULL * 1024ULL;
     std::shared_ptr<Confab::CacheManager> cacheManager(new Confab::CacheManager(FLAGS_data_directory + "/cache",
         maxCache, httpClient));
-    std::async(std::launch::async, [&cacheManager] {
-        cacheManager->checkExistingEntries(FLAGS_validate_file_cache);
+    cacheManager->setDownloadConcurrency(downloadConcurrency);
+    std::unique_ptr<Confab::CachePolicy> cachePolicy = Confab::makeCachePolicy(FLAGS_cache_policy, maxCache);
+    if (!cachePolicy) {
+        LOG(ERROR) << "unknown --cache_policy " << FLAGS_cache_policy;
+        common.shutdown();
+        return -1;
+    }
+    cacheManager->setPolicy(std::move(cachePolicy));
+    if (!FLAGS_ram_cache_path.empty()) {
+        cacheManager->setRamTier(FLAGS_ram_cache_path, static_cast<size_t>(FLAGS_ram_cache_size_mb) * 1024 * 1024,
+            static_cast<size_t>(FLAGS_ram_cache_max_asset_kb) * 1024, std::max(FLAGS_ram_cache_promote_loads, 1));
+    }
+    cacheManager->startEvictionThread(FLAGS_cache_high_watermark, FLAGS_cache_low_watermark,
+        static_cast<size_t>(std::max(FLAGS_cache_min_free_disk_mb, 0)) * 1024 * 1024);
+    // Cached files are usable as soon as each is validated, so serve requests while the rest of the cache is checked.
+    size_t validationThreads = FLAGS_cache_validation_threads > 0 ? FLAGS_cache_validation_threads :
+        std::max(1u, std::thread::hardware_concurrency());
+    std::future<void> cacheCheck = std::async(std::launch::async, [&cacheManager, validationThreads] {
+        cacheManager->checkExistingEntries(FLAGS_validate_file_cache, validationThreads);
     });
 
     LOG(INFO) << "Opening up OSC ports for listen on " << FLAGS_osc_listen_port << " and respond on "
         << FLAGS_osc_respond_port;
     Confab::OscHandler osc(FLAGS_osc_listen_port, FLAGS_osc_respond_port, common.assetDatabase(), httpClient,
         cacheManager);
+    osc.setPrefetch(static_cast<uint64_t>(std::max(FLAGS_prefetch_budget_mb, 0)) * 1024ULL * 1024ULL,
+        FLAGS_prefetch_on_browse);
+    if (!FLAGS_cache_trace_file.empty()) {
+        std::shared_ptr<Confab::CacheTraceWriter> trace(new Confab::CacheTraceWriter);
+        if (trace->open(FLAGS_cache_trace_file)) {
+            osc.setAccessTrace(trace);
+        } else {
+            LOG(ERROR) << "unable to open cache trace file " << FLAGS_cache_trace_file;
+        }
+    }
+    // Map any catalog from a previous run first, so that lookups can be answered from it without waiting on the
+    // network, then check the server for a newer one in the background.
+    fs::path catalogPath = FLAGS_data_directory + "/catalog";
+    std::shared_ptr<Confab::Catalog> catalog(new Confab::Catalog);
+    if (catalog->open(catalogPath, false)) {
+        osc.setCatalog(catalog);
+    }
+    std::future<void> catalogRefresh;
+    if (FLAGS_refresh_catalog) {
+        catalogRefresh = std::async(std::launch::async, [&osc, &httpClient, &catalogPath, catalog] {
+            if (httpClient->downloadCatalog(catalogPath, catalog->checksum())) {
+                std::shared_ptr<Confab::Catalog> freshCatalog(new Confab::Catalog);
+                if (freshCatalog->open(catalogPath, false)) {
+                    osc.setCatalog(freshCatalog);
+                }
+            }
+        });
+    }
+
     osc.run();
 
     common.waitForTerminationSignal();
 
     LOG(INFO) << "Termination signal caught, stopping confab normally.";
     osc.shutdown();
+    if (catalogRefresh.valid()) {
+        catalogRefresh.wait();
+    }
     httpClient->shutdown();
+    cacheCheck.wait();
+    cacheManager->shutdown();
     common.shutdown();
     return 0;
 }